@@ -0,0 +1,211 @@
+//
+//  EZAudioDriftCompensatorTests.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+// Drives an EZAudioDriftCompensator with synthetic sources whose clocks run a
+// known number of ppm off the master's and checks that it finds the drift and
+// keeps the source aligned. Both clocks are simulated, so this runs offline in
+// a fraction of the simulated time.
+
+#include "EZAudioDriftCompensator.h"
+#include <math.h>
+#include <stdio.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//------------------------------------------------------------------------------
+
+static const double   EZAudioDriftCompensatorTestsSampleRate = 48000.0;
+static const double   EZAudioDriftCompensatorTestsFrequency  = 997.0;
+static const uint32_t EZAudioDriftCompensatorTestsLatency    = 2048;
+static const double   EZAudioDriftCompensatorTestsBandwidth  = 4.0;
+static const double   EZAudioDriftCompensatorTestsDuration   = 180.0;
+static const double   EZAudioDriftCompensatorTestsSettleTime = 60.0;
+
+// what a pass has to meet once settled
+static const double EZAudioDriftCompensatorTestsMaximumDriftError     = 1.0;   // ppm
+static const double EZAudioDriftCompensatorTestsMaximumAlignmentError = 2.0;   // master frames
+static const double EZAudioDriftCompensatorTestsMaximumResidual       = -60.0; // dB below the tone
+
+//------------------------------------------------------------------------------
+
+typedef struct
+{
+    double   ppm;
+    uint32_t sourceFrames;
+    uint32_t masterFrames;
+} EZAudioDriftCompensatorTestsCase;
+
+//------------------------------------------------------------------------------
+
+// fits the tone to a window of output, giving its phase in cycles and the power left over
+static void EZAudioDriftCompensatorTestsFit(const float *output,
+                                            uint32_t frames,
+                                            double startTime,
+                                            double *phase,
+                                            double *residual,
+                                            double *power)
+{
+    double sine = 0.0, cosine = 0.0;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        double angle = 2.0 * M_PI * EZAudioDriftCompensatorTestsFrequency * (startTime + i / EZAudioDriftCompensatorTestsSampleRate);
+        sine   += output[i] * sin(angle);
+        cosine += output[i] * cos(angle);
+    }
+    double a = 2.0 * sine / frames, b = 2.0 * cosine / frames;
+    *phase = atan2(b, a) / (2.0 * M_PI);
+    double error = 0.0;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        double angle = 2.0 * M_PI * EZAudioDriftCompensatorTestsFrequency * (startTime + i / EZAudioDriftCompensatorTestsSampleRate);
+        double difference = output[i] - (a * sin(angle) + b * cos(angle));
+        error += difference * difference;
+    }
+    *residual = error / frames;
+    *power    = 0.5 * (a * a + b * b);
+}
+
+//------------------------------------------------------------------------------
+
+static int EZAudioDriftCompensatorTestsRun(EZAudioDriftCompensatorTestsCase testCase)
+{
+    double masterRate = EZAudioDriftCompensatorTestsSampleRate;
+    double sourceRate = masterRate * (1.0 + testCase.ppm * 1.0e-6);
+    EZAudioDriftCompensator *compensator = EZAudioDriftCompensatorCreate(1,
+                                                                         masterRate,
+                                                                         1.0,
+                                                                         EZAudioDriftCompensatorTestsLatency,
+                                                                         EZAudioDriftCompensatorTestsBandwidth);
+    if (!compensator)
+    {
+        printf("FAIL %+7.1f ppm: couldn't create the compensator\n", testCase.ppm);
+        return 1;
+    }
+
+    // a second of output at a time is fitted against the tone on the master's clock
+    static float input[4096], output[4096], window[48000];
+    const float *source[1]      = { input };
+    float       *destination[1] = { output };
+    uint32_t windowFrames = (uint32_t)masterRate, windowFill = 0;
+    double   windowStart  = 0.0;
+
+    uint64_t sourceFrame = 0, masterFrame = 0;
+    double   sourceTime  = 0.0, masterTime = 0.0;
+    double   firstPhase  = 0.0, alignmentError = 0.0, worstResidual = -INFINITY;
+    uint32_t settledUnderruns = 0;
+    int      settledWindows = 0;
+    while (masterTime < EZAudioDriftCompensatorTestsDuration)
+    {
+        // each side delivers whenever its own clock says a block is due
+        if (sourceTime <= masterTime)
+        {
+            for (uint32_t i = 0; i < testCase.sourceFrames; i++)
+            {
+                input[i] = (float)(0.5 * sin(2.0 * M_PI * EZAudioDriftCompensatorTestsFrequency * (double)(sourceFrame + i) / sourceRate));
+            }
+            EZAudioDriftCompensatorWrite(compensator, source, testCase.sourceFrames, sourceTime);
+            sourceFrame += testCase.sourceFrames;
+            sourceTime   = sourceFrame / sourceRate;
+            continue;
+        }
+
+        EZAudioDriftCompensatorRead(compensator, destination, testCase.masterFrames, masterTime);
+        for (uint32_t i = 0; i < testCase.masterFrames; i++)
+        {
+            if (windowFill == 0)
+            {
+                windowStart = (masterFrame + i) / masterRate;
+            }
+            window[windowFill++] = output[i];
+            if (windowFill == windowFrames)
+            {
+                windowFill = 0;
+                if (windowStart < EZAudioDriftCompensatorTestsSettleTime)
+                {
+                    settledUnderruns = EZAudioDriftCompensatorUnderruns(compensator);
+                    continue;
+                }
+                double phase, residual, power;
+                EZAudioDriftCompensatorTestsFit(window, windowFrames, windowStart, &phase, &residual, &power);
+                if (settledWindows++ == 0)
+                {
+                    firstPhase = phase;
+                }
+                // how far the source wandered from where it was when it settled
+                double wander = phase - firstPhase;
+                wander -= floor(wander + 0.5);
+                wander  = fabs(wander) * masterRate / EZAudioDriftCompensatorTestsFrequency;
+                alignmentError = wander > alignmentError ? wander : alignmentError;
+                double residualDecibels = 10.0 * log10(residual / power);
+                worstResidual = residualDecibels > worstResidual ? residualDecibels : worstResidual;
+            }
+        }
+        masterFrame += testCase.masterFrames;
+        masterTime   = masterFrame / masterRate;
+    }
+
+    double   drift      = EZAudioDriftCompensatorDrift(compensator);
+    double   driftError = fabs(drift - testCase.ppm);
+    uint32_t underruns  = EZAudioDriftCompensatorUnderruns(compensator) - settledUnderruns;
+    int failed = driftError > EZAudioDriftCompensatorTestsMaximumDriftError ||
+                 alignmentError > EZAudioDriftCompensatorTestsMaximumAlignmentError ||
+                 worstResidual > EZAudioDriftCompensatorTestsMaximumResidual ||
+                 underruns > 0;
+    printf("%s %+7.1f ppm, blocks %4u/%4u: estimated %+8.2f ppm, alignment within %.2f frames, residual %.1f dB, %u underruns once settled\n",
+           failed ? "FAIL" : "ok  ",
+           testCase.ppm,
+           testCase.sourceFrames,
+           testCase.masterFrames,
+           drift,
+           alignmentError,
+           worstResidual,
+           underruns);
+    EZAudioDriftCompensatorFree(compensator);
+    return failed;
+}
+
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+    // typical crystal offsets either way, with device block sizes that don't line up
+    const EZAudioDriftCompensatorTestsCase cases[] =
+    {
+        {    0.0,  256,  512 },
+        {  100.0,  256,  512 },
+        { -250.0,  512,  441 },
+        {  500.0, 1024,  256 },
+        {   37.5,  480,  512 },
+        { -800.0,  128, 1024 },
+    };
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        failures += EZAudioDriftCompensatorTestsRun(cases[i]);
+    }
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,293 @@
+//
+//  EZAudioFLACEncoderBenchmark.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+// Times EZAudioFLACEncoder against writing the same audio as a WAV file with
+// EZAudioWAVWriter, and reports how much smaller the FLAC file comes out. The
+// audio is synthetic unless a file of raw interleaved 32-bit float samples is
+// given, i.e. one dumped from a recording:
+//
+//   EZAudioFLACEncoderBenchmark [samples.f32 channels sampleRate]
+//
+// Files are written to $TMPDIR (or /tmp) and removed afterwards.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "EZAudioFLACEncoder.h"
+#include "EZAudioWAVWriter.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//------------------------------------------------------------------------------
+
+static const double   EZAudioFLACEncoderBenchmarkSampleRate  = 44100.0;
+static const double   EZAudioFLACEncoderBenchmarkDuration    = 60.0;
+static const uint32_t EZAudioFLACEncoderBenchmarkBufferFrames = 512;
+static const uint32_t EZAudioFLACEncoderBenchmarkMaximumChannels = 8;
+
+//------------------------------------------------------------------------------
+
+static double EZAudioFLACEncoderBenchmarkNow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1.0e-9;
+}
+
+//------------------------------------------------------------------------------
+
+static uint64_t EZAudioFLACEncoderBenchmarkFileSize(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size > 0 ? (uint64_t)size : 0;
+}
+
+//------------------------------------------------------------------------------
+
+// a few decaying notes with harmonics over quiet noise and a stretch of near
+// silence, closer to a recording than a pure tone or white noise
+static void EZAudioFLACEncoderBenchmarkSynthesize(float **samples,
+                                                  uint32_t channels,
+                                                  uint32_t frames,
+                                                  double sampleRate)
+{
+    const double notes[] = { 220.0, 277.18, 329.63, 440.0, 246.94, 196.0 };
+    srand(1);
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        double time = i / sampleRate;
+        int    note = (int)time % (int)(sizeof(notes) / sizeof(notes[0]));
+        double age  = fmod(time, 1.0);
+        double tone = 0.0;
+        for (int harmonic = 1; harmonic <= 4; harmonic++)
+        {
+            tone += sin(2.0 * M_PI * notes[note] * harmonic * time) / harmonic;
+        }
+        tone *= 0.25 * exp(-3.0 * age);
+        if (fmod(time, 20.0) > 17.0)
+        {
+            tone *= 0.001;
+        }
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            float noise = (rand() / (float)RAND_MAX - 0.5f) * 0.002f;
+            samples[channel][i] = (float)(tone * (1.0 - 0.2 * channel)) + noise;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static int EZAudioFLACEncoderBenchmarkLoad(const char *path,
+                                           float **samples,
+                                           uint32_t channels,
+                                           uint32_t *frames)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    *frames = (uint32_t)(size / (long)(channels * sizeof(float)));
+    float *interleaved = malloc((size_t)*frames * channels * sizeof(float));
+    if (!interleaved || fread(interleaved, sizeof(float) * channels, *frames, file) != *frames)
+    {
+        free(interleaved);
+        fclose(file);
+        return 0;
+    }
+    fclose(file);
+    for (uint32_t channel = 0; channel < channels; channel++)
+    {
+        samples[channel] = malloc((size_t)*frames * sizeof(float));
+        if (!samples[channel])
+        {
+            free(interleaved);
+            return 0;
+        }
+        for (uint32_t i = 0; i < *frames; i++)
+        {
+            samples[channel][i] = interleaved[(size_t)i * channels + channel];
+        }
+    }
+    free(interleaved);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderBenchmarkReport(const char *name,
+                                              double elapsed,
+                                              uint64_t bytes,
+                                              uint64_t pcmBytes,
+                                              uint32_t frames,
+                                              double sampleRate)
+{
+    printf("%-32s %5.0fx realtime, %6.2f MB, %5.1f%% of PCM\n",
+           name,
+           (frames / sampleRate) / elapsed,
+           bytes / 1.0e6,
+           100.0 * bytes / pcmBytes);
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    uint32_t channels   = 2;
+    double   sampleRate = EZAudioFLACEncoderBenchmarkSampleRate;
+    uint32_t frames     = (uint32_t)(sampleRate * EZAudioFLACEncoderBenchmarkDuration);
+    float   *samples[EZAudioFLACEncoderBenchmarkMaximumChannels];
+    if (argc == 4)
+    {
+        channels   = (uint32_t)atoi(argv[2]);
+        sampleRate = atof(argv[3]);
+        if (channels < 1 || channels > EZAudioFLACEncoderBenchmarkMaximumChannels || sampleRate <= 0.0 ||
+            !EZAudioFLACEncoderBenchmarkLoad(argv[1], samples, channels, &frames))
+        {
+            fprintf(stderr, "couldn't read %u channels of float samples from %s\n", channels, argv[1]);
+            return 1;
+        }
+    }
+    else if (argc == 1)
+    {
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            samples[channel] = malloc(frames * sizeof(float));
+            if (!samples[channel])
+            {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+        }
+        EZAudioFLACEncoderBenchmarkSynthesize(samples, channels, frames, sampleRate);
+    }
+    else
+    {
+        fprintf(stderr, "usage: %s [samples.f32 channels sampleRate]\n", argv[0]);
+        return 1;
+    }
+
+    const char *directory = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    char flacPath[1024], wavPath[1024];
+    snprintf(flacPath, sizeof(flacPath), "%s/EZAudioFLACEncoderBenchmark.flac", directory);
+    snprintf(wavPath, sizeof(wavPath), "%s/EZAudioFLACEncoderBenchmark.wav", directory);
+    printf("%.1f s of %u channel audio at %.0f Hz, written %u frames at a time\n",
+           frames / sampleRate,
+           channels,
+           sampleRate,
+           EZAudioFLACEncoderBenchmarkBufferFrames);
+
+    // the WAV files are the baseline, both for speed and size
+    const struct { const char *name; EZAudioWAVWriterSampleFormat format; uint32_t bitsPerSample; } wavs[] =
+    {
+        { "WAV 16-bit", EZAudioWAVWriterSampleFormatSInt16, 16 },
+        { "WAV 24-bit", EZAudioWAVWriterSampleFormatSInt24, 24 },
+    };
+    for (size_t w = 0; w < sizeof(wavs) / sizeof(wavs[0]); w++)
+    {
+        double start = EZAudioFLACEncoderBenchmarkNow();
+        EZAudioWAVWriter *writer = EZAudioWAVWriterCreate(wavPath, channels, sampleRate, wavs[w].format);
+        bool ok = writer != NULL;
+        for (uint32_t i = 0; ok && i < frames; i += EZAudioFLACEncoderBenchmarkBufferFrames)
+        {
+            uint32_t count = frames - i < EZAudioFLACEncoderBenchmarkBufferFrames ? frames - i : EZAudioFLACEncoderBenchmarkBufferFrames;
+            const float *buffers[EZAudioFLACEncoderBenchmarkMaximumChannels];
+            for (uint32_t channel = 0; channel < channels; channel++)
+            {
+                buffers[channel] = samples[channel] + i;
+            }
+            ok = EZAudioWAVWriterWrite(writer, buffers, count);
+        }
+        ok = writer && EZAudioWAVWriterClose(writer) && ok;
+        double elapsed = EZAudioFLACEncoderBenchmarkNow() - start;
+        if (!ok)
+        {
+            fprintf(stderr, "couldn't write %s\n", wavPath);
+            return 1;
+        }
+        uint64_t pcmBytes = (uint64_t)frames * channels * (wavs[w].bitsPerSample / 8);
+        EZAudioFLACEncoderBenchmarkReport(wavs[w].name, elapsed, EZAudioFLACEncoderBenchmarkFileSize(wavPath), pcmBytes, frames, sampleRate);
+    }
+    remove(wavPath);
+
+    const uint32_t bitDepths[] = { 16, 24 };
+    const uint32_t levels[]    = { 0, 5, 8 };
+    const uint32_t threads[]   = { 1, 4 };
+    for (size_t b = 0; b < sizeof(bitDepths) / sizeof(bitDepths[0]); b++)
+    {
+        for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++)
+        {
+            for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++)
+            {
+                double start = EZAudioFLACEncoderBenchmarkNow();
+                EZAudioFLACEncoder *encoder = EZAudioFLACEncoderCreate(flacPath, channels, sampleRate, bitDepths[b], levels[l], threads[t]);
+                bool ok = encoder != NULL;
+                for (uint32_t i = 0; ok && i < frames; i += EZAudioFLACEncoderBenchmarkBufferFrames)
+                {
+                    uint32_t count = frames - i < EZAudioFLACEncoderBenchmarkBufferFrames ? frames - i : EZAudioFLACEncoderBenchmarkBufferFrames;
+                    const float *buffers[EZAudioFLACEncoderBenchmarkMaximumChannels];
+                    for (uint32_t channel = 0; channel < channels; channel++)
+                    {
+                        buffers[channel] = samples[channel] + i;
+                    }
+                    ok = EZAudioFLACEncoderWrite(encoder, buffers, count);
+                }
+                ok = encoder && EZAudioFLACEncoderClose(encoder) && ok;
+                double elapsed = EZAudioFLACEncoderBenchmarkNow() - start;
+                if (!ok)
+                {
+                    fprintf(stderr, "couldn't write %s\n", flacPath);
+                    return 1;
+                }
+                char name[64];
+                snprintf(name, sizeof(name), "FLAC %u-bit level %u, %u thread%s", bitDepths[b], levels[l], threads[t], threads[t] == 1 ? "" : "s");
+                uint64_t pcmBytes = (uint64_t)frames * channels * (bitDepths[b] / 8);
+                EZAudioFLACEncoderBenchmarkReport(name, elapsed, EZAudioFLACEncoderBenchmarkFileSize(flacPath), pcmBytes, frames, sampleRate);
+            }
+        }
+    }
+    remove(flacPath);
+
+    for (uint32_t channel = 0; channel < channels; channel++)
+    {
+        free(samples[channel]);
+    }
+    return 0;
+}
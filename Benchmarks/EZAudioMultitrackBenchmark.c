@@ -0,0 +1,211 @@
+//
+//  EZAudioMultitrackBenchmark.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+// Finds how many channels of a multitrack recording the disk keeps up with.
+// An EZAudioBackgroundWriter with a multitrack sink writes one mono 24-bit WAV
+// file per channel, fed as fast as the ring drains, so the realtime factor
+// times the track count is the number of channels it sustains. A last run
+// paces the feed at realtime to check it records without overruns. The files
+// go to the directory given (or $TMPDIR, or /tmp) and are removed afterwards:
+//
+//   EZAudioMultitrackBenchmark [directory]
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "EZAudioBackgroundWriter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+//------------------------------------------------------------------------------
+
+static const double   EZAudioMultitrackBenchmarkSampleRate   = 48000.0;
+static const double   EZAudioMultitrackBenchmarkDuration     = 10.0;
+static const uint32_t EZAudioMultitrackBenchmarkBufferFrames = 512;
+static const uint32_t EZAudioMultitrackBenchmarkMaximumTracks = 128;
+
+//------------------------------------------------------------------------------
+
+static double EZAudioMultitrackBenchmarkNow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1.0e-9;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioMultitrackBenchmarkSleep(double seconds)
+{
+    struct timespec interval = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1.0e9) };
+    nanosleep(&interval, NULL);
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioMultitrackBenchmarkPath(char *path,
+                                           size_t size,
+                                           const char *directory,
+                                           uint32_t track)
+{
+    snprintf(path, size, "%s/EZAudioMultitrackBenchmark_%u.wav", directory, track);
+}
+
+//------------------------------------------------------------------------------
+
+static int EZAudioMultitrackBenchmarkRun(const char *directory,
+                                         float *const *buffers,
+                                         uint32_t tracks,
+                                         uint32_t threads,
+                                         int paced)
+{
+    double sampleRate = EZAudioMultitrackBenchmarkSampleRate;
+    char   path[1024];
+    EZAudioBackgroundWriterSink trackSinks[EZAudioMultitrackBenchmarkMaximumTracks];
+    for (uint32_t track = 0; track < tracks; track++)
+    {
+        EZAudioMultitrackBenchmarkPath(path, sizeof(path), directory, track);
+        EZAudioWAVWriter *wavWriter = EZAudioWAVWriterCreate(path, 1, sampleRate, EZAudioWAVWriterSampleFormatSInt24);
+        if (!wavWriter)
+        {
+            fprintf(stderr, "couldn't create %s\n", path);
+            return 1;
+        }
+        trackSinks[track] = EZAudioBackgroundWriterWAVSink(wavWriter);
+    }
+    EZAudioBackgroundWriterSink multitrackSink;
+    if (!EZAudioBackgroundWriterMultitrackSink(trackSinks, tracks, threads, &multitrackSink))
+    {
+        fprintf(stderr, "couldn't create the multitrack sink\n");
+        return 1;
+    }
+    EZAudioBackgroundWriter *writer = EZAudioBackgroundWriterCreate(multitrackSink,
+                                                                    tracks,
+                                                                    sampleRate,
+                                                                    2.0,
+                                                                    0.25,
+                                                                    EZAudioBackgroundWriterSyncPolicyInterval,
+                                                                    1.0);
+    if (!writer)
+    {
+        fprintf(stderr, "couldn't create the background writer\n");
+        return 1;
+    }
+
+    // unpaced, a full ring is retried rather than counted, since it only means the disk is behind
+    uint64_t total = (uint64_t)(EZAudioMultitrackBenchmarkDuration * sampleRate), written = 0;
+    uint32_t overruns = 0;
+    double start = EZAudioMultitrackBenchmarkNow();
+    while (written < total)
+    {
+        if (EZAudioBackgroundWriterWrite(writer, (const float *const *)buffers, EZAudioMultitrackBenchmarkBufferFrames))
+        {
+            written += EZAudioMultitrackBenchmarkBufferFrames;
+        }
+        else if (paced)
+        {
+            written += EZAudioMultitrackBenchmarkBufferFrames;
+            overruns++;
+        }
+        else
+        {
+            EZAudioMultitrackBenchmarkSleep(0.0005);
+        }
+        if (paced)
+        {
+            double ahead = start + written / sampleRate - EZAudioMultitrackBenchmarkNow();
+            if (ahead > 0.0)
+            {
+                EZAudioMultitrackBenchmarkSleep(ahead);
+            }
+        }
+    }
+    uint32_t maximumFill = EZAudioBackgroundWriterMaximumFill(writer);
+    uint32_t writeErrors = EZAudioBackgroundWriterWriteErrors(writer);
+    EZAudioBackgroundWriterClose(writer);
+    double elapsed = EZAudioMultitrackBenchmarkNow() - start;
+
+    double realtime = EZAudioMultitrackBenchmarkDuration / elapsed;
+    double bytes    = (double)written * tracks * 3;
+    if (paced)
+    {
+        printf("%3u tracks, %u thread%s, at realtime: %u overruns, ring at most %.2f s full, %u write errors\n",
+               tracks, threads, threads == 1 ? " " : "s", overruns, maximumFill / sampleRate, writeErrors);
+    }
+    else
+    {
+        printf("%3u tracks, %u thread%s: %6.1fx realtime, %6.1f MB/s, sustains ~%5.0f channels, %u write errors\n",
+               tracks, threads, threads == 1 ? " " : "s", realtime, bytes / elapsed / 1.0e6, tracks * realtime, writeErrors);
+    }
+    for (uint32_t track = 0; track < tracks; track++)
+    {
+        EZAudioMultitrackBenchmarkPath(path, sizeof(path), directory, track);
+        remove(path);
+    }
+    return writeErrors > 0 || overruns > 0;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    const char *directory = argc > 1 ? argv[1] : getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    float *buffers[EZAudioMultitrackBenchmarkMaximumTracks];
+    srand(1);
+    for (uint32_t track = 0; track < EZAudioMultitrackBenchmarkMaximumTracks; track++)
+    {
+        buffers[track] = malloc(EZAudioMultitrackBenchmarkBufferFrames * sizeof(float));
+        if (!buffers[track])
+        {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        for (uint32_t i = 0; i < EZAudioMultitrackBenchmarkBufferFrames; i++)
+        {
+            buffers[track][i] = 0.5f * (rand() / (float)RAND_MAX - 0.5f);
+        }
+    }
+
+    printf("%.0f s of 24-bit mono tracks at %.0f Hz into %s\n",
+           EZAudioMultitrackBenchmarkDuration,
+           EZAudioMultitrackBenchmarkSampleRate,
+           directory);
+    const uint32_t trackCounts[] = { 8, 32, 64, 128 };
+    const uint32_t threads[]     = { 1, 4 };
+    int failures = 0;
+    for (size_t c = 0; c < sizeof(trackCounts) / sizeof(trackCounts[0]); c++)
+    {
+        for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++)
+        {
+            failures += EZAudioMultitrackBenchmarkRun(directory, buffers, trackCounts[c], threads[t], 0);
+        }
+    }
+    failures += EZAudioMultitrackBenchmarkRun(directory, buffers, 64, 4, 1);
+
+    for (uint32_t track = 0; track < EZAudioMultitrackBenchmarkMaximumTracks; track++)
+    {
+        free(buffers[track]);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,196 @@
+//
+//  EZAudioTimeStretcherBenchmark.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+// Times EZAudioTimeStretcher on a minute of stereo audio, pulled through it in
+// 512 frame renders the way EZAudioPlayer does. Reports how many times faster
+// than realtime each quality and rate runs, and how long a render takes
+// against its 11.6 ms deadline.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "EZAudioTimeStretcher.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//------------------------------------------------------------------------------
+
+static const double   EZAudioTimeStretcherBenchmarkSampleRate  = 44100.0;
+static const double   EZAudioTimeStretcherBenchmarkDuration    = 60.0;
+static const uint32_t EZAudioTimeStretcherBenchmarkRenderFrames = 512;
+
+//------------------------------------------------------------------------------
+
+static double EZAudioTimeStretcherBenchmarkNow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1.0e-9;
+}
+
+//------------------------------------------------------------------------------
+
+static int EZAudioTimeStretcherBenchmarkCompare(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+//------------------------------------------------------------------------------
+
+// stretches the whole input, timing each render, and returns the frames produced
+static uint32_t EZAudioTimeStretcherBenchmarkRun(EZAudioTimeStretcher *timeStretcher,
+                                                 float **input,
+                                                 uint32_t inputFrames,
+                                                 float **output,
+                                                 uint32_t outputCapacity,
+                                                 double *renderTimes,
+                                                 uint32_t *renderCount)
+{
+    const uint32_t block = EZAudioTimeStretcherBenchmarkRenderFrames;
+    uint32_t readPosition = 0, outputPosition = 0;
+    int flushed = 0;
+    *renderCount = 0;
+    while (outputPosition + block <= outputCapacity)
+    {
+        double start = EZAudioTimeStretcherBenchmarkNow();
+        uint32_t rendered = 0;
+        while (rendered < block)
+        {
+            uint32_t needed = EZAudioTimeStretcherInputFramesNeeded(timeStretcher, block - rendered);
+            while (needed > 0 && readPosition < inputFrames)
+            {
+                uint32_t frames = needed < inputFrames - readPosition ? needed : inputFrames - readPosition;
+                const float *source[2] = { input[0] + readPosition, input[1] + readPosition };
+                uint32_t written = EZAudioTimeStretcherWrite(timeStretcher, source, frames);
+                readPosition += written;
+                needed       -= written;
+                if (!written)
+                {
+                    break;
+                }
+            }
+            if (readPosition >= inputFrames && !flushed)
+            {
+                EZAudioTimeStretcherFlush(timeStretcher);
+                flushed = 1;
+            }
+            float *destination[2] = { output[0] + outputPosition + rendered, output[1] + outputPosition + rendered };
+            uint32_t read = EZAudioTimeStretcherRead(timeStretcher, destination, block - rendered);
+            rendered += read;
+            if (!read)
+            {
+                break;
+            }
+        }
+        renderTimes[(*renderCount)++] = EZAudioTimeStretcherBenchmarkNow() - start;
+        outputPosition += rendered;
+        if (rendered < block)
+        {
+            break;
+        }
+    }
+    return outputPosition;
+}
+
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+    double   sampleRate  = EZAudioTimeStretcherBenchmarkSampleRate;
+    uint32_t inputFrames = (uint32_t)(sampleRate * EZAudioTimeStretcherBenchmarkDuration);
+    // the slowest rate below needs twice the input's length
+    uint32_t outputCapacity = inputFrames * 3;
+    float   *input[2], *output[2];
+    for (int channel = 0; channel < 2; channel++)
+    {
+        input[channel]  = malloc(inputFrames * sizeof(float));
+        output[channel] = calloc(outputCapacity, sizeof(float));
+    }
+    double *renderTimes = malloc((outputCapacity / EZAudioTimeStretcherBenchmarkRenderFrames + 1) * sizeof(double));
+    if (!input[0] || !input[1] || !output[0] || !output[1] || !renderTimes)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    // a few partials with a slow vibrato over a little noise, so the search has real work to do
+    srand(1);
+    for (uint32_t i = 0; i < inputFrames; i++)
+    {
+        float noise = (rand() / (float)RAND_MAX - 0.5f) * 0.05f;
+        double time = i / sampleRate;
+        input[0][i] = (float)(0.3 * sin(2.0 * M_PI * 220.0 * time) + 0.2 * sin(2.0 * M_PI * 331.0 * time + sin(i * 0.0001))) + noise;
+        input[1][i] = (float)(0.3 * sin(2.0 * M_PI * 277.0 * time)) + noise;
+    }
+
+    const char *qualities[] = { "low", "medium", "high" };
+    const double rates[]    = { 0.5, 1.0, 1.5, 2.0, 3.0 };
+    double deadline = EZAudioTimeStretcherBenchmarkRenderFrames / sampleRate;
+    printf("%.0f s of stereo at %.0f Hz in %u frame renders (%.0f us deadline)\n",
+           EZAudioTimeStretcherBenchmarkDuration,
+           sampleRate,
+           EZAudioTimeStretcherBenchmarkRenderFrames,
+           deadline * 1.0e6);
+    for (int quality = EZAudioTimeStretcherQualityLow; quality <= EZAudioTimeStretcherQualityHigh; quality++)
+    {
+        for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+        {
+            EZAudioTimeStretcher *timeStretcher = EZAudioTimeStretcherCreate(2, sampleRate, (EZAudioTimeStretcherQuality)quality);
+            EZAudioTimeStretcherSetRate(timeStretcher, rates[r]);
+            uint32_t renderCount;
+            double start = EZAudioTimeStretcherBenchmarkNow();
+            uint32_t frames = EZAudioTimeStretcherBenchmarkRun(timeStretcher,
+                                                               input,
+                                                               inputFrames,
+                                                               output,
+                                                               outputCapacity,
+                                                               renderTimes,
+                                                               &renderCount);
+            double elapsed = EZAudioTimeStretcherBenchmarkNow() - start;
+            qsort(renderTimes, renderCount, sizeof(double), EZAudioTimeStretcherBenchmarkCompare);
+            printf("%-6s rate %.1f: %6.0fx realtime, render median %4.0f us, p99.9 %4.0f us, max %5.0f us\n",
+                   qualities[quality],
+                   rates[r],
+                   (frames / sampleRate) / elapsed,
+                   renderTimes[renderCount / 2] * 1.0e6,
+                   renderTimes[(uint32_t)(renderCount * 0.999)] * 1.0e6,
+                   renderTimes[renderCount - 1] * 1.0e6);
+            EZAudioTimeStretcherFree(timeStretcher);
+        }
+    }
+
+    for (int channel = 0; channel < 2; channel++)
+    {
+        free(input[channel]);
+        free(output[channel]);
+    }
+    free(renderTimes);
+    return 0;
+}
@@ -0,0 +1,333 @@
+//
+//  EZAudioVoiceActivityDetectorBenchmark.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+// Measures how much downstream work EZAudioVoiceActivityDetector saves on an
+// always-on capture. Every 512 frame buffer is run through a stand-in for the
+// downstream consumers (a bank of band filters with their levels, about what
+// an analysis or plot costs), once for every buffer and once gated by the
+// detector the way EZMicrophone gates its delegate, pre-roll included. The
+// corpus is two minutes of synthetic speech over a noise floor, with noise
+// bursts that should be rejected, unless recordings are given as files of raw
+// mono 32-bit float samples:
+//
+//   EZAudioVoiceActivityDetectorBenchmark [sampleRate recording.f32 ...]
+//
+// Speech recall is only known for the synthetic corpus.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "EZAudioVoiceActivityDetector.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//------------------------------------------------------------------------------
+
+static const double   EZAudioVoiceActivityDetectorBenchmarkSampleRate   = 44100.0;
+static const double   EZAudioVoiceActivityDetectorBenchmarkDuration     = 120.0;
+static const uint32_t EZAudioVoiceActivityDetectorBenchmarkBufferFrames = 512;
+static const uint32_t EZAudioVoiceActivityDetectorBenchmarkBands        = 32;
+
+//------------------------------------------------------------------------------
+
+static double EZAudioVoiceActivityDetectorBenchmarkNow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1.0e-9;
+}
+
+//------------------------------------------------------------------------------
+
+static double EZAudioVoiceActivityDetectorBenchmarkGaussian(void)
+{
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Downstream
+//------------------------------------------------------------------------------
+
+typedef struct
+{
+    float  b0[32], a1[32], a2[32];
+    float  z1[32], z2[32];
+    double level;
+} EZAudioVoiceActivityDetectorBenchmarkDownstream;
+
+//------------------------------------------------------------------------------
+
+static void EZAudioVoiceActivityDetectorBenchmarkDownstreamSetup(EZAudioVoiceActivityDetectorBenchmarkDownstream *downstream,
+                                                                 double sampleRate)
+{
+    for (uint32_t band = 0; band < EZAudioVoiceActivityDetectorBenchmarkBands; band++)
+    {
+        // constant-Q bandpasses from 60 Hz up
+        double frequency = 60.0 * pow(2.0, band / 4.0);
+        double omega = 2.0 * M_PI * fmin(frequency, 0.45 * sampleRate) / sampleRate;
+        double alpha = sin(omega) / (2.0 * 4.0);
+        downstream->b0[band] = (float)(alpha / (1.0 + alpha));
+        downstream->a1[band] = (float)(-2.0 * cos(omega) / (1.0 + alpha));
+        downstream->a2[band] = (float)((1.0 - alpha) / (1.0 + alpha));
+        downstream->z1[band] = downstream->z2[band] = 0.0f;
+    }
+    downstream->level = 0.0;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioVoiceActivityDetectorBenchmarkDownstreamProcess(EZAudioVoiceActivityDetectorBenchmarkDownstream *downstream,
+                                                                   const float *buffer,
+                                                                   uint32_t frames)
+{
+    for (uint32_t band = 0; band < EZAudioVoiceActivityDetectorBenchmarkBands; band++)
+    {
+        float b0 = downstream->b0[band], a1 = downstream->a1[band], a2 = downstream->a2[band];
+        float z1 = downstream->z1[band], z2 = downstream->z2[band], sum = 0.0f;
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            // transposed direct form II of b0 * (1 - z^-2)
+            float y = b0 * buffer[i] + z1;
+            z1 = -a1 * y + z2;
+            z2 = -b0 * buffer[i] - a2 * y;
+            sum += y * y;
+        }
+        downstream->z1[band] = z1;
+        downstream->z2[band] = z2;
+        downstream->level += sum;
+    }
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Corpus
+//------------------------------------------------------------------------------
+
+// a 1.5 s utterance every 10 s over a -60 dB noise floor, and a 0.5 s noise burst (a door, a fan) every 10 s
+static void EZAudioVoiceActivityDetectorBenchmarkSynthesize(float *samples,
+                                                            char *speech,
+                                                            uint32_t frames,
+                                                            double sampleRate)
+{
+    double phase = 0.0;
+    srand(1);
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        double time = i / sampleRate;
+        double sample = 0.001 * EZAudioVoiceActivityDetectorBenchmarkGaussian();
+        double utterance = fmod(time - 2.0, 10.0);
+        speech[i] = time >= 2.0 && utterance < 1.5;
+        if (speech[i])
+        {
+            // a gliding voiced source shaped by two formants, in syllables, ending on a fricative
+            double fundamental = 120.0 + 40.0 * sin(2.0 * M_PI * 1.3 * time);
+            phase += 2.0 * M_PI * fundamental / sampleRate;
+            double voice = 0.0;
+            for (int harmonic = 1; harmonic <= 20; harmonic++)
+            {
+                double frequency = harmonic * fundamental;
+                double formants = exp(-pow((frequency - 700.0) / 300.0, 2.0)) + 0.5 * exp(-pow((frequency - 1800.0) / 400.0, 2.0)) + 0.1;
+                voice += formants * sin(harmonic * phase) / harmonic;
+            }
+            double envelope = 0.5 * (1.0 - cos(2.0 * M_PI * utterance / 1.5));
+            double syllables = 0.5 + 0.5 * sin(2.0 * M_PI * 4.0 * utterance);
+            sample += utterance > 1.3 ? 0.03 * EZAudioVoiceActivityDetectorBenchmarkGaussian() : 0.1 * envelope * syllables * voice;
+        }
+        double burst = fmod(time - 7.0, 10.0);
+        if (time >= 7.0 && burst < 0.5)
+        {
+            sample += 0.006 * EZAudioVoiceActivityDetectorBenchmarkGaussian();
+        }
+        samples[i] = (float)sample;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static float *EZAudioVoiceActivityDetectorBenchmarkLoad(const char *path,
+                                                        uint32_t *frames)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    *frames = (uint32_t)(size / (long)sizeof(float));
+    float *samples = malloc((size_t)*frames * sizeof(float));
+    if (samples && fread(samples, sizeof(float), *frames, file) != *frames)
+    {
+        free(samples);
+        samples = NULL;
+    }
+    fclose(file);
+    return samples;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Benchmark
+//------------------------------------------------------------------------------
+
+static void EZAudioVoiceActivityDetectorBenchmarkRun(const char *name,
+                                                     float *samples,
+                                                     const char *speech,
+                                                     uint32_t frames,
+                                                     double sampleRate)
+{
+    const uint32_t bufferFrames = EZAudioVoiceActivityDetectorBenchmarkBufferFrames;
+    uint32_t buffers = frames / bufferFrames;
+    EZAudioVoiceActivityDetectorBenchmarkDownstream downstream;
+
+    // every buffer goes downstream
+    EZAudioVoiceActivityDetectorBenchmarkDownstreamSetup(&downstream, sampleRate);
+    double start = EZAudioVoiceActivityDetectorBenchmarkNow();
+    for (uint32_t b = 0; b < buffers; b++)
+    {
+        EZAudioVoiceActivityDetectorBenchmarkDownstreamProcess(&downstream, samples + (size_t)b * bufferFrames, bufferFrames);
+    }
+    double ungated = EZAudioVoiceActivityDetectorBenchmarkNow() - start;
+    double ungatedLevel = downstream.level;
+
+    // only active buffers and the pre-roll leading into them go downstream
+    uint32_t preRollLength = (uint32_t)(0.2 * sampleRate);
+    EZAudioVoiceActivityDetector *detector = EZAudioVoiceActivityDetectorCreate(1, sampleRate, (uint32_t)(0.3 * sampleRate), preRollLength);
+    float *preRoll = malloc(preRollLength * sizeof(float));
+    char  *delivered = speech ? calloc(frames, 1) : NULL;
+    uint32_t activeBuffers = 0, utterances = 0, preRollFrames = 0;
+    bool wasActive = false;
+    EZAudioVoiceActivityDetectorBenchmarkDownstreamSetup(&downstream, sampleRate);
+    start = EZAudioVoiceActivityDetectorBenchmarkNow();
+    for (uint32_t b = 0; b < buffers; b++)
+    {
+        float *buffer = samples + (size_t)b * bufferFrames;
+        bool active = EZAudioVoiceActivityDetectorProcess(detector, &buffer, bufferFrames);
+        if (active && !wasActive)
+        {
+            float *destination[1] = { preRoll };
+            uint32_t read, total = 0;
+            while ((read = EZAudioVoiceActivityDetectorReadPreRoll(detector, destination, preRollLength)) > 0)
+            {
+                EZAudioVoiceActivityDetectorBenchmarkDownstreamProcess(&downstream, preRoll, read);
+                total += read;
+            }
+            for (uint32_t i = total < b * bufferFrames ? b * bufferFrames - total : 0; delivered && i < b * bufferFrames; i++)
+            {
+                delivered[i] = 1;
+            }
+            preRollFrames += total;
+            utterances++;
+        }
+        if (active)
+        {
+            EZAudioVoiceActivityDetectorBenchmarkDownstreamProcess(&downstream, buffer, bufferFrames);
+            for (uint32_t i = 0; delivered && i < bufferFrames; i++)
+            {
+                delivered[(size_t)b * bufferFrames + i] = 1;
+            }
+            activeBuffers++;
+        }
+        wasActive = active;
+    }
+    double gated = EZAudioVoiceActivityDetectorBenchmarkNow() - start;
+
+    printf("%s: %.1f s, %u buffers, %.1f%% active, %u onsets with %.0f ms of pre-roll each\n",
+           name,
+           frames / sampleRate,
+           buffers,
+           100.0 * activeBuffers / buffers,
+           utterances,
+           utterances ? 1000.0 * preRollFrames / utterances / sampleRate : 0.0);
+    printf("    downstream on every buffer %7.1f ms, gated (detector included) %7.1f ms: %.1f%% of the CPU saved\n",
+           ungated * 1.0e3,
+           gated * 1.0e3,
+           100.0 * (1.0 - gated / ungated));
+    if (speech)
+    {
+        uint32_t speechFrames = 0, speechDelivered = 0;
+        for (uint32_t i = 0; i < buffers * bufferFrames; i++)
+        {
+            speechFrames    += speech[i];
+            speechDelivered += speech[i] && delivered[i];
+        }
+        printf("    %.2f%% of the speech delivered downstream\n", 100.0 * speechDelivered / speechFrames);
+    }
+    // keeps the downstream work from being optimized away
+    if (downstream.level < 0.0 || ungatedLevel < 0.0)
+    {
+        printf("\n");
+    }
+    free(delivered);
+    free(preRoll);
+    EZAudioVoiceActivityDetectorFree(detector);
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    if (argc == 2)
+    {
+        fprintf(stderr, "usage: %s [sampleRate recording.f32 ...]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 2)
+    {
+        double sampleRate = atof(argv[1]);
+        for (int i = 2; i < argc; i++)
+        {
+            uint32_t frames;
+            float *samples = EZAudioVoiceActivityDetectorBenchmarkLoad(argv[i], &frames);
+            if (!samples || sampleRate <= 0.0)
+            {
+                fprintf(stderr, "couldn't read float samples from %s\n", argv[i]);
+                return 1;
+            }
+            EZAudioVoiceActivityDetectorBenchmarkRun(argv[i], samples, NULL, frames, sampleRate);
+            free(samples);
+        }
+        return 0;
+    }
+
+    double   sampleRate = EZAudioVoiceActivityDetectorBenchmarkSampleRate;
+    uint32_t frames     = (uint32_t)(sampleRate * EZAudioVoiceActivityDetectorBenchmarkDuration);
+    float   *samples    = malloc(frames * sizeof(float));
+    char    *speech     = malloc(frames);
+    if (!samples || !speech)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    EZAudioVoiceActivityDetectorBenchmarkSynthesize(samples, speech, frames, sampleRate);
+    EZAudioVoiceActivityDetectorBenchmarkRun("synthetic speech", samples, speech, frames, sampleRate);
+    free(samples);
+    free(speech);
+    return 0;
+}
@@ -4,6 +4,9 @@
 //
 //  Created by Michael Tyson on 25/10/2012.
 //
+//  Altered for EZAudio: native endian float and 16-bit integer formats are
+//  converted with the EZAudioDSP kernels instead of an AudioConverter.
+//
 //  This software is provided 'as-is', without any express or implied
 //  warranty.  In no event will the authors be held liable for any damages
 //  arising from the use of this software.
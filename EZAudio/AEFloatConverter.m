@@ -4,6 +4,9 @@
 //
 //  Created by Michael Tyson on 25/10/2012.
 //
+//  Altered for EZAudio: native endian float and 16-bit integer formats are
+//  converted with the EZAudioDSP kernels instead of an AudioConverter.
+//
 //  This software is provided 'as-is', without any express or implied
 //  warranty.  In no event will the authors be held liable for any damages
 //  arising from the use of this software.
@@ -24,6 +27,7 @@
 //
 
 #import "AEFloatConverter.h"
+#import "EZAudioDSP.h"
 
 #define checkResult(result,operation) (_checkResult((result),(operation),strrchr(__FILE__, '/')+1,__LINE__))
 static inline BOOL _checkResult(OSStatus result, const char *operation, const char* file, int line) {
@@ -46,6 +50,7 @@ struct complexInputDataProc_t {
     AudioConverterRef           _toFloatConverter;
     AudioConverterRef           _fromFloatConverter;
     AudioBufferList            *_scratchFloatBufferList;
+    const EZAudioDSPKernel     *_kernel;
 }
 
 static OSStatus complexInputDataProc(AudioConverterRef             inAudioConverter,
@@ -71,8 +76,9 @@ static OSStatus complexInputDataProc(AudioConverterRef             inAudioConver
     _floatAudioDescription.mSampleRate        = sourceFormat.mSampleRate;
     
     _sourceAudioDescription = sourceFormat;
+    _kernel = EZAudioDSPKernelForFormat(sourceFormat);
     
-    if ( memcmp(&sourceFormat, &_floatAudioDescription, sizeof(AudioStreamBasicDescription)) != 0 ) {
+    if ( !_kernel && memcmp(&sourceFormat, &_floatAudioDescription, sizeof(AudioStreamBasicDescription)) != 0 ) {
         checkResult(AudioConverterNew(&sourceFormat, &_floatAudioDescription, &_toFloatConverter), "AudioConverterNew");
         checkResult(AudioConverterNew(&_floatAudioDescription, &sourceFormat, &_fromFloatConverter), "AudioConverterNew");
         _scratchFloatBufferList = (AudioBufferList*)malloc(sizeof(AudioBufferList) + (_floatAudioDescription.mChannelsPerFrame-1)*sizeof(AudioBuffer));
@@ -96,7 +102,9 @@ static OSStatus complexInputDataProc(AudioConverterRef             inAudioConver
 BOOL AEFloatConverterToFloat(AEFloatConverter* THIS, AudioBufferList *sourceBuffer, float * const * targetBuffers, UInt32 frames) {
     if ( frames == 0 ) return YES;
     
-    if ( THIS->_toFloatConverter ) {
+    if ( THIS->_kernel ) {
+        THIS->_kernel->toFloat(sourceBuffer, 0, targetBuffers, frames, THIS->_sourceAudioDescription.mChannelsPerFrame);
+    } else if ( THIS->_toFloatConverter ) {
         UInt32 priorDataByteSize = sourceBuffer->mBuffers[0].mDataByteSize;
         for ( int i=0; i<sourceBuffer->mNumberBuffers; i++ ) {
             sourceBuffer->mBuffers[i].mDataByteSize = frames * THIS->_sourceAudioDescription.mBytesPerFrame;
@@ -144,7 +152,9 @@ BOOL AEFloatConverterToFloatBufferList(AEFloatConverter* converter, AudioBufferL
 BOOL AEFloatConverterFromFloat(AEFloatConverter* THIS, float * const * sourceBuffers, AudioBufferList *targetBuffer, UInt32 frames) {
     if ( frames == 0 ) return YES;
     
-    if ( THIS->_fromFloatConverter ) {
+    if ( THIS->_kernel ) {
+        THIS->_kernel->fromFloat(sourceBuffers, targetBuffer, 0, frames, THIS->_sourceAudioDescription.mChannelsPerFrame);
+    } else if ( THIS->_fromFloatConverter ) {
         for ( int i=0; i<THIS->_scratchFloatBufferList->mNumberBuffers; i++ ) {
             THIS->_scratchFloatBufferList->mBuffers[i].mData = sourceBuffers[i];
             THIS->_scratchFloatBufferList->mBuffers[i].mDataByteSize = frames * sizeof(float);
@@ -0,0 +1,167 @@
+//
+//  EZAggregateMicrophone.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import "EZMicrophone.h"
+
+@class EZAggregateMicrophone;
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAggregateMicrophoneDelegate
+//------------------------------------------------------------------------------
+
+/**
+ The EZAggregateMicrophoneDelegate receives the merged multichannel audio of an EZAggregateMicrophone.
+ */
+@protocol EZAggregateMicrophoneDelegate <NSObject>
+
+@optional
+
+/**
+ Returns back the merged float arrays of all the microphones, aligned to the first microphone's clock. The channels are ordered by microphone and then by each microphone's own channel order, so with a stereo and a mono microphone buffer[0] and buffer[1] are the first microphone's left and right channels and buffer[2] is the second microphone's channel.
+ @param aggregateMicrophone The instance of the EZAggregateMicrophone that triggered the event.
+ @param buffer              The audio data as an array of float arrays, one per channel.
+ @param bufferSize          The length of each float array.
+ @param numberOfChannels    The total number of channels.
+ @warning This function executes on the first microphone's audio thread. If operations should be performed on any other thread (like the main thread) it should be performed within a dispatch block like so: dispatch_async(dispatch_get_main_queue(), ^{ ...Your Code... })
+ */
+- (void)aggregateMicrophone:(EZAggregateMicrophone *)aggregateMicrophone
+           hasAudioReceived:(float **)buffer
+             withBufferSize:(UInt32)bufferSize
+       withNumberOfChannels:(UInt32)numberOfChannels;
+
+@end
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAggregateMicrophone
+//------------------------------------------------------------------------------
+
+/**
+ The EZAggregateMicrophone merges several EZMicrophone instances (i.e. one per input device, see EZMicrophone's `setInputDevice:` on OSX) into a single multichannel stream. Separate devices run on separate clocks that drift apart by tens to hundreds of ppm, so the first microphone is used as the master clock and every other microphone is aligned to it with an EZAudioDriftCompensator, which estimates its drift and continuously resamples it by the fractional ratio needed to stay in step.
+
+ The aggregate microphone becomes the delegate of each of its microphones. The drift is estimated from the capture time stamps the microphones deliver with their audio, so they may deliver on their audio threads (the default) or on a consumer thread.
+ */
+@interface EZAggregateMicrophone : NSObject <EZMicrophoneDelegate>
+
+//------------------------------------------------------------------------------
+#pragma mark - Properties
+//------------------------------------------------------------------------------
+
+/**
+ The EZAggregateMicrophoneDelegate receiving the merged audio.
+ */
+@property (nonatomic, assign) id<EZAggregateMicrophoneDelegate> delegate;
+
+/**
+ The EZMicrophone instances being merged. The first is the master clock.
+ */
+@property (nonatomic, strong, readonly) NSArray *microphones;
+
+/**
+ The amount of audio in seconds buffered between each microphone and the master. This must cover the master's and the microphone's buffer durations added together plus their scheduling jitter. Default is 0.05 seconds.
+ @warning Do not set this while fetching audio (startFetchingAudio)
+ */
+@property (nonatomic, assign) NSTimeInterval latency;
+
+//------------------------------------------------------------------------------
+#pragma mark - Initializers
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Initializers
+///-----------------------------------------------------------
+
+/**
+ Creates an aggregate of several microphones.
+ @param microphones An NSArray of at least one EZMicrophone. The first microphone is the master clock. The microphones must not be fetching audio yet.
+ @param delegate    An EZAggregateMicrophoneDelegate to receive the merged audio.
+ @return A newly created instance of the EZAggregateMicrophone class.
+ */
+- (instancetype)initWithMicrophones:(NSArray *)microphones
+                           delegate:(id<EZAggregateMicrophoneDelegate>)delegate;
+
+//------------------------------------------------------------------------------
+
+/**
+ Class method to create an aggregate of several microphones.
+ @param microphones An NSArray of at least one EZMicrophone. The first microphone is the master clock. The microphones must not be fetching audio yet.
+ @param delegate    An EZAggregateMicrophoneDelegate to receive the merged audio.
+ @return A newly created instance of the EZAggregateMicrophone class.
+ */
++ (instancetype)aggregateMicrophoneWithMicrophones:(NSArray *)microphones
+                                          delegate:(id<EZAggregateMicrophoneDelegate>)delegate;
+
+//------------------------------------------------------------------------------
+#pragma mark - Events
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Starting/Stopping The Aggregate Microphone
+///-----------------------------------------------------------
+
+/**
+ Starts fetching audio from every microphone. The master microphone is started last so the others are already filling their buffers.
+ */
+- (void)startFetchingAudio;
+
+//------------------------------------------------------------------------------
+
+/**
+ Stops fetching audio from every microphone.
+ */
+- (void)stopFetchingAudio;
+
+//------------------------------------------------------------------------------
+#pragma mark - Getters
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Getting The Alignment Statistics
+///-----------------------------------------------------------
+
+/**
+ Provides the total number of channels of the merged stream.
+ @return The sum of the microphones' channel counts.
+ */
+- (UInt32)numberOfChannels;
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides the estimated clock drift of a microphone relative to the master.
+ @param index The index of the microphone in `microphones`.
+ @return The drift in parts per million. Always 0 for the master.
+ */
+- (double)driftForMicrophoneAtIndex:(NSUInteger)index;
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides the number of times a microphone's buffer ran dry and silence was merged in its place.
+ @param index The index of the microphone in `microphones`.
+ @return The underrun count. Always 0 for the master.
+ */
+- (UInt32)underrunsForMicrophoneAtIndex:(NSUInteger)index;
+
+@end
@@ -0,0 +1,376 @@
+//
+//  EZAggregateMicrophone.m
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#import "EZAggregateMicrophone.h"
+
+//------------------------------------------------------------------------------
+
+#import "EZAudio.h"
+#include <mach/mach_time.h>
+
+//------------------------------------------------------------------------------
+
+// constants
+static const UInt32 EZAggregateMicrophoneMaximumFrames = 4096;
+static const NSTimeInterval EZAggregateMicrophoneDefaultLatency = 0.05;
+static const double EZAggregateMicrophoneDriftBandwidth = 4.0;
+
+//------------------------------------------------------------------------------
+
+typedef void (*EZAggregateMicrophoneHasAudioReceivedIMP)(id, SEL, EZAggregateMicrophone *, float **, UInt32, UInt32);
+
+typedef struct EZAggregateMicrophoneDelegateDispatch
+{
+    __unsafe_unretained id                       delegate;
+    EZAggregateMicrophoneHasAudioReceivedIMP     hasAudioReceived;
+    int64_t                                      retiredEpoch;
+    struct EZAggregateMicrophoneDelegateDispatch *next;
+} EZAggregateMicrophoneDelegateDispatch;
+
+//------------------------------------------------------------------------------
+
+typedef struct
+{
+    __unsafe_unretained EZMicrophone *microphone;
+    EZAudioDriftCompensator          *compensator;
+    UInt32                           channels;
+    UInt32                           channelOffset;
+} EZAggregateMicrophoneSource;
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAggregateMicrophone
+//------------------------------------------------------------------------------
+
+@interface EZAggregateMicrophone ()
+{
+    EZAggregateMicrophoneDelegateDispatch *volatile _delegateDispatch;
+    EZAggregateMicrophoneDelegateDispatch           *_retiredDelegateDispatches;
+    volatile int64_t                                _notifyEpoch;
+}
+@property (nonatomic, strong, readwrite) NSArray *microphones;
+@property (nonatomic) EZAggregateMicrophoneSource *sources;
+@property (nonatomic) UInt32 sourceCount;
+@property (nonatomic) float **buffers;
+@property (nonatomic) UInt32 channels;
+@property (nonatomic) Float64 sampleRate;
+@property (nonatomic) double hostTicksToSeconds;
+@property (nonatomic) BOOL isFetching;
+@end
+
+//------------------------------------------------------------------------------
+
+@implementation EZAggregateMicrophone
+
+//------------------------------------------------------------------------------
+#pragma mark - Dealloc
+//------------------------------------------------------------------------------
+
+- (void)dealloc
+{
+    [self stopFetchingAudio];
+    [self freeSourceBuffers];
+    free(_sources);
+
+    // nothing notifies anymore, so every dispatch table can go
+    [self freeRetiredDelegateDispatches];
+    free(_delegateDispatch);
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Initialization
+//------------------------------------------------------------------------------
+
+- (instancetype)initWithMicrophones:(NSArray *)microphones
+                           delegate:(id<EZAggregateMicrophoneDelegate>)delegate
+{
+    NSAssert(microphones.count > 0, @"An aggregate microphone needs at least one microphone");
+    self = [super init];
+    if (self)
+    {
+        _microphones = [microphones copy];
+        _latency = EZAggregateMicrophoneDefaultLatency;
+        _sourceCount = (UInt32)_microphones.count;
+        _sources = (EZAggregateMicrophoneSource *)calloc(_sourceCount, sizeof(EZAggregateMicrophoneSource));
+        for (UInt32 i = 0; i < _sourceCount; i++)
+        {
+            EZMicrophone *microphone = _microphones[i];
+            _sources[i].microphone = microphone;
+            microphone.microphoneDelegate = self;
+        }
+
+        mach_timebase_info_data_t timebase;
+        mach_timebase_info(&timebase);
+        _hostTicksToSeconds = 1.0e-9 * (double)timebase.numer / (double)timebase.denom;
+
+        self.delegate = delegate;
+    }
+    return self;
+}
+
+//------------------------------------------------------------------------------
+
++ (instancetype)aggregateMicrophoneWithMicrophones:(NSArray *)microphones
+                                          delegate:(id<EZAggregateMicrophoneDelegate>)delegate
+{
+    return [[self alloc] initWithMicrophones:microphones
+                                    delegate:delegate];
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Events
+//------------------------------------------------------------------------------
+
+- (void)startFetchingAudio
+{
+    if (!self.isFetching)
+    {
+        [self configureSourceBuffers];
+        self.isFetching = YES;
+
+        // start the master last so the others are already buffering when it first reads
+        for (NSInteger i = self.sourceCount - 1; i >= 0; i--)
+        {
+            [self.sources[i].microphone startFetchingAudio];
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+- (void)stopFetchingAudio
+{
+    if (self.isFetching)
+    {
+        for (UInt32 i = 0; i < self.sourceCount; i++)
+        {
+            [self.sources[i].microphone stopFetchingAudio];
+        }
+        self.isFetching = NO;
+    }
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Getters
+//------------------------------------------------------------------------------
+
+- (UInt32)numberOfChannels
+{
+    UInt32 channels = 0;
+    for (EZMicrophone *microphone in self.microphones)
+    {
+        channels += microphone.audioStreamBasicDescription.mChannelsPerFrame;
+    }
+    return channels;
+}
+
+//------------------------------------------------------------------------------
+
+- (double)driftForMicrophoneAtIndex:(NSUInteger)index
+{
+    EZAudioDriftCompensator *compensator = index < self.sourceCount ? self.sources[index].compensator : NULL;
+    return compensator ? EZAudioDriftCompensatorDrift(compensator) : 0.0;
+}
+
+//------------------------------------------------------------------------------
+
+- (UInt32)underrunsForMicrophoneAtIndex:(NSUInteger)index
+{
+    EZAudioDriftCompensator *compensator = index < self.sourceCount ? self.sources[index].compensator : NULL;
+    return compensator ? EZAudioDriftCompensatorUnderruns(compensator) : 0;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Setters
+//------------------------------------------------------------------------------
+
+- (void)setDelegate:(id<EZAggregateMicrophoneDelegate>)delegate
+{
+    _delegate = delegate;
+
+    // resolve the delegate's callback into a table of its own, the master's audio thread may still be reading the current one
+    EZAggregateMicrophoneDelegateDispatch *dispatch = (EZAggregateMicrophoneDelegateDispatch *)calloc(1, sizeof(EZAggregateMicrophoneDelegateDispatch));
+    SEL hasAudioReceived = @selector(aggregateMicrophone:hasAudioReceived:withBufferSize:withNumberOfChannels:);
+    dispatch->delegate = delegate;
+    dispatch->hasAudioReceived = [delegate respondsToSelector:hasAudioReceived] ? (EZAggregateMicrophoneHasAudioReceivedIMP)[(NSObject *)delegate methodForSelector:hasAudioReceived] : NULL;
+
+    // publish it once it's complete
+    OSMemoryBarrier();
+    EZAggregateMicrophoneDelegateDispatch *previous = _delegateDispatch;
+    _delegateDispatch = dispatch;
+
+    // a notification running right now (odd epoch) may still be reading the previous table, any later one can't see it
+    if (previous)
+    {
+        OSMemoryBarrier();
+        previous->retiredEpoch = (_notifyEpoch + 1) & ~1LL;
+        previous->next = _retiredDelegateDispatches;
+        _retiredDelegateDispatches = previous;
+    }
+    [self freeRetiredDelegateDispatches];
+}
+
+//------------------------------------------------------------------------------
+
+- (void)freeRetiredDelegateDispatches
+{
+    EZAggregateMicrophoneDelegateDispatch **link = &_retiredDelegateDispatches;
+    while (*link)
+    {
+        EZAggregateMicrophoneDelegateDispatch *dispatch = *link;
+        if (_notifyEpoch >= dispatch->retiredEpoch)
+        {
+            *link = dispatch->next;
+            free(dispatch);
+        }
+        else
+        {
+            link = &dispatch->next;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+- (void)setLatency:(NSTimeInterval)latency
+{
+    NSAssert(!self.isFetching, @"Cannot set the latency while the aggregate microphone is fetching audio");
+    _latency = latency;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Source Buffers
+//------------------------------------------------------------------------------
+
+- (void)configureSourceBuffers
+{
+    [self freeSourceBuffers];
+
+    // the master sets the clock and sample rate everyone is aligned to
+    AudioStreamBasicDescription masterFormat = self.sources[0].microphone.audioStreamBasicDescription;
+    self.sampleRate = masterFormat.mSampleRate;
+
+    UInt32 channelOffset = 0;
+    for (UInt32 i = 0; i < self.sourceCount; i++)
+    {
+        AudioStreamBasicDescription format = self.sources[i].microphone.audioStreamBasicDescription;
+        self.sources[i].channels = format.mChannelsPerFrame;
+        self.sources[i].channelOffset = channelOffset;
+        channelOffset += format.mChannelsPerFrame;
+        if (i > 0)
+        {
+            double nominalRatio = format.mSampleRate / masterFormat.mSampleRate;
+            self.sources[i].compensator = EZAudioDriftCompensatorCreate(format.mChannelsPerFrame,
+                                                                        masterFormat.mSampleRate,
+                                                                        nominalRatio,
+                                                                        (uint32_t)(self.latency * format.mSampleRate),
+                                                                        EZAggregateMicrophoneDriftBandwidth);
+        }
+    }
+    self.channels = channelOffset;
+    self.buffers = [EZAudio floatBuffersWithNumberOfFrames:EZAggregateMicrophoneMaximumFrames
+                                          numberOfChannels:self.channels];
+}
+
+//------------------------------------------------------------------------------
+
+- (void)freeSourceBuffers
+{
+    for (UInt32 i = 0; i < self.sourceCount; i++)
+    {
+        EZAudioDriftCompensatorFree(self.sources[i].compensator);
+        self.sources[i].compensator = NULL;
+    }
+    if (self.buffers)
+    {
+        [EZAudio freeFloatBuffers:self.buffers numberOfChannels:self.channels];
+        self.buffers = NULL;
+    }
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - EZMicrophoneDelegate
+//------------------------------------------------------------------------------
+
+- (void)    microphone:(EZMicrophone *)microphone
+      hasAudioReceived:(float **)buffer
+        withBufferSize:(UInt32)bufferSize
+  withNumberOfChannels:(UInt32)numberOfChannels
+           atTimeStamp:(const AudioTimeStamp *)timeStamp
+{
+    // when the frames were captured, not when they got here, so scheduling jitter and the consumer thread's batching stay out of the drift estimate
+    UInt64 hostTime = (timeStamp->mFlags & kAudioTimeStampHostTimeValid) ? timeStamp->mHostTime : mach_absolute_time();
+    double time = _hostTicksToSeconds * (double)hostTime;
+
+    // every other microphone just queues up its frames for the master to pull
+    if (microphone != _sources[0].microphone)
+    {
+        for (UInt32 i = 1; i < _sourceCount; i++)
+        {
+            if (_sources[i].microphone == microphone)
+            {
+                EZAudioDriftCompensatorWrite(_sources[i].compensator,
+                                             (const float * const *)buffer,
+                                             bufferSize,
+                                             time);
+                break;
+            }
+        }
+        return;
+    }
+
+    // the master drives the merged stream, the epoch is odd while it may be reading the dispatch table
+    OSAtomicIncrement64Barrier(&_notifyEpoch);
+    EZAggregateMicrophoneDelegateDispatch *dispatch = _delegateDispatch;
+    UInt32 masterChannels = MIN(numberOfChannels, _sources[0].channels);
+    for (UInt32 offset = 0; offset < bufferSize; offset += EZAggregateMicrophoneMaximumFrames)
+    {
+        UInt32 frames = MIN(bufferSize - offset, EZAggregateMicrophoneMaximumFrames);
+        double chunkTime = time + offset / _sampleRate;
+
+        for (UInt32 channel = 0; channel < masterChannels; channel++)
+        {
+            memcpy(_buffers[channel], buffer[channel] + offset, frames * sizeof(float));
+        }
+        for (UInt32 i = 1; i < _sourceCount; i++)
+        {
+            EZAudioDriftCompensatorRead(_sources[i].compensator,
+                                        _buffers + _sources[i].channelOffset,
+                                        frames,
+                                        chunkTime);
+        }
+
+        if (dispatch && dispatch->hasAudioReceived)
+        {
+            dispatch->hasAudioReceived(dispatch->delegate,
+                                       @selector(aggregateMicrophone:hasAudioReceived:withBufferSize:withNumberOfChannels:),
+                                       self,
+                                       _buffers,
+                                       frames,
+                                       _channels);
+        }
+    }
+    OSAtomicIncrement64Barrier(&_notifyEpoch);
+}
+
+@end
@@ -29,14 +29,33 @@
 #import "AEFloatConverter.h"
 #import "TPCircularBuffer.h"
 
+#pragma mark - Core Utilities
+#import "EZAudioDSP.h"
+#import "EZAudioRingBuffer.h"
+#import "EZAudioDriftCompensator.h"
+#import "EZAudioCallbackMetrics.h"
+#import "EZAudioVoiceActivityDetector.h"
+#import "EZAudioWAVWriter.h"
+#import "EZAudioFLACEncoder.h"
+#import "EZAudioPeakFile.h"
+#import "EZAudioBackgroundWriter.h"
+#import "EZAudioJitterBuffer.h"
+#import "EZAudioPacketReplay.h"
+#import "EZAudioTimeStretcher.h"
+
 #pragma mark - Core Components
 #import "EZAudioFile.h"
 #import "EZMicrophone.h"
+#import "EZAggregateMicrophone.h"
+#import "EZAudioVirtualInput.h"
 #import "EZOutput.h"
+#import "EZAudioMixer.h"
+#import "EZAudioStreamSource.h"
 #import "EZRecorder.h"
 
 #pragma mark - Extended Components
 #import "EZAudioPlayer.h"
+#import "EZAudioQueuePlayer.h"
 
 #pragma mark - Interface Components
 #import "EZPlot.h"
@@ -253,6 +272,18 @@
 +(void)checkResult:(OSStatus)result
          operation:(const char*)operation;
 
+#pragma mark - Callback Metrics Utility
+///-----------------------------------------------------------
+/// @name Callback Metrics Utility
+///-----------------------------------------------------------
+
+/**
+ Exports a snapshot of an audio callback's metrics (see EZMicrophone's and EZOutput's `callbackMetrics`) for logging or serializing. The dictionary holds every counter of the snapshot as an NSNumber under the field's name, the mean and the 50th, 90th, 99th and 99.9th percentile durations in microseconds (`meanMicroseconds`, `p50Microseconds`, `p90Microseconds`, `p99Microseconds`, `p999Microseconds`) and the non-empty histogram buckets as an array of dictionaries with `lowerBoundMicroseconds` and `count` under `histogram`.
+ @param snapshot An EZAudioCallbackMetricsSnapshot
+ @return An NSDictionary describing the snapshot
+ */
++(NSDictionary *)dictionaryWithCallbackMetrics:(EZAudioCallbackMetricsSnapshot)snapshot;
+
 #pragma mark - Plot Utility
 ///-----------------------------------------------------------
 /// @name Plot Utility
@@ -342,6 +342,39 @@
 
 
 
+#pragma mark - Callback Metrics Utility
++ (NSDictionary *)dictionaryWithCallbackMetrics:(EZAudioCallbackMetricsSnapshot)snapshot
+{
+    NSMutableArray *histogram = [NSMutableArray array];
+    for (UInt32 bucket = 0; bucket < kEZAudioCallbackMetricsHistogramBuckets; bucket++)
+    {
+        if (snapshot.histogram[bucket])
+        {
+            [histogram addObject:@{ @"lowerBoundMicroseconds" : @(EZAudioCallbackMetricsBucketLowerBound(bucket)),
+                                    @"count"                  : @(snapshot.histogram[bucket]) }];
+        }
+    }
+    double mean = snapshot.callbacks ? (double)snapshot.totalMicroseconds / (double)snapshot.callbacks : 0.0;
+    return @{ @"callbacks"         : @(snapshot.callbacks),
+              @"frames"            : @(snapshot.frames),
+              @"framesDelivered"   : @(snapshot.framesDelivered),
+              @"shortBuffers"      : @(snapshot.shortBuffers),
+              @"deadlineMisses"    : @(snapshot.deadlineMisses),
+              @"timestampGaps"     : @(snapshot.timestampGaps),
+              @"gapFrames"         : @(snapshot.gapFrames),
+              @"totalMicroseconds" : @(snapshot.totalMicroseconds),
+              @"maxMicroseconds"   : @(snapshot.maxMicroseconds),
+              @"lastMicroseconds"  : @(snapshot.lastMicroseconds),
+              @"meanMicroseconds"  : @(mean),
+              @"p50Microseconds"   : @(EZAudioCallbackMetricsPercentile(&snapshot, 0.5)),
+              @"p90Microseconds"   : @(EZAudioCallbackMetricsPercentile(&snapshot, 0.9)),
+              @"p99Microseconds"   : @(EZAudioCallbackMetricsPercentile(&snapshot, 0.99)),
+              @"p999Microseconds"  : @(EZAudioCallbackMetricsPercentile(&snapshot, 0.999)),
+              @"histogram"         : histogram };
+}
+
+
+
 #pragma mark - Math Utility
 + (void)appendBufferAndShift:(float*)buffer
               withBufferSize:(int)bufferLength
@@ -396,10 +429,7 @@
 + (float)RMS:(float *)buffer
       length:(int)bufferSize
 {
-    float sum = 0.0;
-    for (int i = 0; i < bufferSize; i++)
-        sum += buffer[i] * buffer[i];
-    return sqrtf( sum / bufferSize );
+    return EZAudioDSPRMS(buffer, bufferSize);
 }
 
 
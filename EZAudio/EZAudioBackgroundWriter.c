@@ -0,0 +1,1022 @@
+//
+//  EZAudioBackgroundWriter.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+// nanosleep and the other threading and file calls are POSIX, not strict C
+#define _POSIX_C_SOURCE 200809L
+
+#include "EZAudioBackgroundWriter.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+
+// the ring indices are shared between the audio thread and the writer thread
+#define EZ_AUDIO_BACKGROUND_WRITER_BARRIER() __sync_synchronize()
+
+// the ring never holds less than this
+static const uint32_t EZAudioBackgroundWriterMinimumCapacity   = 4096;
+
+// how often the writer thread looks at the ring, as a fraction of the flush duration
+static const double   EZAudioBackgroundWriterPollFraction      = 0.25;
+static const double   EZAudioBackgroundWriterMinimumPoll       = 0.001;
+static const double   EZAudioBackgroundWriterMaximumPoll       = 0.02;
+
+// frames mixed down per write to a remixed sink
+#define EZ_AUDIO_BACKGROUND_WRITER_REMIX_FRAMES 4096
+
+// the most threads writing the tracks of a multitrack sink
+#define EZ_AUDIO_BACKGROUND_WRITER_MAXIMUM_TRACK_THREADS 64
+
+//------------------------------------------------------------------------------
+
+struct EZAudioBackgroundWriter
+{
+    // ring (one float array per channel, a power of two long)
+    float                             **ring;
+    const float                       **batch;
+    uint32_t                          channels;
+    uint32_t                          capacity;
+    uint32_t                          mask;
+    volatile uint32_t                 head;
+    volatile uint32_t                 tail;
+
+    // writer thread
+    EZAudioBackgroundWriterSink       sink;
+    pthread_t                         thread;
+    volatile int                      closing;
+    uint32_t                          flushFrames;
+    struct timespec                   pollInterval;
+    EZAudioBackgroundWriterSyncPolicy syncPolicy;
+    double                            syncInterval;
+
+    // segments (writer thread)
+    bool                              segmented;
+    EZAudioBackgroundWriterSegmenter  segmenter;
+    uint64_t                          segmentFrames;
+    uint64_t                          segmentWritten;
+    uint32_t                          segmentIndex;
+    bool                              segmentFailed;
+    EZAudioBackgroundWriterSink       nextSink;
+    bool                              hasNextSink;
+
+    // counters
+    volatile uint32_t                 overruns;
+    volatile uint64_t                 droppedFrames;
+    volatile uint64_t                 writtenFrames;
+    volatile uint32_t                 writeErrors;
+    volatile uint32_t                 maximumFill;
+    volatile uint32_t                 completedSegments;
+};
+
+//------------------------------------------------------------------------------
+#pragma mark - Writer Thread
+//------------------------------------------------------------------------------
+
+static double EZAudioBackgroundWriterNow(void)
+{
+    struct timeval time;
+    gettimeofday(&time, NULL);
+    return (double)time.tv_sec + 1.0e-6 * (double)time.tv_usec;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterSync(EZAudioBackgroundWriter *writer)
+{
+    if (writer->sink.sync && !writer->sink.sync(writer->sink.context))
+    {
+        writer->writeErrors++;
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterCloseSink(EZAudioBackgroundWriter *writer)
+{
+    bool closed = true;
+    if (writer->syncPolicy != EZAudioBackgroundWriterSyncPolicyNone)
+    {
+        closed = EZAudioBackgroundWriterSync(writer);
+    }
+    if (writer->sink.close && !writer->sink.close(writer->sink.context))
+    {
+        writer->writeErrors++;
+        closed = false;
+    }
+    return closed;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioBackgroundWriterCompleteSegment(EZAudioBackgroundWriter *writer)
+{
+    bool closed = EZAudioBackgroundWriterCloseSink(writer);
+    writer->completedSegments++;
+    if (writer->segmenter.segmentCompleted)
+    {
+        writer->segmenter.segmentCompleted(writer->segmenter.context,
+                                           writer->segmentIndex,
+                                           writer->segmentWritten,
+                                           closed && !writer->segmentFailed);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioBackgroundWriterOpenNextSegment(EZAudioBackgroundWriter *writer)
+{
+    if (!writer->hasNextSink)
+    {
+        writer->hasNextSink = writer->segmenter.openSegment(writer->segmenter.context,
+                                                            writer->segmentIndex + 1,
+                                                            &writer->nextSink);
+        if (!writer->hasNextSink)
+        {
+            writer->writeErrors++;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioBackgroundWriterRollOver(EZAudioBackgroundWriter *writer)
+{
+    // if the next segment couldn't be opened the current one keeps growing until it can
+    EZAudioBackgroundWriterOpenNextSegment(writer);
+    if (!writer->hasNextSink)
+    {
+        return;
+    }
+
+    // the finished segment is closed after the swap but before the frames after it are written
+    EZAudioBackgroundWriterSink next = writer->nextSink;
+    EZAudioBackgroundWriterCompleteSegment(writer);
+    writer->sink           = next;
+    writer->hasNextSink    = false;
+    writer->segmentIndex++;
+    writer->segmentWritten = 0;
+    writer->segmentFailed  = false;
+
+    // and the one after is ready well before it's needed
+    EZAudioBackgroundWriterOpenNextSegment(writer);
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioBackgroundWriterWriteBatch(EZAudioBackgroundWriter *writer, uint32_t frames)
+{
+    // at most two pieces, up to the end of the ring and then from its start
+    uint32_t written = 0;
+    while (written < frames)
+    {
+        uint32_t start = (writer->tail + written) & writer->mask;
+        uint32_t count = frames - written < writer->capacity - start ? frames - written : writer->capacity - start;
+        if (writer->segmented && writer->segmentWritten < writer->segmentFrames && writer->segmentFrames - writer->segmentWritten < count)
+        {
+            // split exactly where the segment ends
+            count = (uint32_t)(writer->segmentFrames - writer->segmentWritten);
+        }
+        for (uint32_t channel = 0; channel < writer->channels; channel++)
+        {
+            writer->batch[channel] = writer->ring[channel] + start;
+        }
+        if (writer->sink.write(writer->sink.context, writer->batch, count))
+        {
+            writer->writtenFrames += count;
+        }
+        else
+        {
+            writer->writeErrors++;
+            writer->segmentFailed = true;
+        }
+        written += count;
+        writer->segmentWritten += count;
+        if (writer->segmented && writer->segmentWritten >= writer->segmentFrames)
+        {
+            EZAudioBackgroundWriterRollOver(writer);
+        }
+    }
+
+    // only hand the space back once the sink is done with it
+    EZ_AUDIO_BACKGROUND_WRITER_BARRIER();
+    writer->tail += frames;
+}
+
+//------------------------------------------------------------------------------
+
+static void *EZAudioBackgroundWriterThread(void *argument)
+{
+    EZAudioBackgroundWriter *writer = (EZAudioBackgroundWriter *)argument;
+    double lastSync = EZAudioBackgroundWriterNow();
+    if (writer->segmented)
+    {
+        EZAudioBackgroundWriterOpenNextSegment(writer);
+    }
+    for (;;)
+    {
+        // the audio thread has stopped writing by the time closing is set, so the fill read after it is final
+        int closing = writer->closing;
+        EZ_AUDIO_BACKGROUND_WRITER_BARRIER();
+        uint32_t fill = writer->head - writer->tail;
+        if (fill > 0 && (fill >= writer->flushFrames || closing))
+        {
+            EZAudioBackgroundWriterWriteBatch(writer, fill);
+            double now = EZAudioBackgroundWriterNow();
+            if (writer->syncPolicy == EZAudioBackgroundWriterSyncPolicyEveryBatch ||
+                (writer->syncPolicy == EZAudioBackgroundWriterSyncPolicyInterval && now - lastSync >= writer->syncInterval))
+            {
+                EZAudioBackgroundWriterSync(writer);
+                lastSync = now;
+            }
+        }
+        else if (closing)
+        {
+            break;
+        }
+        else
+        {
+            nanosleep(&writer->pollInterval, NULL);
+        }
+    }
+
+    if (!writer->segmented)
+    {
+        EZAudioBackgroundWriterCloseSink(writer);
+        return NULL;
+    }
+
+    // the last segment is whatever was written of it, the one opened ahead of it is never used
+    EZAudioBackgroundWriterCompleteSegment(writer);
+    if (writer->hasNextSink)
+    {
+        if (writer->segmenter.discardSegment)
+        {
+            writer->segmenter.discardSegment(writer->segmenter.context, writer->segmentIndex + 1, writer->nextSink);
+        }
+        else if (writer->nextSink.close)
+        {
+            writer->nextSink.close(writer->nextSink.context);
+        }
+    }
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+static void EZAudioBackgroundWriterFree(EZAudioBackgroundWriter *writer)
+{
+    if (writer->ring)
+    {
+        for (uint32_t channel = 0; channel < writer->channels; channel++)
+        {
+            free(writer->ring[channel]);
+        }
+    }
+    free(writer->ring);
+    free(writer->batch);
+    free(writer);
+}
+
+//------------------------------------------------------------------------------
+
+static EZAudioBackgroundWriter *EZAudioBackgroundWriterAllocate(uint32_t channels,
+                                                               double sampleRate,
+                                                               double bufferDuration,
+                                                               double flushDuration,
+                                                               EZAudioBackgroundWriterSyncPolicy syncPolicy,
+                                                               double syncInterval)
+{
+    if (channels == 0 || sampleRate <= 0.0 || bufferDuration <= 0.0)
+    {
+        return NULL;
+    }
+
+    EZAudioBackgroundWriter *writer = (EZAudioBackgroundWriter *)calloc(1, sizeof(EZAudioBackgroundWriter));
+    if (!writer)
+    {
+        return NULL;
+    }
+    writer->channels     = channels;
+    writer->syncPolicy   = syncPolicy;
+    writer->syncInterval = syncInterval;
+
+    // a power of two so the free running indices wrap with a mask
+    uint32_t capacity = EZAudioBackgroundWriterMinimumCapacity;
+    while (capacity < bufferDuration * sampleRate && capacity < (1u << 30))
+    {
+        capacity <<= 1;
+    }
+    writer->capacity = capacity;
+    writer->mask     = capacity - 1;
+
+    double   flushFrames = flushDuration * sampleRate;
+    writer->flushFrames  = flushFrames < 1.0 ? 1 : (flushFrames > capacity / 2 ? capacity / 2 : (uint32_t)flushFrames);
+    double   poll        = EZAudioBackgroundWriterPollFraction * writer->flushFrames / sampleRate;
+    poll                 = poll < EZAudioBackgroundWriterMinimumPoll ? EZAudioBackgroundWriterMinimumPoll : (poll > EZAudioBackgroundWriterMaximumPoll ? EZAudioBackgroundWriterMaximumPoll : poll);
+    writer->pollInterval.tv_sec  = (time_t)poll;
+    writer->pollInterval.tv_nsec = (long)((poll - (double)writer->pollInterval.tv_sec) * 1.0e9);
+
+    writer->ring  = (float **)calloc(channels, sizeof(float *));
+    writer->batch = (const float **)calloc(channels, sizeof(float *));
+    if (!writer->ring || !writer->batch)
+    {
+        EZAudioBackgroundWriterFree(writer);
+        return NULL;
+    }
+    for (uint32_t channel = 0; channel < channels; channel++)
+    {
+        // touched now so the audio thread never takes a page fault on it
+        writer->ring[channel] = (float *)calloc(capacity, sizeof(float));
+        if (!writer->ring[channel])
+        {
+            EZAudioBackgroundWriterFree(writer);
+            return NULL;
+        }
+        memset(writer->ring[channel], 0, capacity * sizeof(float));
+    }
+    return writer;
+}
+
+//------------------------------------------------------------------------------
+
+EZAudioBackgroundWriter *EZAudioBackgroundWriterCreate(EZAudioBackgroundWriterSink sink,
+                                                       uint32_t channels,
+                                                       double sampleRate,
+                                                       double bufferDuration,
+                                                       double flushDuration,
+                                                       EZAudioBackgroundWriterSyncPolicy syncPolicy,
+                                                       double syncInterval)
+{
+    if (!sink.write)
+    {
+        return NULL;
+    }
+    EZAudioBackgroundWriter *writer = EZAudioBackgroundWriterAllocate(channels, sampleRate, bufferDuration, flushDuration, syncPolicy, syncInterval);
+    if (!writer)
+    {
+        return NULL;
+    }
+    writer->sink = sink;
+    if (pthread_create(&writer->thread, NULL, EZAudioBackgroundWriterThread, writer) != 0)
+    {
+        EZAudioBackgroundWriterFree(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+//------------------------------------------------------------------------------
+
+EZAudioBackgroundWriter *EZAudioBackgroundWriterCreateSegmented(EZAudioBackgroundWriterSegmenter segmenter,
+                                                                uint64_t segmentFrames,
+                                                                uint32_t channels,
+                                                                double sampleRate,
+                                                                double bufferDuration,
+                                                                double flushDuration,
+                                                                EZAudioBackgroundWriterSyncPolicy syncPolicy,
+                                                                double syncInterval)
+{
+    if (!segmenter.openSegment || segmentFrames == 0)
+    {
+        return NULL;
+    }
+    EZAudioBackgroundWriter *writer = EZAudioBackgroundWriterAllocate(channels, sampleRate, bufferDuration, flushDuration, syncPolicy, syncInterval);
+    if (!writer)
+    {
+        return NULL;
+    }
+    writer->segmented     = true;
+    writer->segmenter     = segmenter;
+    writer->segmentFrames = segmentFrames;
+    if (!segmenter.openSegment(segmenter.context, 0, &writer->sink))
+    {
+        EZAudioBackgroundWriterFree(writer);
+        return NULL;
+    }
+    if (pthread_create(&writer->thread, NULL, EZAudioBackgroundWriterThread, writer) != 0)
+    {
+        if (writer->sink.close)
+        {
+            writer->sink.close(writer->sink.context);
+        }
+        EZAudioBackgroundWriterFree(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+//------------------------------------------------------------------------------
+
+bool EZAudioBackgroundWriterClose(EZAudioBackgroundWriter *writer)
+{
+    if (!writer)
+    {
+        return false;
+    }
+    EZ_AUDIO_BACKGROUND_WRITER_BARRIER();
+    writer->closing = 1;
+    pthread_join(writer->thread, NULL);
+
+    bool completed = writer->writeErrors == 0 && writer->overruns == 0;
+    EZAudioBackgroundWriterFree(writer);
+    return completed;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Writing (Audio Thread)
+//------------------------------------------------------------------------------
+
+bool EZAudioBackgroundWriterWrite(EZAudioBackgroundWriter *writer,
+                                  const float * const *source,
+                                  uint32_t frames)
+{
+    // the writer thread must be done with the space before it's reused
+    uint32_t tail = writer->tail;
+    EZ_AUDIO_BACKGROUND_WRITER_BARRIER();
+    uint32_t head = writer->head;
+    uint32_t fill = head - tail;
+    if (frames > writer->capacity - fill)
+    {
+        writer->overruns++;
+        writer->droppedFrames += frames;
+        return false;
+    }
+
+    uint32_t start = head & writer->mask;
+    uint32_t first = frames < writer->capacity - start ? frames : writer->capacity - start;
+    for (uint32_t channel = 0; channel < writer->channels; channel++)
+    {
+        memcpy(writer->ring[channel] + start, source[channel], first * sizeof(float));
+        memcpy(writer->ring[channel], source[channel] + first, (frames - first) * sizeof(float));
+    }
+
+    // publish the frames once they're all in
+    EZ_AUDIO_BACKGROUND_WRITER_BARRIER();
+    writer->head = head + frames;
+    if (fill + frames > writer->maximumFill)
+    {
+        writer->maximumFill = fill + frames;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Counters
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioBackgroundWriterOverruns(const EZAudioBackgroundWriter *writer)
+{
+    return writer->overruns;
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t EZAudioBackgroundWriterDroppedFrames(const EZAudioBackgroundWriter *writer)
+{
+    return writer->droppedFrames;
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t EZAudioBackgroundWriterWrittenFrames(const EZAudioBackgroundWriter *writer)
+{
+    return writer->writtenFrames;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioBackgroundWriterWriteErrors(const EZAudioBackgroundWriter *writer)
+{
+    return writer->writeErrors;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioBackgroundWriterCompletedSegments(const EZAudioBackgroundWriter *writer)
+{
+    return writer->completedSegments;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioBackgroundWriterMaximumFill(const EZAudioBackgroundWriter *writer)
+{
+    return writer->maximumFill;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Sinks
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterWAVWrite(void *context,
+                                            const float * const *source,
+                                            uint32_t frames)
+{
+    return EZAudioWAVWriterWrite((EZAudioWAVWriter *)context, source, frames);
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterWAVSync(void *context)
+{
+    return EZAudioWAVWriterSync((EZAudioWAVWriter *)context);
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterWAVClose(void *context)
+{
+    return EZAudioWAVWriterClose((EZAudioWAVWriter *)context);
+}
+
+//------------------------------------------------------------------------------
+
+EZAudioBackgroundWriterSink EZAudioBackgroundWriterWAVSink(EZAudioWAVWriter *wavWriter)
+{
+    EZAudioBackgroundWriterSink sink;
+    sink.context = wavWriter;
+    sink.write   = EZAudioBackgroundWriterWAVWrite;
+    sink.sync    = EZAudioBackgroundWriterWAVSync;
+    sink.close   = EZAudioBackgroundWriterWAVClose;
+    return sink;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterFLACWrite(void *context,
+                                             const float * const *source,
+                                             uint32_t frames)
+{
+    return EZAudioFLACEncoderWrite((EZAudioFLACEncoder *)context, source, frames);
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterFLACSync(void *context)
+{
+    return EZAudioFLACEncoderSync((EZAudioFLACEncoder *)context);
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterFLACClose(void *context)
+{
+    return EZAudioFLACEncoderClose((EZAudioFLACEncoder *)context);
+}
+
+//------------------------------------------------------------------------------
+
+EZAudioBackgroundWriterSink EZAudioBackgroundWriterFLACSink(EZAudioFLACEncoder *flacEncoder)
+{
+    EZAudioBackgroundWriterSink sink;
+    sink.context = flacEncoder;
+    sink.write   = EZAudioBackgroundWriterFLACWrite;
+    sink.sync    = EZAudioBackgroundWriterFLACSync;
+    sink.close   = EZAudioBackgroundWriterFLACClose;
+    return sink;
+}
+
+//------------------------------------------------------------------------------
+
+typedef struct
+{
+    EZAudioBackgroundWriterSink sink;
+    uint32_t                    sourceChannels;
+    uint32_t                    destinationChannels;
+    const float                 **channels;
+    float                       *mix;
+} EZAudioBackgroundWriterRemix;
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterRemixWrite(void *context,
+                                              const float * const *source,
+                                              uint32_t frames)
+{
+    EZAudioBackgroundWriterRemix *remix = (EZAudioBackgroundWriterRemix *)context;
+    if (!remix->mix)
+    {
+        // no mixing, just the source channels in the destination's order
+        for (uint32_t channel = 0; channel < remix->destinationChannels; channel++)
+        {
+            remix->channels[channel] = source[channel % remix->sourceChannels];
+        }
+        return remix->sink.write(remix->sink.context, remix->channels, frames);
+    }
+
+    // mixing down to mono a channel at a time keeps the inner loops contiguous
+    float scale = 1.0f / (float)remix->sourceChannels;
+    const float *mix = remix->mix;
+    for (uint32_t offset = 0; offset < frames; offset += EZ_AUDIO_BACKGROUND_WRITER_REMIX_FRAMES)
+    {
+        uint32_t count = frames - offset < EZ_AUDIO_BACKGROUND_WRITER_REMIX_FRAMES ? frames - offset : EZ_AUDIO_BACKGROUND_WRITER_REMIX_FRAMES;
+        memcpy(remix->mix, source[0] + offset, count * sizeof(float));
+        for (uint32_t channel = 1; channel < remix->sourceChannels; channel++)
+        {
+            const float *samples = source[channel] + offset;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                remix->mix[i] += samples[i];
+            }
+        }
+        for (uint32_t i = 0; i < count; i++)
+        {
+            remix->mix[i] *= scale;
+        }
+        if (!remix->sink.write(remix->sink.context, &mix, count))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterRemixSync(void *context)
+{
+    EZAudioBackgroundWriterRemix *remix = (EZAudioBackgroundWriterRemix *)context;
+    return remix->sink.sync ? remix->sink.sync(remix->sink.context) : true;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterRemixClose(void *context)
+{
+    EZAudioBackgroundWriterRemix *remix = (EZAudioBackgroundWriterRemix *)context;
+    bool closed = remix->sink.close ? remix->sink.close(remix->sink.context) : true;
+    free(remix->channels);
+    free(remix->mix);
+    free(remix);
+    return closed;
+}
+
+//------------------------------------------------------------------------------
+
+bool EZAudioBackgroundWriterRemixSink(EZAudioBackgroundWriterSink sink,
+                                      uint32_t sourceChannels,
+                                      uint32_t destinationChannels,
+                                      EZAudioBackgroundWriterSink *remixSink)
+{
+    if (sourceChannels == 0 || destinationChannels == 0 || !remixSink)
+    {
+        return false;
+    }
+
+    EZAudioBackgroundWriterRemix *remix = (EZAudioBackgroundWriterRemix *)calloc(1, sizeof(EZAudioBackgroundWriterRemix));
+    if (!remix)
+    {
+        return false;
+    }
+    remix->sink                = sink;
+    remix->sourceChannels      = sourceChannels;
+    remix->destinationChannels = destinationChannels;
+    remix->channels            = (const float **)calloc(destinationChannels, sizeof(float *));
+    if (destinationChannels == 1 && sourceChannels > 1)
+    {
+        remix->mix = (float *)malloc(EZ_AUDIO_BACKGROUND_WRITER_REMIX_FRAMES * sizeof(float));
+    }
+    if (!remix->channels || (destinationChannels == 1 && sourceChannels > 1 && !remix->mix))
+    {
+        free(remix->channels);
+        free(remix->mix);
+        free(remix);
+        return false;
+    }
+
+    remixSink->context = remix;
+    remixSink->write   = EZAudioBackgroundWriterRemixWrite;
+    remixSink->sync    = EZAudioBackgroundWriterRemixSync;
+    remixSink->close   = EZAudioBackgroundWriterRemixClose;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+typedef struct
+{
+    EZAudioBackgroundWriterSink sink;
+    EZAudioPeakFile             *peakFile;
+} EZAudioBackgroundWriterPeaks;
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterPeaksWrite(void *context,
+                                              const float * const *source,
+                                              uint32_t frames)
+{
+    EZAudioBackgroundWriterPeaks *peaks = (EZAudioBackgroundWriterPeaks *)context;
+    bool written = peaks->sink.write(peaks->sink.context, source, frames);
+    EZAudioPeakFileWrite(peaks->peakFile, source, frames);
+    return written;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterPeaksSync(void *context)
+{
+    EZAudioBackgroundWriterPeaks *peaks = (EZAudioBackgroundWriterPeaks *)context;
+    bool synced = peaks->sink.sync ? peaks->sink.sync(peaks->sink.context) : true;
+    EZAudioPeakFileSync(peaks->peakFile);
+    return synced;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterPeaksClose(void *context)
+{
+    EZAudioBackgroundWriterPeaks *peaks = (EZAudioBackgroundWriterPeaks *)context;
+    bool closed = peaks->sink.close ? peaks->sink.close(peaks->sink.context) : true;
+    free(peaks);
+    return closed;
+}
+
+//------------------------------------------------------------------------------
+
+bool EZAudioBackgroundWriterPeakSink(EZAudioBackgroundWriterSink sink,
+                                     EZAudioPeakFile *peakFile,
+                                     EZAudioBackgroundWriterSink *peakSink)
+{
+    if (!peakFile || !peakSink)
+    {
+        return false;
+    }
+    EZAudioBackgroundWriterPeaks *peaks = (EZAudioBackgroundWriterPeaks *)calloc(1, sizeof(EZAudioBackgroundWriterPeaks));
+    if (!peaks)
+    {
+        return false;
+    }
+    peaks->sink     = sink;
+    peaks->peakFile = peakFile;
+
+    peakSink->context = peaks;
+    peakSink->write   = EZAudioBackgroundWriterPeaksWrite;
+    peakSink->sync    = EZAudioBackgroundWriterPeaksSync;
+    peakSink->close   = EZAudioBackgroundWriterPeaksClose;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+typedef enum
+{
+    EZAudioBackgroundWriterTrackWrite,
+    EZAudioBackgroundWriterTrackSync,
+    EZAudioBackgroundWriterTrackClose
+} EZAudioBackgroundWriterTrackOperation;
+
+typedef struct EZAudioBackgroundWriterMultitrack EZAudioBackgroundWriterMultitrack;
+
+typedef struct
+{
+    EZAudioBackgroundWriterMultitrack *multitrack;
+    pthread_t                         thread;
+} EZAudioBackgroundWriterTrackWorker;
+
+struct EZAudioBackgroundWriterMultitrack
+{
+    EZAudioBackgroundWriterSink           *sinks;
+    uint32_t                              tracks;
+
+    // workers (the first is the writer thread)
+    EZAudioBackgroundWriterTrackWorker    *workers;
+    uint32_t                              threads;
+    pthread_mutex_t                       lock;
+    pthread_cond_t                        wake;
+    pthread_cond_t                        finished;
+    uint32_t                              generation;
+    uint32_t                              nextTrack;
+    uint32_t                              finishedTracks;
+    bool                                  stopping;
+
+    // the operation every track carries out before the writer thread moves on
+    EZAudioBackgroundWriterTrackOperation operation;
+    const float * const                   *source;
+    uint32_t                              frames;
+    bool                                  failed;
+};
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterRunTrack(EZAudioBackgroundWriterMultitrack *multitrack, uint32_t track)
+{
+    EZAudioBackgroundWriterSink *sink = &multitrack->sinks[track];
+    switch (multitrack->operation)
+    {
+        case EZAudioBackgroundWriterTrackWrite:
+            return sink->write(sink->context, multitrack->source + track, multitrack->frames);
+        case EZAudioBackgroundWriterTrackSync:
+            return sink->sync ? sink->sync(sink->context) : true;
+        case EZAudioBackgroundWriterTrackClose:
+            return sink->close ? sink->close(sink->context) : true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+
+// takes tracks until the operation has none left, called with the lock held
+static void EZAudioBackgroundWriterRunTracks(EZAudioBackgroundWriterMultitrack *multitrack)
+{
+    while (multitrack->nextTrack < multitrack->tracks)
+    {
+        uint32_t track = multitrack->nextTrack++;
+        pthread_mutex_unlock(&multitrack->lock);
+        bool succeeded = EZAudioBackgroundWriterRunTrack(multitrack, track);
+        pthread_mutex_lock(&multitrack->lock);
+        multitrack->failed = multitrack->failed || !succeeded;
+        if (++multitrack->finishedTracks == multitrack->tracks)
+        {
+            pthread_cond_broadcast(&multitrack->finished);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void *EZAudioBackgroundWriterTrackWorkerThread(void *argument)
+{
+    EZAudioBackgroundWriterTrackWorker *worker     = (EZAudioBackgroundWriterTrackWorker *)argument;
+    EZAudioBackgroundWriterMultitrack  *multitrack = worker->multitrack;
+    pthread_mutex_lock(&multitrack->lock);
+    uint32_t generation = multitrack->generation;
+    for (;;)
+    {
+        while (!multitrack->stopping && multitrack->generation == generation)
+        {
+            pthread_cond_wait(&multitrack->wake, &multitrack->lock);
+        }
+        if (multitrack->stopping)
+        {
+            break;
+        }
+        generation = multitrack->generation;
+        EZAudioBackgroundWriterRunTracks(multitrack);
+    }
+    pthread_mutex_unlock(&multitrack->lock);
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+
+// every track finishes the operation before this returns, so no file ever gets ahead of the others
+static bool EZAudioBackgroundWriterRunOperation(EZAudioBackgroundWriterMultitrack *multitrack,
+                                                EZAudioBackgroundWriterTrackOperation operation,
+                                                const float * const *source,
+                                                uint32_t frames)
+{
+    // the writer thread takes tracks alongside the workers
+    pthread_mutex_lock(&multitrack->lock);
+    multitrack->operation      = operation;
+    multitrack->source         = source;
+    multitrack->frames         = frames;
+    multitrack->failed         = false;
+    multitrack->nextTrack      = 0;
+    multitrack->finishedTracks = 0;
+    multitrack->generation++;
+    pthread_cond_broadcast(&multitrack->wake);
+    EZAudioBackgroundWriterRunTracks(multitrack);
+    while (multitrack->finishedTracks < multitrack->tracks)
+    {
+        pthread_cond_wait(&multitrack->finished, &multitrack->lock);
+    }
+    bool succeeded = !multitrack->failed;
+    pthread_mutex_unlock(&multitrack->lock);
+    return succeeded;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioBackgroundWriterStopTrackWorkers(EZAudioBackgroundWriterMultitrack *multitrack, uint32_t started)
+{
+    pthread_mutex_lock(&multitrack->lock);
+    multitrack->stopping = true;
+    pthread_cond_broadcast(&multitrack->wake);
+    pthread_mutex_unlock(&multitrack->lock);
+    for (uint32_t t = 1; t < started; t++)
+    {
+        pthread_join(multitrack->workers[t].thread, NULL);
+    }
+    pthread_mutex_destroy(&multitrack->lock);
+    pthread_cond_destroy(&multitrack->wake);
+    pthread_cond_destroy(&multitrack->finished);
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterMultitrackWrite(void *context,
+                                                   const float * const *source,
+                                                   uint32_t frames)
+{
+    EZAudioBackgroundWriterMultitrack *multitrack = (EZAudioBackgroundWriterMultitrack *)context;
+    return EZAudioBackgroundWriterRunOperation(multitrack, EZAudioBackgroundWriterTrackWrite, source, frames);
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterMultitrackSync(void *context)
+{
+    EZAudioBackgroundWriterMultitrack *multitrack = (EZAudioBackgroundWriterMultitrack *)context;
+    return EZAudioBackgroundWriterRunOperation(multitrack, EZAudioBackgroundWriterTrackSync, NULL, 0);
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioBackgroundWriterMultitrackClose(void *context)
+{
+    EZAudioBackgroundWriterMultitrack *multitrack = (EZAudioBackgroundWriterMultitrack *)context;
+    bool closed = EZAudioBackgroundWriterRunOperation(multitrack, EZAudioBackgroundWriterTrackClose, NULL, 0);
+    EZAudioBackgroundWriterStopTrackWorkers(multitrack, multitrack->threads);
+    free(multitrack->workers);
+    free(multitrack->sinks);
+    free(multitrack);
+    return closed;
+}
+
+//------------------------------------------------------------------------------
+
+bool EZAudioBackgroundWriterMultitrackSink(const EZAudioBackgroundWriterSink *trackSinks,
+                                           uint32_t tracks,
+                                           uint32_t threads,
+                                           EZAudioBackgroundWriterSink *multitrackSink)
+{
+    if (!trackSinks || tracks == 0 || !multitrackSink)
+    {
+        return false;
+    }
+
+    EZAudioBackgroundWriterMultitrack *multitrack = (EZAudioBackgroundWriterMultitrack *)calloc(1, sizeof(EZAudioBackgroundWriterMultitrack));
+    if (!multitrack)
+    {
+        return false;
+    }
+    // more threads than tracks would have nothing to do
+    threads = threads == 0 ? 1 : threads;
+    threads = threads > EZ_AUDIO_BACKGROUND_WRITER_MAXIMUM_TRACK_THREADS ? EZ_AUDIO_BACKGROUND_WRITER_MAXIMUM_TRACK_THREADS : threads;
+    multitrack->tracks  = tracks;
+    multitrack->threads = threads < tracks ? threads : tracks;
+    multitrack->sinks   = (EZAudioBackgroundWriterSink *)malloc(tracks * sizeof(EZAudioBackgroundWriterSink));
+    multitrack->workers = (EZAudioBackgroundWriterTrackWorker *)calloc(multitrack->threads, sizeof(EZAudioBackgroundWriterTrackWorker));
+    if (!multitrack->sinks || !multitrack->workers)
+    {
+        free(multitrack->sinks);
+        free(multitrack->workers);
+        free(multitrack);
+        return false;
+    }
+    memcpy(multitrack->sinks, trackSinks, tracks * sizeof(EZAudioBackgroundWriterSink));
+
+    pthread_mutex_init(&multitrack->lock, NULL);
+    pthread_cond_init(&multitrack->wake, NULL);
+    pthread_cond_init(&multitrack->finished, NULL);
+    for (uint32_t t = 0; t < multitrack->threads; t++)
+    {
+        multitrack->workers[t].multitrack = multitrack;
+    }
+    for (uint32_t t = 1; t < multitrack->threads; t++)
+    {
+        if (pthread_create(&multitrack->workers[t].thread, NULL, EZAudioBackgroundWriterTrackWorkerThread, &multitrack->workers[t]) != 0)
+        {
+            EZAudioBackgroundWriterStopTrackWorkers(multitrack, t);
+            free(multitrack->workers);
+            free(multitrack->sinks);
+            free(multitrack);
+            return false;
+        }
+    }
+
+    multitrackSink->context = multitrack;
+    multitrackSink->write   = EZAudioBackgroundWriterMultitrackWrite;
+    multitrackSink->sync    = EZAudioBackgroundWriterMultitrackSync;
+    multitrackSink->close   = EZAudioBackgroundWriterMultitrackClose;
+    return true;
+}
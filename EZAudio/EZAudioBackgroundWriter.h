@@ -0,0 +1,337 @@
+//
+//  EZAudioBackgroundWriter.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef EZAudioBackgroundWriter_h
+#define EZAudioBackgroundWriter_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "EZAudioFLACEncoder.h"
+#include "EZAudioPeakFile.h"
+#include "EZAudioWAVWriter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioBackgroundWriter
+//------------------------------------------------------------------------------
+
+/**
+ Moves writing audio to disk off the realtime audio thread. The audio thread only copies its frames into a preallocated lock-free ring (one per channel) and a dedicated writer thread takes them out in large batches and hands them to a sink, i.e. an EZAudioWAVWriter or an ExtAudioFile. The audio thread never locks, allocates, waits on the writer or touches the disk, so a slow disk or encoder can only cost frames (counted as overruns) rather than glitch the audio.
+
+ The writer thread polls the ring rather than being signaled since waking a thread isn't realtime safe. It writes whenever a batch of at least `flushFrames` has built up, and whatever is left when the writer is closed.
+
+ A long recording can be split into a sequence of files (segments) with EZAudioBackgroundWriterCreateSegmented. The writer thread splits its batches at the exact frame each segment ends on so the segments are sample contiguous, and the next segment's sink is always opened a segment ahead so rolling over is only a swap. The ring keeps filling while the finished segment is closed, so no frames are dropped as long as closing a file takes less than the buffer duration.
+
+ This is plain C on top of POSIX threads without any Core Audio dependencies so it can be stress-tested offline (i.e. on Linux with an EZAudioWAVWriter sink). It is safe for one thread writing frames in, the counters may be read from any thread.
+ */
+typedef struct EZAudioBackgroundWriter EZAudioBackgroundWriter;
+
+/**
+ When the writer thread asks the sink to push what it wrote through to the disk (i.e. fsync).
+ */
+typedef enum
+{
+    /**
+     Never, leave it to the operating system. The least disk traffic.
+     */
+    EZAudioBackgroundWriterSyncPolicyNone,
+    /**
+     Once when the writer is closed so the finished file is on disk when EZAudioBackgroundWriterClose returns.
+     */
+    EZAudioBackgroundWriterSyncPolicyOnClose,
+    /**
+     After a batch once at least the sync interval has passed since the last sync, bounding how much audio a crash or power loss can take.
+     */
+    EZAudioBackgroundWriterSyncPolicyInterval,
+    /**
+     After every batch. The most disk traffic.
+     */
+    EZAudioBackgroundWriterSyncPolicyEveryBatch
+} EZAudioBackgroundWriterSyncPolicy;
+
+/**
+ Where the writer thread puts the frames. Every function is called on the writer thread only.
+ */
+typedef struct
+{
+    /**
+     Passed back to every function.
+     */
+    void *context;
+
+    /**
+     Writes a batch of frames.
+     @param context The sink's context.
+     @param source  One float array per channel.
+     @param frames  The number of frames to write.
+     @return true if the frames were written, false counts a write error.
+     */
+    bool (*write)(void *context,
+                  const float * const *source,
+                  uint32_t frames);
+
+    /**
+     Pushes everything written so far through to the disk. May be NULL if the sink can't.
+     @param context The sink's context.
+     @return true if the sync succeeded, false counts a write error.
+     */
+    bool (*sync)(void *context);
+
+    /**
+     Finishes and closes whatever the sink writes to once every frame has been written. May be NULL.
+     @param context The sink's context.
+     @return true if the close succeeded.
+     */
+    bool (*close)(void *context);
+} EZAudioBackgroundWriterSink;
+
+/**
+ Opens and finishes the segments of a segmented writer. Every function is called on the writer thread, except that the first segment is opened on the thread creating the writer.
+ */
+typedef struct
+{
+    /**
+     Passed back to every function.
+     */
+    void *context;
+
+    /**
+     Opens the sink for a segment (i.e. creates its file).
+     @param context The segmenter's context.
+     @param index   The index of the segment, counting from 0.
+     @param sink    Receives the segment's sink.
+     @return true if the sink was opened. If the next segment can't be opened the current one keeps growing and the open is retried after every batch.
+     */
+    bool (*openSegment)(void *context,
+                        uint32_t index,
+                        EZAudioBackgroundWriterSink *sink);
+
+    /**
+     Called once a segment has been written in full, synced according to the sync policy and its sink closed, i.e. to start uploading it. May be NULL.
+     @param context   The segmenter's context.
+     @param index     The index of the segment.
+     @param frames    The number of frames in the segment.
+     @param succeeded true if every write, sync and the close of the segment succeeded.
+     */
+    void (*segmentCompleted)(void *context,
+                             uint32_t index,
+                             uint64_t frames,
+                             bool succeeded);
+
+    /**
+     Disposes of a segment that was opened ahead but never written to because the writer was closed first (i.e. closes and deletes its empty file). May be NULL, in which case the sink is just closed.
+     @param context The segmenter's context.
+     @param index   The index of the segment.
+     @param sink    The segment's unused sink.
+     */
+    void (*discardSegment)(void *context,
+                           uint32_t index,
+                           EZAudioBackgroundWriterSink sink);
+} EZAudioBackgroundWriterSegmenter;
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+/**
+ Creates a writer and starts its writer thread. Must not be called from an audio thread.
+ @param sink           The EZAudioBackgroundWriterSink the frames are written to. The writer owns it until it's closed.
+ @param channels       The number of channels.
+ @param sampleRate     The sample rate, used to turn the durations into frames.
+ @param bufferDuration How much audio in seconds the ring holds. This is how long the disk may stall before frames are dropped.
+ @param flushDuration  The smallest batch in seconds the writer thread writes at once, i.e. 0.25 for quarter second writes. Clamped to half the buffer duration.
+ @param syncPolicy     The EZAudioBackgroundWriterSyncPolicy for pushing writes through to the disk.
+ @param syncInterval   The shortest time in seconds between syncs for EZAudioBackgroundWriterSyncPolicyInterval, ignored otherwise.
+ @return A new writer or NULL if it couldn't be allocated or its thread started. Close it with EZAudioBackgroundWriterClose.
+ */
+EZAudioBackgroundWriter *EZAudioBackgroundWriterCreate(EZAudioBackgroundWriterSink sink,
+                                                       uint32_t channels,
+                                                       double sampleRate,
+                                                       double bufferDuration,
+                                                       double flushDuration,
+                                                       EZAudioBackgroundWriterSyncPolicy syncPolicy,
+                                                       double syncInterval);
+
+/**
+ Creates a writer that splits the frames into a sequence of segments of a fixed length and starts its writer thread. Must not be called from an audio thread.
+ @param segmenter      The EZAudioBackgroundWriterSegmenter opening and finishing the segments. The first segment is opened before this returns.
+ @param segmentFrames  The number of frames in every segment but the last.
+ @param channels       The number of channels.
+ @param sampleRate     The sample rate, used to turn the durations into frames.
+ @param bufferDuration How much audio in seconds the ring holds. This must cover closing a finished segment on top of any disk stall.
+ @param flushDuration  The smallest batch in seconds the writer thread writes at once. Clamped to half the buffer duration.
+ @param syncPolicy     The EZAudioBackgroundWriterSyncPolicy for pushing writes through to the disk. Anything but EZAudioBackgroundWriterSyncPolicyNone also syncs each segment before it's closed.
+ @param syncInterval   The shortest time in seconds between syncs for EZAudioBackgroundWriterSyncPolicyInterval, ignored otherwise.
+ @return A new writer or NULL if it couldn't be allocated, the first segment opened or its thread started. Close it with EZAudioBackgroundWriterClose.
+ */
+EZAudioBackgroundWriter *EZAudioBackgroundWriterCreateSegmented(EZAudioBackgroundWriterSegmenter segmenter,
+                                                                uint64_t segmentFrames,
+                                                                uint32_t channels,
+                                                                double sampleRate,
+                                                                double bufferDuration,
+                                                                double flushDuration,
+                                                                EZAudioBackgroundWriterSyncPolicy syncPolicy,
+                                                                double syncInterval);
+
+/**
+ Writes out everything still in the ring, closes the sink (completing the last segment of a segmented writer), stops the writer thread and frees the writer. The audio thread must no longer be writing to it.
+ @param writer The writer to close.
+ @return true if every batch, sync, open and close succeeded and no frames were dropped.
+ */
+bool EZAudioBackgroundWriterClose(EZAudioBackgroundWriter *writer);
+
+//------------------------------------------------------------------------------
+#pragma mark - Writing (Audio Thread)
+//------------------------------------------------------------------------------
+
+/**
+ Copies frames into the ring for the writer thread. Safe to call from the realtime audio thread: it never locks, allocates or waits. If there isn't room for all of the frames nothing is copied, the overrun counter is incremented and the frames are added to the dropped frame count.
+ @param writer The writer.
+ @param source One float array per channel.
+ @param frames The number of frames to write.
+ @return true if the frames were queued, false on overrun.
+ */
+bool EZAudioBackgroundWriterWrite(EZAudioBackgroundWriter *writer,
+                                  const float * const *source,
+                                  uint32_t frames);
+
+//------------------------------------------------------------------------------
+#pragma mark - Counters
+//------------------------------------------------------------------------------
+
+/**
+ Provides the number of writes that were dropped because the ring was full.
+ @param writer The writer.
+ @return The overrun count.
+ */
+uint32_t EZAudioBackgroundWriterOverruns(const EZAudioBackgroundWriter *writer);
+
+/**
+ Provides the total number of frames that were dropped because the ring was full.
+ @param writer The writer.
+ @return The dropped frame count.
+ */
+uint64_t EZAudioBackgroundWriterDroppedFrames(const EZAudioBackgroundWriter *writer);
+
+/**
+ Provides the number of frames the sink has written.
+ @param writer The writer.
+ @return The written frame count.
+ */
+uint64_t EZAudioBackgroundWriterWrittenFrames(const EZAudioBackgroundWriter *writer);
+
+/**
+ Provides the number of batches, syncs, segment opens and closes that failed.
+ @param writer The writer.
+ @return The write error count.
+ */
+uint32_t EZAudioBackgroundWriterWriteErrors(const EZAudioBackgroundWriter *writer);
+
+/**
+ Provides the number of segments a segmented writer has completed so far.
+ @param writer The writer.
+ @return The completed segment count.
+ */
+uint32_t EZAudioBackgroundWriterCompletedSegments(const EZAudioBackgroundWriter *writer);
+
+/**
+ Provides the fullest the ring has been, which shows how close the disk came to costing frames and whether the buffer duration can be trimmed.
+ @param writer The writer.
+ @return The high water mark in frames.
+ */
+uint32_t EZAudioBackgroundWriterMaximumFill(const EZAudioBackgroundWriter *writer);
+
+//------------------------------------------------------------------------------
+#pragma mark - Sinks
+//------------------------------------------------------------------------------
+
+/**
+ Provides a sink writing to an EZAudioWAVWriter, synced with EZAudioWAVWriterSync and closed with EZAudioWAVWriterClose.
+ @param wavWriter The EZAudioWAVWriter, with the same number of channels as the background writer. The sink closes it.
+ @return The sink to pass to EZAudioBackgroundWriterCreate.
+ */
+EZAudioBackgroundWriterSink EZAudioBackgroundWriterWAVSink(EZAudioWAVWriter *wavWriter);
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides a sink writing to an EZAudioFLACEncoder, synced with EZAudioFLACEncoderSync and closed with EZAudioFLACEncoderClose. The encoder's own worker threads encode the writer thread's batches, so the writer thread only quantizes and waits on them.
+ @param flacEncoder The EZAudioFLACEncoder, with the same number of channels as the background writer. The sink closes it.
+ @return The sink to pass to EZAudioBackgroundWriterCreate.
+ */
+EZAudioBackgroundWriterSink EZAudioBackgroundWriterFLACSink(EZAudioFLACEncoder *flacEncoder);
+
+//------------------------------------------------------------------------------
+
+/**
+ Wraps a sink so it receives a different number of channels than the background writer holds. Mixing down to mono averages the channels, fewer channels keep the first ones and more channels repeat the source channels in turn (i.e. mono is written to both channels of a stereo file). The remix happens on the writer thread, so the ring only ever holds the source channels.
+ @param sink                The sink taking the destination channels. The wrapping sink closes it.
+ @param sourceChannels      The number of channels the background writer holds.
+ @param destinationChannels The number of channels the wrapped sink takes.
+ @param remixSink           Receives the sink to pass to EZAudioBackgroundWriterCreate.
+ @return true if the remix sink was created. If it wasn't, the caller still owns the wrapped sink.
+ */
+bool EZAudioBackgroundWriterRemixSink(EZAudioBackgroundWriterSink sink,
+                                      uint32_t sourceChannels,
+                                      uint32_t destinationChannels,
+                                      EZAudioBackgroundWriterSink *remixSink);
+
+//------------------------------------------------------------------------------
+
+/**
+ Wraps a sink so every batch written to it is also summarized into an EZAudioPeakFile on the writer thread, and every sync also syncs the peak file. The peak file isn't closed with the sink, so one peak file can span every segment of a segmented recording.
+ @param sink     The sink the audio is written to. The wrapping sink closes it.
+ @param peakFile The EZAudioPeakFile, with the same number of channels as the background writer. The caller closes it after the background writer is closed. A failed peak file doesn't count as a write error.
+ @param peakSink Receives the sink to pass to EZAudioBackgroundWriterCreate.
+ @return true if the peak sink was created. If it wasn't, the caller still owns the wrapped sink.
+ */
+bool EZAudioBackgroundWriterPeakSink(EZAudioBackgroundWriterSink sink,
+                                     EZAudioPeakFile *peakFile,
+                                     EZAudioBackgroundWriterSink *peakSink);
+
+//------------------------------------------------------------------------------
+
+/**
+ Splits a wide recording into one file per channel (a multitrack recording, i.e. each input of a 32 channel interface in its own mono file). Channel i of every batch is written to track i's sink. The tracks are written in parallel by a pool of worker threads together with the writer thread, each taking the next track that hasn't been written yet, so a slow file or encoder holds up the batch rather than a fixed share of the tracks.
+
+ The tracks stay sample aligned: every track is handed exactly the same batches, a batch is finished on every track before the writer thread takes the next one out of the ring, and an overrun drops the same frames from every channel. Syncs and the close are spread over the pool the same way, which matters since fsync is the slowest thing a wide recording does.
+ @param trackSinks     One single channel sink per channel of the background writer. The multitrack sink closes them, they're copied so the array itself can be freed.
+ @param tracks         The number of sinks, the same as the number of channels of the background writer.
+ @param threads        The number of threads writing the tracks, including the writer thread. Clamped to the number of tracks, 1 writes them one after another on the writer thread.
+ @param multitrackSink Receives the sink to pass to EZAudioBackgroundWriterCreate.
+ @return true if the multitrack sink was created and its worker threads started. If it wasn't, the caller still owns the track sinks.
+ */
+bool EZAudioBackgroundWriterMultitrackSink(const EZAudioBackgroundWriterSink *trackSinks,
+                                           uint32_t tracks,
+                                           uint32_t threads,
+                                           EZAudioBackgroundWriterSink *multitrackSink);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,198 @@
+//
+//  EZAudioCallbackMetrics.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#include "EZAudioCallbackMetrics.h"
+#include <libkern/OSAtomic.h>
+#include <mach/mach_time.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+#pragma mark - Histogram
+//------------------------------------------------------------------------------
+
+static inline UInt32 EZAudioCallbackMetricsBucket(UInt32 microseconds)
+{
+    if (microseconds < 4)
+    {
+        return microseconds;
+    }
+
+    // 4 linear sub-buckets per octave, picked by the 2 bits below the leading one
+    UInt32 octave = 31 - __builtin_clz(microseconds);
+    UInt32 sub    = (microseconds >> (octave - 2)) & 3;
+    UInt32 bucket = (octave - 1) * 4 + sub;
+    return bucket < kEZAudioCallbackMetricsHistogramBuckets ? bucket : kEZAudioCallbackMetricsHistogramBuckets - 1;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 EZAudioCallbackMetricsBucketLowerBound(UInt32 bucket)
+{
+    if (bucket < 4)
+    {
+        return bucket;
+    }
+    UInt32 octave = bucket / 4 + 1;
+    UInt32 sub    = bucket % 4;
+    return (4 + sub) << (octave - 2);
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Initialization
+//------------------------------------------------------------------------------
+
+void EZAudioCallbackMetricsInit(EZAudioCallbackMetrics *metrics,
+                                Float64 sampleRate)
+{
+    memset(metrics, 0, sizeof(EZAudioCallbackMetrics));
+    metrics->sampleRate = sampleRate;
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    metrics->hostTicksToMicroseconds = 1.0e-3 * (double)timebase.numer / (double)timebase.denom;
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioCallbackMetricsReset(EZAudioCallbackMetrics *metrics)
+{
+    metrics->resetRequested = 1;
+    OSMemoryBarrier();
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Measuring (Audio Thread)
+//------------------------------------------------------------------------------
+
+UInt64 EZAudioCallbackMetricsBegin(void)
+{
+    return mach_absolute_time();
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioCallbackMetricsEnd(EZAudioCallbackMetrics *metrics,
+                               UInt64 beginTime,
+                               const AudioTimeStamp *timeStamp,
+                               UInt32 frames,
+                               UInt32 framesDelivered)
+{
+    UInt64 endTime      = mach_absolute_time();
+    double elapsed      = (double)(endTime - beginTime) * metrics->hostTicksToMicroseconds;
+    UInt32 microseconds = elapsed < (double)UINT32_MAX ? (UInt32)elapsed : UINT32_MAX;
+    double deadline     = metrics->sampleRate > 0.0 ? 1.0e6 * frames / metrics->sampleRate : 0.0;
+
+    // odd sequence numbers tell readers the counters are mid-update
+    metrics->sequence++;
+    OSMemoryBarrier();
+
+    EZAudioCallbackMetricsSnapshot *counters = &metrics->counters;
+    if (metrics->resetRequested)
+    {
+        memset(counters, 0, sizeof(EZAudioCallbackMetricsSnapshot));
+        metrics->hasNextSampleTime = false;
+        metrics->resetRequested = 0;
+    }
+
+    counters->callbacks++;
+    counters->frames += frames;
+    counters->framesDelivered += framesDelivered;
+    if (framesDelivered < frames)
+    {
+        counters->shortBuffers++;
+    }
+    if (deadline > 0.0 && elapsed > deadline)
+    {
+        counters->deadlineMisses++;
+    }
+    counters->totalMicroseconds += microseconds;
+    counters->lastMicroseconds = microseconds;
+    if (microseconds > counters->maxMicroseconds)
+    {
+        counters->maxMicroseconds = microseconds;
+    }
+    counters->histogram[EZAudioCallbackMetricsBucket(microseconds)]++;
+
+    // every callback should start where the last one left off
+    if (timeStamp && (timeStamp->mFlags & kAudioTimeStampSampleTimeValid))
+    {
+        if (metrics->hasNextSampleTime)
+        {
+            Float64 gap = timeStamp->mSampleTime - metrics->nextSampleTime;
+            if (gap <= -1.0 || gap >= 1.0)
+            {
+                counters->timestampGaps++;
+                counters->gapFrames += (UInt64)(gap < 0.0 ? -gap : gap);
+            }
+        }
+        metrics->nextSampleTime = timeStamp->mSampleTime + frames;
+        metrics->hasNextSampleTime = true;
+    }
+
+    OSMemoryBarrier();
+    metrics->sequence++;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Reading (Any Thread)
+//------------------------------------------------------------------------------
+
+void EZAudioCallbackMetricsRead(EZAudioCallbackMetrics *metrics,
+                                EZAudioCallbackMetricsSnapshot *snapshot)
+{
+    UInt32 sequence;
+    do
+    {
+        sequence = metrics->sequence;
+        OSMemoryBarrier();
+        memcpy(snapshot, &metrics->counters, sizeof(EZAudioCallbackMetricsSnapshot));
+        OSMemoryBarrier();
+    }
+    while ((sequence & 1) || sequence != metrics->sequence);
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 EZAudioCallbackMetricsPercentile(const EZAudioCallbackMetricsSnapshot *snapshot,
+                                        double percentile)
+{
+    if (snapshot->callbacks == 0)
+    {
+        return 0;
+    }
+
+    UInt64 target = (UInt64)(percentile * (double)snapshot->callbacks + 0.5);
+    target = target < 1 ? 1 : target;
+    UInt64 count  = 0;
+    for (UInt32 bucket = 0; bucket < kEZAudioCallbackMetricsHistogramBuckets - 1; bucket++)
+    {
+        count += snapshot->histogram[bucket];
+        if (count >= target)
+        {
+            UInt32 upperBound = EZAudioCallbackMetricsBucketLowerBound(bucket + 1);
+            return upperBound < snapshot->maxMicroseconds ? upperBound : snapshot->maxMicroseconds;
+        }
+    }
+    return snapshot->maxMicroseconds;
+}
@@ -0,0 +1,159 @@
+//
+//  EZAudioCallbackMetrics.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef EZAudioCallbackMetrics_h
+#define EZAudioCallbackMetrics_h
+
+#include <AudioToolbox/AudioToolbox.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------------------------------------------------------
+#pragma mark - Constants
+//------------------------------------------------------------------------------
+
+/**
+ The number of buckets in a callback duration histogram. Bucket boundaries are spaced a quarter octave apart (4 buckets per doubling) starting at 1 microsecond, so every duration is recorded to within 25% and the last bucket collects everything longer than about 0.5 seconds.
+ */
+#define kEZAudioCallbackMetricsHistogramBuckets 76
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioCallbackMetricsSnapshot
+//------------------------------------------------------------------------------
+
+/**
+ A consistent copy of an EZAudioCallbackMetrics' counters, taken with EZAudioCallbackMetricsRead.
+ */
+typedef struct EZAudioCallbackMetricsSnapshot
+{
+    UInt64 callbacks;           // number of callbacks measured
+    UInt64 frames;              // frames the callbacks were asked for
+    UInt64 framesDelivered;     // frames that actually had audio
+    UInt64 shortBuffers;        // callbacks that delivered fewer frames than they were asked for
+    UInt64 deadlineMisses;      // callbacks that took longer than the audio they handled lasts
+    UInt64 timestampGaps;       // callbacks whose sample time didn't follow on from the last one
+    UInt64 gapFrames;           // total frames skipped or repeated between those callbacks
+    UInt64 totalMicroseconds;   // total time spent in the callbacks
+    UInt32 maxMicroseconds;     // longest callback
+    UInt32 lastMicroseconds;    // most recent callback
+    UInt64 histogram[kEZAudioCallbackMetricsHistogramBuckets];
+} EZAudioCallbackMetricsSnapshot;
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioCallbackMetrics
+//------------------------------------------------------------------------------
+
+/**
+ Lock-free instrumentation for a realtime audio callback. The callback brackets its work with EZAudioCallbackMetricsBegin and EZAudioCallbackMetricsEnd, which record how long it took against its deadline (the duration of the frames it handled), how many frames it delivered and whether its sample time jumped. Nothing on the audio thread ever waits: the counters are published through a sequence counter and EZAudioCallbackMetricsRead retries on any other thread until it gets a consistent copy.
+
+ Safe for one audio thread writing and any number of threads reading.
+ */
+typedef struct EZAudioCallbackMetrics
+{
+    EZAudioCallbackMetricsSnapshot counters;
+    volatile UInt32                sequence;
+    volatile UInt32                resetRequested;
+    Float64                        sampleRate;
+    double                         hostTicksToMicroseconds;
+    Float64                        nextSampleTime;
+    bool                           hasNextSampleTime;
+} EZAudioCallbackMetrics;
+
+//------------------------------------------------------------------------------
+#pragma mark - Initialization
+//------------------------------------------------------------------------------
+
+/**
+ Zeroes the metrics and sets the sample rate deadlines are computed with. Must not be called while the audio thread is using the metrics.
+ @param metrics    The metrics to initialize.
+ @param sampleRate The sample rate of the callback's frames.
+ */
+void EZAudioCallbackMetricsInit(EZAudioCallbackMetrics *metrics,
+                                Float64 sampleRate);
+
+/**
+ Asks the audio thread to zero the counters at the end of its next callback. Safe to call from any thread.
+ @param metrics The metrics to reset.
+ */
+void EZAudioCallbackMetricsReset(EZAudioCallbackMetrics *metrics);
+
+//------------------------------------------------------------------------------
+#pragma mark - Measuring (Audio Thread)
+//------------------------------------------------------------------------------
+
+/**
+ Marks the start of a callback.
+ @return The current host time to pass to EZAudioCallbackMetricsEnd.
+ */
+UInt64 EZAudioCallbackMetricsBegin(void);
+
+/**
+ Records a callback. Never locks or allocates.
+ @param metrics         The metrics to record into.
+ @param beginTime       The host time returned by EZAudioCallbackMetricsBegin.
+ @param timeStamp       The callback's AudioTimeStamp, used to detect gaps in the sample time. May be NULL.
+ @param frames          The number of frames the callback was asked for.
+ @param framesDelivered The number of those frames that had audio (i.e. fewer when a source ran dry or a render failed).
+ */
+void EZAudioCallbackMetricsEnd(EZAudioCallbackMetrics *metrics,
+                               UInt64 beginTime,
+                               const AudioTimeStamp *timeStamp,
+                               UInt32 frames,
+                               UInt32 framesDelivered);
+
+//------------------------------------------------------------------------------
+#pragma mark - Reading (Any Thread)
+//------------------------------------------------------------------------------
+
+/**
+ Copies a consistent snapshot of the counters without disturbing the audio thread.
+ @param metrics  The metrics to read.
+ @param snapshot The snapshot to copy into.
+ */
+void EZAudioCallbackMetricsRead(EZAudioCallbackMetrics *metrics,
+                                EZAudioCallbackMetricsSnapshot *snapshot);
+
+/**
+ Provides the callback duration below which a given fraction of the callbacks in a snapshot fall.
+ @param snapshot   The snapshot.
+ @param percentile The fraction of callbacks from 0.0 to 1.0 (i.e. 0.99 for the 99th percentile).
+ @return The upper bound of the histogram bucket holding that percentile in microseconds, or 0 if there were no callbacks.
+ */
+UInt32 EZAudioCallbackMetricsPercentile(const EZAudioCallbackMetricsSnapshot *snapshot,
+                                        double percentile);
+
+/**
+ Provides the lowest duration recorded in a histogram bucket.
+ @param bucket The bucket index from 0 to kEZAudioCallbackMetricsHistogramBuckets - 1.
+ @return The bucket's lower bound in microseconds.
+ */
+UInt32 EZAudioCallbackMetricsBucketLowerBound(UInt32 bucket);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,530 @@
+//
+//  EZAudioDSP.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#include "EZAudioDSP.h"
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+
+#define EZ_AUDIO_DSP_INLINE static inline __attribute__((always_inline))
+
+typedef enum
+{
+    EZAudioDSPSampleTypeFloat32,
+    EZAudioDSPSampleTypeSInt16
+} EZAudioDSPSampleType;
+
+//------------------------------------------------------------------------------
+#pragma mark - Samples
+//------------------------------------------------------------------------------
+
+// The generic loops below take the sample type, channel count and layout as
+// arguments. Every kernel wrapper passes them as constants so the compiler
+// folds the branches away and emits one straight loop per specialization.
+
+EZ_AUDIO_DSP_INLINE size_t _EZAudioDSPSampleSize(const EZAudioDSPSampleType type)
+{
+    return type == EZAudioDSPSampleTypeFloat32 ? sizeof(Float32) : sizeof(SInt16);
+}
+
+//------------------------------------------------------------------------------
+
+EZ_AUDIO_DSP_INLINE float _EZAudioDSPLoad(const void *samples,
+                                          size_t index,
+                                          const EZAudioDSPSampleType type)
+{
+    if (type == EZAudioDSPSampleTypeFloat32)
+    {
+        return ((const Float32 *)samples)[index];
+    }
+    return (float)((const SInt16 *)samples)[index] * (1.0f / 32768.0f);
+}
+
+//------------------------------------------------------------------------------
+
+EZ_AUDIO_DSP_INLINE void _EZAudioDSPStore(void *samples,
+                                          size_t index,
+                                          float value,
+                                          const EZAudioDSPSampleType type)
+{
+    if (type == EZAudioDSPSampleTypeFloat32)
+    {
+        ((Float32 *)samples)[index] = value;
+    }
+    else
+    {
+        float scaled = value * 32768.0f;
+        scaled = scaled > 32767.0f ? 32767.0f : (scaled < -32768.0f ? -32768.0f : scaled);
+        ((SInt16 *)samples)[index] = (SInt16)lrintf(scaled);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+EZ_AUDIO_DSP_INLINE float _EZAudioDSPSumOfSquares(const void *samples,
+                                                  size_t start,
+                                                  UInt32 length,
+                                                  const EZAudioDSPSampleType type)
+{
+    float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+    UInt32 i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        float x0 = _EZAudioDSPLoad(samples, start + i,     type);
+        float x1 = _EZAudioDSPLoad(samples, start + i + 1, type);
+        float x2 = _EZAudioDSPLoad(samples, start + i + 2, type);
+        float x3 = _EZAudioDSPLoad(samples, start + i + 3, type);
+        sum0 += x0 * x0;
+        sum1 += x1 * x1;
+        sum2 += x2 * x2;
+        sum3 += x3 * x3;
+    }
+    for (; i < length; i++)
+    {
+        float x = _EZAudioDSPLoad(samples, start + i, type);
+        sum0 += x * x;
+    }
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Generic Loops
+//------------------------------------------------------------------------------
+
+EZ_AUDIO_DSP_INLINE void _EZAudioDSPToFloat(const AudioBufferList *source,
+                                            UInt32 frameOffset,
+                                            float * const *destination,
+                                            UInt32 frames,
+                                            const UInt32 channels,
+                                            const EZAudioDSPSampleType type,
+                                            const bool interleaved)
+{
+    if (!interleaved || channels == 1)
+    {
+        for (UInt32 channel = 0; channel < channels; channel++)
+        {
+            const void *samples = source->mBuffers[channel].mData;
+            float *out = destination[channel];
+            for (UInt32 i = 0; i < frames; i++)
+            {
+                out[i] = _EZAudioDSPLoad(samples, (size_t)frameOffset + i, type);
+            }
+        }
+    }
+    else if (channels == 2)
+    {
+        const void *samples = source->mBuffers[0].mData;
+        float *left  = destination[0];
+        float *right = destination[1];
+        size_t base  = (size_t)frameOffset * 2;
+        for (UInt32 i = 0; i < frames; i++)
+        {
+            left[i]  = _EZAudioDSPLoad(samples, base + 2 * i,     type);
+            right[i] = _EZAudioDSPLoad(samples, base + 2 * i + 1, type);
+        }
+    }
+    else
+    {
+        const void *samples = source->mBuffers[0].mData;
+        size_t base = (size_t)frameOffset * channels;
+        for (UInt32 channel = 0; channel < channels; channel++)
+        {
+            float *out = destination[channel];
+            for (UInt32 i = 0; i < frames; i++)
+            {
+                out[i] = _EZAudioDSPLoad(samples, base + (size_t)i * channels + channel, type);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+EZ_AUDIO_DSP_INLINE void _EZAudioDSPFromFloat(float * const *source,
+                                              AudioBufferList *destination,
+                                              UInt32 frameOffset,
+                                              UInt32 frames,
+                                              const UInt32 channels,
+                                              const EZAudioDSPSampleType type,
+                                              const bool interleaved)
+{
+    if (!interleaved || channels == 1)
+    {
+        for (UInt32 channel = 0; channel < channels; channel++)
+        {
+            void *samples = destination->mBuffers[channel].mData;
+            const float *in = source[channel];
+            for (UInt32 i = 0; i < frames; i++)
+            {
+                _EZAudioDSPStore(samples, (size_t)frameOffset + i, in[i], type);
+            }
+        }
+    }
+    else if (channels == 2)
+    {
+        void *samples = destination->mBuffers[0].mData;
+        const float *left  = source[0];
+        const float *right = source[1];
+        size_t base = (size_t)frameOffset * 2;
+        for (UInt32 i = 0; i < frames; i++)
+        {
+            _EZAudioDSPStore(samples, base + 2 * i,     left[i],  type);
+            _EZAudioDSPStore(samples, base + 2 * i + 1, right[i], type);
+        }
+    }
+    else
+    {
+        void *samples = destination->mBuffers[0].mData;
+        size_t base = (size_t)frameOffset * channels;
+        for (UInt32 channel = 0; channel < channels; channel++)
+        {
+            const float *in = source[channel];
+            for (UInt32 i = 0; i < frames; i++)
+            {
+                _EZAudioDSPStore(samples, base + (size_t)i * channels + channel, in[i], type);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+EZ_AUDIO_DSP_INLINE void _EZAudioDSPRMS(const AudioBufferList *source,
+                                        UInt32 frameOffset,
+                                        UInt32 frames,
+                                        const UInt32 channels,
+                                        float *rms,
+                                        const EZAudioDSPSampleType type,
+                                        const bool interleaved)
+{
+    if (frames == 0)
+    {
+        for (UInt32 channel = 0; channel < channels; channel++)
+        {
+            rms[channel] = 0.0f;
+        }
+        return;
+    }
+
+    if (!interleaved || channels == 1)
+    {
+        for (UInt32 channel = 0; channel < channels; channel++)
+        {
+            float sum = _EZAudioDSPSumOfSquares(source->mBuffers[channel].mData,
+                                                frameOffset,
+                                                frames,
+                                                type);
+            rms[channel] = sqrtf(sum / frames);
+        }
+    }
+    else if (channels == 2)
+    {
+        const void *samples = source->mBuffers[0].mData;
+        size_t base = (size_t)frameOffset * 2;
+        float left0 = 0.0f, left1 = 0.0f, right0 = 0.0f, right1 = 0.0f;
+        UInt32 i = 0;
+        for (; i + 2 <= frames; i += 2)
+        {
+            float l0 = _EZAudioDSPLoad(samples, base + 2 * i,     type);
+            float r0 = _EZAudioDSPLoad(samples, base + 2 * i + 1, type);
+            float l1 = _EZAudioDSPLoad(samples, base + 2 * i + 2, type);
+            float r1 = _EZAudioDSPLoad(samples, base + 2 * i + 3, type);
+            left0  += l0 * l0;
+            right0 += r0 * r0;
+            left1  += l1 * l1;
+            right1 += r1 * r1;
+        }
+        for (; i < frames; i++)
+        {
+            float l = _EZAudioDSPLoad(samples, base + 2 * i,     type);
+            float r = _EZAudioDSPLoad(samples, base + 2 * i + 1, type);
+            left0  += l * l;
+            right0 += r * r;
+        }
+        rms[0] = sqrtf((left0 + left1) / frames);
+        rms[1] = sqrtf((right0 + right1) / frames);
+    }
+    else
+    {
+        const void *samples = source->mBuffers[0].mData;
+        size_t base = (size_t)frameOffset * channels;
+        for (UInt32 channel = 0; channel < channels; channel++)
+        {
+            float sum = 0.0f;
+            for (UInt32 i = 0; i < frames; i++)
+            {
+                float x = _EZAudioDSPLoad(samples, base + (size_t)i * channels + channel, type);
+                sum += x * x;
+            }
+            rms[channel] = sqrtf(sum / frames);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+EZ_AUDIO_DSP_INLINE void _EZAudioDSPFill(const float *source,
+                                         AudioBufferList *destination,
+                                         UInt32 frameOffset,
+                                         UInt32 frames,
+                                         const UInt32 channels,
+                                         const EZAudioDSPSampleType type,
+                                         const bool interleaved)
+{
+    if (!interleaved || channels == 1)
+    {
+        for (UInt32 channel = 0; channel < channels; channel++)
+        {
+            void *samples = destination->mBuffers[channel].mData;
+            if (type == EZAudioDSPSampleTypeFloat32)
+            {
+                memcpy((Float32 *)samples + frameOffset, source, frames * sizeof(Float32));
+            }
+            else
+            {
+                for (UInt32 i = 0; i < frames; i++)
+                {
+                    _EZAudioDSPStore(samples, (size_t)frameOffset + i, source[i], type);
+                }
+            }
+        }
+    }
+    else if (channels == 2)
+    {
+        void *samples = destination->mBuffers[0].mData;
+        size_t base = (size_t)frameOffset * 2;
+        for (UInt32 i = 0; i < frames; i++)
+        {
+            _EZAudioDSPStore(samples, base + 2 * i,     source[i], type);
+            _EZAudioDSPStore(samples, base + 2 * i + 1, source[i], type);
+        }
+    }
+    else
+    {
+        void *samples = destination->mBuffers[0].mData;
+        size_t base = (size_t)frameOffset * channels;
+        for (UInt32 i = 0; i < frames; i++)
+        {
+            for (UInt32 channel = 0; channel < channels; channel++)
+            {
+                _EZAudioDSPStore(samples, base + (size_t)i * channels + channel, source[i], type);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+EZ_AUDIO_DSP_INLINE void _EZAudioDSPClear(AudioBufferList *destination,
+                                          UInt32 frameOffset,
+                                          UInt32 frames,
+                                          const UInt32 channels,
+                                          const EZAudioDSPSampleType type,
+                                          const bool interleaved)
+{
+    size_t sampleSize = _EZAudioDSPSampleSize(type);
+    if (!interleaved || channels == 1)
+    {
+        for (UInt32 channel = 0; channel < channels; channel++)
+        {
+            char *samples = (char *)destination->mBuffers[channel].mData;
+            memset(samples + (size_t)frameOffset * sampleSize, 0, (size_t)frames * sampleSize);
+        }
+    }
+    else
+    {
+        char *samples = (char *)destination->mBuffers[0].mData;
+        size_t bytesPerFrame = sampleSize * channels;
+        memset(samples + (size_t)frameOffset * bytesPerFrame, 0, (size_t)frames * bytesPerFrame);
+    }
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Kernels
+//------------------------------------------------------------------------------
+
+// Declares the five entry points and the table for one specialization. A
+// channel count of 0 produces the N channel kernel, which reads the channel
+// count passed in at runtime.
+#define EZ_AUDIO_DSP_KERNEL(NAME, TYPE, CHANNELS, INTERLEAVED)                                                   \
+static void NAME##ToFloat(const AudioBufferList *source, UInt32 frameOffset,                                      \
+                          float * const *destination, UInt32 frames, UInt32 channels)                             \
+{                                                                                                                 \
+    _EZAudioDSPToFloat(source, frameOffset, destination, frames,                                                  \
+                       CHANNELS ? CHANNELS : channels, TYPE, INTERLEAVED);                                        \
+}                                                                                                                 \
+static void NAME##FromFloat(float * const *source, AudioBufferList *destination, UInt32 frameOffset,              \
+                            UInt32 frames, UInt32 channels)                                                       \
+{                                                                                                                 \
+    _EZAudioDSPFromFloat(source, destination, frameOffset, frames,                                                \
+                         CHANNELS ? CHANNELS : channels, TYPE, INTERLEAVED);                                      \
+}                                                                                                                 \
+static void NAME##RMS(const AudioBufferList *source, UInt32 frameOffset, UInt32 frames,                           \
+                      UInt32 channels, float *rms)                                                                \
+{                                                                                                                 \
+    _EZAudioDSPRMS(source, frameOffset, frames, CHANNELS ? CHANNELS : channels, rms, TYPE, INTERLEAVED);         \
+}                                                                                                                 \
+static void NAME##Fill(const float *source, AudioBufferList *destination, UInt32 frameOffset,                     \
+                       UInt32 frames, UInt32 channels)                                                            \
+{                                                                                                                 \
+    _EZAudioDSPFill(source, destination, frameOffset, frames, CHANNELS ? CHANNELS : channels, TYPE, INTERLEAVED); \
+}                                                                                                                 \
+static void NAME##Clear(AudioBufferList *destination, UInt32 frameOffset, UInt32 frames, UInt32 channels)         \
+{                                                                                                                 \
+    _EZAudioDSPClear(destination, frameOffset, frames, CHANNELS ? CHANNELS : channels, TYPE, INTERLEAVED);       \
+}                                                                                                                 \
+static const EZAudioDSPKernel NAME =                                                                              \
+{                                                                                                                 \
+    CHANNELS, NAME##ToFloat, NAME##FromFloat, NAME##RMS, NAME##Fill, NAME##Clear                                  \
+};
+
+EZ_AUDIO_DSP_KERNEL(EZAudioDSPKernelFloat32Mono,             EZAudioDSPSampleTypeFloat32, 1, false)
+EZ_AUDIO_DSP_KERNEL(EZAudioDSPKernelFloat32Stereo,           EZAudioDSPSampleTypeFloat32, 2, false)
+EZ_AUDIO_DSP_KERNEL(EZAudioDSPKernelFloat32N,                EZAudioDSPSampleTypeFloat32, 0, false)
+EZ_AUDIO_DSP_KERNEL(EZAudioDSPKernelFloat32StereoInterleaved, EZAudioDSPSampleTypeFloat32, 2, true)
+EZ_AUDIO_DSP_KERNEL(EZAudioDSPKernelFloat32NInterleaved,     EZAudioDSPSampleTypeFloat32, 0, true)
+EZ_AUDIO_DSP_KERNEL(EZAudioDSPKernelSInt16Mono,              EZAudioDSPSampleTypeSInt16,  1, false)
+EZ_AUDIO_DSP_KERNEL(EZAudioDSPKernelSInt16Stereo,            EZAudioDSPSampleTypeSInt16,  2, false)
+EZ_AUDIO_DSP_KERNEL(EZAudioDSPKernelSInt16N,                 EZAudioDSPSampleTypeSInt16,  0, false)
+EZ_AUDIO_DSP_KERNEL(EZAudioDSPKernelSInt16StereoInterleaved, EZAudioDSPSampleTypeSInt16,  2, true)
+EZ_AUDIO_DSP_KERNEL(EZAudioDSPKernelSInt16NInterleaved,      EZAudioDSPSampleTypeSInt16,  0, true)
+
+//------------------------------------------------------------------------------
+#pragma mark - Kernel Lookup
+//------------------------------------------------------------------------------
+
+const EZAudioDSPKernel *EZAudioDSPKernelForFormat(AudioStreamBasicDescription format)
+{
+    if (format.mFormatID != kAudioFormatLinearPCM || format.mChannelsPerFrame == 0)
+    {
+        return NULL;
+    }
+
+    // only native endian, whole-number samples
+    UInt32 flags = format.mFormatFlags;
+    if ((flags & kAudioFormatFlagIsBigEndian) != (kAudioFormatFlagsNativeEndian & kAudioFormatFlagIsBigEndian) ||
+        (flags & kLinearPCMFormatFlagsSampleFractionMask))
+    {
+        return NULL;
+    }
+
+    // the frame must be tightly packed
+    UInt32 channels       = format.mChannelsPerFrame;
+    bool   interleaved    = !(flags & kAudioFormatFlagIsNonInterleaved);
+    UInt32 bytesPerSample = format.mBitsPerChannel / 8;
+    if (format.mBytesPerFrame != bytesPerSample * (interleaved ? channels : 1))
+    {
+        return NULL;
+    }
+
+    // a mono stream has the same layout either way
+    if ((flags & kAudioFormatFlagIsFloat) && format.mBitsPerChannel == 32)
+    {
+        if (channels == 1) return &EZAudioDSPKernelFloat32Mono;
+        if (channels == 2) return interleaved ? &EZAudioDSPKernelFloat32StereoInterleaved : &EZAudioDSPKernelFloat32Stereo;
+        return interleaved ? &EZAudioDSPKernelFloat32NInterleaved : &EZAudioDSPKernelFloat32N;
+    }
+    if ((flags & kAudioFormatFlagIsSignedInteger) && !(flags & kAudioFormatFlagIsFloat) && format.mBitsPerChannel == 16)
+    {
+        if (channels == 1) return &EZAudioDSPKernelSInt16Mono;
+        if (channels == 2) return interleaved ? &EZAudioDSPKernelSInt16StereoInterleaved : &EZAudioDSPKernelSInt16Stereo;
+        return interleaved ? &EZAudioDSPKernelSInt16NInterleaved : &EZAudioDSPKernelSInt16N;
+    }
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Float Utilities
+//------------------------------------------------------------------------------
+
+float EZAudioDSPRMS(const float *buffer, UInt32 length)
+{
+    if (length == 0)
+    {
+        return 0.0f;
+    }
+    return sqrtf(_EZAudioDSPSumOfSquares(buffer, 0, length, EZAudioDSPSampleTypeFloat32) / length);
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioDSPMix(const float *source,
+                   float *destination,
+                   UInt32 length,
+                   float startGain,
+                   float endGain)
+{
+    const float *__restrict in  = source;
+    float       *__restrict out = destination;
+    UInt32 i = 0;
+
+    // a silent source adds nothing
+    if (startGain == 0.0f && endGain == 0.0f)
+    {
+        return;
+    }
+
+    if (startGain == endGain)
+    {
+        const float gain = startGain;
+        for (; i + 4 <= length; i += 4)
+        {
+            out[i]     += in[i]     * gain;
+            out[i + 1] += in[i + 1] * gain;
+            out[i + 2] += in[i + 2] * gain;
+            out[i + 3] += in[i + 3] * gain;
+        }
+        for (; i < length; i++)
+        {
+            out[i] += in[i] * gain;
+        }
+        return;
+    }
+
+    // four lanes each a step apart, advanced four steps at a time
+    const float step = (endGain - startGain) / (float)length;
+    float gain0 = startGain;
+    float gain1 = startGain + step;
+    float gain2 = startGain + 2.0f * step;
+    float gain3 = startGain + 3.0f * step;
+    const float step4 = 4.0f * step;
+    for (; i + 4 <= length; i += 4)
+    {
+        out[i]     += in[i]     * gain0;
+        out[i + 1] += in[i + 1] * gain1;
+        out[i + 2] += in[i + 2] * gain2;
+        out[i + 3] += in[i + 3] * gain3;
+        gain0 += step4;
+        gain1 += step4;
+        gain2 += step4;
+        gain3 += step4;
+    }
+    for (; i < length; i++)
+    {
+        out[i] += in[i] * gain0;
+        gain0 += step;
+    }
+}
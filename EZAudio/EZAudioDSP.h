@@ -0,0 +1,163 @@
+//
+//  EZAudioDSP.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef EZAudioDSP_h
+#define EZAudioDSP_h
+
+#include <AudioToolbox/AudioToolbox.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioDSPKernel
+//------------------------------------------------------------------------------
+
+/**
+ A table of sample loops specialized at compile time for one channel count (mono, stereo or N), one sample type (32-bit float or 16-bit signed integer) and one layout (interleaved or non-interleaved). Components look up the kernel matching their AudioStreamBasicDescription once when the format is configured using `EZAudioDSPKernelForFormat` and then call through the table from the audio thread, so the per-buffer loops never branch on the channel count or layout. The mono and stereo kernels are fully unrolled across channels.
+
+ Every function takes the number of channels as its last argument. The mono and stereo kernels ignore it while the N channel kernels use it as the loop bound.
+ */
+typedef struct EZAudioDSPKernel
+{
+    /**
+     The channel count the kernel was specialized for, or 0 for the N channel kernels.
+     */
+    UInt32 channels;
+
+    /**
+     Converts frames from a buffer list in the kernel's format into non-interleaved float arrays.
+     @param source      The AudioBufferList holding the samples in the kernel's format.
+     @param frameOffset The first frame in the source to convert.
+     @param destination One float array per channel receiving the converted samples.
+     @param frames      The number of frames to convert.
+     @param channels    The number of channels.
+     */
+    void (*toFloat)(const AudioBufferList *source,
+                    UInt32 frameOffset,
+                    float * const *destination,
+                    UInt32 frames,
+                    UInt32 channels);
+
+    /**
+     Converts non-interleaved float arrays into a buffer list in the kernel's format. Integer formats are clipped.
+     @param source      One float array per channel holding the samples to convert.
+     @param destination The AudioBufferList receiving the samples in the kernel's format.
+     @param frameOffset The first frame in the destination to write.
+     @param frames      The number of frames to convert.
+     @param channels    The number of channels.
+     */
+    void (*fromFloat)(float * const *source,
+                      AudioBufferList *destination,
+                      UInt32 frameOffset,
+                      UInt32 frames,
+                      UInt32 channels);
+
+    /**
+     Calculates the root mean square of each channel over a range of frames of a buffer list in the kernel's format.
+     @param source      The AudioBufferList holding the samples.
+     @param frameOffset The first frame of the range.
+     @param frames      The number of frames in the range.
+     @param channels    The number of channels.
+     @param rms         An array with one element per channel receiving the RMS values.
+     */
+    void (*rms)(const AudioBufferList *source,
+                UInt32 frameOffset,
+                UInt32 frames,
+                UInt32 channels,
+                float *rms);
+
+    /**
+     Writes a single float array into every channel of a buffer list in the kernel's format (i.e. a mono source played back on a stereo output).
+     @param source      The float array holding the samples.
+     @param destination The AudioBufferList to fill.
+     @param frameOffset The first frame in the destination to write.
+     @param frames      The number of frames to write.
+     @param channels    The number of channels.
+     */
+    void (*fill)(const float *source,
+                 AudioBufferList *destination,
+                 UInt32 frameOffset,
+                 UInt32 frames,
+                 UInt32 channels);
+
+    /**
+     Writes silence into a range of frames of a buffer list in the kernel's format.
+     @param destination The AudioBufferList to clear.
+     @param frameOffset The first frame to clear.
+     @param frames      The number of frames to clear.
+     @param channels    The number of channels.
+     */
+    void (*clear)(AudioBufferList *destination,
+                  UInt32 frameOffset,
+                  UInt32 frames,
+                  UInt32 channels);
+
+} EZAudioDSPKernel;
+
+//------------------------------------------------------------------------------
+#pragma mark - Kernel Lookup
+//------------------------------------------------------------------------------
+
+/**
+ Provides the kernel specialized for a stream format. Call this when a component is configured (not from the audio thread) and keep the returned pointer around; the kernels are static and never need to be freed.
+ @param format A linear PCM AudioStreamBasicDescription.
+ @return The kernel matching the format, or NULL if the format is not native endian, packed 32-bit float or 16-bit signed integer linear PCM. Callers should fall back to an AudioConverter in that case.
+ */
+const EZAudioDSPKernel *EZAudioDSPKernelForFormat(AudioStreamBasicDescription format);
+
+//------------------------------------------------------------------------------
+#pragma mark - Float Utilities
+//------------------------------------------------------------------------------
+
+/**
+ Calculates the root mean square of a float array using four independent accumulators so the loop pipelines (and vectorizes) without reassociating a single running sum.
+ @param buffer The float array.
+ @param length The length of the float array.
+ @return The RMS of the buffer, or 0 for an empty buffer.
+ */
+float EZAudioDSPRMS(const float *buffer, UInt32 length);
+
+//------------------------------------------------------------------------------
+
+/**
+ Adds a float array scaled by a gain into another float array (destination += source * gain). When the start and end gains differ the gain ramps linearly across the buffer so gain changes don't click. The loops are written four samples wide over non-aliasing arrays so the compiler vectorizes them.
+ @param source      The float array to add.
+ @param destination The float array accumulating the mix. Must not overlap the source.
+ @param length      The length of the float arrays.
+ @param startGain   The gain applied to the first sample.
+ @param endGain     The gain reached after the last sample (the gain the next buffer should start at).
+ */
+void EZAudioDSPMix(const float *source,
+                   float *destination,
+                   UInt32 length,
+                   float startGain,
+                   float endGain);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
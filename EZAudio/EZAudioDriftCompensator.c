@@ -0,0 +1,363 @@
+//
+//  EZAudioDriftCompensator.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#include "EZAudioDriftCompensator.h"
+#include <stdlib.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+
+// the FIFO indices are shared between the writer and reader threads
+#define EZ_AUDIO_DRIFT_BARRIER() __sync_synchronize()
+
+// crystal oscillators are well within 1000 ppm of each other, so anything past
+// that is the fill level correction running away (e.g. a stalled device)
+static const double EZAudioDriftCompensatorMaximumDrift      = 0.001;
+static const double EZAudioDriftCompensatorMaximumCorrection = 0.005;
+
+//------------------------------------------------------------------------------
+
+struct EZAudioDriftCompensator
+{
+    // FIFO (interleaved source frames)
+    float             *fifo;
+    uint32_t          capacity;
+    uint32_t          mask;
+    uint32_t          channels;
+    volatile uint32_t head;
+    volatile uint32_t tail;
+
+    // when the writer last wrote (guarded by a sequence count so the reader
+    // never pairs a new time with an old frame count)
+    volatile uint32_t stampSequence;
+    volatile uint32_t stampFrames;
+    volatile double   stampTime;
+
+    // resampler (read position in source frames relative to the tail)
+    double            position;
+    int               primed;
+
+    // control loop
+    double            sampleRate;
+    double            nominalRatio;
+    double            latency;
+    double            bandwidth;
+    double            kp;
+    double            ki;
+    double            filterRate;
+    double            fillLevel;
+    double            integral;
+    double            ratio;
+    uint32_t          underruns;
+};
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+EZAudioDriftCompensator *EZAudioDriftCompensatorCreate(uint32_t channels,
+                                                       double sampleRate,
+                                                       double nominalRatio,
+                                                       uint32_t latencyFrames,
+                                                       double bandwidth)
+{
+    if (channels == 0 || sampleRate <= 0.0 || nominalRatio <= 0.0 || bandwidth <= 0.0)
+    {
+        return NULL;
+    }
+
+    EZAudioDriftCompensator *compensator = (EZAudioDriftCompensator *)calloc(1, sizeof(EZAudioDriftCompensator));
+    if (!compensator)
+    {
+        return NULL;
+    }
+
+    // room for the target latency plus plenty of slack for bursty devices
+    uint32_t capacity = 1;
+    while (capacity < 4 * latencyFrames + 4096)
+    {
+        capacity <<= 1;
+    }
+    compensator->fifo = (float *)calloc((size_t)capacity * channels, sizeof(float));
+    if (!compensator->fifo)
+    {
+        free(compensator);
+        return NULL;
+    }
+    compensator->capacity = capacity;
+    compensator->mask = capacity - 1;
+    compensator->channels = channels;
+
+    // Critically damped PI loop with a natural frequency of 1 / bandwidth.
+    // The fill level is low-passed at 4x that so the sawtooth from device
+    // block sizes barely reaches the resampling ratio.
+    double omega = 1.0 / (bandwidth * sampleRate);
+    compensator->sampleRate = sampleRate;
+    compensator->nominalRatio = nominalRatio;
+    compensator->latency = latencyFrames;
+    compensator->bandwidth = bandwidth;
+    compensator->kp = 2.0 * omega;
+    compensator->ki = omega * omega;
+    compensator->filterRate = 4.0 * omega;
+
+    EZAudioDriftCompensatorReset(compensator);
+    return compensator;
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioDriftCompensatorFree(EZAudioDriftCompensator *compensator)
+{
+    if (compensator)
+    {
+        free(compensator->fifo);
+        free(compensator);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioDriftCompensatorReset(EZAudioDriftCompensator *compensator)
+{
+    compensator->head = 0;
+    compensator->tail = 0;
+    compensator->stampSequence = 0;
+    compensator->stampFrames = 0;
+    compensator->stampTime = 0.0;
+    compensator->position = 1.0;
+    compensator->primed = 0;
+    compensator->fillLevel = 0.0;
+    compensator->integral = 0.0;
+    compensator->ratio = compensator->nominalRatio;
+    compensator->underruns = 0;
+    EZ_AUDIO_DRIFT_BARRIER();
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Writing (Source Thread)
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioDriftCompensatorWrite(EZAudioDriftCompensator *compensator,
+                                      const float * const *source,
+                                      uint32_t frames,
+                                      double time)
+{
+    uint32_t head = compensator->head;
+    uint32_t tail = compensator->tail;
+    EZ_AUDIO_DRIFT_BARRIER();
+
+    uint32_t space = compensator->capacity - (head - tail);
+    frames = frames < space ? frames : space;
+
+    uint32_t channels = compensator->channels;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        float *frame = compensator->fifo + (size_t)((head + i) & compensator->mask) * channels;
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            frame[channel] = source[channel][i];
+        }
+    }
+
+    // publish the frames only once they've been written
+    EZ_AUDIO_DRIFT_BARRIER();
+    compensator->head = head + frames;
+
+    // then when they arrived
+    compensator->stampSequence++;
+    EZ_AUDIO_DRIFT_BARRIER();
+    compensator->stampFrames = head + frames;
+    compensator->stampTime = time;
+    EZ_AUDIO_DRIFT_BARRIER();
+    compensator->stampSequence++;
+    return frames;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Reading (Master Thread)
+//------------------------------------------------------------------------------
+
+static void EZAudioDriftCompensatorSilence(float * const *destination,
+                                           uint32_t channels,
+                                           uint32_t offset,
+                                           uint32_t frames)
+{
+    for (uint32_t channel = 0; channel < channels; channel++)
+    {
+        memset(destination[channel] + offset, 0, frames * sizeof(float));
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioDriftCompensatorUpdateRatio(EZAudioDriftCompensator *compensator,
+                                               double fill,
+                                               uint32_t frames)
+{
+    double alpha = frames * compensator->filterRate;
+    compensator->fillLevel += (alpha < 1.0 ? alpha : 1.0) * (fill - compensator->fillLevel);
+
+    // the integral settles on the drift, the proportional term pulls the fill level in
+    double error = compensator->fillLevel - compensator->latency;
+    double maximumDrift = EZAudioDriftCompensatorMaximumDrift * compensator->nominalRatio;
+    double integral = compensator->integral + compensator->ki * error * frames;
+    integral = integral > maximumDrift ? maximumDrift : integral;
+    integral = integral < -maximumDrift ? -maximumDrift : integral;
+    compensator->integral = integral;
+
+    double maximumCorrection = EZAudioDriftCompensatorMaximumCorrection * compensator->nominalRatio;
+    double correction = integral + compensator->kp * error;
+    correction = correction > maximumCorrection ? maximumCorrection : correction;
+    correction = correction < -maximumCorrection ? -maximumCorrection : correction;
+    compensator->ratio = compensator->nominalRatio + correction;
+}
+
+//------------------------------------------------------------------------------
+
+static double EZAudioDriftCompensatorWrittenFrames(EZAudioDriftCompensator *compensator,
+                                                   double time)
+{
+    uint32_t sequence;
+    uint32_t frames;
+    double   stampTime;
+    do
+    {
+        sequence = compensator->stampSequence;
+        EZ_AUDIO_DRIFT_BARRIER();
+        frames = compensator->stampFrames;
+        stampTime = compensator->stampTime;
+        EZ_AUDIO_DRIFT_BARRIER();
+    }
+    while ((sequence & 1) || sequence != compensator->stampSequence);
+
+    // The writer delivers in blocks so the raw fill level is a sawtooth whose
+    // phase against the reader slides with the drift. Extrapolating to now
+    // from when the last block arrived flattens it out.
+    double elapsed = time - stampTime;
+    elapsed = elapsed > 0.0 ? elapsed : 0.0;
+    elapsed = elapsed < compensator->bandwidth ? elapsed : compensator->bandwidth;
+    double rate = compensator->sampleRate * (compensator->nominalRatio + compensator->integral);
+    return (double)(uint32_t)(frames - compensator->tail) + elapsed * rate;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioDriftCompensatorRead(EZAudioDriftCompensator *compensator,
+                                     float * const *destination,
+                                     uint32_t frames,
+                                     double time)
+{
+    uint32_t tail = compensator->tail;
+    uint32_t head = compensator->head;
+    EZ_AUDIO_DRIFT_BARRIER();
+
+    uint32_t available = head - tail;
+    uint32_t channels = compensator->channels;
+
+    // wait for the target latency before starting (or restarting) playout
+    if (!compensator->primed)
+    {
+        if (available < compensator->latency + 3)
+        {
+            EZAudioDriftCompensatorSilence(destination, channels, 0, frames);
+            return 0;
+        }
+        compensator->primed = 1;
+        compensator->position = 1.0;
+        compensator->fillLevel = EZAudioDriftCompensatorWrittenFrames(compensator, time) - 1.0;
+    }
+
+    double written = EZAudioDriftCompensatorWrittenFrames(compensator, time);
+    EZAudioDriftCompensatorUpdateRatio(compensator, written - compensator->position, frames);
+
+    // 4-point Hermite interpolation around the fractional read position
+    const float *fifo = compensator->fifo;
+    uint32_t mask = compensator->mask;
+    double position = compensator->position;
+    double ratio = compensator->ratio;
+    uint32_t i;
+    for (i = 0; i < frames; i++)
+    {
+        uint32_t index = (uint32_t)position;
+        if (index + 2 >= available)
+        {
+            // ran dry, fill the rest with silence and build the latency back up
+            EZAudioDriftCompensatorSilence(destination, channels, i, frames - i);
+            compensator->primed = 0;
+            compensator->underruns++;
+            break;
+        }
+
+        float t = (float)(position - index);
+        const float *xm1 = fifo + (size_t)((tail + index - 1) & mask) * channels;
+        const float *x0 = fifo + (size_t)((tail + index) & mask) * channels;
+        const float *x1 = fifo + (size_t)((tail + index + 1) & mask) * channels;
+        const float *x2 = fifo + (size_t)((tail + index + 2) & mask) * channels;
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            float c1 = 0.5f * (x1[channel] - xm1[channel]);
+            float c2 = xm1[channel] - 2.5f * x0[channel] + 2.0f * x1[channel] - 0.5f * x2[channel];
+            float c3 = 0.5f * (x2[channel] - xm1[channel]) + 1.5f * (x0[channel] - x1[channel]);
+            destination[channel][i] = ((c3 * t + c2) * t + c1) * t + x0[channel];
+        }
+        position += ratio;
+    }
+
+    // release everything before the frame preceding the read position
+    uint32_t consumed = (uint32_t)position - 1;
+    compensator->position = position - consumed;
+    EZ_AUDIO_DRIFT_BARRIER();
+    compensator->tail = tail + consumed;
+    return i;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Estimates
+//------------------------------------------------------------------------------
+
+double EZAudioDriftCompensatorDrift(EZAudioDriftCompensator *compensator)
+{
+    return 1.0e6 * compensator->integral / compensator->nominalRatio;
+}
+
+//------------------------------------------------------------------------------
+
+double EZAudioDriftCompensatorRatio(EZAudioDriftCompensator *compensator)
+{
+    return compensator->ratio;
+}
+
+//------------------------------------------------------------------------------
+
+double EZAudioDriftCompensatorFillLevel(EZAudioDriftCompensator *compensator)
+{
+    return compensator->fillLevel;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioDriftCompensatorUnderruns(EZAudioDriftCompensator *compensator)
+{
+    return compensator->underruns;
+}
@@ -0,0 +1,148 @@
+//
+//  EZAudioDriftCompensator.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef EZAudioDriftCompensator_h
+#define EZAudioDriftCompensator_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioDriftCompensator
+//------------------------------------------------------------------------------
+
+/**
+ Aligns a source running on its own clock with a master clock. The source's thread writes float frames in whenever its device delivers them and the master's thread reads the same number of frames it needs, resampled so the source plays out at the master's rate.
+
+ The clock drift is estimated from the fill level of the FIFO between the two, extrapolated to the time of each read from when the writer last delivered: a PI loop (critically damped, with the fill level low-passed so device block sizes don't modulate the pitch) steers the resampling ratio so the fill level settles on the target latency. Once settled the loop's integral term is the drift between the clocks. The resampler is a 4-point Hermite interpolator stepping through the FIFO at the fractional ratio.
+
+ This is plain C without any Core Audio dependencies so drift estimation and alignment can be exercised offline (i.e. on Linux with synthetic sources at known ppm offsets). It is safe for one writer thread and one reader thread.
+ */
+typedef struct EZAudioDriftCompensator EZAudioDriftCompensator;
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+/**
+ Creates a drift compensator. Must not be called from an audio thread.
+ @param channels        The number of channels of the source.
+ @param sampleRate      The master's sample rate. Used to convert the loop bandwidth into frames.
+ @param nominalRatio    The nominal number of source frames per master frame (1.0 when both run at the same nominal sample rate). The estimated drift is relative to this.
+ @param latencyFrames   The number of source frames the FIFO is steered to hold. This must cover both device buffer sizes added together plus their scheduling jitter.
+ @param bandwidth       The time constant of the control loop in seconds. Longer settles slower but resamples smoother, 2 to 10 seconds is typical.
+ @return A new drift compensator or NULL if it couldn't be allocated. Free it with EZAudioDriftCompensatorFree.
+ */
+EZAudioDriftCompensator *EZAudioDriftCompensatorCreate(uint32_t channels,
+                                                       double sampleRate,
+                                                       double nominalRatio,
+                                                       uint32_t latencyFrames,
+                                                       double bandwidth);
+
+/**
+ Frees a drift compensator. Neither thread may be using it.
+ @param compensator The compensator to free.
+ */
+void EZAudioDriftCompensatorFree(EZAudioDriftCompensator *compensator);
+
+/**
+ Empties the FIFO and starts estimating the drift from scratch. Neither thread may be using it.
+ @param compensator The compensator to reset.
+ */
+void EZAudioDriftCompensatorReset(EZAudioDriftCompensator *compensator);
+
+//------------------------------------------------------------------------------
+#pragma mark - Writing (Source Thread)
+//------------------------------------------------------------------------------
+
+/**
+ Writes frames from the source into the FIFO. Never locks or allocates.
+ @param compensator The compensator.
+ @param source      One float array per channel.
+ @param frames      The number of frames to write.
+ @param time        When the frames arrived in seconds, on the same monotonic clock as the reader's times (i.e. the callback's host time).
+ @return The number of frames written. Fewer than `frames` means the reader has stalled and the FIFO overflowed.
+ */
+uint32_t EZAudioDriftCompensatorWrite(EZAudioDriftCompensator *compensator,
+                                      const float * const *source,
+                                      uint32_t frames,
+                                      double time);
+
+//------------------------------------------------------------------------------
+#pragma mark - Reading (Master Thread)
+//------------------------------------------------------------------------------
+
+/**
+ Reads resampled frames at the master's rate and updates the drift estimate. Never locks or allocates. Until the FIFO has filled to the target latency (at start or after an underrun) silence is written instead.
+ @param compensator The compensator.
+ @param destination One float array per channel receiving the aligned frames.
+ @param frames      The number of master frames to read.
+ @param time        When the master needs the frames in seconds, on the same monotonic clock as the writer's times.
+ @return The number of frames that came from the source. The rest of the frames are silence.
+ */
+uint32_t EZAudioDriftCompensatorRead(EZAudioDriftCompensator *compensator,
+                                     float * const *destination,
+                                     uint32_t frames,
+                                     double time);
+
+//------------------------------------------------------------------------------
+#pragma mark - Estimates
+//------------------------------------------------------------------------------
+
+/**
+ Provides the estimated clock drift of the source relative to the master.
+ @param compensator The compensator.
+ @return The drift in parts per million. Positive means the source's clock runs fast.
+ */
+double EZAudioDriftCompensatorDrift(EZAudioDriftCompensator *compensator);
+
+/**
+ Provides the resampling ratio currently applied, including the fill level correction.
+ @param compensator The compensator.
+ @return The number of source frames consumed per master frame.
+ */
+double EZAudioDriftCompensatorRatio(EZAudioDriftCompensator *compensator);
+
+/**
+ Provides the low-passed number of source frames buffered between the writer and the reader.
+ @param compensator The compensator.
+ @return The fill level in source frames.
+ */
+double EZAudioDriftCompensatorFillLevel(EZAudioDriftCompensator *compensator);
+
+/**
+ Provides the number of times the reader ran out of source frames and had to refill to the target latency.
+ @param compensator The compensator.
+ @return The underrun count.
+ */
+uint32_t EZAudioDriftCompensatorUnderruns(EZAudioDriftCompensator *compensator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
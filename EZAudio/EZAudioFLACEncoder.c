@@ -0,0 +1,1517 @@
+//
+//  EZAudioFLACEncoder.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+// fileno, fsync and friends are POSIX, not strict C
+#define _POSIX_C_SOURCE 200809L
+
+#include "EZAudioFLACEncoder.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// not part of strict C
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//------------------------------------------------------------------------------
+
+#define EZ_AUDIO_FLAC_ENCODER_MAXIMUM_CHANNELS        8
+#define EZ_AUDIO_FLAC_ENCODER_MAXIMUM_FIXED_ORDER     4
+#define EZ_AUDIO_FLAC_ENCODER_MAXIMUM_LPC_ORDER       12
+#define EZ_AUDIO_FLAC_ENCODER_MAXIMUM_PARTITION_ORDER 8
+#define EZ_AUDIO_FLAC_ENCODER_MAXIMUM_THREADS         64
+
+// the STREAMINFO block, after "fLaC" and its 4-byte header
+static const uint32_t EZAudioFLACEncoderStreamInfoLength = 34;
+
+// how many blocks each thread gets per batch
+static const uint32_t EZAudioFLACEncoderBlocksPerThread  = 2;
+
+// frames quantized (and hashed) at a time
+static const uint32_t EZAudioFLACEncoderMD5Frames        = 256;
+
+// the largest Rice parameters a 4-bit and a 5-bit parameter field can hold (the next one is the escape code)
+static const uint32_t EZAudioFLACEncoderMaximumRiceParameter     = 14;
+static const uint32_t EZAudioFLACEncoderMaximumWideRiceParameter = 30;
+
+//------------------------------------------------------------------------------
+
+// how hard each compression level searches, modelled on the reference encoder's presets
+typedef struct
+{
+    uint32_t blockSize;
+    uint32_t maximumFixedOrder;
+    uint32_t maximumLPCOrder;
+    uint32_t stereoSearch;      // 0 independent, 1 estimated, 2 exhaustive
+    bool     exhaustiveOrders;
+    uint32_t maximumPartitionOrder;
+} EZAudioFLACEncoderLevel;
+
+static const EZAudioFLACEncoderLevel EZAudioFLACEncoderLevels[] =
+{
+    { 1152, 2, 0,  0, false, 3 },
+    { 1152, 4, 0,  1, false, 3 },
+    { 1152, 4, 0,  2, false, 3 },
+    { 4096, 4, 6,  0, false, 4 },
+    { 4096, 4, 8,  1, false, 4 },
+    { 4096, 4, 8,  2, false, 5 },
+    { 4096, 4, 8,  2, false, 6 },
+    { 4096, 4, 12, 2, false, 6 },
+    { 4096, 4, 12, 2, true,  6 },
+};
+
+//------------------------------------------------------------------------------
+
+typedef enum
+{
+    EZAudioFLACEncoderSubframeTypeConstant,
+    EZAudioFLACEncoderSubframeTypeVerbatim,
+    EZAudioFLACEncoderSubframeTypeFixed,
+    EZAudioFLACEncoderSubframeTypeLPC
+} EZAudioFLACEncoderSubframeType;
+
+// how a channel of a frame is coded and what it costs
+typedef struct
+{
+    EZAudioFLACEncoderSubframeType type;
+    uint32_t                       order;
+    uint32_t                       precision;
+    int32_t                        shift;
+    int32_t                        coefficients[EZ_AUDIO_FLAC_ENCODER_MAXIMUM_LPC_ORDER];
+    uint32_t                       partitionOrder;
+    bool                           wideParameters;
+    uint8_t                        parameters[1 << EZ_AUDIO_FLAC_ENCODER_MAXIMUM_PARTITION_ORDER];
+    uint64_t                       bits;
+} EZAudioFLACEncoderSubframe;
+
+// a signal that could be coded as one of a frame's channels (i.e. left, right, side or mid)
+typedef struct
+{
+    const int32_t              *signal;
+    uint32_t                   bitsPerSample;
+    EZAudioFLACEncoderSubframe subframe;
+    int32_t                    *residual;
+    int32_t                    *trialResidual;
+} EZAudioFLACEncoderCandidate;
+
+typedef struct
+{
+    uint8_t  *bytes;
+    size_t   length;
+    uint64_t accumulator;
+    uint32_t count;
+} EZAudioFLACEncoderBits;
+
+typedef struct
+{
+    uint32_t state[4];
+    uint64_t length;
+    uint8_t  buffer[64];
+} EZAudioFLACEncoderMD5;
+
+// a block of the batch and the frame it's encoded to
+typedef struct
+{
+    int32_t  *samples[EZ_AUDIO_FLAC_ENCODER_MAXIMUM_CHANNELS];
+    uint32_t frames;
+    uint64_t frameNumber;
+    uint8_t  *bytes;
+    size_t   length;
+} EZAudioFLACEncoderJob;
+
+// what each encoding thread works in
+typedef struct
+{
+    EZAudioFLACEncoder          *encoder;
+    pthread_t                   thread;
+    EZAudioFLACEncoderCandidate candidates[EZ_AUDIO_FLAC_ENCODER_MAXIMUM_CHANNELS];
+    int32_t                     *side;
+    int32_t                     *mid;
+    double                      *windowed;
+    double                      *window;
+    uint64_t                    *sums;
+} EZAudioFLACEncoderWorker;
+
+//------------------------------------------------------------------------------
+
+struct EZAudioFLACEncoder
+{
+    FILE                     *file;
+    uint32_t                 channels;
+    uint32_t                 sampleRate;
+    uint32_t                 bitsPerSample;
+    EZAudioFLACEncoderLevel  level;
+    uint32_t                 precision;
+    double                   *window;
+
+    // batch (filled by the writing thread, encoded by the workers)
+    int32_t                  *samples;
+    EZAudioFLACEncoderJob    *jobs;
+    uint32_t                 batchBlocks;
+    uint32_t                 batchCount;
+    uint64_t                 frameNumber;
+    uint8_t                  *md5Bytes;
+    EZAudioFLACEncoderMD5    md5;
+
+    // workers (the first is the writing thread)
+    EZAudioFLACEncoderWorker *workers;
+    uint32_t                 threads;
+    pthread_mutex_t          lock;
+    pthread_cond_t           wake;
+    pthread_cond_t           finished;
+    uint32_t                 generation;
+    uint32_t                 jobCount;
+    uint32_t                 nextJob;
+    uint32_t                 finishedJobs;
+    bool                     stopping;
+
+    // stream
+    uint64_t                 frames;
+    uint64_t                 encodedFrames;
+    uint64_t                 bytes;
+    uint32_t                 minimumFrameSize;
+    uint32_t                 maximumFrameSize;
+    bool                     failed;
+};
+
+//------------------------------------------------------------------------------
+#pragma mark - CRC
+//------------------------------------------------------------------------------
+
+static uint8_t        EZAudioFLACEncoderCRC8Table[256];
+static uint16_t       EZAudioFLACEncoderCRC16Table[256];
+static pthread_once_t EZAudioFLACEncoderCRCOnce = PTHREAD_ONCE_INIT;
+
+static void EZAudioFLACEncoderInitializeCRC(void)
+{
+    // frame headers are checked with x^8 + x^2 + x + 1 and whole frames with x^16 + x^15 + x^2 + 1
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc8  = i;
+        uint32_t crc16 = i << 8;
+        for (uint32_t bit = 0; bit < 8; bit++)
+        {
+            crc8  = (crc8 & 0x80) ? (crc8 << 1) ^ 0x07 : crc8 << 1;
+            crc16 = (crc16 & 0x8000) ? (crc16 << 1) ^ 0x8005 : crc16 << 1;
+        }
+        EZAudioFLACEncoderCRC8Table[i]  = (uint8_t)crc8;
+        EZAudioFLACEncoderCRC16Table[i] = (uint16_t)crc16;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static uint8_t EZAudioFLACEncoderCRC8(const uint8_t *bytes, size_t length)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = EZAudioFLACEncoderCRC8Table[crc ^ bytes[i]];
+    }
+    return crc;
+}
+
+//------------------------------------------------------------------------------
+
+static uint16_t EZAudioFLACEncoderCRC16(const uint8_t *bytes, size_t length)
+{
+    uint16_t crc = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = (uint16_t)((crc << 8) ^ EZAudioFLACEncoderCRC16Table[(crc >> 8) ^ bytes[i]]);
+    }
+    return crc;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - MD5
+//------------------------------------------------------------------------------
+
+static const uint32_t EZAudioFLACEncoderMD5Constants[64] =
+{
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const uint8_t EZAudioFLACEncoderMD5Shifts[16] = { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderMD5Transform(uint32_t *state, const uint8_t *block)
+{
+    uint32_t words[16];
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        words[i] = (uint32_t)block[i * 4] | ((uint32_t)block[i * 4 + 1] << 8) | ((uint32_t)block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    for (uint32_t i = 0; i < 64; i++)
+    {
+        uint32_t f, g;
+        if (i < 16)      { f = (b & c) | (~b & d); g = i; }
+        else if (i < 32) { f = (d & b) | (~d & c); g = (5 * i + 1) & 15; }
+        else if (i < 48) { f = b ^ c ^ d;          g = (3 * i + 5) & 15; }
+        else             { f = c ^ (b | ~d);       g = (7 * i) & 15; }
+        uint32_t shift = EZAudioFLACEncoderMD5Shifts[(i >> 4) * 4 + (i & 3)];
+        uint32_t sum   = a + f + EZAudioFLACEncoderMD5Constants[i] + words[g];
+        a = d;
+        d = c;
+        c = b;
+        b = b + ((sum << shift) | (sum >> (32 - shift)));
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderMD5Initialize(EZAudioFLACEncoderMD5 *md5)
+{
+    md5->state[0] = 0x67452301;
+    md5->state[1] = 0xefcdab89;
+    md5->state[2] = 0x98badcfe;
+    md5->state[3] = 0x10325476;
+    md5->length   = 0;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderMD5Update(EZAudioFLACEncoderMD5 *md5, const uint8_t *bytes, size_t length)
+{
+    size_t used = (size_t)(md5->length & 63);
+    md5->length += length;
+    if (used)
+    {
+        size_t count = length < 64 - used ? length : 64 - used;
+        memcpy(md5->buffer + used, bytes, count);
+        bytes  += count;
+        length -= count;
+        if (used + count < 64)
+        {
+            return;
+        }
+        EZAudioFLACEncoderMD5Transform(md5->state, md5->buffer);
+    }
+    for (; length >= 64; bytes += 64, length -= 64)
+    {
+        EZAudioFLACEncoderMD5Transform(md5->state, bytes);
+    }
+    memcpy(md5->buffer, bytes, length);
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderMD5Finish(EZAudioFLACEncoderMD5 *md5, uint8_t *digest)
+{
+    uint64_t bitLength   = md5->length * 8;
+    uint8_t  padding[72] = { 0x80 };
+    size_t   used        = (size_t)(md5->length & 63);
+    size_t   padLength   = used < 56 ? 56 - used : 120 - used;
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        padding[padLength + i] = (uint8_t)(bitLength >> (8 * i));
+    }
+    EZAudioFLACEncoderMD5Update(md5, padding, padLength + 8);
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        digest[i] = (uint8_t)(md5->state[i / 4] >> (8 * (i & 3)));
+    }
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Bits
+//------------------------------------------------------------------------------
+
+static inline void EZAudioFLACEncoderPut(EZAudioFLACEncoderBits *bits, uint32_t value, uint32_t count)
+{
+    bits->accumulator = (bits->accumulator << count) | (value & (((uint64_t)1 << count) - 1));
+    bits->count += count;
+    while (bits->count >= 8)
+    {
+        bits->count -= 8;
+        bits->bytes[bits->length++] = (uint8_t)(bits->accumulator >> bits->count);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static inline void EZAudioFLACEncoderPutSigned(EZAudioFLACEncoderBits *bits, int32_t value, uint32_t count)
+{
+    EZAudioFLACEncoderPut(bits, (uint32_t)value, count);
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderAlign(EZAudioFLACEncoderBits *bits)
+{
+    if (bits->count)
+    {
+        EZAudioFLACEncoderPut(bits, 0, 8 - bits->count);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// the frame number is coded like a UTF-8 character
+static void EZAudioFLACEncoderPutUTF8(EZAudioFLACEncoderBits *bits, uint64_t value)
+{
+    if (value < 0x80)
+    {
+        EZAudioFLACEncoderPut(bits, (uint32_t)value, 8);
+        return;
+    }
+    uint32_t continuations = value < 0x800 ? 1 : value < 0x10000 ? 2 : value < 0x200000 ? 3 : value < 0x4000000 ? 4 : value < 0x80000000 ? 5 : 6;
+    uint32_t lead          = (0xFF00 >> (continuations + 1)) & 0xFF;
+    EZAudioFLACEncoderPut(bits, lead | (uint32_t)(value >> (6 * continuations)), 8);
+    for (uint32_t i = continuations; i > 0; i--)
+    {
+        EZAudioFLACEncoderPut(bits, 0x80 | (uint32_t)((value >> (6 * (i - 1))) & 0x3F), 8);
+    }
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Prediction
+//------------------------------------------------------------------------------
+
+// a residual folded to unsigned for Rice coding, 0, -1, 1, -2...
+static inline uint32_t EZAudioFLACEncoderFold(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+//------------------------------------------------------------------------------
+
+static uint32_t EZAudioFLACEncoderBestFixedOrder(const int32_t *x, uint32_t frames, uint32_t maximumOrder)
+{
+    // every order's residual magnitude in one pass, each order's residual is the difference of the one below
+    uint64_t sums[EZ_AUDIO_FLAC_ENCODER_MAXIMUM_FIXED_ORDER + 1] = { 0 };
+    for (uint32_t i = EZ_AUDIO_FLAC_ENCODER_MAXIMUM_FIXED_ORDER; i < frames; i++)
+    {
+        int64_t e0 = x[i];
+        int64_t e1 = e0 - x[i - 1];
+        int64_t e2 = e1 - ((int64_t)x[i - 1] - x[i - 2]);
+        int64_t e3 = e2 - ((int64_t)x[i - 1] - 2 * (int64_t)x[i - 2] + x[i - 3]);
+        int64_t e4 = e3 - ((int64_t)x[i - 1] - 3 * (int64_t)x[i - 2] + 3 * (int64_t)x[i - 3] - x[i - 4]);
+        sums[0] += (uint64_t)(e0 < 0 ? -e0 : e0);
+        sums[1] += (uint64_t)(e1 < 0 ? -e1 : e1);
+        sums[2] += (uint64_t)(e2 < 0 ? -e2 : e2);
+        sums[3] += (uint64_t)(e3 < 0 ? -e3 : e3);
+        sums[4] += (uint64_t)(e4 < 0 ? -e4 : e4);
+    }
+    uint32_t best = 0;
+    for (uint32_t order = 1; order <= maximumOrder; order++)
+    {
+        if (sums[order] < sums[best])
+        {
+            best = order;
+        }
+    }
+    return best;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderFixedResidual(const int32_t *x, uint32_t frames, uint32_t order, int32_t *residual)
+{
+    switch (order)
+    {
+        case 0:
+            for (uint32_t i = 0; i < frames; i++)
+            {
+                residual[i] = x[i];
+            }
+            break;
+        case 1:
+            for (uint32_t i = 1; i < frames; i++)
+            {
+                residual[i] = x[i] - x[i - 1];
+            }
+            break;
+        case 2:
+            for (uint32_t i = 2; i < frames; i++)
+            {
+                residual[i] = x[i] - 2 * x[i - 1] + x[i - 2];
+            }
+            break;
+        case 3:
+            for (uint32_t i = 3; i < frames; i++)
+            {
+                residual[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+            }
+            break;
+        default:
+            for (uint32_t i = 4; i < frames; i++)
+            {
+                residual[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+            }
+            break;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static double EZAudioFLACEncoderTukey(uint32_t i, uint32_t frames)
+{
+    // Tukey(0.5), flat in the middle half and a raised cosine over each quarter at the edges
+    double position = (double)i / (double)(frames - 1);
+    if (position < 0.25)
+    {
+        return 0.5 - 0.5 * cos(4.0 * M_PI * position);
+    }
+    if (position > 0.75)
+    {
+        return 0.5 - 0.5 * cos(4.0 * M_PI * (1.0 - position));
+    }
+    return 1.0;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderAutocorrelation(const double *x, uint32_t frames, uint32_t maximumLag, double *autocorrelation)
+{
+    for (uint32_t lag = 0; lag <= maximumLag; lag++)
+    {
+        // four independent accumulators so the compiler vectorizes the products
+        double   a0 = 0.0, a1 = 0.0, a2 = 0.0, a3 = 0.0;
+        uint32_t i  = lag;
+        for (; i + 4 <= frames; i += 4)
+        {
+            a0 += x[i]     * x[i - lag];
+            a1 += x[i + 1] * x[i + 1 - lag];
+            a2 += x[i + 2] * x[i + 2 - lag];
+            a3 += x[i + 3] * x[i + 3 - lag];
+        }
+        for (; i < frames; i++)
+        {
+            a0 += x[i] * x[i - lag];
+        }
+        autocorrelation[lag] = (a0 + a1) + (a2 + a3);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Levinson-Durbin, the predictor of every order up to the maximum and its error, returns the highest usable order
+static uint32_t EZAudioFLACEncoderLevinsonDurbin(const double *autocorrelation,
+                                                 uint32_t maximumOrder,
+                                                 double coefficients[][EZ_AUDIO_FLAC_ENCODER_MAXIMUM_LPC_ORDER],
+                                                 double *errors)
+{
+    double lpc[EZ_AUDIO_FLAC_ENCODER_MAXIMUM_LPC_ORDER];
+    double error = autocorrelation[0];
+    for (uint32_t i = 0; i < maximumOrder; i++)
+    {
+        double reflection = -autocorrelation[i + 1];
+        for (uint32_t j = 0; j < i; j++)
+        {
+            reflection -= lpc[j] * autocorrelation[i - j];
+        }
+        reflection /= error;
+
+        lpc[i] = reflection;
+        uint32_t j = 0;
+        for (; j < i / 2; j++)
+        {
+            double swap = lpc[j];
+            lpc[j]         += reflection * lpc[i - 1 - j];
+            lpc[i - 1 - j] += reflection * swap;
+        }
+        if (i & 1)
+        {
+            lpc[j] += lpc[j] * reflection;
+        }
+        error *= 1.0 - reflection * reflection;
+        for (j = 0; j <= i; j++)
+        {
+            coefficients[i][j] = -lpc[j];
+        }
+        errors[i] = error;
+
+        // a perfectly predicted signal leaves nothing for a higher order to fit
+        if (error <= 0.0)
+        {
+            return i + 1;
+        }
+    }
+    return maximumOrder;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioFLACEncoderQuantize(const double *coefficients,
+                                       uint32_t order,
+                                       uint32_t precision,
+                                       int32_t *quantized,
+                                       int32_t *shift)
+{
+    double maximum = 0.0;
+    for (uint32_t j = 0; j < order; j++)
+    {
+        double magnitude = fabs(coefficients[j]);
+        maximum = magnitude > maximum ? magnitude : maximum;
+    }
+    if (!(maximum > 0.0) || !isfinite(maximum))
+    {
+        return false;
+    }
+
+    // as many fractional bits as fit the largest coefficient in the precision (less its sign bit)
+    int exponent;
+    frexp(maximum, &exponent);
+    int32_t bits              = (int32_t)precision - 1;
+    int32_t quantizationShift = bits - exponent;
+    quantizationShift = quantizationShift > 15 ? 15 : quantizationShift;
+    if (quantizationShift < 0)
+    {
+        return false;
+    }
+
+    // carrying each coefficient's rounding error into the next keeps them from adding up
+    int32_t maximumValue = (1 << bits) - 1;
+    int32_t minimumValue = -(1 << bits);
+    double  error        = 0.0;
+    for (uint32_t j = 0; j < order; j++)
+    {
+        error += coefficients[j] * (double)(1 << quantizationShift);
+        long value = lround(error);
+        value = value > maximumValue ? maximumValue : (value < minimumValue ? minimumValue : value);
+        error -= (double)value;
+        quantized[j] = (int32_t)value;
+    }
+    *shift = quantizationShift;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioFLACEncoderLPCResidual(const int32_t *x,
+                                          uint32_t frames,
+                                          const int32_t *coefficients,
+                                          uint32_t order,
+                                          int32_t shift,
+                                          int32_t *residual)
+{
+    for (uint32_t i = order; i < frames; i++)
+    {
+        int64_t prediction = 0;
+        for (uint32_t j = 0; j < order; j++)
+        {
+            prediction += (int64_t)coefficients[j] * x[i - j - 1];
+        }
+
+        // a wild predictor's residual wouldn't fit the Rice coder, the caller falls back on the others
+        int64_t value = (int64_t)x[i] - (prediction >> shift);
+        if (value > (1 << 30) || value < -(1 << 30))
+        {
+            return false;
+        }
+        residual[i] = (int32_t)value;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Rice Coding
+//------------------------------------------------------------------------------
+
+// the cheapest Rice parameter for a partition of folded residuals given their sum, and what it costs
+static uint32_t EZAudioFLACEncoderRiceParameter(uint64_t sum, uint32_t count, uint64_t *bits)
+{
+    if (count == 0)
+    {
+        *bits = 0;
+        return 0;
+    }
+    uint32_t guess = 0;
+    while (guess < EZAudioFLACEncoderMaximumWideRiceParameter && ((uint64_t)count << (guess + 1)) <= sum)
+    {
+        guess++;
+    }
+
+    // sum >> parameter never undercounts the quotients, so the estimate is an upper bound
+    uint32_t best     = guess;
+    uint64_t bestBits = UINT64_MAX;
+    uint32_t last     = guess < EZAudioFLACEncoderMaximumWideRiceParameter ? guess + 1 : guess;
+    for (uint32_t parameter = guess > 0 ? guess - 1 : 0; parameter <= last; parameter++)
+    {
+        uint64_t cost = (uint64_t)count * (parameter + 1) + (sum >> parameter);
+        if (cost < bestBits)
+        {
+            best     = parameter;
+            bestBits = cost;
+        }
+    }
+    *bits = bestBits;
+    return best;
+}
+
+//------------------------------------------------------------------------------
+
+// picks the partition order and parameters for a residual, returns the bits of the coded residual
+static uint64_t EZAudioFLACEncoderPlanResidual(const int32_t *residual,
+                                               uint32_t frames,
+                                               uint32_t order,
+                                               uint32_t maximumPartitionOrder,
+                                               uint64_t *sums,
+                                               EZAudioFLACEncoderSubframe *subframe)
+{
+    // partitions have to divide the block evenly and the first has to hold more than the warm up samples
+    uint32_t partitionOrder = maximumPartitionOrder;
+    while (partitionOrder > 0 && ((frames & ((1u << partitionOrder) - 1)) || (frames >> partitionOrder) <= order))
+    {
+        partitionOrder--;
+    }
+
+    uint32_t partitions    = 1u << partitionOrder;
+    uint32_t partitionSize = frames >> partitionOrder;
+    for (uint32_t p = 0; p < partitions; p++)
+    {
+        uint64_t sum = 0;
+        for (uint32_t i = p == 0 ? order : p * partitionSize; i < (p + 1) * partitionSize; i++)
+        {
+            sum += EZAudioFLACEncoderFold(residual[i]);
+        }
+        sums[p] = sum;
+    }
+
+    // each coarser partitioning's sums are the pairwise sums of the finer one's
+    uint64_t bestBits = UINT64_MAX;
+    for (int32_t po = (int32_t)partitionOrder; po >= 0; po--)
+    {
+        uint32_t count  = 1u << po;
+        uint32_t size   = frames >> po;
+        uint64_t bits   = 6;
+        uint32_t widest = 0;
+        uint8_t  parameters[1 << EZ_AUDIO_FLAC_ENCODER_MAXIMUM_PARTITION_ORDER];
+        for (uint32_t p = 0; p < count; p++)
+        {
+            uint64_t partitionBits;
+            parameters[p] = (uint8_t)EZAudioFLACEncoderRiceParameter(sums[p], size - (p == 0 ? order : 0), &partitionBits);
+            widest = parameters[p] > widest ? parameters[p] : widest;
+            bits  += partitionBits;
+        }
+        bool wide = widest > EZAudioFLACEncoderMaximumRiceParameter;
+        bits += (uint64_t)count * (wide ? 5 : 4);
+        if (bits < bestBits)
+        {
+            bestBits                 = bits;
+            subframe->partitionOrder = (uint32_t)po;
+            subframe->wideParameters = wide;
+            memcpy(subframe->parameters, parameters, count);
+        }
+        for (uint32_t p = 0; p < count / 2; p++)
+        {
+            sums[p] = sums[2 * p] + sums[2 * p + 1];
+        }
+    }
+    return bestBits;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderPutResidual(EZAudioFLACEncoderBits *bits,
+                                          const int32_t *residual,
+                                          uint32_t frames,
+                                          const EZAudioFLACEncoderSubframe *subframe)
+{
+    uint32_t partitions    = 1u << subframe->partitionOrder;
+    uint32_t partitionSize = frames >> subframe->partitionOrder;
+    EZAudioFLACEncoderPut(bits, subframe->wideParameters ? 1 : 0, 2);
+    EZAudioFLACEncoderPut(bits, subframe->partitionOrder, 4);
+    for (uint32_t p = 0; p < partitions; p++)
+    {
+        uint32_t parameter = subframe->parameters[p];
+        uint32_t mask      = (uint32_t)(((uint64_t)1 << parameter) - 1);
+        EZAudioFLACEncoderPut(bits, parameter, subframe->wideParameters ? 5 : 4);
+        for (uint32_t i = p == 0 ? subframe->order : p * partitionSize; i < (p + 1) * partitionSize; i++)
+        {
+            uint32_t value    = EZAudioFLACEncoderFold(residual[i]);
+            uint32_t quotient = value >> parameter;
+            if (quotient + 1 + parameter <= 32)
+            {
+                // the unary quotient, its stop bit and the remainder in one go
+                EZAudioFLACEncoderPut(bits, (uint32_t)((uint64_t)1 << parameter) | (value & mask), quotient + 1 + parameter);
+                continue;
+            }
+            for (; quotient >= 32; quotient -= 32)
+            {
+                EZAudioFLACEncoderPut(bits, 0, 32);
+            }
+            EZAudioFLACEncoderPut(bits, 1, quotient + 1);
+            EZAudioFLACEncoderPut(bits, value & mask, parameter);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Subframes
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderKeepTrial(EZAudioFLACEncoderCandidate *candidate,
+                                        const EZAudioFLACEncoderSubframe *trial)
+{
+    int32_t *residual = candidate->residual;
+    candidate->residual      = candidate->trialResidual;
+    candidate->trialResidual = residual;
+    candidate->subframe      = *trial;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderPlanSubframe(EZAudioFLACEncoderWorker *worker,
+                                           EZAudioFLACEncoderCandidate *candidate,
+                                           uint32_t frames)
+{
+    EZAudioFLACEncoder            *encoder = worker->encoder;
+    const EZAudioFLACEncoderLevel *level   = &encoder->level;
+    const int32_t                 *x       = candidate->signal;
+    uint32_t                      bps      = candidate->bitsPerSample;
+    EZAudioFLACEncoderSubframe    *best    = &candidate->subframe;
+
+    // silence (or any other constant) is a single sample
+    bool constant = true;
+    for (uint32_t i = 1; i < frames && constant; i++)
+    {
+        constant = x[i] == x[0];
+    }
+    if (constant)
+    {
+        best->type = EZAudioFLACEncoderSubframeTypeConstant;
+        best->bits = 8 + bps;
+        return;
+    }
+
+    // a predictor has to beat the samples as they are
+    best->type = EZAudioFLACEncoderSubframeTypeVerbatim;
+    best->bits = 8 + (uint64_t)frames * bps;
+
+    EZAudioFLACEncoderSubframe trial;
+    if (frames > EZ_AUDIO_FLAC_ENCODER_MAXIMUM_FIXED_ORDER * 2)
+    {
+        trial.type  = EZAudioFLACEncoderSubframeTypeFixed;
+        trial.order = EZAudioFLACEncoderBestFixedOrder(x, frames, level->maximumFixedOrder);
+        EZAudioFLACEncoderFixedResidual(x, frames, trial.order, candidate->trialResidual);
+        trial.bits  = 8 + (uint64_t)trial.order * bps + EZAudioFLACEncoderPlanResidual(candidate->trialResidual, frames, trial.order, level->maximumPartitionOrder, worker->sums, &trial);
+        if (trial.bits < best->bits)
+        {
+            EZAudioFLACEncoderKeepTrial(candidate, &trial);
+        }
+    }
+
+    uint32_t maximumOrder = level->maximumLPCOrder;
+    if (maximumOrder == 0 || frames <= maximumOrder * 2)
+    {
+        return;
+    }
+
+    // the window tapers the block's edges so they don't smear the autocorrelation (a short last block gets its own)
+    const double *window = encoder->window;
+    if (frames != level->blockSize)
+    {
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            worker->window[i] = EZAudioFLACEncoderTukey(i, frames);
+        }
+        window = worker->window;
+    }
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        worker->windowed[i] = (double)x[i] * window[i];
+    }
+    double autocorrelation[EZ_AUDIO_FLAC_ENCODER_MAXIMUM_LPC_ORDER + 1];
+    EZAudioFLACEncoderAutocorrelation(worker->windowed, frames, maximumOrder, autocorrelation);
+    if (!(autocorrelation[0] > 0.0))
+    {
+        return;
+    }
+    double coefficients[EZ_AUDIO_FLAC_ENCODER_MAXIMUM_LPC_ORDER][EZ_AUDIO_FLAC_ENCODER_MAXIMUM_LPC_ORDER];
+    double errors[EZ_AUDIO_FLAC_ENCODER_MAXIMUM_LPC_ORDER];
+    maximumOrder = EZAudioFLACEncoderLevinsonDurbin(autocorrelation, maximumOrder, coefficients, errors);
+
+    // every order is tried or only the one whose prediction error promises the fewest bits
+    uint32_t firstOrder = 1;
+    if (!level->exhaustiveOrders)
+    {
+        double scale     = 0.5 / (double)frames;
+        double bestGuess = HUGE_VAL;
+        for (uint32_t order = 1; order <= maximumOrder; order++)
+        {
+            double error      = errors[order - 1];
+            double sampleBits = error > 0.0 ? 0.5 * log2(scale * error) : 0.0;
+            double guess      = (sampleBits > 0.0 ? sampleBits : 0.0) * (double)(frames - order) + (double)(order * (encoder->precision + bps));
+            if (guess < bestGuess)
+            {
+                bestGuess  = guess;
+                firstOrder = order;
+            }
+        }
+        maximumOrder = firstOrder;
+    }
+    for (uint32_t order = firstOrder; order <= maximumOrder; order++)
+    {
+        trial.type      = EZAudioFLACEncoderSubframeTypeLPC;
+        trial.order     = order;
+        trial.precision = encoder->precision;
+        if (!EZAudioFLACEncoderQuantize(coefficients[order - 1], order, trial.precision, trial.coefficients, &trial.shift) ||
+            !EZAudioFLACEncoderLPCResidual(x, frames, trial.coefficients, order, trial.shift, candidate->trialResidual))
+        {
+            continue;
+        }
+        trial.bits = 8 + (uint64_t)order * bps + 4 + 5 + (uint64_t)order * trial.precision + EZAudioFLACEncoderPlanResidual(candidate->trialResidual, frames, order, level->maximumPartitionOrder, worker->sums, &trial);
+        if (trial.bits < best->bits)
+        {
+            EZAudioFLACEncoderKeepTrial(candidate, &trial);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderPutSubframe(EZAudioFLACEncoderBits *bits,
+                                          const EZAudioFLACEncoderCandidate *candidate,
+                                          uint32_t frames)
+{
+    const EZAudioFLACEncoderSubframe *subframe = &candidate->subframe;
+    const int32_t                    *x        = candidate->signal;
+    uint32_t                         bps       = candidate->bitsPerSample;
+
+    // a zero pad bit, the 6-bit type and no wasted bits
+    switch (subframe->type)
+    {
+        case EZAudioFLACEncoderSubframeTypeConstant:
+            EZAudioFLACEncoderPut(bits, 0x00, 8);
+            EZAudioFLACEncoderPutSigned(bits, x[0], bps);
+            return;
+        case EZAudioFLACEncoderSubframeTypeVerbatim:
+            EZAudioFLACEncoderPut(bits, 0x02, 8);
+            for (uint32_t i = 0; i < frames; i++)
+            {
+                EZAudioFLACEncoderPutSigned(bits, x[i], bps);
+            }
+            return;
+        case EZAudioFLACEncoderSubframeTypeFixed:
+            EZAudioFLACEncoderPut(bits, (0x08 | subframe->order) << 1, 8);
+            break;
+        case EZAudioFLACEncoderSubframeTypeLPC:
+            EZAudioFLACEncoderPut(bits, (0x20 | (subframe->order - 1)) << 1, 8);
+            break;
+    }
+    for (uint32_t i = 0; i < subframe->order; i++)
+    {
+        EZAudioFLACEncoderPutSigned(bits, x[i], bps);
+    }
+    if (subframe->type == EZAudioFLACEncoderSubframeTypeLPC)
+    {
+        EZAudioFLACEncoderPut(bits, subframe->precision - 1, 4);
+        EZAudioFLACEncoderPutSigned(bits, subframe->shift, 5);
+        for (uint32_t j = 0; j < subframe->order; j++)
+        {
+            EZAudioFLACEncoderPutSigned(bits, subframe->coefficients[j], subframe->precision);
+        }
+    }
+    EZAudioFLACEncoderPutResidual(bits, candidate->residual, frames, subframe);
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Frames
+//------------------------------------------------------------------------------
+
+static uint32_t EZAudioFLACEncoderBlockSizeCode(uint32_t frames)
+{
+    switch (frames)
+    {
+        case 192:   return 1;
+        case 576:   return 2;
+        case 1152:  return 3;
+        case 2304:  return 4;
+        case 4608:  return 5;
+        case 256:   return 8;
+        case 512:   return 9;
+        case 1024:  return 10;
+        case 2048:  return 11;
+        case 4096:  return 12;
+        case 8192:  return 13;
+        case 16384: return 14;
+        case 32768: return 15;
+        default:    return frames <= 256 ? 6 : 7;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static uint32_t EZAudioFLACEncoderSampleRateCode(uint32_t sampleRate)
+{
+    switch (sampleRate)
+    {
+        case 88200:  return 1;
+        case 176400: return 2;
+        case 192000: return 3;
+        case 8000:   return 4;
+        case 16000:  return 5;
+        case 22050:  return 6;
+        case 24000:  return 7;
+        case 32000:  return 8;
+        case 44100:  return 9;
+        case 48000:  return 10;
+        case 96000:  return 11;
+        default:
+            if (sampleRate % 1000 == 0 && sampleRate / 1000 <= 255)
+            {
+                return 12;
+            }
+            if (sampleRate <= 65535)
+            {
+                return 13;
+            }
+            return sampleRate % 10 == 0 && sampleRate / 10 <= 65535 ? 14 : 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderEncodeFrame(EZAudioFLACEncoderWorker *worker, EZAudioFLACEncoderJob *job)
+{
+    EZAudioFLACEncoder *encoder  = worker->encoder;
+    uint32_t           frames    = job->frames;
+    uint32_t           channels  = encoder->channels;
+    uint32_t           bps       = encoder->bitsPerSample;
+
+    // left, right, side and mid for stereo, otherwise just the channels
+    EZAudioFLACEncoderCandidate *candidates = worker->candidates;
+    uint32_t assignment = channels - 1;
+    uint32_t chosen[2]  = { 0, 1 };
+    for (uint32_t channel = 0; channel < channels; channel++)
+    {
+        candidates[channel].signal        = job->samples[channel];
+        candidates[channel].bitsPerSample = bps;
+    }
+    if (channels == 2 && encoder->level.stereoSearch)
+    {
+        const int32_t *left  = job->samples[0];
+        const int32_t *right = job->samples[1];
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            worker->side[i] = left[i] - right[i];
+            worker->mid[i]  = (left[i] + right[i]) >> 1;
+        }
+        candidates[2].signal        = worker->side;
+        candidates[2].bitsPerSample = bps + 1;
+        candidates[3].signal        = worker->mid;
+        candidates[3].bitsPerSample = bps;
+
+        uint64_t costs[4];
+        if (encoder->level.stereoSearch == 1)
+        {
+            // estimated from each one's second order residual, then only the chosen pair is planned
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                const int32_t *x   = candidates[c].signal;
+                uint64_t      sum  = 0;
+                for (uint32_t i = 2; i < frames; i++)
+                {
+                    int64_t e = (int64_t)x[i] - 2 * (int64_t)x[i - 1] + x[i - 2];
+                    sum += (uint64_t)(e < 0 ? -e : e);
+                }
+                costs[c] = sum;
+            }
+        }
+        else
+        {
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                EZAudioFLACEncoderPlanSubframe(worker, &candidates[c], frames);
+                costs[c] = candidates[c].subframe.bits;
+            }
+        }
+
+        // independent, left/side, side/right or mid/side
+        static const uint32_t pairs[4][2] = { { 0, 1 }, { 0, 2 }, { 2, 1 }, { 3, 2 } };
+        static const uint32_t codes[4]    = { 1, 8, 9, 10 };
+        uint32_t best = 0;
+        for (uint32_t p = 1; p < 4; p++)
+        {
+            if (costs[pairs[p][0]] + costs[pairs[p][1]] < costs[pairs[best][0]] + costs[pairs[best][1]])
+            {
+                best = p;
+            }
+        }
+        assignment = codes[best];
+        chosen[0]  = pairs[best][0];
+        chosen[1]  = pairs[best][1];
+        if (encoder->level.stereoSearch == 1)
+        {
+            EZAudioFLACEncoderPlanSubframe(worker, &candidates[chosen[0]], frames);
+            EZAudioFLACEncoderPlanSubframe(worker, &candidates[chosen[1]], frames);
+        }
+    }
+    else
+    {
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            EZAudioFLACEncoderPlanSubframe(worker, &candidates[channel], frames);
+        }
+    }
+
+    // frame header, fixed block size so it's numbered by frame
+    EZAudioFLACEncoderBits bits = { job->bytes, 0, 0, 0 };
+    uint32_t blockSizeCode  = EZAudioFLACEncoderBlockSizeCode(frames);
+    uint32_t sampleRateCode = EZAudioFLACEncoderSampleRateCode(encoder->sampleRate);
+    EZAudioFLACEncoderPut(&bits, 0x3FFE, 14);
+    EZAudioFLACEncoderPut(&bits, 0, 2);
+    EZAudioFLACEncoderPut(&bits, blockSizeCode, 4);
+    EZAudioFLACEncoderPut(&bits, sampleRateCode, 4);
+    EZAudioFLACEncoderPut(&bits, assignment, 4);
+    EZAudioFLACEncoderPut(&bits, bps == 16 ? 4 : 6, 3);
+    EZAudioFLACEncoderPut(&bits, 0, 1);
+    EZAudioFLACEncoderPutUTF8(&bits, job->frameNumber);
+    if (blockSizeCode == 6 || blockSizeCode == 7)
+    {
+        EZAudioFLACEncoderPut(&bits, frames - 1, blockSizeCode == 6 ? 8 : 16);
+    }
+    if (sampleRateCode == 12)
+    {
+        EZAudioFLACEncoderPut(&bits, encoder->sampleRate / 1000, 8);
+    }
+    else if (sampleRateCode == 13)
+    {
+        EZAudioFLACEncoderPut(&bits, encoder->sampleRate, 16);
+    }
+    else if (sampleRateCode == 14)
+    {
+        EZAudioFLACEncoderPut(&bits, encoder->sampleRate / 10, 16);
+    }
+    EZAudioFLACEncoderPut(&bits, EZAudioFLACEncoderCRC8(bits.bytes, bits.length), 8);
+
+    // subframes and the footer
+    for (uint32_t channel = 0; channel < channels; channel++)
+    {
+        EZAudioFLACEncoderPutSubframe(&bits, &candidates[channels == 2 ? chosen[channel] : channel], frames);
+    }
+    EZAudioFLACEncoderAlign(&bits);
+    EZAudioFLACEncoderPut(&bits, EZAudioFLACEncoderCRC16(bits.bytes, bits.length), 16);
+    job->length = bits.length;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Workers
+//------------------------------------------------------------------------------
+
+// takes jobs until the batch has none left, called with the lock held
+static void EZAudioFLACEncoderRunJobs(EZAudioFLACEncoderWorker *worker)
+{
+    EZAudioFLACEncoder *encoder = worker->encoder;
+    while (encoder->nextJob < encoder->jobCount)
+    {
+        EZAudioFLACEncoderJob *job = &encoder->jobs[encoder->nextJob++];
+        pthread_mutex_unlock(&encoder->lock);
+        EZAudioFLACEncoderEncodeFrame(worker, job);
+        pthread_mutex_lock(&encoder->lock);
+        if (++encoder->finishedJobs == encoder->jobCount)
+        {
+            pthread_cond_broadcast(&encoder->finished);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void *EZAudioFLACEncoderWorkerThread(void *argument)
+{
+    EZAudioFLACEncoderWorker *worker  = (EZAudioFLACEncoderWorker *)argument;
+    EZAudioFLACEncoder       *encoder = worker->encoder;
+    pthread_mutex_lock(&encoder->lock);
+    uint32_t generation = encoder->generation;
+    for (;;)
+    {
+        while (!encoder->stopping && encoder->generation == generation)
+        {
+            pthread_cond_wait(&encoder->wake, &encoder->lock);
+        }
+        if (encoder->stopping)
+        {
+            break;
+        }
+        generation = encoder->generation;
+        EZAudioFLACEncoderRunJobs(worker);
+    }
+    pthread_mutex_unlock(&encoder->lock);
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderEncodeBatch(EZAudioFLACEncoder *encoder, uint32_t count)
+{
+    for (uint32_t b = 0; b < count; b++)
+    {
+        encoder->jobs[b].frameNumber = encoder->frameNumber++;
+    }
+
+    // the writing thread encodes alongside the workers
+    pthread_mutex_lock(&encoder->lock);
+    encoder->jobCount     = count;
+    encoder->nextJob      = 0;
+    encoder->finishedJobs = 0;
+    encoder->generation++;
+    pthread_cond_broadcast(&encoder->wake);
+    EZAudioFLACEncoderRunJobs(&encoder->workers[0]);
+    while (encoder->finishedJobs < encoder->jobCount)
+    {
+        pthread_cond_wait(&encoder->finished, &encoder->lock);
+    }
+    pthread_mutex_unlock(&encoder->lock);
+
+    // written in order, whatever order they finished in
+    for (uint32_t b = 0; b < count; b++)
+    {
+        EZAudioFLACEncoderJob *job = &encoder->jobs[b];
+        if (!encoder->failed && fwrite(job->bytes, 1, job->length, encoder->file) != job->length)
+        {
+            encoder->failed = true;
+        }
+        uint32_t length = (uint32_t)job->length;
+        encoder->minimumFrameSize = encoder->minimumFrameSize == 0 || length < encoder->minimumFrameSize ? length : encoder->minimumFrameSize;
+        encoder->maximumFrameSize = length > encoder->maximumFrameSize ? length : encoder->maximumFrameSize;
+        encoder->bytes           += job->length;
+        encoder->encodedFrames   += job->frames;
+        job->frames = 0;
+    }
+    encoder->batchCount = 0;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Header
+//------------------------------------------------------------------------------
+
+static bool EZAudioFLACEncoderWriteStreamInfo(EZAudioFLACEncoder *encoder, const uint8_t *md5)
+{
+    uint8_t                bytes[42] = { 'f', 'L', 'a', 'C' };
+    EZAudioFLACEncoderBits bits      = { bytes, 4, 0, 0 };
+
+    // the only metadata block, so it's also the last
+    EZAudioFLACEncoderPut(&bits, 0x80, 8);
+    EZAudioFLACEncoderPut(&bits, EZAudioFLACEncoderStreamInfoLength, 24);
+    EZAudioFLACEncoderPut(&bits, encoder->level.blockSize, 16);
+    EZAudioFLACEncoderPut(&bits, encoder->level.blockSize, 16);
+    EZAudioFLACEncoderPut(&bits, encoder->minimumFrameSize, 24);
+    EZAudioFLACEncoderPut(&bits, encoder->maximumFrameSize, 24);
+    EZAudioFLACEncoderPut(&bits, encoder->sampleRate, 20);
+    EZAudioFLACEncoderPut(&bits, encoder->channels - 1, 3);
+    EZAudioFLACEncoderPut(&bits, encoder->bitsPerSample - 1, 5);
+    EZAudioFLACEncoderPut(&bits, (uint32_t)(encoder->encodedFrames >> 32), 4);
+    EZAudioFLACEncoderPut(&bits, (uint32_t)encoder->encodedFrames, 32);
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        EZAudioFLACEncoderPut(&bits, md5 ? md5[i] : 0, 8);
+    }
+    return fseek(encoder->file, 0, SEEK_SET) == 0 && fwrite(bytes, 1, sizeof(bytes), encoder->file) == sizeof(bytes);
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderFree(EZAudioFLACEncoder *encoder)
+{
+    if (encoder->workers)
+    {
+        for (uint32_t t = 0; t < encoder->threads; t++)
+        {
+            EZAudioFLACEncoderWorker *worker = &encoder->workers[t];
+            for (uint32_t c = 0; c < EZ_AUDIO_FLAC_ENCODER_MAXIMUM_CHANNELS; c++)
+            {
+                free(worker->candidates[c].residual);
+                free(worker->candidates[c].trialResidual);
+            }
+            free(worker->side);
+            free(worker->mid);
+            free(worker->windowed);
+            free(worker->window);
+            free(worker->sums);
+        }
+        free(encoder->workers);
+    }
+    if (encoder->jobs)
+    {
+        for (uint32_t b = 0; b < encoder->batchBlocks; b++)
+        {
+            free(encoder->jobs[b].bytes);
+        }
+        free(encoder->jobs);
+    }
+    free(encoder->samples);
+    free(encoder->md5Bytes);
+    free(encoder->window);
+    if (encoder->file)
+    {
+        fclose(encoder->file);
+    }
+    free(encoder);
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioFLACEncoderStopWorkers(EZAudioFLACEncoder *encoder, uint32_t started)
+{
+    pthread_mutex_lock(&encoder->lock);
+    encoder->stopping = true;
+    pthread_cond_broadcast(&encoder->wake);
+    pthread_mutex_unlock(&encoder->lock);
+    for (uint32_t t = 1; t < started; t++)
+    {
+        pthread_join(encoder->workers[t].thread, NULL);
+    }
+    pthread_mutex_destroy(&encoder->lock);
+    pthread_cond_destroy(&encoder->wake);
+    pthread_cond_destroy(&encoder->finished);
+}
+
+//------------------------------------------------------------------------------
+
+EZAudioFLACEncoder *EZAudioFLACEncoderCreate(const char *path,
+                                             uint32_t channels,
+                                             double sampleRate,
+                                             uint32_t bitsPerSample,
+                                             uint32_t compressionLevel,
+                                             uint32_t threads)
+{
+    uint32_t rate = sampleRate > 0.0 && sampleRate < (double)(1 << 20) ? (uint32_t)lround(sampleRate) : 0;
+    if (!path || channels == 0 || channels > EZ_AUDIO_FLAC_ENCODER_MAXIMUM_CHANNELS ||
+        rate == 0 || (bitsPerSample != 16 && bitsPerSample != 24))
+    {
+        return NULL;
+    }
+    pthread_once(&EZAudioFLACEncoderCRCOnce, EZAudioFLACEncoderInitializeCRC);
+
+    EZAudioFLACEncoder *encoder = (EZAudioFLACEncoder *)calloc(1, sizeof(EZAudioFLACEncoder));
+    if (!encoder)
+    {
+        return NULL;
+    }
+    uint32_t levels = (uint32_t)(sizeof(EZAudioFLACEncoderLevels) / sizeof(EZAudioFLACEncoderLevels[0]));
+    encoder->channels      = channels;
+    encoder->sampleRate    = rate;
+    encoder->bitsPerSample = bitsPerSample;
+    encoder->level         = EZAudioFLACEncoderLevels[compressionLevel < levels ? compressionLevel : levels - 1];
+    encoder->threads       = threads == 0 ? 1 : (threads > EZ_AUDIO_FLAC_ENCODER_MAXIMUM_THREADS ? EZ_AUDIO_FLAC_ENCODER_MAXIMUM_THREADS : threads);
+    encoder->batchBlocks   = encoder->threads * EZAudioFLACEncoderBlocksPerThread;
+
+    // the coefficient precision grows with the block size like the reference encoder's, a little more for 24-bit
+    uint32_t blockSize = encoder->level.blockSize;
+    encoder->precision = (blockSize <= 1152 ? 10 : 12) + (bitsPerSample > 16 ? 2 : 0);
+
+    encoder->window = (double *)malloc(blockSize * sizeof(double));
+    if (encoder->window)
+    {
+        for (uint32_t i = 0; i < blockSize; i++)
+        {
+            encoder->window[i] = EZAudioFLACEncoderTukey(i, blockSize);
+        }
+    }
+
+    // no frame is bigger than its samples as they are (the side channel's a bit wider) plus the header and footer
+    size_t   maximumFrameBytes = 32 + channels * (2 + ((size_t)blockSize * (bitsPerSample + 1) + 7) / 8);
+    uint32_t candidates        = channels == 2 ? 4 : channels;
+    encoder->samples  = (int32_t *)malloc((size_t)encoder->batchBlocks * channels * blockSize * sizeof(int32_t));
+    encoder->jobs     = (EZAudioFLACEncoderJob *)calloc(encoder->batchBlocks, sizeof(EZAudioFLACEncoderJob));
+    encoder->md5Bytes = (uint8_t *)malloc((size_t)EZAudioFLACEncoderMD5Frames * channels * (bitsPerSample / 8));
+    encoder->workers  = (EZAudioFLACEncoderWorker *)calloc(encoder->threads, sizeof(EZAudioFLACEncoderWorker));
+    bool allocated = encoder->window && encoder->samples && encoder->jobs && encoder->md5Bytes && encoder->workers;
+    for (uint32_t b = 0; allocated && b < encoder->batchBlocks; b++)
+    {
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            encoder->jobs[b].samples[channel] = encoder->samples + ((size_t)b * channels + channel) * blockSize;
+        }
+        encoder->jobs[b].bytes = (uint8_t *)malloc(maximumFrameBytes);
+        allocated = encoder->jobs[b].bytes != NULL;
+    }
+    for (uint32_t t = 0; allocated && t < encoder->threads; t++)
+    {
+        EZAudioFLACEncoderWorker *worker = &encoder->workers[t];
+        worker->encoder  = encoder;
+        worker->side     = (int32_t *)malloc(blockSize * sizeof(int32_t));
+        worker->mid      = (int32_t *)malloc(blockSize * sizeof(int32_t));
+        worker->windowed = (double *)malloc(blockSize * sizeof(double));
+        worker->window   = (double *)malloc(blockSize * sizeof(double));
+        worker->sums     = (uint64_t *)malloc(((size_t)1 << EZ_AUDIO_FLAC_ENCODER_MAXIMUM_PARTITION_ORDER) * sizeof(uint64_t));
+        allocated = worker->side && worker->mid && worker->windowed && worker->window && worker->sums;
+        for (uint32_t c = 0; allocated && c < candidates; c++)
+        {
+            worker->candidates[c].residual      = (int32_t *)malloc(blockSize * sizeof(int32_t));
+            worker->candidates[c].trialResidual = (int32_t *)malloc(blockSize * sizeof(int32_t));
+            allocated = worker->candidates[c].residual && worker->candidates[c].trialResidual;
+        }
+    }
+    encoder->file = allocated ? fopen(path, "wb") : NULL;
+    if (!encoder->file || !EZAudioFLACEncoderWriteStreamInfo(encoder, NULL))
+    {
+        EZAudioFLACEncoderFree(encoder);
+        return NULL;
+    }
+    EZAudioFLACEncoderMD5Initialize(&encoder->md5);
+
+    pthread_mutex_init(&encoder->lock, NULL);
+    pthread_cond_init(&encoder->wake, NULL);
+    pthread_cond_init(&encoder->finished, NULL);
+    for (uint32_t t = 1; t < encoder->threads; t++)
+    {
+        if (pthread_create(&encoder->workers[t].thread, NULL, EZAudioFLACEncoderWorkerThread, &encoder->workers[t]) != 0)
+        {
+            EZAudioFLACEncoderStopWorkers(encoder, t);
+            EZAudioFLACEncoderFree(encoder);
+            return NULL;
+        }
+    }
+    return encoder;
+}
+
+//------------------------------------------------------------------------------
+
+bool EZAudioFLACEncoderClose(EZAudioFLACEncoder *encoder)
+{
+    if (!encoder)
+    {
+        return false;
+    }
+
+    // the last block can be short
+    uint32_t count = encoder->batchCount + (encoder->jobs[encoder->batchCount].frames > 0 ? 1 : 0);
+    if (count)
+    {
+        EZAudioFLACEncoderEncodeBatch(encoder, count);
+    }
+    uint8_t md5[16];
+    EZAudioFLACEncoderMD5Finish(&encoder->md5, md5);
+    bool completed = !encoder->failed;
+    completed = EZAudioFLACEncoderWriteStreamInfo(encoder, md5) && completed;
+    completed = fclose(encoder->file) == 0 && completed;
+    encoder->file = NULL;
+    EZAudioFLACEncoderStopWorkers(encoder, encoder->threads);
+    EZAudioFLACEncoderFree(encoder);
+    return completed;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Writing
+//------------------------------------------------------------------------------
+
+bool EZAudioFLACEncoderWrite(EZAudioFLACEncoder *encoder,
+                             const float * const *source,
+                             uint32_t frames)
+{
+    uint32_t channels       = encoder->channels;
+    uint32_t blockSize      = encoder->level.blockSize;
+    uint32_t bytesPerSample = encoder->bitsPerSample / 8;
+    float    scale          = (float)(1 << (encoder->bitsPerSample - 1));
+    float    maximum        = scale - 1.0f;
+    uint32_t written        = 0;
+    while (written < frames)
+    {
+        EZAudioFLACEncoderJob *job = &encoder->jobs[encoder->batchCount];
+        uint32_t count = frames - written;
+        count = count < blockSize - job->frames ? count : blockSize - job->frames;
+        count = count < EZAudioFLACEncoderMD5Frames ? count : EZAudioFLACEncoderMD5Frames;
+
+        // rounded and clipped into the block
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            const float *input  = source[channel] + written;
+            int32_t     *output = job->samples[channel] + job->frames;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                float value = input[i] * scale;
+                value = value < maximum ? value : maximum;
+                value = value > -scale ? value : -scale;
+                output[i] = (int32_t)lrintf(value);
+            }
+        }
+
+        // the MD5 is of the interleaved little endian samples
+        uint8_t *bytes = encoder->md5Bytes;
+        for (uint32_t i = job->frames; i < job->frames + count; i++)
+        {
+            for (uint32_t channel = 0; channel < channels; channel++)
+            {
+                int32_t value = job->samples[channel][i];
+                for (uint32_t b = 0; b < bytesPerSample; b++)
+                {
+                    *bytes++ = (uint8_t)(value >> (8 * b));
+                }
+            }
+        }
+        EZAudioFLACEncoderMD5Update(&encoder->md5, encoder->md5Bytes, (size_t)(bytes - encoder->md5Bytes));
+
+        job->frames     += count;
+        written         += count;
+        encoder->frames += count;
+        if (job->frames == blockSize && ++encoder->batchCount == encoder->batchBlocks)
+        {
+            EZAudioFLACEncoderEncodeBatch(encoder, encoder->batchCount);
+        }
+    }
+    return !encoder->failed;
+}
+
+//------------------------------------------------------------------------------
+
+bool EZAudioFLACEncoderSync(EZAudioFLACEncoder *encoder)
+{
+    // the frames have to be on the disk before the header counts them (the MD5 is left unset until the file's complete)
+    if (fflush(encoder->file) != 0 || fsync(fileno(encoder->file)) != 0)
+    {
+        return false;
+    }
+    bool committed = EZAudioFLACEncoderWriteStreamInfo(encoder, NULL);
+    committed = fseek(encoder->file, 0, SEEK_END) == 0 && committed;
+    return fflush(encoder->file) == 0 && fsync(fileno(encoder->file)) == 0 && committed;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Properties
+//------------------------------------------------------------------------------
+
+uint64_t EZAudioFLACEncoderFrames(const EZAudioFLACEncoder *encoder)
+{
+    return encoder->frames;
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t EZAudioFLACEncoderBytes(const EZAudioFLACEncoder *encoder)
+{
+    return encoder->bytes;
+}
@@ -0,0 +1,122 @@
+//
+//  EZAudioFLACEncoder.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef EZAudioFLACEncoder_h
+#define EZAudioFLACEncoder_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioFLACEncoder
+//------------------------------------------------------------------------------
+
+/**
+ Encodes non-interleaved float audio to a lossless FLAC file, usually about half the size of the same audio in WAV. The float samples are quantized to 16 or 24-bit integers and gathered into fixed size blocks, and each block is encoded as an independent FLAC frame.
+
+ Each channel of a frame is predicted with the best of a constant, a fixed polynomial or a linear predictor (LPC) and the prediction's residual is Rice coded with an adaptive partitioning. The LPC coefficients come from the autocorrelation of the windowed block via Levinson-Durbin, with the autocorrelation's lags accumulated four samples wide so the compiler vectorizes them. Stereo frames also try the left/side, side/right and mid/side decorrelations. The compression level (0-8, like the reference encoder's) trades speed for size by widening the search.
+
+ Since frames are independent, a batch of them is encoded in parallel by a pool of worker threads and written out in order. The STREAMINFO header (with the MD5 of the audio that FLAC decoders verify) is written with placeholder sizes when the file is created and patched when it's synced or closed.
+
+ This is plain C on top of stdio and POSIX threads without any Core Audio dependencies, so it can be benchmarked and verified anywhere (i.e. on Linux). An encoder is not thread safe, use it from one thread at a time.
+ */
+typedef struct EZAudioFLACEncoder EZAudioFLACEncoder;
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+/**
+ Creates a FLAC file (replacing any file at the path), writes its header and starts the encoder's worker threads. Must not be called from an audio thread.
+ @param path             The file system path of the file to write.
+ @param channels         The number of channels (1 to 8).
+ @param sampleRate       The sample rate.
+ @param bitsPerSample    The bit depth the samples are quantized to, 16 or 24.
+ @param compressionLevel The compression level, from 0 (fastest) to 8 (smallest). 5 is the usual default.
+ @param threads          The number of threads encoding frames, including the one writing to the encoder, i.e. the number of cores. 1 encodes on the writing thread only.
+ @return A new encoder or NULL if the file couldn't be created or the parameters aren't supported. Close it with EZAudioFLACEncoderClose.
+ */
+EZAudioFLACEncoder *EZAudioFLACEncoderCreate(const char *path,
+                                             uint32_t channels,
+                                             double sampleRate,
+                                             uint32_t bitsPerSample,
+                                             uint32_t compressionLevel,
+                                             uint32_t threads);
+
+/**
+ Encodes whatever is still buffered (the last frame may be short), patches the STREAMINFO header, closes the file, stops the worker threads and frees the encoder.
+ @param encoder The encoder to close.
+ @return true if the file was completed, false if a write or the header patch failed along the way.
+ */
+bool EZAudioFLACEncoderClose(EZAudioFLACEncoder *encoder);
+
+//------------------------------------------------------------------------------
+#pragma mark - Writing
+//------------------------------------------------------------------------------
+
+/**
+ Appends frames to the file. The frames are quantized and buffered, and every time a batch of blocks is full it's encoded by the worker threads and written before this returns.
+ @param encoder The encoder.
+ @param source  One float array per channel.
+ @param frames  The number of frames to write.
+ @return true if everything encoded so far was written, false if a write failed.
+ */
+bool EZAudioFLACEncoderWrite(EZAudioFLACEncoder *encoder,
+                             const float * const *source,
+                             uint32_t frames);
+
+/**
+ Pushes every frame encoded so far through to the disk and then commits the STREAMINFO header to match it, like EZAudioWAVWriterSync. Audio still buffered in a partial batch isn't encoded until the batch fills or the encoder is closed.
+ @param encoder The encoder.
+ @return true if the sync and the header commit succeeded.
+ */
+bool EZAudioFLACEncoderSync(EZAudioFLACEncoder *encoder);
+
+//------------------------------------------------------------------------------
+#pragma mark - Properties
+//------------------------------------------------------------------------------
+
+/**
+ Provides the number of frames (per channel samples) written to the encoder so far.
+ @param encoder The encoder.
+ @return The number of frames.
+ */
+uint64_t EZAudioFLACEncoderFrames(const EZAudioFLACEncoder *encoder);
+
+/**
+ Provides the number of bytes of encoded FLAC frames written to the file so far, i.e. to compare against the audio's uncompressed size.
+ @param encoder The encoder.
+ @return The number of bytes.
+ */
+uint64_t EZAudioFLACEncoderBytes(const EZAudioFLACEncoder *encoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
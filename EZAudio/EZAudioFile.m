@@ -51,15 +51,28 @@ typedef struct
     ExtAudioFileRef             extAudioFileRef;
     AudioStreamBasicDescription fileFormat;
     SInt64                      frames;
+    const EZAudioDSPKernel      *kernel;
     EZAudioFilePermission       permission;
     CFURLRef                    sourceURL;
 } EZAudioFileInfo;
 
+//------------------------------------------------------------------------------
+
+typedef void (*EZAudioFileReadAudioIMP)(id, SEL, EZAudioFile *, float **, UInt32, UInt32);
+typedef void (*EZAudioFileUpdatedPositionIMP)(id, SEL, EZAudioFile *, SInt64);
+
+typedef struct
+{
+    EZAudioFileReadAudioIMP       readAudio;
+    EZAudioFileUpdatedPositionIMP updatedPosition;
+} EZAudioFileDelegateDispatch;
+
 //------------------------------------------------------------------------------
 #pragma mark - EZAudioFile
 //------------------------------------------------------------------------------
 
 @interface EZAudioFile ()
+@property (nonatomic) EZAudioFileDelegateDispatch delegateDispatch;
 @property (nonatomic, strong) EZAudioFloatConverter *floatConverter;
 @property (nonatomic) float **floatData;
 @property (nonatomic) EZAudioFileInfo info;
@@ -317,6 +330,10 @@ typedef struct
 {
     if (pthread_mutex_trylock(&_lock) == 0)
     {
+        // the delegate's methods were resolved when it was set
+        EZAudioFileDelegateDispatch dispatch = _delegateDispatch;
+        id delegate = self.delegate;
+        
         // perform read
         [EZAudio checkResult:ExtAudioFileRead(self.info.extAudioFileRef,
                                               &frames,
@@ -326,27 +343,33 @@ typedef struct
         *eof = frames == 0;
         
         // notify delegate
-        if ([self.delegate respondsToSelector:@selector(audioFile:updatedPosition:)])
+        if (delegate && dispatch.updatedPosition)
         {
-            [self.delegate audioFile:self
-                     updatedPosition:self.frameIndex];
+            dispatch.updatedPosition(delegate,
+                                     @selector(audioFile:updatedPosition:),
+                                     self,
+                                     self.frameIndex);
         }
         
-        // convert into float data
-        [self.floatConverter convertDataFromAudioBufferList:audioBufferList
-                                         withNumberOfFrames:*bufferSize
-                                             toFloatBuffers:self.floatData];
+        // convert into float data (only needed for the delegate)
+        if (delegate && dispatch.readAudio)
+        {
+            [self.floatConverter convertDataFromAudioBufferList:audioBufferList
+                                             withNumberOfFrames:*bufferSize
+                                                 toFloatBuffers:self.floatData];
+        }
         
         pthread_mutex_unlock(&_lock);
         
-        if ([self.delegate respondsToSelector:@selector(audioFile:readAudio:withBufferSize:withNumberOfChannels:)])
+        if (delegate && dispatch.readAudio)
         {
             UInt32 channels = self.clientFormat.mChannelsPerFrame;
-            [self.delegate audioFile:self
-                           readAudio:self.floatData
-                      withBufferSize:*bufferSize
-                withNumberOfChannels:channels];
-            
+            dispatch.readAudio(delegate,
+                               @selector(audioFile:readAudio:withBufferSize:withNumberOfChannels:),
+                               self,
+                               self.floatData,
+                               *bufferSize,
+                               channels);
         }
     }
 }
@@ -360,13 +383,17 @@ typedef struct
         [EZAudio checkResult:ExtAudioFileSeek(self.info.extAudioFileRef,
                                               frame)
                    operation:"Failed to seek frame position within audio file"];
+        EZAudioFileDelegateDispatch dispatch = _delegateDispatch;
+        id delegate = self.delegate;
         pthread_mutex_unlock(&_lock);
         
         // notify delegate
-        if ([self.delegate respondsToSelector:@selector(audioFile:updatedPosition:)])
+        if (delegate && dispatch.updatedPosition)
         {
-            [self.delegate audioFile:self
-                     updatedPosition:self.frameIndex];
+            dispatch.updatedPosition(delegate,
+                                     @selector(audioFile:updatedPosition:),
+                                     self,
+                                     self.frameIndex);
         }
     }
 }
@@ -395,16 +422,16 @@ typedef struct
     if (pthread_mutex_trylock(&_lock) == 0)
     {
         // store current frame
-        SInt64 currentFrame     = self.frameIndex;
-        UInt32 channels         = self.clientFormat.mChannelsPerFrame;
-        BOOL   interleaved      = [EZAudio isInterleaved:self.clientFormat];
-        SInt64 totalFrames      = self.totalClientFrames;
-        SInt64 framesPerBuffer  = ((SInt64) totalFrames / numberOfPoints);
-        SInt64 framesPerChannel = framesPerBuffer / channels;
-        float  **data           = (float **)malloc( sizeof(float *) * channels );
+        SInt64 currentFrame    = self.frameIndex;
+        UInt32 channels        = self.clientFormat.mChannelsPerFrame;
+        BOOL   interleaved     = [EZAudio isInterleaved:self.clientFormat];
+        SInt64 totalFrames     = self.totalClientFrames;
+        UInt32 framesPerBuffer = (UInt32)(totalFrames / numberOfPoints);
+        const EZAudioDSPKernel *kernel = self.info.kernel;
+        float  **data          = (float **)malloc( sizeof(float *) * channels );
         for (int i = 0; i < channels; i++)
         {
-            data[i] = (float *)malloc( sizeof(float) * numberOfPoints );
+            data[i] = (float *)calloc( numberOfPoints, sizeof(float) );
         }
         
         // seek to 0
@@ -423,40 +450,54 @@ typedef struct
                                               audioBufferList)
                    operation:"Failed to read audio data from file waveform"];
         
-        // read through file and calculate rms at each point
-        SInt64 offset = 0;
-        for (SInt64 i = 0; i < numberOfPoints; i++)
+        // read through file and calculate rms at each point using the
+        // kernel matching the client format's channel count and layout
+        if (kernel)
         {
-            float buffer[framesPerBuffer];
-            if (interleaved)
+            float rms[channels];
+            for (UInt32 i = 0; i < numberOfPoints; i++)
             {
-                float *samples = (float *)audioBufferList->mBuffers[0].mData;
-                memcpy(buffer, &samples[offset], framesPerBuffer * sizeof(float));
+                kernel->rms(audioBufferList,
+                            i * framesPerBuffer,
+                            framesPerBuffer,
+                            channels,
+                            rms);
                 for (int channel = 0; channel < channels; channel++)
                 {
-                    float channelData[framesPerChannel];
-                    for (int frame = 0; frame < framesPerChannel; frame++)
-                    {
-                        channelData[frame] = buffer[frame * channels + channel];
-                    }
-                    float rms = [EZAudio RMS:channelData length:(UInt32)framesPerChannel];
-                    data[channel][i] = rms;
+                    data[channel][i] = rms[channel];
                 }
-                offset += channels * framesPerBuffer;
             }
-            else
+        }
+        else
+        {
+            // no kernel for the client format, fall back to the generic
+            // float rms of each channel
+            float *channelData = interleaved ? (float *)malloc( sizeof(float) * MAX(framesPerBuffer, 1) ) : NULL;
+            for (UInt32 i = 0; i < numberOfPoints; i++)
             {
+                SInt64 offset = (SInt64)i * framesPerBuffer;
                 for (int channel = 0; channel < channels; channel++)
                 {
-                    float *samples = (float *)audioBufferList->mBuffers[channel].mData;
-                    memcpy(buffer, &samples[offset], framesPerBuffer * sizeof(float));
-                    float rms = [EZAudio RMS:buffer length:(UInt32)framesPerBuffer];
-                    data[channel][i] = rms;
+                    float *samples;
+                    if (interleaved)
+                    {
+                        float *buffer = (float *)audioBufferList->mBuffers[0].mData;
+                        for (UInt32 frame = 0; frame < framesPerBuffer; frame++)
+                        {
+                            channelData[frame] = buffer[(offset + frame) * channels + channel];
+                        }
+                        samples = channelData;
+                    }
+                    else
+                    {
+                        samples = (float *)audioBufferList->mBuffers[channel].mData + offset;
+                    }
+                    data[channel][i] = [EZAudio RMS:samples length:framesPerBuffer];
                 }
-                offset += framesPerBuffer;
             }
+            free(channelData);
         }
-        
+
         // clean up
         [EZAudio freeBufferList:audioBufferList];
         
@@ -610,6 +651,31 @@ typedef struct
 #pragma mark - Setters
 //------------------------------------------------------------------------------
 
+- (void)setDelegate:(id<EZAudioFileDelegate>)delegate
+{
+    // resolve the delegate's methods once here instead of on every read
+    EZAudioFileDelegateDispatch dispatch;
+    memset(&dispatch, 0, sizeof(dispatch));
+    SEL readAudio = @selector(audioFile:readAudio:withBufferSize:withNumberOfChannels:);
+    SEL updatedPosition = @selector(audioFile:updatedPosition:);
+    if ([delegate respondsToSelector:readAudio])
+    {
+        dispatch.readAudio = (EZAudioFileReadAudioIMP)[(NSObject *)delegate methodForSelector:readAudio];
+    }
+    if ([delegate respondsToSelector:updatedPosition])
+    {
+        dispatch.updatedPosition = (EZAudioFileUpdatedPositionIMP)[(NSObject *)delegate methodForSelector:updatedPosition];
+    }
+
+    // swap the delegate and its methods together so a read never mixes them
+    pthread_mutex_lock(&_lock);
+    _delegate = delegate;
+    _delegateDispatch = dispatch;
+    pthread_mutex_unlock(&_lock);
+}
+
+//------------------------------------------------------------------------------
+
 - (void)setClientFormat:(AudioStreamBasicDescription)clientFormat
 {
     NSAssert([EZAudio isLinearPCM:clientFormat], @"Client format must be linear PCM");
@@ -627,6 +693,9 @@ typedef struct
     // create a new float converter using the client format as the input format
     self.floatConverter = [EZAudioFloatConverter converterWithInputFormat:clientFormat];
     
+    // pick the sample loops used for the waveform data
+    _info.kernel = EZAudioDSPKernelForFormat(clientFormat);
+    
     UInt32 maxPacketSize;
     UInt32 propSize = sizeof(maxPacketSize);
     [EZAudio checkResult:ExtAudioFileGetProperty(self.info.extAudioFileRef,
@@ -20,6 +20,7 @@ typedef struct
     AudioStreamBasicDescription outputFormat;
     AudioStreamPacketDescription *packetDescriptions;
     UInt32 packetsPerBuffer;
+    const EZAudioDSPKernel *kernel;
 } EZAudioFloatConverterInfo;
 
 OSStatus EZAudioFloatConverterCallback(AudioConverterRef            inAudioConverter,
@@ -75,6 +76,9 @@ OSStatus EZAudioFloatConverterCallback(AudioConverterRef            inAudioConve
         info.outputFormat = [EZAudio floatFormatWithNumberOfChannels:inputFormat.mChannelsPerFrame
                                                           sampleRate:inputFormat.mSampleRate];
         
+        // plain float and 16-bit integer input can skip the audio converter
+        info.kernel = EZAudioDSPKernelForFormat(inputFormat);
+        
         // get max packets per buffer so you can allocate a proper AudioBufferList
         UInt32 packetsPerBuffer = 0;
         UInt32 outputBufferSize = EZAudioFloatConverterDefaultOutputBufferSize;
@@ -146,6 +150,14 @@ OSStatus EZAudioFloatConverterCallback(AudioConverterRef            inAudioConve
     if (frames == 0)
     {
         
+    }
+    else if (info.kernel)
+    {
+        info.kernel->toFloat(audioBufferList,
+                             0,
+                             buffers,
+                             frames,
+                             info.inputFormat.mChannelsPerFrame);
     }
     else
     {
@@ -161,7 +173,7 @@ OSStatus EZAudioFloatConverterCallback(AudioConverterRef            inAudioConve
         {
             memcpy(buffers[i],
                    info.floatAudioBufferList->mBuffers[i].mData,
-                   info.floatAudioBufferList->mBuffers[i].mDataByteSize);
+                   frames * sizeof(float));
         }
     }
 }
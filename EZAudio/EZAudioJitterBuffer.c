@@ -0,0 +1,965 @@
+//
+//  EZAudioJitterBuffer.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#include "EZAudioJitterBuffer.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+
+// the FIFO indices are shared between the writer and reader threads
+#define EZ_AUDIO_JITTER_BARRIER() __sync_synchronize()
+
+// whichever thread swaps a gap's state first gets its frames (a full barrier)
+#define EZ_AUDIO_JITTER_SWAP(state, from, to) __sync_bool_compare_and_swap(state, from, to)
+
+// arrival statistics
+static const double EZAudioJitterBufferJitterMultiple  = 4.0;
+static const double EZAudioJitterBufferPeakDecay       = 4.0;
+static const double EZAudioJitterBufferBaselineCreep   = 0.001;
+
+// playout control, a 10 ms excess is 0.25% faster and the rate never strays past 1%
+static const double EZAudioJitterBufferFillFilter      = 0.25;
+static const double EZAudioJitterBufferStretchGain     = 0.25;
+static const double EZAudioJitterBufferMaximumStretch  = 0.01;
+
+// concealment, the shortest period peaking close to the best is taken so the
+// repeated cycle reaches back as little as possible (i.e. not into a fade)
+static const float  EZAudioJitterBufferPeriodTolerance = 0.95f;
+static const double EZAudioJitterBufferFadeDuration    = 0.004;
+static const double EZAudioJitterBufferDecayDuration   = 0.06;
+static const double EZAudioJitterBufferMinimumPeriod   = 0.0025;
+static const double EZAudioJitterBufferMaximumPeriod   = 0.016;
+
+// How many gaps late packets can still fill in. They're only outstanding for
+// the latency, so it would take every other 10 ms packet of half a second
+// going missing to run out (the gaps after that are played as silence).
+#define EZAudioJitterBufferMaximumGaps 32
+
+//------------------------------------------------------------------------------
+
+// repeats the last pitch period before `end` with a decaying gain
+typedef struct
+{
+    float    *history;
+    float    *scores;
+    float    *frame;
+    uint32_t end;
+    uint32_t period;
+    uint32_t phase;
+    float    gain;
+    int      active;
+} EZAudioJitterBufferConcealment;
+
+//------------------------------------------------------------------------------
+
+// who a gap's frames belong to
+enum
+{
+    EZAudioJitterBufferGapFree,     // the slot isn't in use
+    EZAudioJitterBufferGapMissing,  // still missing, either thread may take it
+    EZAudioJitterBufferGapFilling,  // the writer is copying a late packet into it
+    EZAudioJitterBufferGapConcealed // the reader concealed it, it's too late to fill
+};
+
+// A stretch of the FIFO the packets skipped over. It's published along with the
+// packet after it and the writer can fill it in until the reader is about to
+// play it, at which point the reader conceals it. Its bounds only change while
+// the writer owns it (the gap is split or shrunk by what's filled in).
+typedef struct
+{
+    volatile uint32_t start;
+    volatile uint32_t end;
+    volatile int32_t  state;
+} EZAudioJitterBufferGap;
+
+//------------------------------------------------------------------------------
+
+struct EZAudioJitterBuffer
+{
+    // FIFO (interleaved stream frames)
+    float             *fifo;
+    uint32_t          capacity;
+    uint32_t          mask;
+    uint32_t          guard;
+    uint32_t          channels;
+    volatile uint32_t head;
+    volatile uint32_t tail;
+
+    // settings in frames
+    double            sampleRate;
+    uint32_t          minimumLatency;
+    uint32_t          maximumLatency;
+    uint32_t          fadeFrames;
+    uint32_t          decayFrames;
+    uint32_t          minimumPeriod;
+    uint32_t          maximumPeriod;
+
+    // arrivals (writer), the statistics are read by the reader
+    int               started;
+    int64_t           startIndex;
+    int64_t           nextIndex;
+    double            lastTransit;
+    double            lastSendTime;
+    double            baseline;
+    volatile double   jitter;
+    volatile double   peakDelay;
+    volatile uint32_t packetFrames;
+    EZAudioJitterBufferGap gaps[EZAudioJitterBufferMaximumGaps];
+    uint64_t          writerConcealedFrames;
+    uint64_t          writerDroppedFrames;
+
+    // playout (reader)
+    double            position;
+    int               primed;
+    double            fillLevel;
+    double            ratio;
+    volatile double   target;
+    int               playing;
+    uint32_t          resumeFade;
+    uint32_t          dropOffset;
+    uint32_t          dropProgress;
+    float             *frame;
+    float             *otherFrame;
+    EZAudioJitterBufferConcealment readerConcealment;
+    EZAudioJitterBufferConcealment gapConcealment;
+    uint32_t          underruns;
+    uint64_t          readerConcealedFrames;
+    uint64_t          readerDroppedFrames;
+};
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+EZAudioJitterBuffer *EZAudioJitterBufferCreate(uint32_t channels,
+                                               double sampleRate,
+                                               double minimumLatency,
+                                               double maximumLatency)
+{
+    if (channels == 0 || sampleRate <= 0.0 || minimumLatency < 0.0 || maximumLatency < minimumLatency)
+    {
+        return NULL;
+    }
+
+    EZAudioJitterBuffer *jitterBuffer = (EZAudioJitterBuffer *)calloc(1, sizeof(EZAudioJitterBuffer));
+    if (!jitterBuffer)
+    {
+        return NULL;
+    }
+
+    jitterBuffer->channels = channels;
+    jitterBuffer->sampleRate = sampleRate;
+    jitterBuffer->fadeFrames = (uint32_t)(EZAudioJitterBufferFadeDuration * sampleRate) + 1;
+    jitterBuffer->decayFrames = (uint32_t)(EZAudioJitterBufferDecayDuration * sampleRate) + 1;
+    jitterBuffer->minimumPeriod = (uint32_t)(EZAudioJitterBufferMinimumPeriod * sampleRate) + 1;
+    jitterBuffer->maximumPeriod = (uint32_t)(EZAudioJitterBufferMaximumPeriod * sampleRate) + 1;
+
+    // the drop crossfade reads ahead of the target so it must always hold one
+    uint32_t smallest = jitterBuffer->fadeFrames + 4;
+    jitterBuffer->minimumLatency = (uint32_t)(minimumLatency * sampleRate);
+    jitterBuffer->minimumLatency = jitterBuffer->minimumLatency > smallest ? jitterBuffer->minimumLatency : smallest;
+    jitterBuffer->maximumLatency = (uint32_t)(maximumLatency * sampleRate);
+    jitterBuffer->maximumLatency = jitterBuffer->maximumLatency > jitterBuffer->minimumLatency ? jitterBuffer->maximumLatency : jitterBuffer->minimumLatency;
+
+    // The writer keeps clear of the history behind the tail so the reader can
+    // conceal from it, and there's room for twice the maximum latency (the
+    // reader only drops the excess when it reads) plus a gap and a packet.
+    jitterBuffer->guard = jitterBuffer->minimumPeriod + jitterBuffer->maximumPeriod + 4;
+    uint32_t capacity = 1;
+    while (capacity < 3 * jitterBuffer->maximumLatency + jitterBuffer->guard + 8192)
+    {
+        capacity <<= 1;
+    }
+    jitterBuffer->capacity = capacity;
+    jitterBuffer->mask = capacity - 1;
+
+    uint32_t historyFrames = jitterBuffer->minimumPeriod + jitterBuffer->maximumPeriod;
+    jitterBuffer->fifo = (float *)calloc((size_t)capacity * channels, sizeof(float));
+    jitterBuffer->frame = (float *)calloc(channels, sizeof(float));
+    jitterBuffer->otherFrame = (float *)calloc(channels, sizeof(float));
+    jitterBuffer->gapConcealment.history = (float *)calloc(historyFrames, sizeof(float));
+    jitterBuffer->gapConcealment.scores = (float *)calloc(jitterBuffer->maximumPeriod + 1, sizeof(float));
+    jitterBuffer->gapConcealment.frame = (float *)calloc(channels, sizeof(float));
+    jitterBuffer->readerConcealment.history = (float *)calloc(historyFrames, sizeof(float));
+    jitterBuffer->readerConcealment.scores = (float *)calloc(jitterBuffer->maximumPeriod + 1, sizeof(float));
+    jitterBuffer->readerConcealment.frame = (float *)calloc(channels, sizeof(float));
+    if (!jitterBuffer->fifo ||
+        !jitterBuffer->frame ||
+        !jitterBuffer->otherFrame ||
+        !jitterBuffer->gapConcealment.history ||
+        !jitterBuffer->gapConcealment.scores ||
+        !jitterBuffer->gapConcealment.frame ||
+        !jitterBuffer->readerConcealment.history ||
+        !jitterBuffer->readerConcealment.scores ||
+        !jitterBuffer->readerConcealment.frame)
+    {
+        EZAudioJitterBufferFree(jitterBuffer);
+        return NULL;
+    }
+
+    EZAudioJitterBufferReset(jitterBuffer);
+    return jitterBuffer;
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioJitterBufferFree(EZAudioJitterBuffer *jitterBuffer)
+{
+    if (jitterBuffer)
+    {
+        free(jitterBuffer->fifo);
+        free(jitterBuffer->frame);
+        free(jitterBuffer->otherFrame);
+        free(jitterBuffer->gapConcealment.history);
+        free(jitterBuffer->gapConcealment.scores);
+        free(jitterBuffer->gapConcealment.frame);
+        free(jitterBuffer->readerConcealment.history);
+        free(jitterBuffer->readerConcealment.scores);
+        free(jitterBuffer->readerConcealment.frame);
+        free(jitterBuffer);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioJitterBufferReset(EZAudioJitterBuffer *jitterBuffer)
+{
+    // the history before the first packet conceals as silence
+    memset(jitterBuffer->fifo, 0, (size_t)jitterBuffer->capacity * jitterBuffer->channels * sizeof(float));
+    jitterBuffer->head = 0;
+    jitterBuffer->tail = 0;
+
+    jitterBuffer->started = 0;
+    jitterBuffer->startIndex = 0;
+    jitterBuffer->nextIndex = 0;
+    jitterBuffer->lastTransit = 0.0;
+    jitterBuffer->lastSendTime = 0.0;
+    jitterBuffer->baseline = 0.0;
+    jitterBuffer->jitter = 0.0;
+    jitterBuffer->peakDelay = 0.0;
+    jitterBuffer->packetFrames = 0;
+    memset(jitterBuffer->gaps, 0, sizeof(jitterBuffer->gaps));
+    jitterBuffer->writerConcealedFrames = 0;
+    jitterBuffer->writerDroppedFrames = 0;
+
+    jitterBuffer->position = 1.0;
+    jitterBuffer->primed = 0;
+    jitterBuffer->playing = 0;
+    jitterBuffer->fillLevel = 0.0;
+    jitterBuffer->ratio = 1.0;
+    jitterBuffer->target = jitterBuffer->minimumLatency;
+    jitterBuffer->resumeFade = 0;
+    jitterBuffer->dropOffset = 0;
+    jitterBuffer->dropProgress = 0;
+    jitterBuffer->readerConcealment.active = 0;
+    jitterBuffer->underruns = 0;
+    jitterBuffer->readerConcealedFrames = 0;
+    jitterBuffer->readerDroppedFrames = 0;
+    EZ_AUDIO_JITTER_BARRIER();
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Concealment
+//------------------------------------------------------------------------------
+
+static float *EZAudioJitterBufferFrame(EZAudioJitterBuffer *jitterBuffer,
+                                      uint32_t index)
+{
+    return jitterBuffer->fifo + (size_t)(index & jitterBuffer->mask) * jitterBuffer->channels;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioJitterBufferConcealmentStart(EZAudioJitterBuffer *jitterBuffer,
+                                                EZAudioJitterBufferConcealment *concealment,
+                                                uint32_t end)
+{
+    // mix the history down to mono for the period search
+    uint32_t channels = jitterBuffer->channels;
+    uint32_t window = jitterBuffer->minimumPeriod;
+    uint32_t length = window + jitterBuffer->maximumPeriod;
+    float *history = concealment->history;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        const float *frame = jitterBuffer->fifo + (size_t)((end - length + i) & jitterBuffer->mask) * channels;
+        float sum = 0.0f;
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            sum += frame[channel];
+        }
+        history[i] = sum;
+    }
+
+    // how well each period's previous cycle matches the last window
+    const float *last = history + length - window;
+    float lastEnergy = 0.0f;
+    for (uint32_t i = 0; i < window; i++)
+    {
+        lastEnergy += last[i] * last[i];
+    }
+    float *scores = concealment->scores;
+    float bestScore = 0.0f;
+    for (uint32_t lag = jitterBuffer->minimumPeriod; lag <= jitterBuffer->maximumPeriod; lag++)
+    {
+        const float *cycle = last - lag;
+        float correlation = 0.0f;
+        float energy = 0.0f;
+        for (uint32_t i = 0; i < window; i++)
+        {
+            correlation += last[i] * cycle[i];
+            energy += cycle[i] * cycle[i];
+        }
+        float denominator = lastEnergy * energy;
+        float score = denominator > 0.0f ? correlation / sqrtf(denominator) : 0.0f;
+        scores[lag] = score;
+        bestScore = score > bestScore ? score : bestScore;
+    }
+    uint32_t period = jitterBuffer->maximumPeriod;
+    for (uint32_t lag = jitterBuffer->minimumPeriod + 1; bestScore > 0.0f && lag < jitterBuffer->maximumPeriod; lag++)
+    {
+        if (scores[lag] >= EZAudioJitterBufferPeriodTolerance * bestScore &&
+            scores[lag] >= scores[lag - 1] &&
+            scores[lag] >= scores[lag + 1])
+        {
+            period = lag;
+            break;
+        }
+    }
+
+    concealment->end = end;
+    concealment->period = period;
+    concealment->phase = 0;
+    concealment->gain = 1.0f;
+    concealment->active = 1;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioJitterBufferConcealmentFrame(EZAudioJitterBuffer *jitterBuffer,
+                                                EZAudioJitterBufferConcealment *concealment,
+                                                float *frame)
+{
+    uint32_t channels = jitterBuffer->channels;
+    const float *source = jitterBuffer->fifo + (size_t)((concealment->end - concealment->period + concealment->phase) & jitterBuffer->mask) * channels;
+    float gain = concealment->gain;
+    for (uint32_t channel = 0; channel < channels; channel++)
+    {
+        frame[channel] = gain * source[channel];
+    }
+    concealment->phase = concealment->phase + 1 < concealment->period ? concealment->phase + 1 : 0;
+    gain -= 1.0f / (float)jitterBuffer->decayFrames;
+    concealment->gain = gain > 0.0f ? gain : 0.0f;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioJitterBufferCrossfade(EZAudioJitterBuffer *jitterBuffer,
+                                         EZAudioJitterBufferConcealment *concealment,
+                                         uint32_t index,
+                                         uint32_t frames)
+{
+    // from the concealment carrying on into the frames already written there
+    uint32_t channels = jitterBuffer->channels;
+    float *concealed = concealment->frame;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        EZAudioJitterBufferConcealmentFrame(jitterBuffer, concealment, concealed);
+        float fade = (float)(i + 1) / (float)(frames + 1);
+        float *frame = EZAudioJitterBufferFrame(jitterBuffer, index + i);
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            frame[channel] = fade * frame[channel] + (1.0f - fade) * concealed[channel];
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+#pragma mark - Writing (Network Thread)
+//------------------------------------------------------------------------------
+
+static void EZAudioJitterBufferUpdateArrivals(EZAudioJitterBuffer *jitterBuffer,
+                                              uint32_t frames,
+                                              int64_t frameIndex,
+                                              double time,
+                                              int restart)
+{
+    double sendTime = (double)frameIndex / jitterBuffer->sampleRate;
+    double transit = time - sendTime;
+    if (restart)
+    {
+        jitterBuffer->baseline = transit;
+        jitterBuffer->lastTransit = transit;
+        jitterBuffer->lastSendTime = sendTime;
+        jitterBuffer->packetFrames = frames;
+        return;
+    }
+
+    // RFC 3550's interarrival jitter
+    double difference = fabs(transit - jitterBuffer->lastTransit);
+    jitterBuffer->jitter += (difference - jitterBuffer->jitter) / 16.0;
+    jitterBuffer->lastTransit = transit;
+
+    // The earliest transit is the baseline the others are late against. It
+    // creeps up slowly so a sender running slow can't leave it behind.
+    double elapsed = sendTime - jitterBuffer->lastSendTime;
+    elapsed = elapsed > 0.0 ? elapsed : 0.0;
+    double baseline = jitterBuffer->baseline + EZAudioJitterBufferBaselineCreep * elapsed;
+    jitterBuffer->baseline = transit < baseline ? transit : baseline;
+    jitterBuffer->lastSendTime = sendTime > jitterBuffer->lastSendTime ? sendTime : jitterBuffer->lastSendTime;
+
+    // how late the latest packets have been, decaying once they're on time again
+    double decay = elapsed < EZAudioJitterBufferPeakDecay ? elapsed / EZAudioJitterBufferPeakDecay : 1.0;
+    double peakDelay = jitterBuffer->peakDelay * (1.0 - decay);
+    double delay = transit - jitterBuffer->baseline;
+    jitterBuffer->peakDelay = delay > peakDelay ? delay : peakDelay;
+    jitterBuffer->packetFrames = frames;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioJitterBufferCopy(EZAudioJitterBuffer *jitterBuffer,
+                                    uint32_t index,
+                                    const float * const *source,
+                                    uint32_t offset,
+                                    uint32_t frames)
+{
+    uint32_t channels = jitterBuffer->channels;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        float *frame = EZAudioJitterBufferFrame(jitterBuffer, index + i);
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            frame[channel] = source[channel][offset + i];
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static EZAudioJitterBufferGap *EZAudioJitterBufferFreeGap(EZAudioJitterBuffer *jitterBuffer)
+{
+    for (uint32_t i = 0; i < EZAudioJitterBufferMaximumGaps; i++)
+    {
+        if (jitterBuffer->gaps[i].state == EZAudioJitterBufferGapFree)
+        {
+            return &jitterBuffer->gaps[i];
+        }
+    }
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioJitterBufferHoldGap(EZAudioJitterBuffer *jitterBuffer,
+                                       uint32_t start,
+                                       uint32_t end)
+{
+    // it's past the head so the reader can't see it before it's published
+    EZAudioJitterBufferGap *gap = EZAudioJitterBufferFreeGap(jitterBuffer);
+    if (!gap)
+    {
+        for (uint32_t index = start; index != end; index++)
+        {
+            memset(EZAudioJitterBufferFrame(jitterBuffer, index), 0, jitterBuffer->channels * sizeof(float));
+        }
+        jitterBuffer->writerConcealedFrames += end - start;
+        return;
+    }
+    gap->start = start;
+    gap->end = end;
+    EZ_AUDIO_JITTER_BARRIER();
+    gap->state = EZAudioJitterBufferGapMissing;
+}
+
+//------------------------------------------------------------------------------
+
+static uint32_t EZAudioJitterBufferFillGaps(EZAudioJitterBuffer *jitterBuffer,
+                                            const float * const *source,
+                                            uint32_t frames,
+                                            uint32_t index)
+{
+    uint32_t filled = 0;
+    for (uint32_t i = 0; i < EZAudioJitterBufferMaximumGaps; i++)
+    {
+        // only the writer moves a gap's bounds so they can be looked at first
+        EZAudioJitterBufferGap *gap = &jitterBuffer->gaps[i];
+        if (gap->state != EZAudioJitterBufferGapMissing)
+        {
+            continue;
+        }
+        uint32_t gapStart = gap->start;
+        uint32_t gapEnd = gap->end;
+        uint32_t start = (int32_t)(index - gapStart) > 0 ? index : gapStart;
+        uint32_t end = (int32_t)(index + frames - gapEnd) < 0 ? index + frames : gapEnd;
+        if ((int32_t)(end - start) <= 0)
+        {
+            continue;
+        }
+
+        // a packet inside the gap leaves it in two
+        EZAudioJitterBufferGap *rest = NULL;
+        if (start != gapStart && end != gapEnd)
+        {
+            rest = EZAudioJitterBufferFreeGap(jitterBuffer);
+            if (!rest)
+            {
+                continue;
+            }
+        }
+
+        // too late if the reader's already concealed it
+        if (!EZ_AUDIO_JITTER_SWAP(&gap->state, EZAudioJitterBufferGapMissing, EZAudioJitterBufferGapFilling))
+        {
+            continue;
+        }
+        EZAudioJitterBufferCopy(jitterBuffer, start, source, start - index, end - start);
+        filled += end - start;
+        EZ_AUDIO_JITTER_BARRIER();
+        if (rest)
+        {
+            rest->start = end;
+            rest->end = gapEnd;
+            EZ_AUDIO_JITTER_BARRIER();
+            rest->state = EZAudioJitterBufferGapMissing;
+        }
+        gap->start = start == gapStart ? end : gapStart;
+        gap->end = start == gapStart ? gapEnd : start;
+        EZ_AUDIO_JITTER_BARRIER();
+        gap->state = gap->start == gap->end ? EZAudioJitterBufferGapFree : EZAudioJitterBufferGapMissing;
+    }
+    return filled;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioJitterBufferWrite(EZAudioJitterBuffer *jitterBuffer,
+                                  const float * const *source,
+                                  uint32_t frames,
+                                  int64_t frameIndex,
+                                  double time)
+{
+    if (frames == 0)
+    {
+        return 0;
+    }
+    uint32_t head = jitterBuffer->head;
+    uint32_t tail = jitterBuffer->tail;
+    EZ_AUDIO_JITTER_BARRIER();
+
+    // A jump ahead past the maximum latency or back past the whole FIFO is the
+    // stream starting over (i.e. the sender restarted), carry on from there.
+    int64_t missing = frameIndex - jitterBuffer->nextIndex;
+    int restart = !jitterBuffer->started || missing > (int64_t)jitterBuffer->maximumLatency || missing < -(int64_t)jitterBuffer->capacity;
+    EZAudioJitterBufferUpdateArrivals(jitterBuffer, frames, frameIndex, time, restart);
+    if (restart)
+    {
+        jitterBuffer->started = 1;
+        jitterBuffer->startIndex = frameIndex - head;
+        jitterBuffer->nextIndex = frameIndex;
+        missing = 0;
+    }
+    uint32_t index = (uint32_t)(frameIndex - jitterBuffer->startIndex);
+
+    // Whatever arrived late can still fill in a gap the reader hasn't reached,
+    // anything else before the head has been played or is a duplicate.
+    uint32_t late = missing < 0 ? (uint32_t)(-missing < frames ? -missing : frames) : 0;
+    uint32_t filled = late ? EZAudioJitterBufferFillGaps(jitterBuffer, source, late, index) : 0;
+    jitterBuffer->writerDroppedFrames += late - filled;
+
+    uint32_t count = 0;
+    if (late < frames)
+    {
+        uint32_t used = head - tail + jitterBuffer->guard;
+        uint32_t space = used < jitterBuffer->capacity ? jitterBuffer->capacity - used : 0;
+        uint32_t gapFrames = missing > 0 ? (uint32_t)missing : 0;
+        gapFrames = gapFrames < space ? gapFrames : space;
+        count = frames - late;
+        count = count < space - gapFrames ? count : space - gapFrames;
+        jitterBuffer->writerDroppedFrames += frames - late - count;
+
+        // the packets missing in between are published as a gap to fill in later
+        if (count)
+        {
+            EZAudioJitterBufferCopy(jitterBuffer, head + gapFrames, source, late, count);
+            if (gapFrames)
+            {
+                EZAudioJitterBufferHoldGap(jitterBuffer, head, head + gapFrames);
+            }
+            jitterBuffer->nextIndex += gapFrames + count;
+            EZ_AUDIO_JITTER_BARRIER();
+            jitterBuffer->head = head + gapFrames + count;
+        }
+    }
+    return filled + count;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Reading (Audio Thread)
+//------------------------------------------------------------------------------
+
+static double EZAudioJitterBufferTargetFrames(EZAudioJitterBuffer *jitterBuffer,
+                                              uint32_t frames)
+{
+    // enough to ride out the latest packets being as late as they've recently been
+    double jitter = EZAudioJitterBufferJitterMultiple * jitterBuffer->jitter;
+    double peakDelay = jitterBuffer->peakDelay;
+    double delay = peakDelay > jitter ? peakDelay : jitter;
+    double target = jitterBuffer->packetFrames + frames + delay * jitterBuffer->sampleRate;
+    target = target > jitterBuffer->minimumLatency ? target : jitterBuffer->minimumLatency;
+    target = target < jitterBuffer->maximumLatency ? target : jitterBuffer->maximumLatency;
+    return target;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioJitterBufferConceal(EZAudioJitterBuffer *jitterBuffer,
+                                       float * const *destination,
+                                       uint32_t end,
+                                       uint32_t offset,
+                                       uint32_t frames)
+{
+    // keep going if the last underrun is still being concealed
+    EZAudioJitterBufferConcealment *concealment = &jitterBuffer->readerConcealment;
+    if (!concealment->active)
+    {
+        EZAudioJitterBufferConcealmentStart(jitterBuffer, concealment, end);
+    }
+    uint32_t channels = jitterBuffer->channels;
+    float *frame = concealment->frame;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        EZAudioJitterBufferConcealmentFrame(jitterBuffer, concealment, frame);
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            destination[channel][offset + i] = frame[channel];
+        }
+    }
+
+    // waiting for the first packets isn't concealing anything
+    if (jitterBuffer->playing)
+    {
+        jitterBuffer->readerConcealedFrames += frames;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioJitterBufferInterpolate(EZAudioJitterBuffer *jitterBuffer,
+                                           uint32_t tail,
+                                           double position,
+                                           float *frame)
+{
+    // 4-point Hermite interpolation around the fractional read position
+    uint32_t channels = jitterBuffer->channels;
+    uint32_t mask = jitterBuffer->mask;
+    uint32_t index = (uint32_t)position;
+    float t = (float)(position - index);
+    const float *xm1 = jitterBuffer->fifo + (size_t)((tail + index - 1) & mask) * channels;
+    const float *x0 = jitterBuffer->fifo + (size_t)((tail + index) & mask) * channels;
+    const float *x1 = jitterBuffer->fifo + (size_t)((tail + index + 1) & mask) * channels;
+    const float *x2 = jitterBuffer->fifo + (size_t)((tail + index + 2) & mask) * channels;
+    for (uint32_t channel = 0; channel < channels; channel++)
+    {
+        float c1 = 0.5f * (x1[channel] - xm1[channel]);
+        float c2 = xm1[channel] - 2.5f * x0[channel] + 2.0f * x1[channel] - 0.5f * x2[channel];
+        float c3 = 0.5f * (x2[channel] - xm1[channel]) + 1.5f * (x0[channel] - x1[channel]);
+        frame[channel] = ((c3 * t + c2) * t + c1) * t + x0[channel];
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioJitterBufferConcealGap(EZAudioJitterBuffer *jitterBuffer,
+                                         EZAudioJitterBufferGap *gap,
+                                         uint32_t head)
+{
+    // The audio after the gap runs up to the next one (which the writer may be
+    // filling in), anything since the head was read isn't there yet.
+    uint32_t start = gap->start;
+    uint32_t end = gap->end;
+    uint32_t next = head;
+    for (uint32_t i = 0; i < EZAudioJitterBufferMaximumGaps; i++)
+    {
+        EZAudioJitterBufferGap *other = &jitterBuffer->gaps[i];
+        uint32_t otherStart = other->start;
+        if (other != gap &&
+            other->state != EZAudioJitterBufferGapFree &&
+            (int32_t)(otherStart - end) >= 0 &&
+            (int32_t)(otherStart - next) < 0)
+        {
+            next = otherStart;
+        }
+    }
+    EZ_AUDIO_JITTER_BARRIER();
+
+    // conceal it from the audio before it and crossfade into the audio after it
+    uint32_t fadeFrames = next - end < jitterBuffer->fadeFrames ? next - end : jitterBuffer->fadeFrames;
+    EZAudioJitterBufferConcealment *concealment = &jitterBuffer->gapConcealment;
+    EZAudioJitterBufferConcealmentStart(jitterBuffer, concealment, start);
+    for (uint32_t index = start; index != end; index++)
+    {
+        EZAudioJitterBufferConcealmentFrame(jitterBuffer,
+                                            concealment,
+                                            EZAudioJitterBufferFrame(jitterBuffer, index));
+    }
+    EZAudioJitterBufferCrossfade(jitterBuffer, concealment, end, fadeFrames);
+    jitterBuffer->readerConcealedFrames += end - start;
+}
+
+//------------------------------------------------------------------------------
+
+static uint32_t EZAudioJitterBufferConcealGaps(EZAudioJitterBuffer *jitterBuffer,
+                                               uint32_t tail,
+                                               uint32_t head,
+                                               uint32_t reach)
+{
+    // Take the gaps the read can reach from the writer, earliest first so each
+    // one is concealed from audio that's final. One that's being filled in is
+    // as far as the read can go.
+    uint32_t limit = reach < head - tail ? tail + reach : head;
+    for (;;)
+    {
+        EZAudioJitterBufferGap *earliest = NULL;
+        uint32_t earliestStart = limit;
+        for (uint32_t i = 0; i < EZAudioJitterBufferMaximumGaps; i++)
+        {
+            EZAudioJitterBufferGap *gap = &jitterBuffer->gaps[i];
+            int32_t state = gap->state;
+            uint32_t start = gap->start;
+            if ((state == EZAudioJitterBufferGapMissing || state == EZAudioJitterBufferGapFilling) &&
+                (int32_t)(start - tail) >= 0 &&
+                (int32_t)(start - earliestStart) < 0)
+            {
+                earliest = gap;
+                earliestStart = start;
+            }
+        }
+        if (!earliest)
+        {
+            return head;
+        }
+        if (EZ_AUDIO_JITTER_SWAP(&earliest->state, EZAudioJitterBufferGapMissing, EZAudioJitterBufferGapConcealed))
+        {
+            EZAudioJitterBufferConcealGap(jitterBuffer, earliest, head);
+        }
+        else if (earliest->state == EZAudioJitterBufferGapFilling)
+        {
+            return earliestStart;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioJitterBufferRead(EZAudioJitterBuffer *jitterBuffer,
+                                 float * const *destination,
+                                 uint32_t frames)
+{
+    uint32_t tail = jitterBuffer->tail;
+    uint32_t head = jitterBuffer->head;
+    EZ_AUDIO_JITTER_BARRIER();
+
+    // the gaps that have been played are done with
+    for (uint32_t i = 0; i < EZAudioJitterBufferMaximumGaps; i++)
+    {
+        EZAudioJitterBufferGap *gap = &jitterBuffer->gaps[i];
+        if (gap->state == EZAudioJitterBufferGapConcealed && (int32_t)(gap->end - tail) <= 0)
+        {
+            gap->state = EZAudioJitterBufferGapFree;
+        }
+    }
+
+    uint32_t available = head - tail;
+    uint32_t channels = jitterBuffer->channels;
+    double target = EZAudioJitterBufferTargetFrames(jitterBuffer, frames);
+    jitterBuffer->target = target;
+
+    // conceal until the buffer has filled to the target (at start or after an underrun)
+    if (!jitterBuffer->primed)
+    {
+        if (available < (uint32_t)target + 3)
+        {
+            EZAudioJitterBufferConceal(jitterBuffer, destination, tail, 0, frames);
+            return 0;
+        }
+        jitterBuffer->primed = 1;
+        jitterBuffer->playing = 1;
+        jitterBuffer->position = 1.0;
+        jitterBuffer->fillLevel = available - 1.0;
+        jitterBuffer->resumeFade = jitterBuffer->readerConcealment.active ? jitterBuffer->fadeFrames : 0;
+    }
+
+    // steer the low-passed fill level onto the target
+    double fill = available - jitterBuffer->position;
+    double alpha = frames / (EZAudioJitterBufferFillFilter * jitterBuffer->sampleRate);
+    jitterBuffer->fillLevel += (alpha < 1.0 ? alpha : 1.0) * (fill - jitterBuffer->fillLevel);
+    double stretch = EZAudioJitterBufferStretchGain * (jitterBuffer->fillLevel - target) / jitterBuffer->sampleRate;
+    stretch = stretch > EZAudioJitterBufferMaximumStretch ? EZAudioJitterBufferMaximumStretch : stretch;
+    stretch = stretch < -EZAudioJitterBufferMaximumStretch ? -EZAudioJitterBufferMaximumStretch : stretch;
+    jitterBuffer->ratio = 1.0 + stretch;
+
+    // a burst past the maximum latency (i.e. after a stall) is too much to stretch away
+    if (!jitterBuffer->dropOffset && fill > jitterBuffer->maximumLatency + jitterBuffer->packetFrames + frames)
+    {
+        jitterBuffer->dropOffset = (uint32_t)(fill - target);
+        jitterBuffer->dropProgress = 0;
+    }
+
+    // conceal the gaps this read (and the drop) can reach, it stops at one being filled in
+    uint32_t reach = (uint32_t)jitterBuffer->position + jitterBuffer->dropOffset + frames + frames / 32 + 4;
+    available = EZAudioJitterBufferConcealGaps(jitterBuffer, tail, head, reach) - tail;
+
+    EZAudioJitterBufferConcealment *concealment = &jitterBuffer->readerConcealment;
+    float *frame = jitterBuffer->frame;
+    float *otherFrame = jitterBuffer->otherFrame;
+    uint32_t fadeFrames = jitterBuffer->fadeFrames;
+    double position = jitterBuffer->position;
+    double ratio = jitterBuffer->ratio;
+    uint32_t i;
+    for (i = 0; i < frames; i++)
+    {
+        uint32_t index = (uint32_t)position;
+        if (index + 2 >= available)
+        {
+            // ran dry, conceal the rest and build the latency back up
+            EZAudioJitterBufferConceal(jitterBuffer, destination, tail + index, i, frames - i);
+            jitterBuffer->primed = 0;
+            jitterBuffer->underruns++;
+            jitterBuffer->resumeFade = 0;
+            jitterBuffer->dropOffset = 0;
+            break;
+        }
+        EZAudioJitterBufferInterpolate(jitterBuffer, tail, position, frame);
+
+        // crossfade over to the target fill level and jump there
+        if (jitterBuffer->dropOffset)
+        {
+            uint32_t dropOffset = jitterBuffer->dropOffset;
+            if (index + dropOffset + 2 >= available)
+            {
+                // drained since, there's nothing left to drop
+                jitterBuffer->dropOffset = 0;
+            }
+            else
+            {
+                EZAudioJitterBufferInterpolate(jitterBuffer, tail, position + dropOffset, otherFrame);
+                float fade = (float)(jitterBuffer->dropProgress + 1) / (float)(fadeFrames + 1);
+                for (uint32_t channel = 0; channel < channels; channel++)
+                {
+                    frame[channel] = (1.0f - fade) * frame[channel] + fade * otherFrame[channel];
+                }
+                if (++jitterBuffer->dropProgress == fadeFrames)
+                {
+                    position += dropOffset;
+                    jitterBuffer->fillLevel -= dropOffset;
+                    jitterBuffer->readerDroppedFrames += dropOffset;
+                    jitterBuffer->dropOffset = 0;
+                }
+            }
+        }
+
+        // crossfade out of the concealment back into the stream
+        if (jitterBuffer->resumeFade)
+        {
+            EZAudioJitterBufferConcealmentFrame(jitterBuffer, concealment, otherFrame);
+            float fade = (float)(fadeFrames - jitterBuffer->resumeFade + 1) / (float)(fadeFrames + 1);
+            for (uint32_t channel = 0; channel < channels; channel++)
+            {
+                frame[channel] = fade * frame[channel] + (1.0f - fade) * otherFrame[channel];
+            }
+            if (--jitterBuffer->resumeFade == 0)
+            {
+                concealment->active = 0;
+            }
+        }
+
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            destination[channel][i] = frame[channel];
+        }
+        position += ratio;
+    }
+
+    // release everything before the frame preceding the read position
+    uint32_t consumed = (uint32_t)position - 1;
+    jitterBuffer->position = position - consumed;
+    EZ_AUDIO_JITTER_BARRIER();
+    jitterBuffer->tail = tail + consumed;
+    return i;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Statistics
+//------------------------------------------------------------------------------
+
+double EZAudioJitterBufferJitter(EZAudioJitterBuffer *jitterBuffer)
+{
+    return jitterBuffer->jitter;
+}
+
+//------------------------------------------------------------------------------
+
+double EZAudioJitterBufferTargetLatency(EZAudioJitterBuffer *jitterBuffer)
+{
+    return jitterBuffer->target / jitterBuffer->sampleRate;
+}
+
+//------------------------------------------------------------------------------
+
+double EZAudioJitterBufferLatency(EZAudioJitterBuffer *jitterBuffer)
+{
+    return jitterBuffer->fillLevel / jitterBuffer->sampleRate;
+}
+
+//------------------------------------------------------------------------------
+
+double EZAudioJitterBufferRatio(EZAudioJitterBuffer *jitterBuffer)
+{
+    return jitterBuffer->ratio;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioJitterBufferUnderruns(EZAudioJitterBuffer *jitterBuffer)
+{
+    return jitterBuffer->underruns;
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t EZAudioJitterBufferConcealedFrames(EZAudioJitterBuffer *jitterBuffer)
+{
+    return jitterBuffer->writerConcealedFrames + jitterBuffer->readerConcealedFrames;
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t EZAudioJitterBufferDroppedFrames(EZAudioJitterBuffer *jitterBuffer)
+{
+    return jitterBuffer->writerDroppedFrames + jitterBuffer->readerDroppedFrames;
+}
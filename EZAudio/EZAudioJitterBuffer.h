@@ -0,0 +1,169 @@
+//
+//  EZAudioJitterBuffer.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef EZAudioJitterBuffer_h
+#define EZAudioJitterBuffer_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioJitterBuffer
+//------------------------------------------------------------------------------
+
+/**
+ Smooths out audio arriving over a network for playout on a local clock. The network thread writes packets in as they arrive, each tagged with its position in the stream, and the output's audio thread reads however many frames it needs.
+
+ The arrival jitter is tracked the way RTP does (RFC 3550's running mean of the difference between successive transit times) along with a slowly decaying peak of how late packets arrive relative to the earliest ones. The target fill level is enough to ride out that peak plus a packet and a read. Playout is steered onto the target by resampling a fraction of a percent faster or slower (a 4-point Hermite interpolator, like the EZAudioDriftCompensator), and if the fill level runs past the maximum latency anyway (i.e. a burst after a stall) the excess is dropped with a short crossfade.
+
+ Gaps are concealed by repeating the last pitch period of the audio before them with a decaying gain, found by autocorrelation over the history. A gap between packets (a lost or reordered packet) is left for the missing packet to fill in until the audio thread is about to play it, at which point it's concealed and crossfaded into the audio after it. Each gap is handed over with a compare-and-swap, so a late packet either fills it in before the reader gets there or is dropped, and neither thread ever writes frames the other is using. An empty buffer on the audio thread (an underrun) is concealed while the buffer refills to the target fill level, then crossfaded back into the stream. Packets arriving after their place in the stream has been played are dropped.
+
+ This is plain C without any Core Audio dependencies so it can be exercised offline (i.e. on Linux with an EZAudioPacketReplay standing in for the network). It is safe for one writer thread and one reader thread.
+ */
+typedef struct EZAudioJitterBuffer EZAudioJitterBuffer;
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+/**
+ Creates a jitter buffer. Must not be called from an audio thread.
+ @param channels       The number of channels of the stream.
+ @param sampleRate     The sample rate of the stream (and the output it plays out on).
+ @param minimumLatency The smallest target fill level in seconds, however steady the network.
+ @param maximumLatency The largest target fill level in seconds, however jittery the network. Anything buffered past this is dropped.
+ @return A new jitter buffer or NULL if it couldn't be allocated. Free it with EZAudioJitterBufferFree.
+ */
+EZAudioJitterBuffer *EZAudioJitterBufferCreate(uint32_t channels,
+                                               double sampleRate,
+                                               double minimumLatency,
+                                               double maximumLatency);
+
+/**
+ Frees a jitter buffer. Neither thread may be using it.
+ @param jitterBuffer The jitter buffer to free.
+ */
+void EZAudioJitterBufferFree(EZAudioJitterBuffer *jitterBuffer);
+
+/**
+ Empties the jitter buffer and forgets the stream and its statistics, i.e. before playing a new stream. Neither thread may be using it.
+ @param jitterBuffer The jitter buffer to reset.
+ */
+void EZAudioJitterBufferReset(EZAudioJitterBuffer *jitterBuffer);
+
+//------------------------------------------------------------------------------
+#pragma mark - Writing (Network Thread)
+//------------------------------------------------------------------------------
+
+/**
+ Writes a packet into the jitter buffer as it arrives. Never locks or allocates.
+ @param jitterBuffer The jitter buffer.
+ @param source       One float array per channel.
+ @param frames       The number of frames in the packet.
+ @param frameIndex   The position of the packet's first frame in the stream (i.e. an RTP timestamp). Consecutive packets are contiguous, a jump forward is a gap to conceal and a jump back is a late packet.
+ @param time         When the packet arrived in seconds on a monotonic clock.
+ @return The number of frames of the packet written. Fewer than `frames` means part of the packet arrived too late to play or the reader has stalled and the buffer is full.
+ */
+uint32_t EZAudioJitterBufferWrite(EZAudioJitterBuffer *jitterBuffer,
+                                  const float * const *source,
+                                  uint32_t frames,
+                                  int64_t frameIndex,
+                                  double time);
+
+//------------------------------------------------------------------------------
+#pragma mark - Reading (Audio Thread)
+//------------------------------------------------------------------------------
+
+/**
+ Reads the next frames for playout. Never locks or allocates. Whatever the buffer can't provide (before the first packets have filled it to the target or while it refills after an underrun) is concealed instead, as are the gaps the read is about to reach.
+ @param jitterBuffer The jitter buffer.
+ @param destination  One float array per channel receiving the frames.
+ @param frames       The number of frames to read.
+ @return The number of frames that came from the stream. The rest are concealment.
+ */
+uint32_t EZAudioJitterBufferRead(EZAudioJitterBuffer *jitterBuffer,
+                                 float * const *destination,
+                                 uint32_t frames);
+
+//------------------------------------------------------------------------------
+#pragma mark - Statistics
+//------------------------------------------------------------------------------
+
+/**
+ Provides the arrival jitter estimated from the packets' transit times.
+ @param jitterBuffer The jitter buffer.
+ @return The mean jitter in seconds.
+ */
+double EZAudioJitterBufferJitter(EZAudioJitterBuffer *jitterBuffer);
+
+/**
+ Provides the fill level the playout is currently steered towards.
+ @param jitterBuffer The jitter buffer.
+ @return The target latency in seconds.
+ */
+double EZAudioJitterBufferTargetLatency(EZAudioJitterBuffer *jitterBuffer);
+
+/**
+ Provides the low-passed amount of audio buffered between the network and the output.
+ @param jitterBuffer The jitter buffer.
+ @return The latency in seconds.
+ */
+double EZAudioJitterBufferLatency(EZAudioJitterBuffer *jitterBuffer);
+
+/**
+ Provides the playout rate currently applied to steer the fill level.
+ @param jitterBuffer The jitter buffer.
+ @return The number of stream frames consumed per output frame.
+ */
+double EZAudioJitterBufferRatio(EZAudioJitterBuffer *jitterBuffer);
+
+/**
+ Provides the number of times the reader ran out of frames and had to refill to the target.
+ @param jitterBuffer The jitter buffer.
+ @return The underrun count.
+ */
+uint32_t EZAudioJitterBufferUnderruns(EZAudioJitterBuffer *jitterBuffer);
+
+/**
+ Provides the number of frames of concealment played in place of lost packets and underruns.
+ @param jitterBuffer The jitter buffer.
+ @return The concealed frame count.
+ */
+uint64_t EZAudioJitterBufferConcealedFrames(EZAudioJitterBuffer *jitterBuffer);
+
+/**
+ Provides the number of stream frames that were never played because they arrived too late, the buffer was full or they were dropped to bring the latency back down.
+ @param jitterBuffer The jitter buffer.
+ @return The dropped frame count.
+ */
+uint64_t EZAudioJitterBufferDroppedFrames(EZAudioJitterBuffer *jitterBuffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
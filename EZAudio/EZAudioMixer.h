@@ -0,0 +1,187 @@
+//
+//  EZAudioMixer.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+#import <Foundation/Foundation.h>
+#import "EZOutput.h"
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioMixer
+//------------------------------------------------------------------------------
+
+/**
+ The EZAudioMixer lets several sources play through one EZOutput at the same time. It becomes the output's data source and, on every render, asks each of its sources for audio, scales it by the source's gain and pan and sums everything with the vectorized EZAudioDSPMix kernel before writing the mix into the output's format.
+
+ A source is any EZOutputDataSource implementing `output:shouldFillAudioBufferList:withNumberOfFrames:` (i.e. an EZAudioPlayer, see its `mixer` property). It is asked for audio in the mixer's `sourceFormat` and is passed the mixer's output as the `output` argument, so a data source written for an EZOutput works unchanged. Sources can be added and removed and their gain and pan changed from any thread at any time: the audio thread never locks and only ever reads a fixed array of source slots, a removed source is released once the audio thread is guaranteed to be done with it, and the other threads share a lock that the audio thread never takes. Gain and pan changes are ramped across the next render so they don't click.
+ */
+@interface EZAudioMixer : NSObject <EZOutputDataSource>
+
+//------------------------------------------------------------------------------
+#pragma mark - Properties
+//------------------------------------------------------------------------------
+
+/**
+ The EZOutput the mixer renders into.
+ */
+@property (nonatomic, strong, readonly) EZOutput *output;
+
+/**
+ The format the sources are asked to fill: non-interleaved float with the output's channel count and sample rate.
+ */
+@property (nonatomic, readonly) AudioStreamBasicDescription sourceFormat;
+
+/**
+ The maximum number of sources the mixer can play at once. Default is 128.
+ */
+@property (nonatomic, readonly) UInt32 maximumNumberOfSources;
+
+//------------------------------------------------------------------------------
+#pragma mark - Initializers
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Initializers
+///-----------------------------------------------------------
+
+/**
+ Creates a mixer that becomes the data source of an output. The output's stream format should be set before creating the mixer.
+ @param output An EZOutput to render the mix into (i.e. `[EZOutput sharedOutput]`).
+ @return A newly created instance of the EZAudioMixer class.
+ */
+- (instancetype)initWithOutput:(EZOutput *)output;
+
+//------------------------------------------------------------------------------
+
+/**
+ Creates a mixer that becomes the data source of an output.
+ @param output                 An EZOutput to render the mix into.
+ @param maximumNumberOfSources The number of source slots to preallocate.
+ @return A newly created instance of the EZAudioMixer class.
+ */
+- (instancetype)initWithOutput:(EZOutput *)output
+        maximumNumberOfSources:(UInt32)maximumNumberOfSources;
+
+//------------------------------------------------------------------------------
+
+/**
+ Class method to create a mixer that becomes the data source of an output.
+ @param output An EZOutput to render the mix into (i.e. `[EZOutput sharedOutput]`).
+ @return A newly created instance of the EZAudioMixer class.
+ */
++ (instancetype)mixerWithOutput:(EZOutput *)output;
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides a shared mixer rendering into `[EZOutput sharedOutput]`, so components that would otherwise fight over the shared output's data source can play side by side.
+ @return The shared instance of the EZAudioMixer class.
+ */
++ (instancetype)sharedMixer;
+
+//------------------------------------------------------------------------------
+#pragma mark - Sources
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Adding And Removing Sources
+///-----------------------------------------------------------
+
+/**
+ Adds a source at unity gain and centered. The mixer retains the source until it's removed. Safe to call from any thread while the output is playing.
+ @param source An EZOutputDataSource implementing `output:shouldFillAudioBufferList:withNumberOfFrames:`.
+ @return YES if the source was added, NO if it was already added or every slot is taken.
+ */
+- (BOOL)addSource:(id<EZOutputDataSource>)source;
+
+//------------------------------------------------------------------------------
+
+/**
+ Removes a source. The mix stops including it from the next render. Safe to call from any thread while the output is playing.
+ @param source A source previously added with `addSource:`.
+ */
+- (void)removeSource:(id<EZOutputDataSource>)source;
+
+//------------------------------------------------------------------------------
+
+/**
+ Removes every source.
+ */
+- (void)removeAllSources;
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides whether a source is currently being mixed.
+ @param source An EZOutputDataSource.
+ @return YES if the source was added and not removed since.
+ */
+- (BOOL)containsSource:(id<EZOutputDataSource>)source;
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides the number of sources currently being mixed.
+ @return The number of sources.
+ */
+- (UInt32)numberOfSources;
+
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Setting The Gain And Pan
+///-----------------------------------------------------------
+
+/**
+ Sets the linear gain of a source. The change is ramped across the next render. Ignored for a source that has been removed.
+ @param gain   The linear gain (1 is unity, 0 is silent).
+ @param source A source previously added with `addSource:`.
+ */
+- (void)setGain:(float)gain forSource:(id<EZOutputDataSource>)source;
+
+//------------------------------------------------------------------------------
+
+/**
+ Sets the pan (balance) of a source on a stereo output. At 0 both channels play at the source's gain, towards -1 the right channel is attenuated and towards 1 the left channel is. Ignored on outputs that aren't stereo. Ignored for a source that has been removed.
+ @param pan    The pan from -1 (left) to 1 (right).
+ @param source A source previously added with `addSource:`.
+ */
+- (void)setPan:(float)pan forSource:(id<EZOutputDataSource>)source;
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides the linear gain of a source.
+ @param source A source previously added with `addSource:`.
+ @return The gain, or 0 if the source isn't being mixed.
+ */
+- (float)gainForSource:(id<EZOutputDataSource>)source;
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides the pan of a source.
+ @param source A source previously added with `addSource:`.
+ @return The pan, or 0 if the source isn't being mixed.
+ */
+- (float)panForSource:(id<EZOutputDataSource>)source;
+
+@end
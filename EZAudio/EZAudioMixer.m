@@ -0,0 +1,494 @@
+//
+//  EZAudioMixer.m
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+#import "EZAudioMixer.h"
+
+//------------------------------------------------------------------------------
+
+#import "EZAudio.h"
+#import <pthread.h>
+
+//------------------------------------------------------------------------------
+
+// constants
+static const UInt32 EZAudioMixerMaximumFrames = 4096;
+static const UInt32 EZAudioMixerDefaultMaximumNumberOfSources = 128;
+
+//------------------------------------------------------------------------------
+
+typedef void (*EZAudioMixerFillIMP)(id, SEL, EZOutput *, AudioBufferList *, UInt32);
+
+//------------------------------------------------------------------------------
+
+// one per added source, immutable apart from the gain and pan once it's in a slot
+typedef struct EZAudioMixerSource
+{
+    const void                *source;
+    EZAudioMixerFillIMP       fill;
+    volatile float            gain;
+    volatile float            pan;
+    float                     appliedGains[2];
+    BOOL                      hasAppliedGains;
+    int64_t                   retiredEpoch;
+    struct EZAudioMixerSource *next;
+} EZAudioMixerSource;
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioMixer
+//------------------------------------------------------------------------------
+
+@interface EZAudioMixer ()
+{
+    EZAudioMixerSource *volatile *_slots;
+    EZAudioMixerSource *volatile _retired;
+    volatile int64_t             _renderEpoch;
+    pthread_mutex_t              _controlLock;
+    const EZAudioDSPKernel       *_kernel;
+    UInt32                       _channels;
+    AudioBufferList              *_sourceBufferList;
+    float                        **_sourceBuffers;
+    float                        **_mixBuffers;
+}
+@property (nonatomic, strong, readwrite) EZOutput *output;
+@property (nonatomic, readwrite) AudioStreamBasicDescription sourceFormat;
+@property (nonatomic, readwrite) UInt32 maximumNumberOfSources;
+@end
+
+//------------------------------------------------------------------------------
+
+@implementation EZAudioMixer
+
+//------------------------------------------------------------------------------
+#pragma mark - Dealloc
+//------------------------------------------------------------------------------
+
+- (void)dealloc
+{
+    if (self.output.outputDataSource == self)
+    {
+        self.output.outputDataSource = nil;
+    }
+    [self removeAllSources];
+    [self reclaimRetiredSourcesWaiting:YES];
+    pthread_mutex_destroy(&_controlLock);
+    free((void *)_slots);
+    free(_sourceBufferList);
+    [EZAudio freeFloatBuffers:_sourceBuffers numberOfChannels:_channels];
+    [EZAudio freeFloatBuffers:_mixBuffers numberOfChannels:_channels];
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Initialization
+//------------------------------------------------------------------------------
+
+- (instancetype)initWithOutput:(EZOutput *)output
+{
+    return [self initWithOutput:output
+         maximumNumberOfSources:EZAudioMixerDefaultMaximumNumberOfSources];
+}
+
+//------------------------------------------------------------------------------
+
+- (instancetype)initWithOutput:(EZOutput *)output
+        maximumNumberOfSources:(UInt32)maximumNumberOfSources
+{
+    NSAssert(output, @"A mixer needs an output to render into");
+    self = [super init];
+    if (self)
+    {
+        AudioStreamBasicDescription outputFormat = output.audioStreamBasicDescription;
+        _kernel = EZAudioDSPKernelForFormat(outputFormat);
+        NSAssert(_kernel, @"The mixer's output must be packed native endian float or 16-bit integer linear PCM");
+        _channels = outputFormat.mChannelsPerFrame;
+        _sourceFormat = [EZAudio floatFormatWithNumberOfChannels:_channels
+                                                      sampleRate:outputFormat.mSampleRate];
+        _maximumNumberOfSources = MAX(maximumNumberOfSources, 1);
+        _slots = (EZAudioMixerSource *volatile *)calloc(_maximumNumberOfSources, sizeof(EZAudioMixerSource *));
+
+        // the audio thread never takes this, it only keeps other threads from reading a record while it's freed
+        pthread_mutex_init(&_controlLock, NULL);
+
+        // everything the render needs is allocated up front, the sources all share one buffer list
+        _sourceBuffers = [EZAudio floatBuffersWithNumberOfFrames:EZAudioMixerMaximumFrames
+                                                numberOfChannels:_channels];
+        _mixBuffers = [EZAudio floatBuffersWithNumberOfFrames:EZAudioMixerMaximumFrames
+                                             numberOfChannels:_channels];
+        _sourceBufferList = (AudioBufferList *)malloc(offsetof(AudioBufferList, mBuffers[0]) + sizeof(AudioBuffer) * _channels);
+        _sourceBufferList->mNumberBuffers = _channels;
+        for (UInt32 i = 0; i < _channels; i++)
+        {
+            _sourceBufferList->mBuffers[i].mNumberChannels = 1;
+            _sourceBufferList->mBuffers[i].mData = _sourceBuffers[i];
+        }
+
+        _output = output;
+        _output.outputDataSource = self;
+    }
+    return self;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Class Initializers
+//------------------------------------------------------------------------------
+
++ (instancetype)mixerWithOutput:(EZOutput *)output
+{
+    return [[self alloc] initWithOutput:output];
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Singleton
+//------------------------------------------------------------------------------
+
++ (instancetype)sharedMixer
+{
+    static EZAudioMixer *sharedMixer = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedMixer = [[self alloc] initWithOutput:[EZOutput sharedOutput]];
+    });
+    return sharedMixer;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Sources
+//------------------------------------------------------------------------------
+
+- (BOOL)addSource:(id<EZOutputDataSource>)source
+{
+    SEL fill = @selector(output:shouldFillAudioBufferList:withNumberOfFrames:);
+    NSAssert([source respondsToSelector:fill], @"A mixer source must implement output:shouldFillAudioBufferList:withNumberOfFrames:");
+    [self reclaimRetiredSourcesWaiting:NO];
+    if (!source)
+    {
+        return NO;
+    }
+
+    // resolve everything the audio thread needs before it can see the source
+    EZAudioMixerSource *record = (EZAudioMixerSource *)calloc(1, sizeof(EZAudioMixerSource));
+    record->source = CFBridgingRetain(source);
+    record->fill = (EZAudioMixerFillIMP)[(NSObject *)source methodForSelector:fill];
+    record->gain = 1.0f;
+    record->pan = 0.0f;
+
+    // claim the first free slot, the barrier publishes the record along with it
+    BOOL added = NO;
+    BOOL contained = NO;
+    pthread_mutex_lock(&_controlLock);
+    contained = [self recordForSource:source] != NULL;
+    for (UInt32 i = 0; i < _maximumNumberOfSources && !contained && !added; i++)
+    {
+        added = !_slots[i] && OSAtomicCompareAndSwapPtrBarrier(NULL, record, (void *volatile *)&_slots[i]);
+    }
+    pthread_mutex_unlock(&_controlLock);
+    if (added)
+    {
+        return YES;
+    }
+
+    if (!contained)
+    {
+        NSLog(@"The mixer already has its maximum of %u sources", (unsigned int)_maximumNumberOfSources);
+    }
+    CFBridgingRelease(record->source);
+    free(record);
+    return NO;
+}
+
+//------------------------------------------------------------------------------
+
+- (void)removeSource:(id<EZOutputDataSource>)source
+{
+    pthread_mutex_lock(&_controlLock);
+    for (UInt32 i = 0; i < _maximumNumberOfSources; i++)
+    {
+        EZAudioMixerSource *record = _slots[i];
+        if (record && record->source == (__bridge const void *)source &&
+            OSAtomicCompareAndSwapPtrBarrier(record, NULL, (void *volatile *)&_slots[i]))
+        {
+            [self retireSource:record];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&_controlLock);
+    [self reclaimRetiredSourcesWaiting:NO];
+}
+
+//------------------------------------------------------------------------------
+
+- (void)removeAllSources
+{
+    pthread_mutex_lock(&_controlLock);
+    for (UInt32 i = 0; i < _maximumNumberOfSources; i++)
+    {
+        EZAudioMixerSource *record = _slots[i];
+        if (record && OSAtomicCompareAndSwapPtrBarrier(record, NULL, (void *volatile *)&_slots[i]))
+        {
+            [self retireSource:record];
+        }
+    }
+    pthread_mutex_unlock(&_controlLock);
+    [self reclaimRetiredSourcesWaiting:NO];
+}
+
+//------------------------------------------------------------------------------
+
+- (BOOL)containsSource:(id<EZOutputDataSource>)source
+{
+    pthread_mutex_lock(&_controlLock);
+    BOOL contains = [self recordForSource:source] != NULL;
+    pthread_mutex_unlock(&_controlLock);
+    return contains;
+}
+
+//------------------------------------------------------------------------------
+
+- (UInt32)numberOfSources
+{
+    UInt32 count = 0;
+    for (UInt32 i = 0; i < _maximumNumberOfSources; i++)
+    {
+        count += _slots[i] ? 1 : 0;
+    }
+    return count;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Gain And Pan
+//------------------------------------------------------------------------------
+
+- (void)setGain:(float)gain forSource:(id<EZOutputDataSource>)source
+{
+    pthread_mutex_lock(&_controlLock);
+    EZAudioMixerSource *record = [self recordForSource:source];
+    if (record)
+    {
+        record->gain = MAX(gain, 0.0f);
+    }
+    pthread_mutex_unlock(&_controlLock);
+}
+
+//------------------------------------------------------------------------------
+
+- (void)setPan:(float)pan forSource:(id<EZOutputDataSource>)source
+{
+    pthread_mutex_lock(&_controlLock);
+    EZAudioMixerSource *record = [self recordForSource:source];
+    if (record)
+    {
+        record->pan = MIN(MAX(pan, -1.0f), 1.0f);
+    }
+    pthread_mutex_unlock(&_controlLock);
+}
+
+//------------------------------------------------------------------------------
+
+- (float)gainForSource:(id<EZOutputDataSource>)source
+{
+    pthread_mutex_lock(&_controlLock);
+    EZAudioMixerSource *record = [self recordForSource:source];
+    float gain = record ? record->gain : 0.0f;
+    pthread_mutex_unlock(&_controlLock);
+    return gain;
+}
+
+//------------------------------------------------------------------------------
+
+- (float)panForSource:(id<EZOutputDataSource>)source
+{
+    pthread_mutex_lock(&_controlLock);
+    EZAudioMixerSource *record = [self recordForSource:source];
+    float pan = record ? record->pan : 0.0f;
+    pthread_mutex_unlock(&_controlLock);
+    return pan;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Utility
+//------------------------------------------------------------------------------
+
+// the caller holds the control lock, so the record stays valid until it lets go
+- (EZAudioMixerSource *)recordForSource:(id<EZOutputDataSource>)source
+{
+    for (UInt32 i = 0; i < _maximumNumberOfSources; i++)
+    {
+        EZAudioMixerSource *record = _slots[i];
+        if (record && record->source == (__bridge const void *)source)
+        {
+            return record;
+        }
+    }
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+
+- (void)retireSource:(EZAudioMixerSource *)record
+{
+    // a render running right now (odd epoch) may still be reading it, any render after that can't see it
+    OSMemoryBarrier();
+    int64_t epoch = _renderEpoch;
+    record->retiredEpoch = (epoch + 1) & ~1LL;
+    [self pushRetiredSource:record];
+}
+
+//------------------------------------------------------------------------------
+
+- (void)pushRetiredSource:(EZAudioMixerSource *)record
+{
+    EZAudioMixerSource *head;
+    do
+    {
+        head = _retired;
+        record->next = head;
+    } while (!OSAtomicCompareAndSwapPtrBarrier(head, record, (void *volatile *)&_retired));
+}
+
+//------------------------------------------------------------------------------
+
+- (void)reclaimRetiredSourcesWaiting:(BOOL)waiting
+{
+    // under the control lock so no other thread is looking at a record while it's freed
+    pthread_mutex_lock(&_controlLock);
+    EZAudioMixerSource *list;
+    do
+    {
+        list = _retired;
+    } while (list && !OSAtomicCompareAndSwapPtrBarrier(list, NULL, (void *volatile *)&_retired));
+
+    while (list)
+    {
+        EZAudioMixerSource *record = list;
+        list = record->next;
+        while (waiting && _renderEpoch < record->retiredEpoch)
+        {
+            usleep(1000);
+        }
+        if (_renderEpoch >= record->retiredEpoch)
+        {
+            CFBridgingRelease(record->source);
+            free(record);
+        }
+        else
+        {
+            // still in use, put it back for next time
+            [self pushRetiredSource:record];
+        }
+    }
+    pthread_mutex_unlock(&_controlLock);
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Render
+//------------------------------------------------------------------------------
+
+static void EZAudioMixerRender(EZAudioMixer *mixer,
+                               AudioBufferList *ioData,
+                               UInt32 frameOffset,
+                               UInt32 frames)
+{
+    UInt32 channels = mixer->_channels;
+    float **mix = mixer->_mixBuffers;
+    for (UInt32 channel = 0; channel < channels; channel++)
+    {
+        memset(mix[channel], 0, frames * sizeof(float));
+    }
+
+    AudioBufferList *sourceBufferList = mixer->_sourceBufferList;
+    float **sourceBuffers = mixer->_sourceBuffers;
+    EZOutput *output = mixer->_output;
+    for (UInt32 i = 0; i < mixer->_maximumNumberOfSources; i++)
+    {
+        EZAudioMixerSource *record = mixer->_slots[i];
+        if (!record)
+        {
+            continue;
+        }
+
+        // a source that reads past its end shouldn't replay the previous source's audio
+        for (UInt32 channel = 0; channel < channels; channel++)
+        {
+            sourceBufferList->mBuffers[channel].mDataByteSize = frames * sizeof(float);
+            memset(sourceBuffers[channel], 0, frames * sizeof(float));
+        }
+        record->fill((__bridge id)record->source,
+                     @selector(output:shouldFillAudioBufferList:withNumberOfFrames:),
+                     output,
+                     sourceBufferList,
+                     frames);
+
+        // balance on a stereo output, the same gain everywhere otherwise
+        float gain = record->gain;
+        float pan = record->pan;
+        float gains[2] = { gain, gain };
+        if (channels == 2)
+        {
+            gains[0] = pan > 0.0f ? gain * (1.0f - pan) : gain;
+            gains[1] = pan < 0.0f ? gain * (1.0f + pan) : gain;
+        }
+        if (!record->hasAppliedGains)
+        {
+            record->appliedGains[0] = gains[0];
+            record->appliedGains[1] = gains[1];
+            record->hasAppliedGains = YES;
+        }
+        for (UInt32 channel = 0; channel < channels; channel++)
+        {
+            UInt32 side = channel < 2 ? channel : 0;
+            EZAudioDSPMix(sourceBuffers[channel],
+                          mix[channel],
+                          frames,
+                          record->appliedGains[side],
+                          gains[side]);
+        }
+        record->appliedGains[0] = gains[0];
+        record->appliedGains[1] = gains[1];
+    }
+
+    mixer->_kernel->fromFloat(mix, ioData, frameOffset, frames, channels);
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - EZOutputDataSource
+//------------------------------------------------------------------------------
+
+- (void)output:(EZOutput *)output
+callbackWithActionFlags:(AudioUnitRenderActionFlags *)ioActionFlags
+   inTimeStamp:(const AudioTimeStamp *)inTimeStamp
+   inBusNumber:(UInt32)inBusNumber
+inNumberFrames:(UInt32)inNumberFrames
+        ioData:(AudioBufferList *)ioData
+{
+    // odd while rendering so a source removed meanwhile is kept until this render is done
+    OSAtomicIncrement64Barrier(&_renderEpoch);
+    for (UInt32 offset = 0; offset < inNumberFrames; offset += EZAudioMixerMaximumFrames)
+    {
+        EZAudioMixerRender(self,
+                           ioData,
+                           offset,
+                           MIN(inNumberFrames - offset, EZAudioMixerMaximumFrames));
+    }
+    OSAtomicIncrement64Barrier(&_renderEpoch);
+}
+
+@end
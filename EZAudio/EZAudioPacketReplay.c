@@ -0,0 +1,189 @@
+//
+//  EZAudioPacketReplay.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#include "EZAudioPacketReplay.h"
+#include <math.h>
+#include <stdlib.h>
+
+//------------------------------------------------------------------------------
+
+struct EZAudioPacketReplay
+{
+    // the network
+    double                    sampleRate;
+    uint32_t                  packetFrames;
+    double                    delay;
+    double                    jitter;
+    double                    lossEnter;
+    double                    lossLeave;
+    uint32_t                  random;
+    int                       losing;
+
+    // packets in flight, sorted by arrival
+    EZAudioPacketReplayPacket *pending;
+    uint32_t                  pendingCount;
+    uint32_t                  pendingCapacity;
+    uint64_t                  sentPackets;
+    uint64_t                  lostPackets;
+};
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+EZAudioPacketReplay *EZAudioPacketReplayCreate(double sampleRate,
+                                               uint32_t packetFrames,
+                                               double delay,
+                                               double jitter,
+                                               double lossProbability,
+                                               double burstLength,
+                                               uint32_t seed)
+{
+    if (sampleRate <= 0.0 || packetFrames == 0 || delay < 0.0 || jitter < 0.0 ||
+        lossProbability < 0.0 || lossProbability >= 1.0 || burstLength < 1.0)
+    {
+        return NULL;
+    }
+
+    EZAudioPacketReplay *replay = (EZAudioPacketReplay *)calloc(1, sizeof(EZAudioPacketReplay));
+    if (!replay)
+    {
+        return NULL;
+    }
+    replay->sampleRate = sampleRate;
+    replay->packetFrames = packetFrames;
+    replay->delay = delay;
+    replay->jitter = jitter;
+
+    // Bursts end with a chance of 1 / burstLength per packet, and start often
+    // enough for the loss probability to be the fraction of time spent in one.
+    replay->lossLeave = 1.0 / burstLength;
+    replay->lossEnter = lossProbability * replay->lossLeave / (1.0 - lossProbability);
+    replay->random = seed ? seed : 1;
+    return replay;
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioPacketReplayFree(EZAudioPacketReplay *replay)
+{
+    if (replay)
+    {
+        free(replay->pending);
+        free(replay);
+    }
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Replaying
+//------------------------------------------------------------------------------
+
+static double EZAudioPacketReplayUniform(EZAudioPacketReplay *replay)
+{
+    // xorshift32, mapped onto (0, 1]
+    uint32_t x = replay->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    replay->random = x;
+    return (double)((x >> 8) + 1) / 16777216.0;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioPacketReplaySend(EZAudioPacketReplay *replay)
+{
+    EZAudioPacketReplayPacket packet;
+    packet.frameIndex = (int64_t)replay->sentPackets * replay->packetFrames;
+    packet.frames = replay->packetFrames;
+    packet.sendTime = (double)packet.frameIndex / replay->sampleRate;
+    packet.arrivalTime = packet.sendTime + replay->delay - replay->jitter * log(EZAudioPacketReplayUniform(replay));
+    replay->sentPackets++;
+
+    double chance = replay->losing ? replay->lossLeave : replay->lossEnter;
+    if (EZAudioPacketReplayUniform(replay) <= chance)
+    {
+        replay->losing = !replay->losing;
+    }
+    if (replay->losing)
+    {
+        replay->lostPackets++;
+        return;
+    }
+
+    if (replay->pendingCount == replay->pendingCapacity)
+    {
+        uint32_t capacity = replay->pendingCapacity ? 2 * replay->pendingCapacity : 64;
+        EZAudioPacketReplayPacket *pending = (EZAudioPacketReplayPacket *)realloc(replay->pending, capacity * sizeof(EZAudioPacketReplayPacket));
+        if (!pending)
+        {
+            replay->lostPackets++;
+            return;
+        }
+        replay->pending = pending;
+        replay->pendingCapacity = capacity;
+    }
+
+    uint32_t i = replay->pendingCount++;
+    while (i > 0 && replay->pending[i - 1].arrivalTime > packet.arrivalTime)
+    {
+        replay->pending[i] = replay->pending[i - 1];
+        i--;
+    }
+    replay->pending[i] = packet;
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioPacketReplayNext(EZAudioPacketReplay *replay,
+                             EZAudioPacketReplayPacket *packet)
+{
+    // nothing sent from now on can overtake a packet arriving before the next send plus the fixed delay
+    while (replay->pendingCount == 0 ||
+           replay->pending[0].arrivalTime > (double)replay->sentPackets * replay->packetFrames / replay->sampleRate + replay->delay)
+    {
+        EZAudioPacketReplaySend(replay);
+    }
+
+    *packet = replay->pending[0];
+    replay->pendingCount--;
+    for (uint32_t i = 0; i < replay->pendingCount; i++)
+    {
+        replay->pending[i] = replay->pending[i + 1];
+    }
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t EZAudioPacketReplaySentPackets(EZAudioPacketReplay *replay)
+{
+    return replay->sentPackets;
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t EZAudioPacketReplayLostPackets(EZAudioPacketReplay *replay)
+{
+    return replay->lostPackets;
+}
@@ -0,0 +1,117 @@
+//
+//  EZAudioPacketReplay.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef EZAudioPacketReplay_h
+#define EZAudioPacketReplay_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioPacketReplay
+//------------------------------------------------------------------------------
+
+/**
+ Stands in for a network when testing network-fed playback (i.e. an EZAudioJitterBuffer) locally. A stream is cut into fixed size packets sent in real time, each one delayed by a fixed delay plus an exponentially distributed queueing delay (which reorders packets when it exceeds a packet's duration) and lost in bursts (a Gilbert model, the loss probability being the long run fraction of packets lost). The packets are replayed in the order they arrive.
+
+ It is seeded so a run can be repeated exactly. This is plain C without any Core Audio dependencies so it can drive offline tests (i.e. on Linux) as well as a replay thread on a device.
+ */
+typedef struct EZAudioPacketReplay EZAudioPacketReplay;
+
+//------------------------------------------------------------------------------
+
+/**
+ A packet as it arrives.
+ */
+typedef struct
+{
+    int64_t  frameIndex;
+    uint32_t frames;
+    double   sendTime;
+    double   arrivalTime;
+} EZAudioPacketReplayPacket;
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+/**
+ Creates a packet replay.
+ @param sampleRate      The sample rate of the stream.
+ @param packetFrames    The number of frames in each packet.
+ @param delay           The fixed part of the transit time in seconds.
+ @param jitter          The mean of the random part of the transit time in seconds.
+ @param lossProbability The fraction of packets lost, from 0 to 1.
+ @param burstLength     The mean number of packets lost in a row (1 for independent losses).
+ @param seed            The seed of the random number generator.
+ @return A new packet replay or NULL if it couldn't be allocated. Free it with EZAudioPacketReplayFree.
+ */
+EZAudioPacketReplay *EZAudioPacketReplayCreate(double sampleRate,
+                                               uint32_t packetFrames,
+                                               double delay,
+                                               double jitter,
+                                               double lossProbability,
+                                               double burstLength,
+                                               uint32_t seed);
+
+/**
+ Frees a packet replay.
+ @param replay The packet replay to free.
+ */
+void EZAudioPacketReplayFree(EZAudioPacketReplay *replay);
+
+//------------------------------------------------------------------------------
+#pragma mark - Replaying
+//------------------------------------------------------------------------------
+
+/**
+ Provides the next packet to arrive. The stream starts at frame 0 sent at time 0 and never ends. May allocate (to hold the packets in flight) so don't call it from an audio thread.
+ @param replay The packet replay.
+ @param packet Receives the packet.
+ */
+void EZAudioPacketReplayNext(EZAudioPacketReplay *replay,
+                             EZAudioPacketReplayPacket *packet);
+
+/**
+ Provides the number of packets sent so far, including the ones still in flight.
+ @param replay The packet replay.
+ @return The sent packet count.
+ */
+uint64_t EZAudioPacketReplaySentPackets(EZAudioPacketReplay *replay);
+
+/**
+ Provides the number of packets lost so far.
+ @param replay The packet replay.
+ @return The lost packet count.
+ */
+uint64_t EZAudioPacketReplayLostPackets(EZAudioPacketReplay *replay);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
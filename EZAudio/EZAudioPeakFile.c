@@ -0,0 +1,1009 @@
+//
+//  EZAudioPeakFile.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+// pread and pwrite are POSIX, not strict C
+#define _POSIX_C_SOURCE 200809L
+
+#include "EZAudioPeakFile.h"
+#include <fcntl.h>
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+
+// each coarser level summarizes this many blocks of the level below it
+#define EZ_AUDIO_PEAK_FILE_LEVEL_FACTOR 8
+
+// 256 * 8^15 frames is far longer than anything will ever be recorded
+#define EZ_AUDIO_PEAK_FILE_MAX_LEVELS 16
+
+// finest level blocks gathered per write to the file
+#define EZ_AUDIO_PEAK_FILE_STAGED_BLOCKS 64
+
+// finest level blocks read per pass when rebuilding the coarser levels
+#define EZ_AUDIO_PEAK_FILE_REBUILD_BLOCKS 4096
+
+static const char     EZAudioPeakFileMagic[4]   = { 'E', 'Z', 'P', 'K' };
+static const uint32_t EZAudioPeakFileVersion    = 1;
+static const uint32_t EZAudioPeakFileHeaderSize = 64;
+
+// a channel's minimum, maximum and RMS as 16-bit values
+static const uint32_t EZAudioPeakFileValueSize  = 6;
+
+//------------------------------------------------------------------------------
+
+typedef struct
+{
+    int16_t  minimum;
+    int16_t  maximum;
+    uint16_t rms;
+} EZAudioPeakFileValue;
+
+//------------------------------------------------------------------------------
+
+// the block of a level that's still being summarized, one entry per channel
+typedef struct
+{
+    float    *minimum;
+    float    *maximum;
+    double   *sumOfSquares;
+    uint64_t frames;
+    uint32_t blocks;
+} EZAudioPeakFileAccumulator;
+
+//------------------------------------------------------------------------------
+
+// the coarser levels are held in memory, the finest one is only in the file
+typedef struct
+{
+    EZAudioPeakFileValue *values;
+    uint64_t             count;
+    uint64_t             capacity;
+} EZAudioPeakFileLevel;
+
+//------------------------------------------------------------------------------
+
+struct EZAudioPeakFile
+{
+    int                        fd;
+    bool                       writable;
+    bool                       failed;
+    uint32_t                   channels;
+    uint32_t                   sampleRate;
+    uint32_t                   blockFrames;
+    uint32_t                   rowBytes;
+    uint64_t                   frames;
+    EZAudioPeakFileLevel       levels[EZ_AUDIO_PEAK_FILE_MAX_LEVELS];
+    EZAudioPeakFileAccumulator accumulators[EZ_AUDIO_PEAK_FILE_MAX_LEVELS];
+    float                      *accumulatorStorage;
+    double                     *sumOfSquaresStorage;
+    EZAudioPeakFileValue       *block;
+    uint8_t                    *staged;
+    uint32_t                   stagedCount;
+    pthread_mutex_t            lock;
+};
+
+//------------------------------------------------------------------------------
+#pragma mark - Utility
+//------------------------------------------------------------------------------
+
+// the file is little endian whatever the host is
+static void EZAudioPeakFilePut16(uint8_t *bytes, uint16_t value)
+{
+    bytes[0] = (uint8_t)(value);
+    bytes[1] = (uint8_t)(value >> 8);
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioPeakFilePut32(uint8_t *bytes, uint32_t value)
+{
+    EZAudioPeakFilePut16(bytes, (uint16_t)value);
+    EZAudioPeakFilePut16(bytes + 2, (uint16_t)(value >> 16));
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioPeakFilePut64(uint8_t *bytes, uint64_t value)
+{
+    EZAudioPeakFilePut32(bytes, (uint32_t)value);
+    EZAudioPeakFilePut32(bytes + 4, (uint32_t)(value >> 32));
+}
+
+//------------------------------------------------------------------------------
+
+static uint16_t EZAudioPeakFileGet16(const uint8_t *bytes)
+{
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+//------------------------------------------------------------------------------
+
+static uint32_t EZAudioPeakFileGet32(const uint8_t *bytes)
+{
+    return (uint32_t)EZAudioPeakFileGet16(bytes) | ((uint32_t)EZAudioPeakFileGet16(bytes + 2) << 16);
+}
+
+//------------------------------------------------------------------------------
+
+static uint64_t EZAudioPeakFileGet64(const uint8_t *bytes)
+{
+    return (uint64_t)EZAudioPeakFileGet32(bytes) | ((uint64_t)EZAudioPeakFileGet32(bytes + 4) << 32);
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioPeakFileEncode(const EZAudioPeakFileValue *values, uint32_t count, uint8_t *bytes)
+{
+    for (uint32_t i = 0; i < count; i++, bytes += EZAudioPeakFileValueSize)
+    {
+        EZAudioPeakFilePut16(bytes, (uint16_t)values[i].minimum);
+        EZAudioPeakFilePut16(bytes + 2, (uint16_t)values[i].maximum);
+        EZAudioPeakFilePut16(bytes + 4, values[i].rms);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioPeakFileDecode(const uint8_t *bytes, uint32_t count, EZAudioPeakFileValue *values)
+{
+    for (uint32_t i = 0; i < count; i++, bytes += EZAudioPeakFileValueSize)
+    {
+        values[i].minimum = (int16_t)EZAudioPeakFileGet16(bytes);
+        values[i].maximum = (int16_t)EZAudioPeakFileGet16(bytes + 2);
+        values[i].rms     = EZAudioPeakFileGet16(bytes + 4);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioPeakFileWriteAt(EZAudioPeakFile *peakFile, uint64_t offset, const void *bytes, size_t length)
+{
+    const uint8_t *remaining = (const uint8_t *)bytes;
+    while (length > 0)
+    {
+        ssize_t written = pwrite(peakFile->fd, remaining, length, (off_t)offset);
+        if (written <= 0)
+        {
+            peakFile->failed = true;
+            return false;
+        }
+        remaining += written;
+        offset    += (uint64_t)written;
+        length    -= (size_t)written;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioPeakFileReadAt(int fd, uint64_t offset, void *bytes, size_t length)
+{
+    uint8_t *remaining = (uint8_t *)bytes;
+    while (length > 0)
+    {
+        ssize_t bytesRead = pread(fd, remaining, length, (off_t)offset);
+        if (bytesRead <= 0)
+        {
+            return false;
+        }
+        remaining += bytesRead;
+        offset    += (uint64_t)bytesRead;
+        length    -= (size_t)bytesRead;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioPeakFileWriteHeader(EZAudioPeakFile *peakFile,
+                                       uint64_t frames,
+                                       uint64_t trailerOffset,
+                                       uint32_t levelCount)
+{
+    uint8_t header[EZAudioPeakFileHeaderSize];
+    memset(header, 0, sizeof(header));
+    memcpy(header, EZAudioPeakFileMagic, 4);
+    EZAudioPeakFilePut32(header + 4, EZAudioPeakFileVersion);
+    EZAudioPeakFilePut32(header + 8, peakFile->channels);
+    EZAudioPeakFilePut32(header + 12, peakFile->sampleRate);
+    EZAudioPeakFilePut32(header + 16, peakFile->blockFrames);
+    EZAudioPeakFilePut32(header + 20, EZ_AUDIO_PEAK_FILE_LEVEL_FACTOR);
+    EZAudioPeakFilePut64(header + 24, frames);
+    EZAudioPeakFilePut64(header + 32, trailerOffset);
+    EZAudioPeakFilePut32(header + 40, levelCount);
+    return EZAudioPeakFileWriteAt(peakFile, 0, header, sizeof(header));
+}
+
+//------------------------------------------------------------------------------
+
+static uint64_t EZAudioPeakFileLevelFrames(const EZAudioPeakFile *peakFile, uint32_t level)
+{
+    uint64_t frames = peakFile->blockFrames;
+    for (uint32_t i = 0; i < level; i++)
+    {
+        frames *= EZ_AUDIO_PEAK_FILE_LEVEL_FACTOR;
+    }
+    return frames;
+}
+
+//------------------------------------------------------------------------------
+
+// frames covered by blocks that can be read, the finest level's partial block only counts once it's written on close
+static uint64_t EZAudioPeakFileReadableFrames(const EZAudioPeakFile *peakFile)
+{
+    uint64_t finest = peakFile->levels[0].count * peakFile->blockFrames;
+    return finest < peakFile->frames ? finest : peakFile->frames;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Summarizing
+//------------------------------------------------------------------------------
+
+static void EZAudioPeakFileResetAccumulator(EZAudioPeakFile *peakFile, uint32_t level)
+{
+    EZAudioPeakFileAccumulator *accumulator = &peakFile->accumulators[level];
+    for (uint32_t channel = 0; channel < peakFile->channels; channel++)
+    {
+        accumulator->minimum[channel]      = FLT_MAX;
+        accumulator->maximum[channel]      = -FLT_MAX;
+        accumulator->sumOfSquares[channel] = 0.0;
+    }
+    accumulator->frames = 0;
+    accumulator->blocks = 0;
+}
+
+//------------------------------------------------------------------------------
+
+// the extremes are rounded outwards so a peak never looks lower than it was
+static EZAudioPeakFileValue EZAudioPeakFileQuantize(float minimum,
+                                                    float maximum,
+                                                    double sumOfSquares,
+                                                    uint64_t frames)
+{
+    float low  = floorf(minimum * 32767.0f);
+    float high = ceilf(maximum * 32767.0f);
+    float rms  = frames > 0 ? (float)sqrt(sumOfSquares / (double)frames) * 65535.0f + 0.5f : 0.0f;
+    EZAudioPeakFileValue value;
+    value.minimum = (int16_t)(low < -32768.0f ? -32768.0f : (low > 32767.0f ? 32767.0f : low));
+    value.maximum = (int16_t)(high < -32768.0f ? -32768.0f : (high > 32767.0f ? 32767.0f : high));
+    value.rms     = (uint16_t)(rms > 65535.0f ? 65535.0f : rms);
+    return value;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioPeakFileFlush(EZAudioPeakFile *peakFile)
+{
+    if (peakFile->stagedCount == 0)
+    {
+        return;
+    }
+    uint64_t offset = EZAudioPeakFileHeaderSize + peakFile->levels[0].count * peakFile->rowBytes;
+    if (EZAudioPeakFileWriteAt(peakFile, offset, peakFile->staged, (size_t)peakFile->stagedCount * peakFile->rowBytes))
+    {
+        peakFile->levels[0].count += peakFile->stagedCount;
+    }
+    peakFile->stagedCount = 0;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioPeakFileAppend(EZAudioPeakFile *peakFile, uint32_t level, const EZAudioPeakFileValue *values)
+{
+    if (level == 0)
+    {
+        if (peakFile->stagedCount == EZ_AUDIO_PEAK_FILE_STAGED_BLOCKS)
+        {
+            EZAudioPeakFileFlush(peakFile);
+        }
+        EZAudioPeakFileEncode(values, peakFile->channels, peakFile->staged + (size_t)peakFile->stagedCount * peakFile->rowBytes);
+        peakFile->stagedCount++;
+        return true;
+    }
+
+    EZAudioPeakFileLevel *peakLevel = &peakFile->levels[level];
+    if (peakLevel->count == peakLevel->capacity)
+    {
+        uint64_t capacity = peakLevel->capacity ? peakLevel->capacity * 2 : 256;
+        EZAudioPeakFileValue *values = (EZAudioPeakFileValue *)realloc(peakLevel->values, (size_t)(capacity * peakFile->channels * sizeof(EZAudioPeakFileValue)));
+        if (!values)
+        {
+            peakFile->failed = true;
+            return false;
+        }
+        peakLevel->values   = values;
+        peakLevel->capacity = capacity;
+    }
+    memcpy(peakLevel->values + peakLevel->count * peakFile->channels, values, peakFile->channels * sizeof(EZAudioPeakFileValue));
+    peakLevel->count++;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioPeakFileEmit(EZAudioPeakFile *peakFile, uint32_t level);
+
+// adds a finished block of the level below to a level's current block
+static void EZAudioPeakFileAccumulate(EZAudioPeakFile *peakFile,
+                                      uint32_t level,
+                                      const float *minimum,
+                                      const float *maximum,
+                                      const double *sumOfSquares,
+                                      uint64_t frames)
+{
+    if (level >= EZ_AUDIO_PEAK_FILE_MAX_LEVELS)
+    {
+        return;
+    }
+    EZAudioPeakFileAccumulator *accumulator = &peakFile->accumulators[level];
+    for (uint32_t channel = 0; channel < peakFile->channels; channel++)
+    {
+        accumulator->minimum[channel]       = minimum[channel] < accumulator->minimum[channel] ? minimum[channel] : accumulator->minimum[channel];
+        accumulator->maximum[channel]       = maximum[channel] > accumulator->maximum[channel] ? maximum[channel] : accumulator->maximum[channel];
+        accumulator->sumOfSquares[channel] += sumOfSquares[channel];
+    }
+    accumulator->frames += frames;
+    accumulator->blocks++;
+    if (accumulator->blocks == EZ_AUDIO_PEAK_FILE_LEVEL_FACTOR)
+    {
+        EZAudioPeakFileEmit(peakFile, level);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// finishes a level's current block and passes it up to the next level
+static void EZAudioPeakFileEmit(EZAudioPeakFile *peakFile, uint32_t level)
+{
+    EZAudioPeakFileAccumulator *accumulator = &peakFile->accumulators[level];
+    for (uint32_t channel = 0; channel < peakFile->channels; channel++)
+    {
+        peakFile->block[channel] = EZAudioPeakFileQuantize(accumulator->minimum[channel],
+                                                           accumulator->maximum[channel],
+                                                           accumulator->sumOfSquares[channel],
+                                                           accumulator->frames);
+    }
+    EZAudioPeakFileAppend(peakFile, level, peakFile->block);
+    EZAudioPeakFileAccumulate(peakFile,
+                              level + 1,
+                              accumulator->minimum,
+                              accumulator->maximum,
+                              accumulator->sumOfSquares,
+                              accumulator->frames);
+    EZAudioPeakFileResetAccumulator(peakFile, level);
+}
+
+//------------------------------------------------------------------------------
+
+// writes out the partial blocks above the finest level until a level has a single block, which is the top
+static uint32_t EZAudioPeakFileFinishLevels(EZAudioPeakFile *peakFile)
+{
+    uint32_t level = 1;
+    for (; level < EZ_AUDIO_PEAK_FILE_MAX_LEVELS; level++)
+    {
+        if (peakFile->levels[level - 1].count <= 1)
+        {
+            break;
+        }
+        if (peakFile->accumulators[level].frames > 0)
+        {
+            EZAudioPeakFileEmit(peakFile, level);
+        }
+    }
+    return level;
+}
+
+//------------------------------------------------------------------------------
+
+// the extremes and the sum of squares of a channel's samples
+static void EZAudioPeakFileScan(const float *samples,
+                                uint32_t count,
+                                float *minimum,
+                                float *maximum,
+                                double *sumOfSquares)
+{
+    // four independent accumulators so the compiler vectorizes
+    float low0 = *minimum, low1 = *minimum, low2 = *minimum, low3 = *minimum;
+    float high0 = *maximum, high1 = *maximum, high2 = *maximum, high3 = *maximum;
+    float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        low0  = samples[i] < low0 ? samples[i] : low0;
+        low1  = samples[i + 1] < low1 ? samples[i + 1] : low1;
+        low2  = samples[i + 2] < low2 ? samples[i + 2] : low2;
+        low3  = samples[i + 3] < low3 ? samples[i + 3] : low3;
+        high0 = samples[i] > high0 ? samples[i] : high0;
+        high1 = samples[i + 1] > high1 ? samples[i + 1] : high1;
+        high2 = samples[i + 2] > high2 ? samples[i + 2] : high2;
+        high3 = samples[i + 3] > high3 ? samples[i + 3] : high3;
+        sum0 += samples[i] * samples[i];
+        sum1 += samples[i + 1] * samples[i + 1];
+        sum2 += samples[i + 2] * samples[i + 2];
+        sum3 += samples[i + 3] * samples[i + 3];
+    }
+    for (; i < count; i++)
+    {
+        low0  = samples[i] < low0 ? samples[i] : low0;
+        high0 = samples[i] > high0 ? samples[i] : high0;
+        sum0 += samples[i] * samples[i];
+    }
+    low0  = low1 < low0 ? low1 : low0;
+    low2  = low3 < low2 ? low3 : low2;
+    high0 = high1 > high0 ? high1 : high0;
+    high2 = high3 > high2 ? high3 : high2;
+    *minimum       = low2 < low0 ? low2 : low0;
+    *maximum       = high2 > high0 ? high2 : high0;
+    *sumOfSquares += (double)((sum0 + sum1) + (sum2 + sum3));
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+static EZAudioPeakFile *EZAudioPeakFileAllocate(uint32_t channels, uint32_t sampleRate, uint32_t blockFrames)
+{
+    EZAudioPeakFile *peakFile = (EZAudioPeakFile *)calloc(1, sizeof(EZAudioPeakFile));
+    if (!peakFile)
+    {
+        return NULL;
+    }
+    peakFile->fd          = -1;
+    peakFile->channels    = channels;
+    peakFile->sampleRate  = sampleRate;
+    peakFile->blockFrames = blockFrames;
+    peakFile->rowBytes    = channels * EZAudioPeakFileValueSize;
+    peakFile->accumulatorStorage  = (float *)malloc((size_t)channels * EZ_AUDIO_PEAK_FILE_MAX_LEVELS * 2 * sizeof(float));
+    peakFile->sumOfSquaresStorage = (double *)malloc((size_t)channels * EZ_AUDIO_PEAK_FILE_MAX_LEVELS * sizeof(double));
+    peakFile->block               = (EZAudioPeakFileValue *)malloc(channels * sizeof(EZAudioPeakFileValue));
+    peakFile->staged              = (uint8_t *)malloc((size_t)EZ_AUDIO_PEAK_FILE_STAGED_BLOCKS * peakFile->rowBytes);
+    if (!peakFile->accumulatorStorage || !peakFile->sumOfSquaresStorage || !peakFile->block || !peakFile->staged)
+    {
+        free(peakFile->accumulatorStorage);
+        free(peakFile->sumOfSquaresStorage);
+        free(peakFile->block);
+        free(peakFile->staged);
+        free(peakFile);
+        return NULL;
+    }
+    for (uint32_t level = 0; level < EZ_AUDIO_PEAK_FILE_MAX_LEVELS; level++)
+    {
+        peakFile->accumulators[level].minimum      = peakFile->accumulatorStorage + (size_t)level * channels * 2;
+        peakFile->accumulators[level].maximum      = peakFile->accumulators[level].minimum + channels;
+        peakFile->accumulators[level].sumOfSquares = peakFile->sumOfSquaresStorage + (size_t)level * channels;
+        EZAudioPeakFileResetAccumulator(peakFile, level);
+    }
+    pthread_mutex_init(&peakFile->lock, NULL);
+    return peakFile;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioPeakFileFree(EZAudioPeakFile *peakFile)
+{
+    for (uint32_t level = 0; level < EZ_AUDIO_PEAK_FILE_MAX_LEVELS; level++)
+    {
+        free(peakFile->levels[level].values);
+    }
+    pthread_mutex_destroy(&peakFile->lock);
+    free(peakFile->accumulatorStorage);
+    free(peakFile->sumOfSquaresStorage);
+    free(peakFile->block);
+    free(peakFile->staged);
+    free(peakFile);
+}
+
+//------------------------------------------------------------------------------
+
+EZAudioPeakFile *EZAudioPeakFileCreate(const char *path,
+                                       uint32_t channels,
+                                       double sampleRate,
+                                       uint32_t blockFrames)
+{
+    if (!path || channels == 0 || channels > UINT16_MAX || sampleRate <= 0.0 || blockFrames == 0)
+    {
+        return NULL;
+    }
+    EZAudioPeakFile *peakFile = EZAudioPeakFileAllocate(channels, (uint32_t)lround(sampleRate), blockFrames);
+    if (!peakFile)
+    {
+        return NULL;
+    }
+    peakFile->writable = true;
+    peakFile->fd       = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (peakFile->fd < 0 || !EZAudioPeakFileWriteHeader(peakFile, 0, 0, 0))
+    {
+        if (peakFile->fd >= 0)
+        {
+            close(peakFile->fd);
+        }
+        EZAudioPeakFileFree(peakFile);
+        return NULL;
+    }
+    return peakFile;
+}
+
+//------------------------------------------------------------------------------
+
+// a file whose writer never closed it only has its finest level, the rest is summarized again from that
+static bool EZAudioPeakFileRebuild(EZAudioPeakFile *peakFile)
+{
+    uint8_t              *bytes  = (uint8_t *)malloc((size_t)EZ_AUDIO_PEAK_FILE_REBUILD_BLOCKS * peakFile->rowBytes);
+    EZAudioPeakFileValue *values = (EZAudioPeakFileValue *)malloc(peakFile->channels * sizeof(EZAudioPeakFileValue));
+    float                *minimum      = (float *)malloc(peakFile->channels * sizeof(float));
+    float                *maximum      = (float *)malloc(peakFile->channels * sizeof(float));
+    double               *sumOfSquares = (double *)malloc(peakFile->channels * sizeof(double));
+    bool rebuilt = bytes && values && minimum && maximum && sumOfSquares;
+    uint64_t count = peakFile->levels[0].count;
+    for (uint64_t start = 0; rebuilt && start < count; start += EZ_AUDIO_PEAK_FILE_REBUILD_BLOCKS)
+    {
+        uint32_t blocks = count - start < EZ_AUDIO_PEAK_FILE_REBUILD_BLOCKS ? (uint32_t)(count - start) : EZ_AUDIO_PEAK_FILE_REBUILD_BLOCKS;
+        rebuilt = EZAudioPeakFileReadAt(peakFile->fd, EZAudioPeakFileHeaderSize + start * peakFile->rowBytes, bytes, (size_t)blocks * peakFile->rowBytes);
+        for (uint32_t block = 0; rebuilt && block < blocks; block++)
+        {
+            EZAudioPeakFileDecode(bytes + (size_t)block * peakFile->rowBytes, peakFile->channels, values);
+            for (uint32_t channel = 0; channel < peakFile->channels; channel++)
+            {
+                float rms = values[channel].rms / 65535.0f;
+                minimum[channel]      = values[channel].minimum / 32767.0f;
+                maximum[channel]      = values[channel].maximum / 32767.0f;
+                sumOfSquares[channel] = (double)rms * rms * peakFile->blockFrames;
+            }
+            EZAudioPeakFileAccumulate(peakFile, 1, minimum, maximum, sumOfSquares, peakFile->blockFrames);
+        }
+    }
+    if (rebuilt)
+    {
+        EZAudioPeakFileFinishLevels(peakFile);
+    }
+    free(bytes);
+    free(values);
+    free(minimum);
+    free(maximum);
+    free(sumOfSquares);
+    return rebuilt && !peakFile->failed;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioPeakFileReadTrailer(EZAudioPeakFile *peakFile, uint64_t trailerOffset, uint32_t levelCount)
+{
+    uint64_t offset = trailerOffset;
+    for (uint32_t level = 1; level < levelCount; level++)
+    {
+        EZAudioPeakFileLevel *peakLevel = &peakFile->levels[level];
+        uint64_t levelFrames = EZAudioPeakFileLevelFrames(peakFile, level);
+        uint64_t count       = (peakFile->frames + levelFrames - 1) / levelFrames;
+        size_t   length      = (size_t)(count * peakFile->rowBytes);
+        uint8_t  *bytes      = (uint8_t *)malloc(length);
+        peakLevel->values    = (EZAudioPeakFileValue *)malloc((size_t)(count * peakFile->channels * sizeof(EZAudioPeakFileValue)));
+        if (!bytes || !peakLevel->values || !EZAudioPeakFileReadAt(peakFile->fd, offset, bytes, length))
+        {
+            free(bytes);
+            return false;
+        }
+        EZAudioPeakFileDecode(bytes, (uint32_t)(count * peakFile->channels), peakLevel->values);
+        peakLevel->count    = count;
+        peakLevel->capacity = count;
+        offset += length;
+        free(bytes);
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+EZAudioPeakFile *EZAudioPeakFileOpen(const char *path)
+{
+    if (!path)
+    {
+        return NULL;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    uint8_t     header[EZAudioPeakFileHeaderSize];
+    struct stat status;
+    if (fstat(fd, &status) != 0 || !EZAudioPeakFileReadAt(fd, 0, header, sizeof(header)) ||
+        memcmp(header, EZAudioPeakFileMagic, 4) != 0 || EZAudioPeakFileGet32(header + 4) != EZAudioPeakFileVersion ||
+        EZAudioPeakFileGet32(header + 20) != EZ_AUDIO_PEAK_FILE_LEVEL_FACTOR)
+    {
+        close(fd);
+        return NULL;
+    }
+    uint32_t channels    = EZAudioPeakFileGet32(header + 8);
+    uint32_t blockFrames = EZAudioPeakFileGet32(header + 16);
+    EZAudioPeakFile *peakFile = channels > 0 && channels <= UINT16_MAX && blockFrames > 0 ? EZAudioPeakFileAllocate(channels, EZAudioPeakFileGet32(header + 12), blockFrames) : NULL;
+    if (!peakFile)
+    {
+        close(fd);
+        return NULL;
+    }
+    peakFile->fd = fd;
+
+    // a closed file says where its coarser levels are, otherwise whatever of the finest level reached the disk is used
+    uint64_t frames        = EZAudioPeakFileGet64(header + 24);
+    uint64_t trailerOffset = EZAudioPeakFileGet64(header + 32);
+    uint32_t levelCount    = EZAudioPeakFileGet32(header + 40);
+    uint64_t finestCount   = (frames + blockFrames - 1) / blockFrames;
+    bool     opened;
+    if (trailerOffset != 0 && levelCount > 0 && levelCount <= EZ_AUDIO_PEAK_FILE_MAX_LEVELS &&
+        trailerOffset == EZAudioPeakFileHeaderSize + finestCount * peakFile->rowBytes)
+    {
+        peakFile->frames          = frames;
+        peakFile->levels[0].count = finestCount;
+        opened = EZAudioPeakFileReadTrailer(peakFile, trailerOffset, levelCount);
+    }
+    else
+    {
+        uint64_t available = status.st_size > EZAudioPeakFileHeaderSize ? (uint64_t)status.st_size - EZAudioPeakFileHeaderSize : 0;
+        peakFile->levels[0].count = available / peakFile->rowBytes;
+        peakFile->frames          = peakFile->levels[0].count * blockFrames;
+        opened = EZAudioPeakFileRebuild(peakFile);
+    }
+    if (!opened)
+    {
+        close(fd);
+        EZAudioPeakFileFree(peakFile);
+        return NULL;
+    }
+    return peakFile;
+}
+
+//------------------------------------------------------------------------------
+
+bool EZAudioPeakFileClose(EZAudioPeakFile *peakFile)
+{
+    if (!peakFile)
+    {
+        return false;
+    }
+    if (!peakFile->writable)
+    {
+        close(peakFile->fd);
+        EZAudioPeakFileFree(peakFile);
+        return true;
+    }
+
+    pthread_mutex_lock(&peakFile->lock);
+    if (peakFile->accumulators[0].frames > 0)
+    {
+        EZAudioPeakFileEmit(peakFile, 0);
+    }
+    EZAudioPeakFileFlush(peakFile);
+    uint32_t levelCount = EZAudioPeakFileFinishLevels(peakFile);
+    pthread_mutex_unlock(&peakFile->lock);
+
+    // the coarser levels follow the finest one, and the header says where
+    uint64_t trailerOffset = EZAudioPeakFileHeaderSize + peakFile->levels[0].count * peakFile->rowBytes;
+    uint64_t offset        = trailerOffset;
+    uint8_t  *bytes        = (uint8_t *)malloc((size_t)EZ_AUDIO_PEAK_FILE_REBUILD_BLOCKS * peakFile->rowBytes);
+    bool     completed     = bytes != NULL;
+    for (uint32_t level = 1; completed && level < levelCount; level++)
+    {
+        EZAudioPeakFileLevel *peakLevel = &peakFile->levels[level];
+        for (uint64_t start = 0; completed && start < peakLevel->count; start += EZ_AUDIO_PEAK_FILE_REBUILD_BLOCKS)
+        {
+            uint32_t blocks = peakLevel->count - start < EZ_AUDIO_PEAK_FILE_REBUILD_BLOCKS ? (uint32_t)(peakLevel->count - start) : EZ_AUDIO_PEAK_FILE_REBUILD_BLOCKS;
+            EZAudioPeakFileEncode(peakLevel->values + start * peakFile->channels, blocks * peakFile->channels, bytes);
+            completed = EZAudioPeakFileWriteAt(peakFile, offset, bytes, (size_t)blocks * peakFile->rowBytes);
+            offset   += (uint64_t)blocks * peakFile->rowBytes;
+        }
+    }
+    free(bytes);
+    completed = completed && EZAudioPeakFileWriteHeader(peakFile, peakFile->frames, trailerOffset, levelCount);
+    completed = fsync(peakFile->fd) == 0 && completed;
+    completed = close(peakFile->fd) == 0 && completed;
+    completed = completed && !peakFile->failed;
+    EZAudioPeakFileFree(peakFile);
+    return completed;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Writing
+//------------------------------------------------------------------------------
+
+bool EZAudioPeakFileWrite(EZAudioPeakFile *peakFile,
+                          const float * const *source,
+                          uint32_t frames)
+{
+    if (!peakFile->writable || peakFile->failed)
+    {
+        return false;
+    }
+
+    // readers only wait for the summary of one batch, never for the audio thread
+    pthread_mutex_lock(&peakFile->lock);
+    EZAudioPeakFileAccumulator *accumulator = &peakFile->accumulators[0];
+    for (uint32_t offset = 0; offset < frames;)
+    {
+        uint32_t room  = peakFile->blockFrames - (uint32_t)accumulator->frames;
+        uint32_t count = frames - offset < room ? frames - offset : room;
+        for (uint32_t channel = 0; channel < peakFile->channels; channel++)
+        {
+            EZAudioPeakFileScan(source[channel] + offset,
+                                count,
+                                &accumulator->minimum[channel],
+                                &accumulator->maximum[channel],
+                                &accumulator->sumOfSquares[channel]);
+        }
+        accumulator->frames += count;
+        peakFile->frames    += count;
+        offset              += count;
+        if (accumulator->frames == peakFile->blockFrames)
+        {
+            EZAudioPeakFileEmit(peakFile, 0);
+        }
+    }
+    EZAudioPeakFileFlush(peakFile);
+    bool written = !peakFile->failed;
+    pthread_mutex_unlock(&peakFile->lock);
+    return written;
+}
+
+//------------------------------------------------------------------------------
+
+bool EZAudioPeakFileSync(EZAudioPeakFile *peakFile)
+{
+    if (!peakFile->writable)
+    {
+        return false;
+    }
+
+    // the blocks have to be on the disk before the header says they're there
+    if (fsync(peakFile->fd) != 0)
+    {
+        return false;
+    }
+    pthread_mutex_lock(&peakFile->lock);
+    uint64_t frames = peakFile->levels[0].count * peakFile->blockFrames;
+    pthread_mutex_unlock(&peakFile->lock);
+    return EZAudioPeakFileWriteHeader(peakFile, frames, 0, 0) && fsync(peakFile->fd) == 0;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Reading
+//------------------------------------------------------------------------------
+
+// a level's blocks as the extremes and the sum of squares they cover
+static void EZAudioPeakFileMergeValues(const EZAudioPeakFileValue *values,
+                                       uint32_t channels,
+                                       uint64_t frames,
+                                       float *minimum,
+                                       float *maximum,
+                                       double *sumOfSquares)
+{
+    for (uint32_t channel = 0; channel < channels; channel++)
+    {
+        float low  = values[channel].minimum / 32767.0f;
+        float high = values[channel].maximum / 32767.0f;
+        double rms = values[channel].rms / 65535.0;
+        minimum[channel]       = low < minimum[channel] ? low : minimum[channel];
+        maximum[channel]       = high > maximum[channel] ? high : maximum[channel];
+        sumOfSquares[channel] += rms * rms * (double)frames;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioPeakFileRead(EZAudioPeakFile *peakFile,
+                             uint64_t startFrame,
+                             uint64_t frames,
+                             uint32_t points,
+                             float *minimums,
+                             float *maximums,
+                             float *rms)
+{
+    uint32_t channels = peakFile->channels;
+    size_t   length   = (size_t)points * channels * sizeof(float);
+    if (minimums)
+    {
+        memset(minimums, 0, length);
+    }
+    if (maximums)
+    {
+        memset(maximums, 0, length);
+    }
+    if (rms)
+    {
+        memset(rms, 0, length);
+    }
+
+    pthread_mutex_lock(&peakFile->lock);
+    uint64_t readable = EZAudioPeakFileReadableFrames(peakFile);
+    if (points == 0 || startFrame >= readable)
+    {
+        pthread_mutex_unlock(&peakFile->lock);
+        return 0;
+    }
+    uint64_t span     = frames > 0 ? frames : readable - startFrame;
+    uint64_t endFrame = span < readable - startFrame ? startFrame + span : readable;
+    double   pointFrames = (double)span / (double)points;
+
+    // the coarsest level that still has a block or more per point
+    uint32_t level = 0;
+    while (level + 1 < EZ_AUDIO_PEAK_FILE_MAX_LEVELS && peakFile->levels[level + 1].count > 0 &&
+           (double)EZAudioPeakFileLevelFrames(peakFile, level + 1) <= pointFrames)
+    {
+        level++;
+    }
+    uint64_t levelFrames = EZAudioPeakFileLevelFrames(peakFile, level);
+    uint64_t count       = peakFile->levels[level].count;
+
+    // while recording, the frames past a coarser level's last block are summarized by the blocks still being filled above the finest level
+    uint64_t stored     = count * levelFrames < readable ? count * levelFrames : readable;
+    uint64_t tailFrames = readable - stored;
+    float    *tail      = (float *)malloc((size_t)channels * 2 * sizeof(float));
+    double   *tailSum   = (double *)calloc(channels, sizeof(double));
+    float    *minimum   = (float *)malloc((size_t)channels * 2 * sizeof(float));
+    double   *sum       = (double *)malloc(channels * sizeof(double));
+    uint64_t firstBlock = startFrame / levelFrames;
+    uint64_t lastBlock  = (endFrame + levelFrames - 1) / levelFrames;
+    lastBlock = lastBlock < count ? lastBlock : count;
+    EZAudioPeakFileValue *values = NULL;
+    uint8_t              *bytes  = NULL;
+    bool ready = tail && tailSum && minimum && sum;
+    if (ready && tailFrames > 0)
+    {
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            tail[channel]            = FLT_MAX;
+            tail[channels + channel] = -FLT_MAX;
+        }
+        for (uint32_t above = 1; above <= level; above++)
+        {
+            EZAudioPeakFileAccumulator *accumulator = &peakFile->accumulators[above];
+            for (uint32_t channel = 0; channel < channels; channel++)
+            {
+                tail[channel]            = accumulator->minimum[channel] < tail[channel] ? accumulator->minimum[channel] : tail[channel];
+                tail[channels + channel] = accumulator->maximum[channel] > tail[channels + channel] ? accumulator->maximum[channel] : tail[channels + channel];
+                tailSum[channel]        += accumulator->sumOfSquares[channel];
+            }
+        }
+    }
+    if (ready && level == 0 && lastBlock > firstBlock)
+    {
+        // the finest level is read from the file, only the blocks the points cover
+        size_t blocks = (size_t)(lastBlock - firstBlock);
+        bytes  = (uint8_t *)malloc(blocks * peakFile->rowBytes);
+        values = (EZAudioPeakFileValue *)malloc(blocks * channels * sizeof(EZAudioPeakFileValue));
+        ready  = bytes && values && EZAudioPeakFileReadAt(peakFile->fd, EZAudioPeakFileHeaderSize + firstBlock * peakFile->rowBytes, bytes, blocks * peakFile->rowBytes);
+        if (ready)
+        {
+            EZAudioPeakFileDecode(bytes, (uint32_t)(blocks * channels), values);
+        }
+    }
+    else if (ready && level > 0)
+    {
+        values = peakFile->levels[level].values + firstBlock * channels;
+    }
+
+    uint32_t covered = 0;
+    for (uint32_t point = 0; ready && point < points; point++)
+    {
+        uint64_t pointStart = startFrame + (uint64_t)(point * pointFrames);
+        uint64_t pointEnd   = startFrame + (uint64_t)((point + 1) * pointFrames);
+        if (pointStart >= endFrame)
+        {
+            break;
+        }
+        pointEnd = pointEnd > pointStart ? pointEnd : pointStart + 1;
+        pointEnd = pointEnd < endFrame ? pointEnd : endFrame;
+
+        float  *maximum      = minimum + channels;
+        uint64_t pointWeight = 0;
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            minimum[channel] = FLT_MAX;
+            maximum[channel] = -FLT_MAX;
+            sum[channel]     = 0.0;
+        }
+        uint64_t block     = pointStart / levelFrames;
+        uint64_t lastPoint = (pointEnd + levelFrames - 1) / levelFrames;
+        for (; block < lastPoint && block < count; block++)
+        {
+            uint64_t blockFrames = readable - block * levelFrames < levelFrames ? readable - block * levelFrames : levelFrames;
+            EZAudioPeakFileMergeValues(values + (block - firstBlock) * channels, channels, blockFrames, minimum, maximum, sum);
+            pointWeight += blockFrames;
+        }
+        if (pointEnd > stored && tailFrames > 0)
+        {
+            for (uint32_t channel = 0; channel < channels; channel++)
+            {
+                minimum[channel] = tail[channel] < minimum[channel] ? tail[channel] : minimum[channel];
+                maximum[channel] = tail[channels + channel] > maximum[channel] ? tail[channels + channel] : maximum[channel];
+                sum[channel]    += tailSum[channel];
+            }
+            pointWeight += tailFrames;
+        }
+        if (pointWeight == 0)
+        {
+            continue;
+        }
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            size_t index = (size_t)channel * points + point;
+            if (minimums)
+            {
+                minimums[index] = minimum[channel];
+            }
+            if (maximums)
+            {
+                maximums[index] = maximum[channel];
+            }
+            if (rms)
+            {
+                rms[index] = (float)sqrt(sum[channel] / (double)pointWeight);
+            }
+        }
+        covered = point + 1;
+    }
+    pthread_mutex_unlock(&peakFile->lock);
+
+    free(bytes);
+    if (level == 0)
+    {
+        free(values);
+    }
+    free(tail);
+    free(tailSum);
+    free(minimum);
+    free(sum);
+    return covered;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Properties
+//------------------------------------------------------------------------------
+
+uint64_t EZAudioPeakFileFrames(EZAudioPeakFile *peakFile)
+{
+    pthread_mutex_lock(&peakFile->lock);
+    uint64_t frames = EZAudioPeakFileReadableFrames(peakFile);
+    pthread_mutex_unlock(&peakFile->lock);
+    return frames;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioPeakFileChannels(const EZAudioPeakFile *peakFile)
+{
+    return peakFile->channels;
+}
+
+//------------------------------------------------------------------------------
+
+double EZAudioPeakFileSampleRate(const EZAudioPeakFile *peakFile)
+{
+    return peakFile->sampleRate;
+}
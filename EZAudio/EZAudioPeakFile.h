@@ -0,0 +1,163 @@
+//
+//  EZAudioPeakFile.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef EZAudioPeakFile_h
+#define EZAudioPeakFile_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioPeakFile
+//------------------------------------------------------------------------------
+
+/**
+ Builds a multi-resolution min/max/RMS summary (a peak file) of audio as it's written, so the waveform of a recording of any length can be drawn without reading its audio back. The finest level summarizes every block of frames (i.e. 256), and every coarser level summarizes 8 blocks of the level below it, so a waveform of any width is read from the level closest to its resolution and only ever merges a handful of blocks per point.
+
+ The finest level is appended to the file as the audio is written and each EZAudioPeakFileSync puts it on the disk, while the coarser levels (an eighth of the size together) are kept in memory and written after it when the file is closed. EZAudioPeakFileRead can be called from any thread while the file is still being written, i.e. to draw a recording's waveform live. A file that was never closed is still readable, its coarser levels are rebuilt from the finest one when it's opened.
+
+ Levels are stored as 16-bit values (a peak file is about 1% of the size of the 16-bit audio it summarizes, and samples past full scale are summarized as full scale), which is plenty for drawing. This is plain C on top of POSIX file I/O without any Core Audio dependencies, so peak files can be built and checked anywhere (i.e. on Linux). Writing has to happen on one thread at a time, reading is thread safe.
+ */
+typedef struct EZAudioPeakFile EZAudioPeakFile;
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+/**
+ Creates a peak file (replacing any file at the path) to summarize audio as it's written.
+ @param path        The file system path of the peak file to write.
+ @param channels    The number of channels.
+ @param sampleRate  The sample rate of the audio.
+ @param blockFrames The number of frames each value of the finest level summarizes, i.e. 256.
+ @return A new peak file or NULL if the file couldn't be created. Close it with EZAudioPeakFileClose.
+ */
+EZAudioPeakFile *EZAudioPeakFileCreate(const char *path,
+                                       uint32_t channels,
+                                       double sampleRate,
+                                       uint32_t blockFrames);
+
+//------------------------------------------------------------------------------
+
+/**
+ Opens an existing peak file for reading. A file whose writer never closed it is read up to the last block that reached the disk.
+ @param path The file system path of the peak file.
+ @return The peak file or NULL if it couldn't be read or isn't a peak file. Close it with EZAudioPeakFileClose.
+ */
+EZAudioPeakFile *EZAudioPeakFileOpen(const char *path);
+
+//------------------------------------------------------------------------------
+
+/**
+ Closes a peak file. A peak file being written gets its last, partial blocks and its coarser levels written first.
+ @param peakFile The peak file.
+ @return true if everything was written, false if any write failed along the way.
+ */
+bool EZAudioPeakFileClose(EZAudioPeakFile *peakFile);
+
+//------------------------------------------------------------------------------
+#pragma mark - Writing
+//------------------------------------------------------------------------------
+
+/**
+ Summarizes the next frames of the audio.
+ @param peakFile The peak file.
+ @param source   One float array per channel.
+ @param frames   The number of frames.
+ @return true if the finest level's new blocks were written, false if a write failed (the peak file stays failed).
+ */
+bool EZAudioPeakFileWrite(EZAudioPeakFile *peakFile,
+                          const float * const *source,
+                          uint32_t frames);
+
+//------------------------------------------------------------------------------
+
+/**
+ Pushes the finest level through to the disk and commits the number of frames it covers to the header.
+ @param peakFile The peak file.
+ @return true if the sync succeeded.
+ */
+bool EZAudioPeakFileSync(EZAudioPeakFile *peakFile);
+
+//------------------------------------------------------------------------------
+#pragma mark - Reading
+//------------------------------------------------------------------------------
+
+/**
+ Reads a waveform from the peak file, one minimum, maximum and RMS value per point and channel. Safe to call from any thread, including while the file is being written.
+ @param peakFile   The peak file.
+ @param startFrame The first frame of the waveform.
+ @param frames     The number of frames the waveform spans, or 0 for everything from the start frame on.
+ @param points     The number of points, i.e. the width of the plot in pixels.
+ @param minimums   Receives the lowest sample of each point, points values for each channel one after the other (i.e. channel 1's start at minimums[points]). May be NULL.
+ @param maximums   Receives the highest sample of each point, laid out the same way. May be NULL.
+ @param rms        Receives the RMS of each point, laid out the same way. May be NULL.
+ @return The number of points that cover audio, the others are zeroed. 0 if there's nothing to read yet.
+ */
+uint32_t EZAudioPeakFileRead(EZAudioPeakFile *peakFile,
+                             uint64_t startFrame,
+                             uint64_t frames,
+                             uint32_t points,
+                             float *minimums,
+                             float *maximums,
+                             float *rms);
+
+//------------------------------------------------------------------------------
+#pragma mark - Properties
+//------------------------------------------------------------------------------
+
+/**
+ Provides the number of frames that can be read, which lags the frames written by less than a block until the file is closed.
+ @param peakFile The peak file.
+ @return The number of frames.
+ */
+uint64_t EZAudioPeakFileFrames(EZAudioPeakFile *peakFile);
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides the number of channels the peak file summarizes.
+ @param peakFile The peak file.
+ @return The number of channels.
+ */
+uint32_t EZAudioPeakFileChannels(const EZAudioPeakFile *peakFile);
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides the sample rate of the audio the peak file summarizes.
+ @param peakFile The peak file.
+ @return The sample rate.
+ */
+double EZAudioPeakFileSampleRate(const EZAudioPeakFile *peakFile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -105,10 +105,21 @@
 @property (nonatomic,assign) id<EZAudioPlayerDelegate> audioPlayerDelegate;
 
 /**
- A BOOL indicating whether the player should loop the file
+ A BOOL indicating whether the player should loop the file, or the loop region if one was set with `setLoopRegionWithStartFrame:endFrame:`. The wrap is sample accurate and the start of the loop is kept decoded in memory so it never waits on the disk.
  */
 @property (nonatomic,assign) BOOL shouldLoop;
 
+/**
+ The playback speed, from 0.25 to 4.0. Default is 1.0. Any other speed is played through an EZAudioTimeStretcher so the pitch stays the same (i.e. to review a long recording at 2x). Safe to change while playing, the new speed takes effect within a few milliseconds.
+ @warning The file's client format (the output's, or the mixer's `sourceFormat`) must be packed native endian float or 16-bit integer linear PCM to play at any speed other than 1.0.
+ */
+@property (nonatomic,assign) float rate;
+
+/**
+ The EZAudioTimeStretcherQuality used when the rate isn't 1.0, trading CPU for fewer artifacts. Default is EZAudioTimeStretcherQualityMedium.
+ */
+@property (nonatomic,assign) EZAudioTimeStretcherQuality timeStretchQuality;
+
 #pragma mark - Initializers
 ///-----------------------------------------------------------
 /// @name Initializers
@@ -224,6 +235,24 @@
  */
 -(SInt64)frameIndex;
 
+/**
+ Provides the number of frames the player has rendered since it was created, counting silence while paused. This is the clock `seekToFrame:atSampleTime:` is scheduled against.
+ @return An SInt64 representing the player's render sample time.
+ */
+-(SInt64)sampleTime;
+
+/**
+ Provides the first frame of the loop region.
+ @return An SInt64 representing the loop-in frame, or 0 if no loop region was set.
+ */
+-(SInt64)loopStartFrame;
+
+/**
+ Provides the frame just past the end of the loop region.
+ @return An SInt64 representing the loop-out frame, or 0 if no loop region was set.
+ */
+-(SInt64)loopEndFrame;
+
 /**
  Provides a flag indicating whether the EZAudioPlayer is currently playing back any audio.
  @return A BOOL indicating whether or not the EZAudioPlayer is performing playback,
@@ -236,6 +265,12 @@
  */
 -(EZOutput*)output;
 
+/**
+ Provides the EZAudioMixer the player is playing through, if any.
+ @return The EZAudioMixer instance the player was added to with `setMixer:`, or nil if the player drives its output directly.
+ */
+-(EZAudioMixer*)mixer;
+
 /**
  Provides the total duration of the current audio file being used for playback (in seconds).
  @return A float representing the total duration of the current audio file being used for playback in seconds.
@@ -271,30 +306,62 @@
  */
 -(void)setOutput:(EZOutput*)output;
 
+/**
+ Sets an EZAudioMixer to play through instead of owning the output's data source, so several players can play at once on the same output. The player switches to the mixer's output (handing that output back to the mixer), reads its file in the mixer's `sourceFormat`, and then `play` adds it to the mixer while `pause` and `stop` remove it. Pass nil to go back to driving the mixer's output directly.
+ @param mixer The EZAudioMixer to play through (i.e. [EZAudioMixer sharedMixer]), or nil.
+ */
+-(void)setMixer:(EZAudioMixer*)mixer;
+
+#pragma mark - Looping
+///-----------------------------------------------------------
+/// @name Setting The Loop Region
+///-----------------------------------------------------------
+
+/**
+ Sets the region looped while `shouldLoop` is YES. Playback runs up to the end frame and carries on from the start frame within the same buffer, the first 0.5 seconds of the region are decoded up front so the wrap plays from memory while the rest of the region is already queued up on a second reader. Playback before the start frame plays through into the region as usual. The region is cleared when a new audio file is set.
+ @param startFrame The first frame of the region (the loop-in point) in the client format's frames.
+ @param endFrame   The frame just past the end of the region (the loop-out point), clamped to the file's length.
+ */
+-(void)setLoopRegionWithStartFrame:(SInt64)startFrame endFrame:(SInt64)endFrame;
+
+/**
+ Clears the loop region so `shouldLoop` loops the whole file again.
+ */
+-(void)clearLoopRegion;
+
 #pragma mark - Methods
 ///-----------------------------------------------------------
 /// @name Play/Pause/Seeking the Player
 ///-----------------------------------------------------------
 
 /**
- Starts or resumes playback.
+ Starts or resumes playback, fading in over a few milliseconds.
+
+ Like the rest of the transport methods this only queues the change, the audio thread applies it at the start of its next buffer so it never races a read of the file. Safe to call from any thread.
  */
 -(void)play;
 
 /**
- Pauses playback.
+ Pauses playback. The audio thread fades out over a few milliseconds before the output is stopped.
  */
 -(void)pause;
 
 /**
- Stops playback.
+ Stops playback and rewinds to the start of the file, fading out first like `pause`.
  */
 -(void)stop;
 
 /**
- Seeks playback to a specified frame within the internal EZAudioFile. This will notify the EZAudioFileDelegate (if specified) with the audioPlayer:updatedPosition:inAudioFile: function.
+ Seeks playback to a specified frame within the internal EZAudioFile. While playing the audio thread fades out, seeks and fades back in, so `frameIndex` reports the new position a buffer later. This will notify the EZAudioFileDelegate (if specified) with the audioPlayer:updatedPosition:inAudioFile: function.
  @param frame The new frame position to seek to as a SInt64.
  */
 -(void)seekToFrame:(SInt64)frame;
 
+/**
+ Seeks playback to a specified frame once the player's `sampleTime` reaches a given time, i.e. to jump between sections in time with the music. The fade out starts at exactly that sample, in the middle of a buffer if need be. Changes queued after this one wait for it.
+ @param frame      The new frame position to seek to as a SInt64.
+ @param sampleTime The `sampleTime` at which the seek starts, or a time already passed to seek right away.
+ */
+-(void)seekToFrame:(SInt64)frame atSampleTime:(SInt64)sampleTime;
+
 @end
@@ -28,19 +28,146 @@
 #if TARGET_OS_IPHONE
 #elif TARGET_OS_MAC
 #endif
+
+// The most frames read from the file or stretched at once
+static const UInt32 EZAudioPlayerMaximumFrames = 4096;
+
+// How much of the loop region is kept decoded in memory, this is the time the spare readers have to seek
+static const NSTimeInterval EZAudioPlayerLoopHeadDuration = 0.5;
+
+// The length of the fades around a pause, stop or seek so they don't click
+static const NSTimeInterval EZAudioPlayerDeclickDuration = 0.005;
+
+// The most transport changes that can wait for the audio thread
+static const UInt32 EZAudioPlayerMaximumCommands = 256;
+
+// Everything the audio thread needs to play at a rate other than 1x, swapped as a whole
+typedef struct {
+  EZAudioTimeStretcher   *stretcher;
+  const EZAudioDSPKernel *kernel;
+  AudioBufferList        *readBufferList;
+  UInt32                 bytesPerFrame;
+  UInt32                 channels;
+  float                  **input;
+  float                  **output;
+  BOOL                   flushed;
+} EZAudioPlayerTimeStretch;
+
+// Everything the audio thread needs to render part of a buffer and fade it, swapped as a whole
+typedef struct {
+  const EZAudioDSPKernel *kernel;
+  UInt32                 channels;
+  UInt32                 bytesPerFrame;
+  UInt32                 rampFrames;
+  float                  **buffers;
+  AudioBufferList        *segmentBufferList;
+} EZAudioPlayerDeclick;
+
+// A transport change queued for the audio thread
+typedef enum {
+  EZAudioPlayerCommandPlay,
+  EZAudioPlayerCommandPause,
+  EZAudioPlayerCommandStop,
+  EZAudioPlayerCommandSeek
+} EZAudioPlayerCommandType;
+
+typedef struct {
+  EZAudioPlayerCommandType type;
+  SInt64                   frame;
+  SInt64                   sampleTime;
+} EZAudioPlayerCommand;
+
+// A slot in the command queue, its sequence is the write index it's free for or one past the index it was written at
+typedef struct {
+  volatile int64_t     sequence;
+  EZAudioPlayerCommand command;
+} EZAudioPlayerCommandSlot;
+
+// Who owns each of the loop's spare readers
+enum {
+  EZAudioPlayerLoopReaderInUse = 0, // the audio thread is reading from it
+  EZAudioPlayerLoopReaderIdle  = 1, // waiting for the loop queue to seek it back to the end of the head
+  EZAudioPlayerLoopReaderArmed = 2  // seeked and ready for the audio thread to take at the next wrap
+};
+
+// The loop region and its predecoded head, swapped as a whole
+typedef struct {
+  SInt64           startFrame;
+  SInt64           endFrame;
+  AudioBufferList  *head;
+  UInt32           headFrames;
+  UInt32           headPosition;
+  BOOL             inHead;
+  AudioBufferList  *readBufferList;
+  UInt32           bytesPerFrame;
+  const void       *readers[2];
+  volatile int32_t readerStates[2];
+  int              reader;
+} EZAudioPlayerLoop;
+
+// Silence is all zero bytes in every linear PCM format the player reads
+static void EZAudioPlayerClear(AudioBufferList *audioBufferList,UInt32 offset,UInt32 frames,UInt32 bytesPerFrame) {
+  for( UInt32 i = 0; i < audioBufferList->mNumberBuffers; i++ ){
+    memset((char*)audioBufferList->mBuffers[i].mData + offset*bytesPerFrame,0,frames*bytesPerFrame);
+  }
+}
+
 @interface EZAudioPlayer () <EZAudioFileDelegate,EZOutputDataSource>
 {
   BOOL _eof;
+  EZAudioPlayerTimeStretch *volatile _timeStretch;
+  EZAudioPlayerLoop        *volatile _loop;
+  dispatch_queue_t                   _loopQueue;
+  dispatch_source_t                  _loopSource;
+  SInt64                             _loopStartFrame;
+  SInt64                             _loopEndFrame;
+  volatile SInt64                    _frameIndex;
+  volatile int64_t                   _renderEpoch;
+  
+  // Transport changes, any number of callers claim slots without locking and only the holder of the consumer flag applies them
+  EZAudioPlayerCommandSlot           *_commands;
+  volatile int64_t                   _commandWriteIndex;
+  int64_t                            _commandReadIndex;
+  volatile int32_t                   _commandConsumer;
+  dispatch_source_t                  _transportSource;
+  EZAudioPlayerDeclick *volatile     _declick;
+  
+  // Every start and stop of the output runs on this queue, so a stop checks for a newer play right before it stops
+  dispatch_queue_t                   _outputQueue;
+  volatile BOOL                      _playRequested;
+  
+  // Owned by whoever holds the consumer flag
+  volatile SInt64                    _sampleTime;
+  BOOL                               _playing;
+  float                              _gain;
+  float                              _gainTarget;
+  UInt32                             _rampFramesLeft;
+  EZAudioPlayerCommand               _pendingCommand;
+  BOOL                               _hasPendingCommand;
 }
 @property (nonatomic,strong,setter=setAudioFile:) EZAudioFile *audioFile;
 @property (nonatomic,strong,setter=setOutput:)    EZOutput    *output;
+@property (nonatomic,strong,setter=setMixer:)     EZAudioMixer *mixer;
 @end
 
 @implementation EZAudioPlayer
 @synthesize audioFile = _audioFile;
 @synthesize audioPlayerDelegate = _audioPlayerDelegate;
 @synthesize output = _output;
+@synthesize mixer = _mixer;
 @synthesize shouldLoop = _shouldLoop;
+@synthesize rate = _rate;
+@synthesize timeStretchQuality = _timeStretchQuality;
+
+#pragma mark - Dealloc
+-(void)dealloc {
+  [self _publishTimeStretch:NULL];
+  [self _publishLoop:NULL];
+  [self _publishDeclick:NULL];
+  dispatch_source_cancel(_loopSource);
+  dispatch_source_cancel(_transportSource);
+  free(_commands);
+}
 
 #pragma mark - Initializers
 -(id)init {
@@ -117,7 +244,30 @@
 -(void)_configureAudioPlayer {
   
   // Defaults
-  self.output = [EZOutput sharedOutput];
+  _rate               = 1.0f;
+  _timeStretchQuality = EZAudioTimeStretcherQualityMedium;
+  self.output         = [EZOutput sharedOutput];
+  
+  // Seeks the loop's spare readers off the audio thread
+  __weak EZAudioPlayer *weakSelf = self;
+  _loopQueue  = dispatch_queue_create("com.ezaudio.player.loop",DISPATCH_QUEUE_SERIAL);
+  _loopSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_OR,0,0,_loopQueue);
+  dispatch_source_set_event_handler(_loopSource,^{
+    [weakSelf _armLoopReaders];
+  });
+  dispatch_resume(_loopSource);
+  
+  // Transport changes are queued for the audio thread, which asks for the output to be stopped once a pause or a stop has faded out
+  _commands = (EZAudioPlayerCommandSlot*)calloc(EZAudioPlayerMaximumCommands,sizeof(EZAudioPlayerCommandSlot));
+  for( UInt32 i = 0; i < EZAudioPlayerMaximumCommands; i++ ){
+    _commands[i].sequence = i;
+  }
+  _outputQueue     = dispatch_queue_create("com.ezaudio.player.output",DISPATCH_QUEUE_SERIAL);
+  _transportSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_OR,0,0,_outputQueue);
+  dispatch_source_set_event_handler(_transportSource,^{
+    [weakSelf _stopOutputIfPaused];
+  });
+  dispatch_resume(_transportSource);
   
 #if TARGET_OS_IPHONE
   // Configure the AVSession
@@ -136,6 +286,225 @@
   
 }
 
+-(void)_configureTimeStretch {
+  // Only needed once the rate has left 1x, after that the stretcher stays in the path so changing speed doesn't jump
+  if( !_audioFile || (_rate == 1.0f && !_timeStretch) ){
+    return;
+  }
+  AudioStreamBasicDescription clientFormat = _audioFile.clientFormat;
+  const EZAudioDSPKernel *kernel = EZAudioDSPKernelForFormat(clientFormat);
+  NSAssert(kernel,@"The player's client format must be packed native endian float or 16-bit integer linear PCM to play at any rate other than 1x");
+  if( !kernel ){
+    return;
+  }
+  
+  EZAudioTimeStretcher *stretcher = EZAudioTimeStretcherCreate(clientFormat.mChannelsPerFrame,clientFormat.mSampleRate,_timeStretchQuality);
+  if( !stretcher ){
+    NSLog(@"Failed to create a time stretcher for the player's client format");
+    return;
+  }
+  
+  EZAudioPlayerTimeStretch *timeStretch = (EZAudioPlayerTimeStretch*)calloc(1,sizeof(EZAudioPlayerTimeStretch));
+  timeStretch->channels      = clientFormat.mChannelsPerFrame;
+  timeStretch->kernel        = kernel;
+  timeStretch->stretcher     = stretcher;
+  timeStretch->input         = [EZAudio floatBuffersWithNumberOfFrames:EZAudioPlayerMaximumFrames numberOfChannels:timeStretch->channels];
+  timeStretch->output        = [EZAudio floatBuffersWithNumberOfFrames:EZAudioPlayerMaximumFrames numberOfChannels:timeStretch->channels];
+  timeStretch->bytesPerFrame = clientFormat.mBytesPerFrame;
+  EZAudioTimeStretcherSetRate(timeStretch->stretcher,_rate);
+  
+  // The file is read in its client format and converted to float for the stretcher
+  timeStretch->readBufferList = [self _audioBufferListWithFormat:clientFormat numberOfFrames:EZAudioPlayerMaximumFrames];
+  
+  [self _publishTimeStretch:timeStretch];
+}
+
+-(AudioBufferList*)_audioBufferListWithFormat:(AudioStreamBasicDescription)format numberOfFrames:(UInt32)frames {
+  // With no frames this is just a shell to point at someone else's buffers
+  BOOL   interleaved = !(format.mFormatFlags & kAudioFormatFlagIsNonInterleaved);
+  UInt32 buffers     = interleaved ? 1 : format.mChannelsPerFrame;
+  AudioBufferList *audioBufferList = (AudioBufferList*)malloc(offsetof(AudioBufferList,mBuffers[0]) + sizeof(AudioBuffer)*buffers);
+  audioBufferList->mNumberBuffers = buffers;
+  for( UInt32 i = 0; i < buffers; i++ ){
+    audioBufferList->mBuffers[i].mNumberChannels = interleaved ? format.mChannelsPerFrame : 1;
+    audioBufferList->mBuffers[i].mDataByteSize   = frames*format.mBytesPerFrame;
+    audioBufferList->mBuffers[i].mData           = frames ? malloc(frames*format.mBytesPerFrame) : NULL;
+  }
+  return audioBufferList;
+}
+
+-(void)_waitForRender {
+  // A render running right now (odd epoch) may still be using whatever was just replaced
+  int64_t epoch = _renderEpoch;
+  while( (epoch & 1) && _renderEpoch == epoch ){
+    usleep(1000);
+  }
+}
+
+-(void)_publishTimeStretch:(EZAudioPlayerTimeStretch*)timeStretch {
+  EZAudioPlayerTimeStretch *previous = _timeStretch;
+  OSMemoryBarrier();
+  _timeStretch = timeStretch;
+  OSMemoryBarrier();
+  if( !previous ){
+    return;
+  }
+  [self _waitForRender];
+  EZAudioTimeStretcherFree(previous->stretcher);
+  [EZAudio freeFloatBuffers:previous->input numberOfChannels:previous->channels];
+  [EZAudio freeFloatBuffers:previous->output numberOfChannels:previous->channels];
+  [EZAudio freeBufferList:previous->readBufferList];
+  free(previous);
+}
+
+-(void)_configureDeclick {
+  AudioStreamBasicDescription clientFormat = _audioFile.clientFormat;
+  EZAudioPlayerDeclick *declick = (EZAudioPlayerDeclick*)calloc(1,sizeof(EZAudioPlayerDeclick));
+  declick->kernel            = EZAudioDSPKernelForFormat(clientFormat);
+  declick->channels          = clientFormat.mChannelsPerFrame;
+  declick->bytesPerFrame     = clientFormat.mBytesPerFrame;
+  declick->rampFrames        = MAX((UInt32)(EZAudioPlayerDeclickDuration*clientFormat.mSampleRate),1);
+  declick->segmentBufferList = [self _audioBufferListWithFormat:clientFormat numberOfFrames:0];
+  if( declick->kernel ){
+    // Other formats can't be faded so they switch immediately
+    declick->buffers = [EZAudio floatBuffersWithNumberOfFrames:EZAudioPlayerMaximumFrames numberOfChannels:declick->channels];
+  }
+  [self _publishDeclick:declick];
+}
+
+-(void)_publishDeclick:(EZAudioPlayerDeclick*)declick {
+  EZAudioPlayerDeclick *previous = _declick;
+  OSMemoryBarrier();
+  _declick = declick;
+  OSMemoryBarrier();
+  if( !previous ){
+    return;
+  }
+  [self _waitForRender];
+  if( previous->buffers ){
+    [EZAudio freeFloatBuffers:previous->buffers numberOfChannels:previous->channels];
+  }
+  free(previous->segmentBufferList);
+  free(previous);
+}
+
+-(void)_configureLoop {
+  EZAudioPlayerLoop *previous = _loop;
+  EZAudioPlayerLoop *loop     = NULL;
+  if( _audioFile && _shouldLoop ){
+    // Without a region the whole file loops
+    SInt64 totalFrames = _audioFile.totalClientFrames;
+    BOOL   hasRegion   = _loopEndFrame > _loopStartFrame;
+    SInt64 startFrame  = hasRegion ? MIN(_loopStartFrame,totalFrames) : 0;
+    SInt64 endFrame    = hasRegion ? MIN(_loopEndFrame,totalFrames) : totalFrames;
+    if( endFrame > startFrame ){
+      loop = [self _loopWithStartFrame:startFrame endFrame:endFrame];
+    }
+  }
+  [self _publishLoop:loop];
+  
+  // The previous loop may have left off in one of its own readers, pick up from there in the file
+  if( previous && _audioFile ){
+    [self seekToFrame:_frameIndex];
+  }
+}
+
+-(EZAudioPlayerLoop*)_loopWithStartFrame:(SInt64)startFrame endFrame:(SInt64)endFrame {
+  // The head and both spare readers come from separate instances so the audio thread's file is never touched here
+  AudioStreamBasicDescription clientFormat = _audioFile.clientFormat;
+  EZAudioFile *readers[2];
+  for( int i = 0; i < 2; i++ ){
+    readers[i] = [EZAudioFile audioFileWithURL:_audioFile.url];
+    [readers[i] setClientFormat:clientFormat];
+    [readers[i] seekToFrame:startFrame];
+  }
+  
+  EZAudioPlayerLoop *loop = (EZAudioPlayerLoop*)calloc(1,sizeof(EZAudioPlayerLoop));
+  loop->startFrame     = startFrame;
+  loop->endFrame       = endFrame;
+  loop->bytesPerFrame  = clientFormat.mBytesPerFrame;
+  loop->headFrames     = (UInt32)MIN(endFrame - startFrame,(SInt64)(EZAudioPlayerLoopHeadDuration*clientFormat.mSampleRate));
+  loop->head           = [self _audioBufferListWithFormat:clientFormat numberOfFrames:loop->headFrames];
+  loop->readBufferList = [self _audioBufferListWithFormat:clientFormat numberOfFrames:0];
+  loop->reader         = -1;
+  
+  // Decode the head, which leaves the first reader just past it
+  UInt32 decoded = 0;
+  while( decoded < loop->headFrames ){
+    for( UInt32 i = 0; i < loop->head->mNumberBuffers; i++ ){
+      loop->readBufferList->mBuffers[i].mData         = (char*)loop->head->mBuffers[i].mData + decoded*loop->bytesPerFrame;
+      loop->readBufferList->mBuffers[i].mDataByteSize = (loop->headFrames - decoded)*loop->bytesPerFrame;
+    }
+    UInt32 bufferSize = 0;
+    BOOL   eof        = NO;
+    [readers[0] readFrames:loop->headFrames - decoded
+           audioBufferList:loop->readBufferList
+                bufferSize:&bufferSize
+                       eof:&eof];
+    if( bufferSize == 0 ){
+      break;
+    }
+    decoded += bufferSize;
+  }
+  if( decoded < loop->headFrames ){
+    // The file is shorter than it claimed, the loop ends where it does
+    loop->headFrames = decoded;
+    loop->endFrame   = startFrame + decoded;
+  }
+  [readers[1] seekToFrame:startFrame + loop->headFrames];
+  
+  for( int i = 0; i < 2; i++ ){
+    loop->readers[i]      = CFBridgingRetain(readers[i]);
+    loop->readerStates[i] = EZAudioPlayerLoopReaderArmed;
+  }
+  if( loop->headFrames == 0 ){
+    [EZAudioPlayer _freeLoop:loop];
+    return NULL;
+  }
+  return loop;
+}
+
+-(void)_publishLoop:(EZAudioPlayerLoop*)loop {
+  EZAudioPlayerLoop *previous = _loop;
+  OSMemoryBarrier();
+  _loop = loop;
+  OSMemoryBarrier();
+  if( !previous ){
+    return;
+  }
+  [self _waitForRender];
+  
+  // Running it on the loop queue waits out a re-seek of its readers already under way
+  dispatch_sync(_loopQueue,^{
+    [EZAudioPlayer _freeLoop:previous];
+  });
+}
+
++(void)_freeLoop:(EZAudioPlayerLoop*)loop {
+  for( int i = 0; i < 2; i++ ){
+    if( loop->readers[i] ){
+      CFBridgingRelease(loop->readers[i]);
+    }
+  }
+  [EZAudio freeBufferList:loop->head];
+  free(loop->readBufferList);
+  free(loop);
+}
+
+-(void)_armLoopReaders {
+  // Runs on the loop queue, which the loop is only ever freed on
+  EZAudioPlayerLoop *loop = _loop;
+  if( !loop ){
+    return;
+  }
+  for( int i = 0; i < 2; i++ ){
+    if( loop->readerStates[i] == EZAudioPlayerLoopReaderIdle ){
+      [(__bridge EZAudioFile*)loop->readers[i] seekToFrame:loop->startFrame + loop->headFrames];
+      OSAtomicCompareAndSwap32Barrier(EZAudioPlayerLoopReaderIdle,EZAudioPlayerLoopReaderArmed,&loop->readerStates[i]);
+    }
+  }
+}
+
 #pragma mark - Getters
 -(EZAudioFile*)audioFile {
   return _audioFile;
@@ -143,7 +512,7 @@
 
 -(float)currentTime {
   NSAssert(_audioFile,@"No audio file to perform the seek on, check that EZAudioFile is not nil");
-  return [EZAudio MAP:self.audioFile.frameIndex
+  return [EZAudio MAP:self.frameIndex
               leftMin:0
               leftMax:self.audioFile.totalFrames
              rightMin:0
@@ -156,11 +525,27 @@
 
 -(SInt64)frameIndex {
   NSAssert(_audioFile,@"No audio file to perform the seek on, check that EZAudioFile is not nil");
-  return _audioFile.frameIndex;
+  // Tracked by the audio thread since a loop may be playing from memory or one of its own readers
+  return _frameIndex;
+}
+
+-(SInt64)loopStartFrame {
+  return _loopStartFrame;
+}
+
+-(SInt64)loopEndFrame {
+  return _loopEndFrame;
 }
 
 -(BOOL)isPlaying {
-  return self.output.isPlaying;
+  if( _mixer ){
+    return _playRequested && self.output.isPlaying && [_mixer containsSource:self];
+  }
+  return _playRequested && self.output.isPlaying;
+}
+
+-(SInt64)sampleTime {
+  return _sampleTime;
 }
 
 -(EZOutput*)output {
@@ -168,6 +553,10 @@
   return _output;
 }
 
+-(EZAudioMixer*)mixer {
+  return _mixer;
+}
+
 -(float)totalDuration {
   NSAssert(_audioFile,@"No audio file to perform the seek on, check that EZAudioFile is not nil");
   return _audioFile.totalDuration;
@@ -188,10 +577,24 @@
   if( _audioFile ){
     _audioFile.audioFileDelegate = nil;
   }
-  _eof       = NO;
-  _audioFile = [EZAudioFile audioFileWithURL:audioFile.url andDelegate:self];
+  // A loop region belongs to the file it was set on
+  [self _publishLoop:NULL];
+  _loopStartFrame = 0;
+  _loopEndFrame   = 0;
+  _eof            = NO;
+  _frameIndex     = 0;
+  _audioFile      = [EZAudioFile audioFileWithURL:audioFile.url andDelegate:self];
   NSAssert(_output,@"No output was found, this should by default be the EZOutput shared instance");
-  [_output setAudioStreamBasicDescription:self.audioFile.clientFormat];    
+  if( _mixer ){
+    // The mixer's output plays other sources too so the file has to match the mixer instead
+    [_audioFile setClientFormat:_mixer.sourceFormat];
+  }
+  else {
+    [_output setAudioStreamBasicDescription:self.audioFile.clientFormat];
+  }
+  [self _configureDeclick];
+  [self _configureTimeStretch];
+  [self _configureLoop];
 }
 
 -(void)setOutput:(EZOutput*)output {
@@ -199,14 +602,92 @@
   _output.outputDataSource = self;
 }
 
+-(void)setMixer:(EZAudioMixer*)mixer {
+  if( _mixer == mixer ){
+    return;
+  }
+  [_mixer removeSource:self];
+  _mixer = mixer;
+  if( _mixer ){
+    // Play on the mixer's output without taking it over
+    _output                  = _mixer.output;
+    _output.outputDataSource = _mixer;
+    if( _audioFile ){
+      [_audioFile setClientFormat:_mixer.sourceFormat];
+    }
+  }
+  else if( _output ){
+    self.output = _output;
+    if( _audioFile ){
+      [_output setAudioStreamBasicDescription:_audioFile.clientFormat];
+    }
+  }
+  if( _audioFile ){
+    [self _configureDeclick];
+  }
+  [self _configureTimeStretch];
+  // The head was decoded in the previous client format
+  [self _configureLoop];
+}
+
+-(void)setRate:(float)rate {
+  _rate = MIN(MAX(rate,0.25f),4.0f);
+  if( !_timeStretch ){
+    [self _configureTimeStretch];
+  }
+  else {
+    EZAudioTimeStretcherSetRate(_timeStretch->stretcher,_rate);
+  }
+}
+
+-(void)setShouldLoop:(BOOL)shouldLoop {
+  if( _shouldLoop != shouldLoop ){
+    _shouldLoop = shouldLoop;
+    [self _configureLoop];
+  }
+}
+
+-(void)setLoopRegionWithStartFrame:(SInt64)startFrame endFrame:(SInt64)endFrame {
+  NSAssert(endFrame > startFrame && startFrame >= 0,@"The loop region's end frame must come after its start frame");
+  _loopStartFrame = startFrame;
+  _loopEndFrame   = endFrame;
+  [self _configureLoop];
+}
+
+-(void)clearLoopRegion {
+  _loopStartFrame = 0;
+  _loopEndFrame   = 0;
+  [self _configureLoop];
+}
+
+-(void)setTimeStretchQuality:(EZAudioTimeStretcherQuality)timeStretchQuality {
+  if( _timeStretchQuality != timeStretchQuality ){
+    _timeStretchQuality = timeStretchQuality;
+    if( _timeStretch ){
+      [self _configureTimeStretch];
+    }
+  }
+}
+
 #pragma mark - Methods
 -(void)play {
   NSAssert(_audioFile,@"No audio file to perform the seek on, check that EZAudioFile is not nil");
   if( _audioFile ){
-    [_output startPlayback];
-    if( self.frameIndex != self.totalFrames ){
-      _eof = NO;
-    }
+    // Queued before the output starts so the first render already fades in
+    _playRequested = YES;
+    [self _sendCommand:EZAudioPlayerCommandPlay frame:0 sampleTime:-1];
+    // Behind any stop already on the queue, and a stop queued after this one sees the request
+    dispatch_sync(_outputQueue,^{
+      if( _mixer ){
+        [_mixer addSource:self];
+        if( !_output.isPlaying ){
+          [_output startPlayback];
+        }
+      }
+      else {
+        [_output startPlayback];
+      }
+    });
     if( self.audioPlayerDelegate ){
       if( [self.audioPlayerDelegate respondsToSelector:@selector(audioPlayer:didResumePlaybackOnAudioFile:)] ){
         // Notify the delegate we're starting playback
@@ -219,7 +700,9 @@
 -(void)pause {
   NSAssert(self.audioFile,@"No audio file to perform the seek on, check that EZAudioFile is not nil");
   if( _audioFile ){
-    [_output stopPlayback];
+    // The output is stopped once the audio thread has faded out
+    _playRequested = NO;
+    [self _sendCommand:EZAudioPlayerCommandPause frame:0 sampleTime:-1];
     if( self.audioPlayerDelegate ){
       if( [self.audioPlayerDelegate respondsToSelector:@selector(audioPlayer:didPausePlaybackOnAudioFile:)] ){
         // Notify the delegate we're pausing playback
@@ -230,21 +713,82 @@
 }
 
 -(void)seekToFrame:(SInt64)frame {
+  [self seekToFrame:frame atSampleTime:-1];
+}
+
+-(void)seekToFrame:(SInt64)frame atSampleTime:(SInt64)sampleTime {
   NSAssert(_audioFile,@"No audio file to perform the seek on, check that EZAudioFile is not nil");
   if( _audioFile ){
-    [_audioFile seekToFrame:frame];
-  }
-  if( self.frameIndex != self.totalFrames ){
-    _eof = NO;
+    [self _sendCommand:EZAudioPlayerCommandSeek frame:frame sampleTime:sampleTime];
   }
 }
 
 -(void)stop {
   NSAssert(_audioFile,@"No audio file to perform the seek on, check that EZAudioFile is not nil");
   if( _audioFile ){
+    _playRequested = NO;
+    [self _sendCommand:EZAudioPlayerCommandStop frame:0 sampleTime:-1];
+  }
+}
+
+#pragma mark - Transport
+-(void)_sendCommand:(EZAudioPlayerCommandType)type frame:(SInt64)frame sampleTime:(SInt64)sampleTime {
+  EZAudioPlayerCommand command = { type, frame, sampleTime };
+  if( ![self _enqueueCommand:command] ){
+    NSLog(@"Dropped a transport change, the audio thread hasn't applied the last %u",EZAudioPlayerMaximumCommands);
+  }
+  
+  // Nothing is rendering (i.e. before the first play) so apply it here, the audio thread outputs silence if it starts meanwhile
+  if( ![self _isRendering] && OSAtomicCompareAndSwap32Barrier(0,2,&_commandConsumer) ){
+    if( _hasPendingCommand ){
+      // Nothing is audible so whatever was fading out is done
+      _rampFramesLeft = 0;
+      [self _finishCommandWithLoop:_loop timeStretch:_timeStretch];
+    }
+    [self _dequeueCommandsForFrames:0 loop:_loop timeStretch:_timeStretch];
+    OSAtomicCompareAndSwap32Barrier(2,0,&_commandConsumer);
+  }
+}
+
+-(BOOL)_enqueueCommand:(EZAudioPlayerCommand)command {
+  // A caller claims the slot at the write index by moving the index past it, losing the race only means another caller got that one
+  int64_t index = _commandWriteIndex;
+  for(;;){
+    EZAudioPlayerCommandSlot *slot = &_commands[index % EZAudioPlayerMaximumCommands];
+    int64_t sequence = slot->sequence;
+    if( sequence == index ){
+      if( OSAtomicCompareAndSwap64Barrier(index,index + 1,&_commandWriteIndex) ){
+        slot->command = command;
+        OSMemoryBarrier();
+        slot->sequence = index + 1;
+        return YES;
+      }
+    }
+    else if( sequence < index ){
+      // Still holds the command from a lap ago, the queue is full
+      return NO;
+    }
+    index = _commandWriteIndex;
+  }
+}
+
+-(BOOL)_isRendering {
+  if( _mixer ){
+    return _output.isPlaying && [_mixer containsSource:self];
+  }
+  return _output.isPlaying && _output.outputDataSource == self;
+}
+
+-(void)_stopOutputIfPaused {
+  // Runs on the output queue, only if nothing asked to play again while the pause was fading out
+  if( _playRequested || !_audioFile ){
+    return;
+  }
+  if( _mixer ){
+    [_mixer removeSource:self];
+  }
+  else if( _output.outputDataSource == self ){
     [_output stopPlayback];
-    [_audioFile seekToFrame:0];
-    _eof = NO;
   }
 }
 
@@ -274,23 +818,389 @@ withNumberOfChannels:(UInt32)numberOfChannels {
   }
 }
 
-#pragma mark - EZOutputDataSource
--(void)             output:(EZOutput *)output
- shouldFillAudioBufferList:(AudioBufferList *)audioBufferList
-        withNumberOfFrames:(UInt32)frames
+#pragma mark - Applying Transport Changes
+-(UInt32)_dequeueCommandsForFrames:(UInt32)frames
+                              loop:(EZAudioPlayerLoop*)loop
+                       timeStretch:(EZAudioPlayerTimeStretch*)timeStretch
+{
+    // Returns the frames that can be rendered before the next change is due
+    while( !_hasPendingCommand )
+    {
+        // Empty, or the caller that claimed the next slot hasn't finished writing it (the rest wait behind it)
+        EZAudioPlayerCommandSlot *slot = &_commands[_commandReadIndex % EZAudioPlayerMaximumCommands];
+        if( slot->sequence != _commandReadIndex + 1 )
+        {
+            break;
+        }
+        OSMemoryBarrier();
+        EZAudioPlayerCommand next = slot->command;
+        if( next.sampleTime > _sampleTime )
+        {
+            return (UInt32)MIN((SInt64)frames,next.sampleTime - _sampleTime);
+        }
+        OSMemoryBarrier();
+        slot->sequence = _commandReadIndex + EZAudioPlayerMaximumCommands;
+        _commandReadIndex++;
+        [self _beginCommand:next loop:loop timeStretch:timeStretch];
+    }
+    return frames;
+}
+
+-(void)_beginCommand:(EZAudioPlayerCommand)command
+                loop:(EZAudioPlayerLoop*)loop
+         timeStretch:(EZAudioPlayerTimeStretch*)timeStretch
+{
+    if( command.type == EZAudioPlayerCommandPlay )
+    {
+        _playing = YES;
+        [self _rampToGain:1.0f];
+        return;
+    }
+    // Everything else fades out first when it's audible (the audio thread holds the consumer flag)
+    _pendingCommand    = command;
+    _hasPendingCommand = YES;
+    if( _commandConsumer == 1 && _playing && _gain > 0.0f )
+    {
+        [self _rampToGain:0.0f];
+    }
+    else
+    {
+        [self _finishCommandWithLoop:loop timeStretch:timeStretch];
+    }
+}
+
+-(BOOL)_finishCommandWithLoop:(EZAudioPlayerLoop*)loop
+                  timeStretch:(EZAudioPlayerTimeStretch*)timeStretch
+{
+    EZAudioPlayerCommand command = _pendingCommand;
+    if( command.type != EZAudioPlayerCommandPause )
+    {
+        SInt64 frame = command.type == EZAudioPlayerCommandStop ? 0 : MIN(MAX(command.frame,0),self.audioFile.totalClientFrames);
+        [self.audioFile seekToFrame:frame];
+        if( self.audioFile.frameIndex != frame )
+        {
+            // The file was busy (i.e. reading waveform data), stay faded out and try again
+            return NO;
+        }
+        // Read from the file again and drop whatever the stretcher buffered from before
+        _frameIndex = frame;
+        _eof        = NO;
+        if( loop )
+        {
+            [self _leaveLoopReader:loop];
+        }
+        if( timeStretch )
+        {
+            EZAudioTimeStretcherReset(timeStretch->stretcher);
+            timeStretch->flushed = NO;
+        }
+    }
+    _hasPendingCommand = NO;
+    if( command.type == EZAudioPlayerCommandSeek && _playing )
+    {
+        [self _rampToGain:1.0f];
+    }
+    else if( command.type != EZAudioPlayerCommandSeek )
+    {
+        _playing        = NO;
+        _gain           = 0.0f;
+        _rampFramesLeft = 0;
+        dispatch_source_merge_data(_transportSource,1);
+    }
+    return YES;
+}
+
+-(void)_rampToGain:(float)gain {
+    EZAudioPlayerDeclick *declick = _declick;
+    _gainTarget     = gain;
+    _rampFramesLeft = declick && declick->kernel ? declick->rampFrames : 0;
+    if( _rampFramesLeft == 0 )
+    {
+        _gain = gain;
+    }
+}
+
+-(void)_rampAudioBufferList:(AudioBufferList*)audioBufferList
+                     offset:(UInt32)offset
+                     frames:(UInt32)frames
+                    declick:(EZAudioPlayerDeclick*)declick
+{
+    const EZAudioDSPKernel *kernel  = declick->kernel;
+    float                  endGain  = _gain + (_gainTarget - _gain)*(float)frames/(float)_rampFramesLeft;
+    float                  step     = (endGain - _gain)/(float)frames;
+    for( UInt32 done = 0; done < frames; done += EZAudioPlayerMaximumFrames )
+    {
+        UInt32 count = MIN(frames - done,EZAudioPlayerMaximumFrames);
+        float  gain  = _gain + step*(float)done;
+        kernel->toFloat(audioBufferList,offset + done,declick->buffers,count,declick->channels);
+        for( UInt32 channel = 0; channel < declick->channels; channel++ )
+        {
+            float *buffer = declick->buffers[channel];
+            for( UInt32 i = 0; i < count; i++ )
+            {
+                buffer[i] *= gain + step*(float)i;
+            }
+        }
+        kernel->fromFloat(declick->buffers,audioBufferList,offset + done,count,declick->channels);
+    }
+    _rampFramesLeft -= frames;
+    _gain            = _rampFramesLeft ? endGain : _gainTarget;
+}
+
+-(void)_renderAudioBufferList:(AudioBufferList*)audioBufferList
+           withNumberOfFrames:(UInt32)frames
+                      declick:(EZAudioPlayerDeclick*)declick
 {
-    if( self.audioFile )
+    EZAudioPlayerTimeStretch *timeStretch   = _timeStretch;
+    EZAudioPlayerLoop        *loop          = _loop;
+    AudioBufferList          *segment       = declick->segmentBufferList;
+    UInt32                   bytesPerFrame  = declick->bytesPerFrame;
+    UInt32                   offset         = 0;
+    while( offset < frames )
     {
-        UInt32 bufferSize;
+        // Changes land at their sample time, splitting the buffer there
+        UInt32 count = [self _dequeueCommandsForFrames:frames - offset loop:loop timeStretch:timeStretch];
+        if( _hasPendingCommand && _rampFramesLeft == 0 )
+        {
+            // Faded out so the change can be made now
+            if( ![self _finishCommandWithLoop:loop timeStretch:timeStretch] )
+            {
+                EZAudioPlayerClear(audioBufferList,offset,frames - offset,bytesPerFrame);
+                _sampleTime += frames - offset;
+                break;
+            }
+            continue;
+        }
+        if( _rampFramesLeft > 0 )
+        {
+            count = MIN(count,_rampFramesLeft);
+        }
+        
+        if( _playing && self.audioFile )
+        {
+            for( UInt32 i = 0; i < audioBufferList->mNumberBuffers; i++ )
+            {
+                segment->mBuffers[i].mNumberChannels = audioBufferList->mBuffers[i].mNumberChannels;
+                segment->mBuffers[i].mData           = (char*)audioBufferList->mBuffers[i].mData + offset*bytesPerFrame;
+                segment->mBuffers[i].mDataByteSize   = count*bytesPerFrame;
+            }
+            if( timeStretch )
+            {
+                [self _fillTimeStretchedAudioBufferList:segment
+                                     withNumberOfFrames:count
+                                            timeStretch:timeStretch
+                                                   loop:loop];
+            }
+            else
+            {
+                UInt32 read = [self _readFrames:count intoAudioBufferList:segment loop:loop];
+                EZAudioPlayerClear(audioBufferList,offset + read,count - read,bytesPerFrame);
+            }
+            if( _rampFramesLeft > 0 )
+            {
+                [self _rampAudioBufferList:audioBufferList offset:offset frames:count declick:declick];
+            }
+        }
+        else
+        {
+            EZAudioPlayerClear(audioBufferList,offset,count,bytesPerFrame);
+        }
+        _sampleTime += count;
+        offset      += count;
+    }
+}
+
+#pragma mark - Reading
+-(UInt32)_readFrames:(UInt32)frames
+ intoAudioBufferList:(AudioBufferList*)audioBufferList
+                loop:(EZAudioPlayerLoop*)loop
+{
+    if( !loop )
+    {
+        UInt32 bufferSize = 0;
         [self.audioFile readFrames:frames
                    audioBufferList:audioBufferList
                         bufferSize:&bufferSize
                                eof:&_eof];
-        if( _eof && self.shouldLoop )
+        _frameIndex += bufferSize;
+        return bufferSize;
+    }
+    
+    _eof = NO;
+    UInt32 bytesPerFrame = loop->bytesPerFrame;
+    UInt32 read          = 0;
+    while( read < frames )
+    {
+        // Wrap at the exact frame, the rest of this buffer carries on from the loop-in point
+        if( _frameIndex >= loop->endFrame )
+        {
+            [self _leaveLoopReader:loop];
+            _frameIndex        = loop->startFrame;
+            loop->headPosition = 0;
+            loop->inHead       = YES;
+        }
+        UInt32 count = (UInt32)MIN((SInt64)(frames - read),loop->endFrame - _frameIndex);
+        
+        // Right after a wrap the head plays from memory while a reader is already waiting past it
+        if( loop->inHead )
+        {
+            count = MIN(count,loop->headFrames - loop->headPosition);
+            for( UInt32 i = 0; i < audioBufferList->mNumberBuffers; i++ )
+            {
+                memcpy((char*)audioBufferList->mBuffers[i].mData + read*bytesPerFrame,
+                       (char*)loop->head->mBuffers[i].mData + loop->headPosition*bytesPerFrame,
+                       count*bytesPerFrame);
+            }
+            loop->headPosition += count;
+            _frameIndex        += count;
+            read               += count;
+            if( loop->headPosition == loop->headFrames )
+            {
+                loop->inHead = NO;
+                if( _frameIndex < loop->endFrame )
+                {
+                    [self _takeLoopReader:loop];
+                }
+            }
+            continue;
+        }
+        
+        EZAudioFile *reader = loop->reader >= 0 ? (__bridge EZAudioFile*)loop->readers[loop->reader] : self.audioFile;
+        for( UInt32 i = 0; i < audioBufferList->mNumberBuffers; i++ )
+        {
+            loop->readBufferList->mBuffers[i].mNumberChannels = audioBufferList->mBuffers[i].mNumberChannels;
+            loop->readBufferList->mBuffers[i].mData           = (char*)audioBufferList->mBuffers[i].mData + read*bytesPerFrame;
+            loop->readBufferList->mBuffers[i].mDataByteSize   = count*bytesPerFrame;
+        }
+        UInt32 bufferSize = 0;
+        BOOL   eof        = NO;
+        [reader readFrames:count
+           audioBufferList:loop->readBufferList
+                bufferSize:&bufferSize
+                       eof:&eof];
+        _frameIndex += bufferSize;
+        read        += bufferSize;
+        if( bufferSize == 0 )
+        {
+            if( !eof )
+            {
+                // The file is busy (i.e. being seeked), try again next render
+                break;
+            }
+            // The file ran out before the region's end (its length is only an estimate for some formats)
+            _frameIndex = loop->endFrame;
+        }
+    }
+    return read;
+}
+
+-(void)_leaveLoopReader:(EZAudioPlayerLoop*)loop {
+    // Hand it back to the loop queue to be seeked in time for a later wrap
+    if( loop->reader >= 0 )
+    {
+        OSAtomicCompareAndSwap32Barrier(EZAudioPlayerLoopReaderInUse,EZAudioPlayerLoopReaderIdle,&loop->readerStates[loop->reader]);
+        dispatch_source_merge_data(_loopSource,1);
+    }
+    loop->reader = -1;
+    loop->inHead = NO;
+}
+
+-(void)_takeLoopReader:(EZAudioPlayerLoop*)loop {
+    for( int i = 0; i < 2; i++ )
+    {
+        if( OSAtomicCompareAndSwap32Barrier(EZAudioPlayerLoopReaderArmed,EZAudioPlayerLoopReaderInUse,&loop->readerStates[i]) )
+        {
+            loop->reader = i;
+            return;
+        }
+    }
+    // Neither was seeked in time (a loop much shorter than a render wrapping over and over), fall back to seeking here
+    [self.audioFile seekToFrame:loop->startFrame + loop->headFrames];
+    loop->reader = -1;
+}
+
+#pragma mark - Time Stretching
+-(void)_fillTimeStretchedAudioBufferList:(AudioBufferList*)audioBufferList
+                      withNumberOfFrames:(UInt32)frames
+                             timeStretch:(EZAudioPlayerTimeStretch*)timeStretch
+                                    loop:(EZAudioPlayerLoop*)loop
+{
+    EZAudioTimeStretcher   *stretcher = timeStretch->stretcher;
+    const EZAudioDSPKernel *kernel    = timeStretch->kernel;
+    UInt32                 channels   = timeStretch->channels;
+    
+    for( UInt32 offset = 0; offset < frames; offset += EZAudioPlayerMaximumFrames )
+    {
+        UInt32 count     = MIN(frames - offset,EZAudioPlayerMaximumFrames);
+        UInt32 stretched = 0;
+        while( stretched < count )
+        {
+            // Read just as much of the file as the frames still to come need
+            UInt32 needed = EZAudioTimeStretcherInputFramesNeeded(stretcher,count - stretched);
+            while( needed > 0 && !_eof )
+            {
+                UInt32 chunk = MIN(needed,EZAudioPlayerMaximumFrames);
+                for( UInt32 i = 0; i < timeStretch->readBufferList->mNumberBuffers; i++ )
+                {
+                    timeStretch->readBufferList->mBuffers[i].mDataByteSize = chunk*timeStretch->bytesPerFrame;
+                }
+                // A loop wraps in here without resetting the stretcher so it's seamless
+                UInt32 bufferSize = [self _readFrames:chunk intoAudioBufferList:timeStretch->readBufferList loop:loop];
+                kernel->toFloat(timeStretch->readBufferList,0,timeStretch->input,bufferSize,channels);
+                EZAudioTimeStretcherWrite(stretcher,(const float * const *)timeStretch->input,bufferSize);
+                needed -= MIN(needed,bufferSize);
+                if( bufferSize == 0 )
+                {
+                    break;
+                }
+            }
+            
+            // Push the end of the file through once there's nothing left to read
+            if( _eof && !timeStretch->flushed )
+            {
+                EZAudioTimeStretcherFlush(stretcher);
+                timeStretch->flushed = YES;
+            }
+            
+            UInt32 read = EZAudioTimeStretcherRead(stretcher,timeStretch->output,count - stretched);
+            if( read == 0 )
+            {
+                break;
+            }
+            kernel->fromFloat(timeStretch->output,audioBufferList,offset + stretched,read,channels);
+            stretched += read;
+        }
+        if( stretched < count )
+        {
+            kernel->clear(audioBufferList,offset + stretched,count - stretched,channels);
+        }
+    }
+}
+
+#pragma mark - EZOutputDataSource
+-(void)             output:(EZOutput *)output
+ shouldFillAudioBufferList:(AudioBufferList *)audioBufferList
+        withNumberOfFrames:(UInt32)frames
+{
+    // Odd while rendering so anything replaced is kept until this render is done
+    OSAtomicIncrement64Barrier(&_renderEpoch);
+    EZAudioPlayerDeclick *declick = _declick;
+    if( declick && OSAtomicCompareAndSwap32Barrier(0,1,&_commandConsumer) )
+    {
+        [self _renderAudioBufferList:audioBufferList
+                  withNumberOfFrames:frames
+                             declick:declick];
+        OSAtomicCompareAndSwap32Barrier(1,0,&_commandConsumer);
+    }
+    else
+    {
+        // A change is being applied on the caller's thread while nothing was meant to be playing
+        for( UInt32 i = 0; i < audioBufferList->mNumberBuffers; i++ )
         {
-            [self seekToFrame:0];
+            memset(audioBufferList->mBuffers[i].mData,0,audioBufferList->mBuffers[i].mDataByteSize);
         }
     }
+    OSAtomicIncrement64Barrier(&_renderEpoch);
 }
 
 @end
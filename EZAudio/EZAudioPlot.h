@@ -47,6 +47,7 @@
  */
 @interface EZAudioPlot : EZPlot
 {
+    // The path's vertices, at most a min and max per pixel column of the view
     CGPoint *plotData;
     UInt32   plotLength;
 }
@@ -72,9 +73,9 @@
 #pragma mark - Subclass Methods
 
 /**
- <#Description#>
- @param data   <#theplotData description#>
- @param length <#length description#>
+ Sets the samples the plot draws. However many samples there are, the path only gets as many vertices as the view is wide in pixels (its backing width): once there are more than two samples per pixel column each column keeps just its lowest and highest sample, so drawing costs the same for 8192 samples as for the view's width. The vertices go into a buffer that's reused from one update to the next rather than allocated for each one.
+ @param data   The samples, between -1.0 and 1.0. Not modified.
+ @param length The number of samples.
  */
 -(void)setSampleData:(float *)data
               length:(int)length;
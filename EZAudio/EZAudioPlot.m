@@ -27,6 +27,52 @@
 
 #import "EZAudio.h"
 
+// Decimates the samples down to at most a min and max vertex per pixel column (the first and last vertices are always on the center line), returns the number of vertices. With no more than two samples per column every sample is a vertex.
+static UInt32 EZAudioPlotDecimate(const float *data,
+                                  UInt32 length,
+                                  UInt32 columns,
+                                  float gain,
+                                  CGPoint *vertices){
+  if( length < 2 ){
+    return 0;
+  }
+  UInt32 count = 0;
+  vertices[count++] = CGPointMake(0,0.0f);
+  if( columns == 0 || length <= 2*columns ){
+    for(UInt32 i = 1; i < length-1; i++) {
+      vertices[count++] = CGPointMake(i,data[i] * gain);
+    }
+  }
+  else {
+    // Each column keeps its extremes in the order they happened so the line stays continuous
+    for(UInt32 column = 0; column < columns; column++) {
+      UInt32 start = MAX((UInt32)((UInt64)column*length/columns),1);
+      UInt32 end   = MIN((UInt32)((UInt64)(column+1)*length/columns),length-1);
+      if( start >= end ){
+        continue;
+      }
+      UInt32 minimumIndex = start;
+      UInt32 maximumIndex = start;
+      for(UInt32 i = start+1; i < end; i++) {
+        if( data[i] < data[minimumIndex] ){
+          minimumIndex = i;
+        }
+        else if( data[i] > data[maximumIndex] ){
+          maximumIndex = i;
+        }
+      }
+      UInt32 first  = MIN(minimumIndex,maximumIndex);
+      UInt32 second = MAX(minimumIndex,maximumIndex);
+      vertices[count++] = CGPointMake(first,data[first] * gain);
+      if( second != first ){
+        vertices[count++] = CGPointMake(second,data[second] * gain);
+      }
+    }
+  }
+  vertices[count++] = CGPointMake(length-1,0.0f);
+  return count;
+}
+
 @interface EZAudioPlot () {
 //  BOOL             _hasData;
 //  TPCircularBuffer _historyBuffer;
@@ -37,6 +83,10 @@
   int     _scrollHistoryIndex;
   UInt32  _scrollHistoryLength;
   BOOL    _changingHistorySize;
+
+  // Vertex buffer (reused between updates, only grows)
+  UInt32  _plotCapacity;
+  UInt32  _plotSampleLength;
 }
 @end
 
@@ -89,7 +139,10 @@
   self.plotType        = EZPlotTypeRolling;
   self.shouldMirror    = NO;
   self.shouldFill      = NO;
-  plotData             = NULL;
+  plotData             = (CGPoint *)calloc(kEZAudioPlotMaxHistoryBufferLength,sizeof(CGPoint));
+  plotLength           = 0;
+  _plotCapacity        = plotData ? kEZAudioPlotMaxHistoryBufferLength : 0;
+  _plotSampleLength    = 0;
   _scrollHistory       = NULL;
   _scrollHistoryLength = kEZAudioPlotDefaultHistoryBufferLength;
 }
@@ -136,20 +189,33 @@
 #pragma mark - Get Data
 -(void)setSampleData:(float *)data
               length:(int)length {
-  if( plotData != nil ){
-    free(plotData);
+  // The path only needs as many vertices as the view has pixel columns to show
+  UInt32 sampleLength = length > 0 ? (UInt32)length : 0;
+  UInt32 columns      = [self _backingWidth];
+  UInt32 capacity     = columns > 0 ? MIN(sampleLength,2*columns+2) : sampleLength;
+  if( capacity > _plotCapacity ){
+    CGPoint *vertices = (CGPoint *)realloc(plotData,capacity*sizeof(CGPoint));
+    if( !vertices ){
+      return;
+    }
+    plotData      = vertices;
+    _plotCapacity = capacity;
   }
   
-  plotData   = (CGPoint *)calloc(sizeof(CGPoint),length);
-  plotLength = length;
-  
-  for(int i = 0; i < length; i++) {
-    data[i]     = i == 0 ? 0 : data[i];
-    plotData[i] = CGPointMake(i,data[i] * _gain);
-  }
+  plotLength        = EZAudioPlotDecimate(data,sampleLength,columns,_gain,plotData);
+  _plotSampleLength = sampleLength;
     
   [self _refreshDisplay];
 }
+
+-(UInt32)_backingWidth {
+#if TARGET_OS_IPHONE
+  CGFloat width = self.bounds.size.width * self.contentScaleFactor;
+#elif TARGET_OS_MAC
+  CGFloat width = [self convertSizeToBacking:self.bounds.size].width;
+#endif
+  return width > 0 ? (UInt32)ceil(width) : 0;
+}
   
 #pragma mark - Update
 -(void)updateBuffer:(float *)buffer withBufferSize:(UInt32)bufferSize {
@@ -211,8 +277,6 @@
     
     if(plotLength > 0) {
       
-      plotData[plotLength-1] = CGPointMake(plotLength-1,0.0f);
-      
       CGMutablePathRef halfPath = CGPathCreateMutable();
       CGPathAddLines(halfPath,
                      NULL,
@@ -220,7 +284,8 @@
                      plotLength);
       CGMutablePathRef path = CGPathCreateMutable();
       
-      double xscale = (frame.size.width) / (float)plotLength;
+      // The vertices are at their sample's position, so the scale is by the samples and not the vertices
+      double xscale = (frame.size.width) / (float)_plotSampleLength;
       double halfHeight = floor( frame.size.height / 2.0 );
       
       // iOS drawing origin is flipped by default so make sure we account for that
@@ -0,0 +1,221 @@
+//
+//  EZAudioQueuePlayer.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+#import <Foundation/Foundation.h>
+#import "EZOutput.h"
+
+@class EZAudioMixer;
+@class EZAudioQueuePlayer;
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioQueuePlayerDelegate
+//------------------------------------------------------------------------------
+
+/**
+ The EZAudioQueuePlayerDelegate is told when the EZAudioQueuePlayer moves from one item to the next. Both methods are called on the main thread.
+ */
+@protocol EZAudioQueuePlayerDelegate <NSObject>
+
+@optional
+
+/**
+ Triggered when an item starts playing, i.e. at the sample its first frame was rendered (or when its crossfade began).
+ @param queuePlayer The instance of the EZAudioQueuePlayer that triggered the event.
+ @param url         The NSURL of the item that started playing.
+ */
+- (void)queuePlayer:(EZAudioQueuePlayer *)queuePlayer didStartPlayingURL:(NSURL *)url;
+
+//------------------------------------------------------------------------------
+
+/**
+ Triggered when the last item in the queue has finished playing and there is nothing left to play.
+ @param queuePlayer The instance of the EZAudioQueuePlayer that triggered the event.
+ */
+- (void)queuePlayerDidFinishPlayingQueue:(EZAudioQueuePlayer *)queuePlayer;
+
+@end
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioQueuePlayer
+//------------------------------------------------------------------------------
+
+/**
+ The EZAudioQueuePlayer plays a queue of audio files back to back without a gap. Switching files on an EZAudioPlayer (`setAudioFile:`) reopens the file and reconfigures the output, which stops and restarts it. The queue player instead opens every item with the same client format, so the output never changes, and opens the next item on a background queue as soon as the current one starts, decoding its first `prerollDuration` seconds ahead of time. The render moves on to the next item at the exact sample the current one ends, continuing in the same render from the next item's predecoded head, so the switch costs neither a gap nor a disk read on the audio thread.
+
+ Setting a `crossfadeDuration` overlaps the end of each item with the start of the next using equal power gain ramps instead.
+ */
+@interface EZAudioQueuePlayer : NSObject <EZOutputDataSource>
+
+//------------------------------------------------------------------------------
+#pragma mark - Properties
+//------------------------------------------------------------------------------
+
+/**
+ The EZAudioQueuePlayerDelegate told when items start playing and when the queue is finished.
+ */
+@property (nonatomic, weak) id<EZAudioQueuePlayerDelegate> delegate;
+
+/**
+ The EZOutput the queue player plays through. When created with a mixer this is the mixer's output.
+ */
+@property (nonatomic, strong, readonly) EZOutput *output;
+
+/**
+ The EZAudioMixer the queue player plays through, or nil when it's the output's data source.
+ */
+@property (nonatomic, strong, readonly) EZAudioMixer *mixer;
+
+/**
+ The format every item is decoded into, i.e. the output's `audioStreamBasicDescription` at the time the queue player was created or the mixer's `sourceFormat`. Files with a different sample rate or channel count are converted to it when they're read.
+ */
+@property (nonatomic, readonly) AudioStreamBasicDescription format;
+
+/**
+ The duration in seconds over which the end of an item is crossfaded into the start of the next one. Default is 0, playing the items back to back with no overlap. Takes effect from the next item on.
+ */
+@property (nonatomic, assign) NSTimeInterval crossfadeDuration;
+
+/**
+ The duration in seconds decoded from the start of the next item before the current one ends. Default is 0.5 seconds. Takes effect from the next item that is opened.
+ */
+@property (nonatomic, assign) NSTimeInterval prerollDuration;
+
+/**
+ The NSURL of the item playing right now, or nil. Updated on the main thread when the delegate is told an item has started.
+ */
+@property (nonatomic, strong, readonly) NSURL *currentURL;
+
+//------------------------------------------------------------------------------
+#pragma mark - Initializers
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Initializers
+///-----------------------------------------------------------
+
+/**
+ Creates a queue player that plays through `[EZOutput sharedOutput]`.
+ @return A newly created instance of the EZAudioQueuePlayer class.
+ */
+- (instancetype)init;
+
+//------------------------------------------------------------------------------
+
+/**
+ Creates a queue player that becomes the data source of an output. The output's stream format should be set before creating the queue player and must be packed native endian float or 16-bit integer linear PCM.
+ @param output An EZOutput to play through.
+ @return A newly created instance of the EZAudioQueuePlayer class.
+ */
+- (instancetype)initWithOutput:(EZOutput *)output;
+
+//------------------------------------------------------------------------------
+
+/**
+ Creates a queue player that plays as a source of a mixer, alongside the mixer's other sources.
+ @param mixer An EZAudioMixer to play through.
+ @return A newly created instance of the EZAudioQueuePlayer class.
+ */
+- (instancetype)initWithMixer:(EZAudioMixer *)mixer;
+
+//------------------------------------------------------------------------------
+
+/**
+ Class method to create a queue player that becomes the data source of an output.
+ @param output An EZOutput to play through.
+ @return A newly created instance of the EZAudioQueuePlayer class.
+ */
++ (instancetype)queuePlayerWithOutput:(EZOutput *)output;
+
+//------------------------------------------------------------------------------
+#pragma mark - Queue
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Managing The Queue
+///-----------------------------------------------------------
+
+/**
+ Adds an audio file to the end of the queue. Safe to call while playing.
+ @param url An NSURL pointing to a local audio file.
+ */
+- (void)enqueueURL:(NSURL *)url;
+
+//------------------------------------------------------------------------------
+
+/**
+ Adds several audio files to the end of the queue, in order. Safe to call while playing.
+ @param urls An NSArray of NSURLs pointing to local audio files.
+ */
+- (void)enqueueURLs:(NSArray *)urls;
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides the items waiting to play after the current one, in order, including the next item once it's been opened ahead of time.
+ @return An NSArray of NSURLs.
+ */
+- (NSArray *)queuedURLs;
+
+//------------------------------------------------------------------------------
+
+/**
+ Removes every item waiting to play. The current item plays on to its end.
+ */
+- (void)removeAllQueuedURLs;
+
+//------------------------------------------------------------------------------
+
+/**
+ Moves on to the next item, fading the current one out over a few milliseconds (or over the `crossfadeDuration` if it is longer) so it doesn't click. Safe to call from any thread.
+ */
+- (void)skipToNextItem;
+
+//------------------------------------------------------------------------------
+#pragma mark - Playback
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Controlling Playback
+///-----------------------------------------------------------
+
+/**
+ Starts or resumes playback, starting the output (or joining the mixer) if needed.
+ */
+- (void)play;
+
+//------------------------------------------------------------------------------
+
+/**
+ Pauses playback. The current item resumes where it left off on `play`.
+ */
+- (void)pause;
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides whether the queue player is playing.
+ @return YES if playing, NO otherwise.
+ */
+- (BOOL)isPlaying;
+
+@end
@@ -0,0 +1,752 @@
+//
+//  EZAudioQueuePlayer.m
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+#import "EZAudioQueuePlayer.h"
+
+//------------------------------------------------------------------------------
+
+#import "EZAudio.h"
+
+//------------------------------------------------------------------------------
+
+// constants
+static const UInt32 EZAudioQueuePlayerMaximumFrames = 4096;
+static const UInt32 EZAudioQueuePlayerFadeSegmentFrames = 256;
+static const NSTimeInterval EZAudioQueuePlayerDefaultPrerollDuration = 0.5;
+static const NSTimeInterval EZAudioQueuePlayerSkipFadeDuration = 0.01;
+
+//------------------------------------------------------------------------------
+
+typedef void (*EZAudioQueuePlayerReadIMP)(id, SEL, UInt32, AudioBufferList *, UInt32 *, BOOL *);
+
+//------------------------------------------------------------------------------
+
+// one per opened item, owned by whichever thread took it out of its slot
+typedef struct EZAudioQueuePlayerItem
+{
+    const void                    *audioFile;
+    const void                    *url;
+    EZAudioQueuePlayerReadIMP     readFrames;
+    float                         **preroll;
+    UInt32                        channels;
+    UInt32                        prerollCapacity;
+    UInt32                        prerollFrames;
+    SInt64                        totalFrames;
+    SInt64                        position;
+    BOOL                          eof;
+    struct EZAudioQueuePlayerItem *next;
+} EZAudioQueuePlayerItem;
+
+//------------------------------------------------------------------------------
+
+static AudioBufferList *EZAudioQueuePlayerCreateBufferList(UInt32 channels);
+static void EZAudioQueuePlayerFreeItem(EZAudioQueuePlayerItem *item);
+static void EZAudioQueuePlayerRetireItem(EZAudioQueuePlayer *player, EZAudioQueuePlayerItem *item);
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioQueuePlayer
+//------------------------------------------------------------------------------
+
+@interface EZAudioQueuePlayer ()
+{
+    // handed between threads
+    EZAudioQueuePlayerItem *volatile _next;
+    EZAudioQueuePlayerItem *volatile _retired;
+    EZAudioQueuePlayerItem *volatile _lastStarted;
+    volatile int64_t                 _itemChanges;
+    volatile int32_t                 _skipRequests;
+    volatile UInt32                  _crossfadeFrames;
+
+    // audio thread only
+    EZAudioQueuePlayerItem           *_current;
+    EZAudioQueuePlayerItem           *_incoming;
+    UInt32                           _fadeFrames;
+    UInt32                           _fadePosition;
+    BOOL                             _idle;
+    const EZAudioDSPKernel           *_kernel;
+    UInt32                           _channels;
+    AudioBufferList                  *_readBufferList;
+    float                            **_mixBuffers;
+    float                            **_fadeBuffers;
+
+    // loader queue only
+    dispatch_queue_t                 _loaderQueue;
+    dispatch_source_t                _loaderSource;
+    int64_t                          _notifiedItemChanges;
+
+    // guarded by _queuedURLs
+    NSMutableArray                   *_queuedURLs;
+    NSURL                            *_preparedURL;
+    NSUInteger                       _queueGeneration;
+}
+@property (nonatomic, strong, readwrite) EZOutput *output;
+@property (nonatomic, strong, readwrite) EZAudioMixer *mixer;
+@property (nonatomic, readwrite) AudioStreamBasicDescription format;
+@property (nonatomic, strong, readwrite) NSURL *currentURL;
+@property (nonatomic, readwrite) BOOL isPlaying;
+@end
+
+//------------------------------------------------------------------------------
+
+@implementation EZAudioQueuePlayer
+
+//------------------------------------------------------------------------------
+#pragma mark - Dealloc
+//------------------------------------------------------------------------------
+
+- (void)dealloc
+{
+    [self pause];
+    if (self.output.outputDataSource == self)
+    {
+        self.output.outputDataSource = nil;
+    }
+    dispatch_source_cancel(_loaderSource);
+
+    // nothing renders any more so every item can be freed from here
+    [self reclaimRetiredItems];
+    EZAudioQueuePlayerFreeItem(_current);
+    EZAudioQueuePlayerFreeItem(_incoming);
+    EZAudioQueuePlayerFreeItem(_next);
+    free(_readBufferList);
+    [EZAudio freeFloatBuffers:_mixBuffers numberOfChannels:_channels];
+    [EZAudio freeFloatBuffers:_fadeBuffers numberOfChannels:_channels];
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Initialization
+//------------------------------------------------------------------------------
+
+- (instancetype)init
+{
+    return [self initWithOutput:[EZOutput sharedOutput]];
+}
+
+//------------------------------------------------------------------------------
+
+- (instancetype)initWithOutput:(EZOutput *)output
+{
+    NSAssert(output, @"A queue player needs an output to play through");
+    self = [self initWithFormat:output.audioStreamBasicDescription];
+    if (self)
+    {
+        _output = output;
+        _output.outputDataSource = self;
+    }
+    return self;
+}
+
+//------------------------------------------------------------------------------
+
+- (instancetype)initWithMixer:(EZAudioMixer *)mixer
+{
+    NSAssert(mixer, @"A queue player needs a mixer to play through");
+    self = [self initWithFormat:mixer.sourceFormat];
+    if (self)
+    {
+        _mixer = mixer;
+        _output = mixer.output;
+    }
+    return self;
+}
+
+//------------------------------------------------------------------------------
+
+- (instancetype)initWithFormat:(AudioStreamBasicDescription)format
+{
+    self = [super init];
+    if (self)
+    {
+        _kernel = EZAudioDSPKernelForFormat(format);
+        NSAssert(_kernel, @"The queue player's format must be packed native endian float or 16-bit integer linear PCM");
+        _format = format;
+        _channels = format.mChannelsPerFrame;
+        _prerollDuration = EZAudioQueuePlayerDefaultPrerollDuration;
+        _idle = YES;
+        _queuedURLs = [NSMutableArray array];
+
+        // everything the render needs is allocated up front
+        _mixBuffers = [EZAudio floatBuffersWithNumberOfFrames:EZAudioQueuePlayerMaximumFrames
+                                             numberOfChannels:_channels];
+        _fadeBuffers = [EZAudio floatBuffersWithNumberOfFrames:EZAudioQueuePlayerMaximumFrames
+                                              numberOfChannels:_channels];
+        _readBufferList = EZAudioQueuePlayerCreateBufferList(_channels);
+
+        // the audio thread wakes the loader by merging into a data source, which never blocks or allocates
+        __weak EZAudioQueuePlayer *weakSelf = self;
+        _loaderQueue = dispatch_queue_create("com.ezaudio.queueplayer.loader", DISPATCH_QUEUE_SERIAL);
+        _loaderSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_OR, 0, 0, _loaderQueue);
+        dispatch_source_set_event_handler(_loaderSource, ^{
+            [weakSelf serviceQueue];
+        });
+        dispatch_resume(_loaderSource);
+    }
+    return self;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Class Initializers
+//------------------------------------------------------------------------------
+
++ (instancetype)queuePlayerWithOutput:(EZOutput *)output
+{
+    return [[self alloc] initWithOutput:output];
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Queue
+//------------------------------------------------------------------------------
+
+- (void)enqueueURL:(NSURL *)url
+{
+    NSAssert(url, @"Cannot enqueue a nil url");
+    [self enqueueURLs:@[ url ]];
+}
+
+//------------------------------------------------------------------------------
+
+- (void)enqueueURLs:(NSArray *)urls
+{
+    @synchronized(_queuedURLs)
+    {
+        [_queuedURLs addObjectsFromArray:urls];
+    }
+    dispatch_source_merge_data(_loaderSource, 1);
+}
+
+//------------------------------------------------------------------------------
+
+- (NSArray *)queuedURLs
+{
+    @synchronized(_queuedURLs)
+    {
+        return _preparedURL ? [@[ _preparedURL ] arrayByAddingObjectsFromArray:_queuedURLs] : [_queuedURLs copy];
+    }
+}
+
+//------------------------------------------------------------------------------
+
+- (void)removeAllQueuedURLs
+{
+    @synchronized(_queuedURLs)
+    {
+        [_queuedURLs removeAllObjects];
+        _preparedURL = nil;
+        _queueGeneration++;
+
+        // unless the audio thread took it first the opened item goes too
+        EZAudioQueuePlayerItem *item = _next;
+        if (item && OSAtomicCompareAndSwapPtrBarrier(item, NULL, (void *volatile *)&_next))
+        {
+            EZAudioQueuePlayerRetireItem(self, item);
+        }
+    }
+    dispatch_source_merge_data(_loaderSource, 1);
+}
+
+//------------------------------------------------------------------------------
+
+- (void)skipToNextItem
+{
+    OSAtomicIncrement32Barrier(&_skipRequests);
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Playback
+//------------------------------------------------------------------------------
+
+- (void)play
+{
+    if (!self.isPlaying)
+    {
+        self.isPlaying = YES;
+        dispatch_source_merge_data(_loaderSource, 1);
+        if (self.mixer)
+        {
+            [self.mixer addSource:self];
+        }
+        if (!self.output.isPlaying)
+        {
+            [self.output startPlayback];
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+- (void)pause
+{
+    if (self.isPlaying)
+    {
+        self.isPlaying = NO;
+        if (self.mixer)
+        {
+            [self.mixer removeSource:self];
+        }
+        else
+        {
+            [self.output stopPlayback];
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Setters
+//------------------------------------------------------------------------------
+
+- (void)setCrossfadeDuration:(NSTimeInterval)crossfadeDuration
+{
+    _crossfadeDuration = MAX(crossfadeDuration, 0.0);
+    _crossfadeFrames = (UInt32)(_crossfadeDuration * _format.mSampleRate);
+}
+
+//------------------------------------------------------------------------------
+
+- (void)setPrerollDuration:(NSTimeInterval)prerollDuration
+{
+    _prerollDuration = MAX(prerollDuration, 0.0);
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Loader
+//------------------------------------------------------------------------------
+
+- (void)serviceQueue
+{
+    [self notifyItemChanges];
+    [self reclaimRetiredItems];
+    [self prepareNextItem];
+}
+
+//------------------------------------------------------------------------------
+
+- (void)notifyItemChanges
+{
+    int64_t itemChanges = _itemChanges;
+    if (itemChanges == _notifiedItemChanges)
+    {
+        return;
+    }
+    _notifiedItemChanges = itemChanges;
+
+    // only this queue frees items so the last started one is safe to read until we reclaim
+    OSMemoryBarrier();
+    EZAudioQueuePlayerItem *item = _lastStarted;
+    NSURL *url = item ? (__bridge NSURL *)item->url : nil;
+    BOOL finished;
+    @synchronized(_queuedURLs)
+    {
+        finished = !url && !_next && !_preparedURL && _queuedURLs.count == 0;
+    }
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+        self.currentURL = url;
+        id<EZAudioQueuePlayerDelegate> delegate = self.delegate;
+        if (url && [delegate respondsToSelector:@selector(queuePlayer:didStartPlayingURL:)])
+        {
+            [delegate queuePlayer:self didStartPlayingURL:url];
+        }
+        else if (finished && [delegate respondsToSelector:@selector(queuePlayerDidFinishPlayingQueue:)])
+        {
+            [delegate queuePlayerDidFinishPlayingQueue:self];
+        }
+    });
+}
+
+//------------------------------------------------------------------------------
+
+- (void)prepareNextItem
+{
+    NSURL *url;
+    NSUInteger generation;
+    @synchronized(_queuedURLs)
+    {
+        // the audio thread took the opened item, so it's no longer waiting
+        if (!_next)
+        {
+            _preparedURL = nil;
+        }
+        if (_next || _queuedURLs.count == 0)
+        {
+            return;
+        }
+        url = _queuedURLs[0];
+        [_queuedURLs removeObjectAtIndex:0];
+        generation = _queueGeneration;
+    }
+
+    // open and decode the head outside the lock, this is the slow part
+    EZAudioQueuePlayerItem *item = [self itemWithURL:url];
+    @synchronized(_queuedURLs)
+    {
+        if (generation == _queueGeneration)
+        {
+            _preparedURL = url;
+            OSAtomicCompareAndSwapPtrBarrier(NULL, item, (void *volatile *)&_next);
+            item = NULL;
+        }
+    }
+    EZAudioQueuePlayerFreeItem(item);
+}
+
+//------------------------------------------------------------------------------
+
+- (EZAudioQueuePlayerItem *)itemWithURL:(NSURL *)url
+{
+    // every item reads into the same format so the output never has to be reconfigured
+    EZAudioFile *audioFile = [EZAudioFile audioFileWithURL:url];
+    [audioFile setClientFormat:[EZAudio floatFormatWithNumberOfChannels:_channels
+                                                             sampleRate:_format.mSampleRate]];
+
+    EZAudioQueuePlayerItem *item = (EZAudioQueuePlayerItem *)calloc(1, sizeof(EZAudioQueuePlayerItem));
+    SEL readFrames = @selector(readFrames:audioBufferList:bufferSize:eof:);
+    item->audioFile = CFBridgingRetain(audioFile);
+    item->url = CFBridgingRetain(url);
+    item->readFrames = (EZAudioQueuePlayerReadIMP)[audioFile methodForSelector:readFrames];
+    item->channels = _channels;
+    item->totalFrames = audioFile.totalClientFrames;
+
+    // decode the head now so the switch doesn't wait on the disk or the decoder
+    SInt64 prerollFrames = (SInt64)(self.prerollDuration * _format.mSampleRate);
+    item->prerollCapacity = (UInt32)MAX(MIN(prerollFrames, item->totalFrames), 1);
+    item->preroll = [EZAudio floatBuffersWithNumberOfFrames:item->prerollCapacity
+                                           numberOfChannels:_channels];
+    AudioBufferList *bufferList = EZAudioQueuePlayerCreateBufferList(_channels);
+    while (item->prerollFrames < item->prerollCapacity && !item->eof)
+    {
+        UInt32 frames = item->prerollCapacity - item->prerollFrames;
+        for (UInt32 channel = 0; channel < _channels; channel++)
+        {
+            bufferList->mBuffers[channel].mData = item->preroll[channel] + item->prerollFrames;
+            bufferList->mBuffers[channel].mDataByteSize = frames * sizeof(float);
+        }
+        UInt32 bufferSize = 0;
+        BOOL eof = NO;
+        [audioFile readFrames:frames
+              audioBufferList:bufferList
+                   bufferSize:&bufferSize
+                          eof:&eof];
+        item->prerollFrames += bufferSize;
+        item->eof = eof || bufferSize == 0;
+    }
+    free(bufferList);
+    return item;
+}
+
+//------------------------------------------------------------------------------
+
+- (void)reclaimRetiredItems
+{
+    EZAudioQueuePlayerItem *list;
+    do
+    {
+        list = _retired;
+    } while (list && !OSAtomicCompareAndSwapPtrBarrier(list, NULL, (void *volatile *)&_retired));
+
+    while (list)
+    {
+        EZAudioQueuePlayerItem *item = list;
+        list = item->next;
+        EZAudioQueuePlayerFreeItem(item);
+    }
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Items
+//------------------------------------------------------------------------------
+
+static AudioBufferList *EZAudioQueuePlayerCreateBufferList(UInt32 channels)
+{
+    AudioBufferList *bufferList = (AudioBufferList *)malloc(offsetof(AudioBufferList, mBuffers[0]) + sizeof(AudioBuffer) * channels);
+    bufferList->mNumberBuffers = channels;
+    for (UInt32 channel = 0; channel < channels; channel++)
+    {
+        bufferList->mBuffers[channel].mNumberChannels = 1;
+        bufferList->mBuffers[channel].mDataByteSize = 0;
+        bufferList->mBuffers[channel].mData = NULL;
+    }
+    return bufferList;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioQueuePlayerFreeItem(EZAudioQueuePlayerItem *item)
+{
+    if (item)
+    {
+        [EZAudio freeFloatBuffers:item->preroll
+                 numberOfChannels:item->channels];
+        CFBridgingRelease(item->audioFile);
+        CFBridgingRelease(item->url);
+        free(item);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioQueuePlayerRetireItem(EZAudioQueuePlayer *player,
+                                         EZAudioQueuePlayerItem *item)
+{
+    // the loader may read the last started item until it's told otherwise
+    if (player->_lastStarted == item)
+    {
+        player->_lastStarted = NULL;
+    }
+    EZAudioQueuePlayerItem *head;
+    do
+    {
+        head = player->_retired;
+        item->next = head;
+    } while (!OSAtomicCompareAndSwapPtrBarrier(head, item, (void *volatile *)&player->_retired));
+}
+
+//------------------------------------------------------------------------------
+
+static EZAudioQueuePlayerItem *EZAudioQueuePlayerTakeNextItem(EZAudioQueuePlayer *player)
+{
+    EZAudioQueuePlayerItem *item = player->_next;
+    if (!item || !OSAtomicCompareAndSwapPtrBarrier(item, NULL, (void *volatile *)&player->_next))
+    {
+        return NULL;
+    }
+
+    // publish the item before the change so the loader reports this one
+    player->_lastStarted = item;
+    player->_idle = NO;
+    OSAtomicIncrement64Barrier(&player->_itemChanges);
+    return item;
+}
+
+//------------------------------------------------------------------------------
+
+static UInt32 EZAudioQueuePlayerReadItem(EZAudioQueuePlayer *player,
+                                         EZAudioQueuePlayerItem *item,
+                                         float **buffers,
+                                         UInt32 offset,
+                                         UInt32 frames)
+{
+    UInt32 channels = player->_channels;
+    UInt32 read = 0;
+
+    // the head was decoded ahead of time
+    if (item->position < item->prerollFrames)
+    {
+        read = (UInt32)MIN(frames, item->prerollFrames - item->position);
+        for (UInt32 channel = 0; channel < channels; channel++)
+        {
+            memcpy(buffers[channel] + offset, item->preroll[channel] + item->position, read * sizeof(float));
+        }
+    }
+
+    // the rest is read straight into the buffers
+    AudioBufferList *bufferList = player->_readBufferList;
+    while (read < frames && !item->eof)
+    {
+        for (UInt32 channel = 0; channel < channels; channel++)
+        {
+            bufferList->mBuffers[channel].mData = buffers[channel] + offset + read;
+            bufferList->mBuffers[channel].mDataByteSize = (frames - read) * sizeof(float);
+        }
+        UInt32 bufferSize = 0;
+        BOOL eof = NO;
+        item->readFrames((__bridge id)item->audioFile,
+                         @selector(readFrames:audioBufferList:bufferSize:eof:),
+                         frames - read,
+                         bufferList,
+                         &bufferSize,
+                         &eof);
+        if (bufferSize == 0)
+        {
+            // either the end or the file was busy, only the end moves us on
+            item->eof = eof;
+            break;
+        }
+        read += bufferSize;
+    }
+    item->position += read;
+
+    for (UInt32 channel = 0; channel < channels; channel++)
+    {
+        memset(buffers[channel] + offset + read, 0, (frames - read) * sizeof(float));
+    }
+    return read;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Render
+//------------------------------------------------------------------------------
+
+static void EZAudioQueuePlayerMixFade(EZAudioQueuePlayer *player,
+                                      float **source,
+                                      UInt32 offset,
+                                      UInt32 frames,
+                                      float startGain,
+                                      float endGain)
+{
+    for (UInt32 channel = 0; channel < player->_channels; channel++)
+    {
+        EZAudioDSPMix(source[channel],
+                      player->_mixBuffers[channel] + offset,
+                      frames,
+                      startGain,
+                      endGain);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static BOOL EZAudioQueuePlayerRender(EZAudioQueuePlayer *player,
+                                     UInt32 frames)
+{
+    UInt32 channels = player->_channels;
+    for (UInt32 channel = 0; channel < channels; channel++)
+    {
+        memset(player->_mixBuffers[channel], 0, frames * sizeof(float));
+    }
+
+    BOOL changed = NO;
+    UInt32 rendered = 0;
+    while (rendered < frames)
+    {
+        // a skip fades the current item out (and the next in) over a few milliseconds
+        int32_t skipRequests = player->_skipRequests;
+        if (skipRequests && OSAtomicCompareAndSwap32Barrier(skipRequests, 0, &player->_skipRequests) &&
+            player->_current && !player->_incoming && !player->_fadeFrames)
+        {
+            UInt32 skipFadeFrames = (UInt32)(EZAudioQueuePlayerSkipFadeDuration * player->_format.mSampleRate);
+            player->_incoming = EZAudioQueuePlayerTakeNextItem(player);
+            player->_fadeFrames = MAX(MAX(player->_crossfadeFrames, skipFadeFrames), 1);
+            player->_fadePosition = 0;
+            changed = YES;
+        }
+
+        // pick up the next item at this exact sample
+        if (!player->_current)
+        {
+            player->_current = EZAudioQueuePlayerTakeNextItem(player);
+            if (!player->_current)
+            {
+                if (!player->_idle)
+                {
+                    player->_idle = YES;
+                    OSAtomicIncrement64Barrier(&player->_itemChanges);
+                    changed = YES;
+                }
+                break;
+            }
+            changed = YES;
+        }
+
+        EZAudioQueuePlayerItem *current = player->_current;
+        UInt32 crossfadeFrames = player->_crossfadeFrames;
+        SInt64 remaining = current->totalFrames - current->position;
+
+        // start the crossfade once the current item is within the crossfade of its end
+        if (!player->_fadeFrames && crossfadeFrames && remaining > 0 && remaining <= crossfadeFrames)
+        {
+            player->_incoming = EZAudioQueuePlayerTakeNextItem(player);
+            if (player->_incoming)
+            {
+                player->_fadeFrames = (UInt32)remaining;
+                player->_fadePosition = 0;
+                changed = YES;
+            }
+        }
+
+        if (player->_fadeFrames)
+        {
+            // equal power ramps, linear within each short segment
+            UInt32 fadeFrames = player->_fadeFrames;
+            UInt32 count = MIN(MIN(frames - rendered, fadeFrames - player->_fadePosition), EZAudioQueuePlayerFadeSegmentFrames);
+            float start = (float)M_PI_2 * player->_fadePosition / fadeFrames;
+            float end = (float)M_PI_2 * (player->_fadePosition + count) / fadeFrames;
+
+            EZAudioQueuePlayerReadItem(player, current, player->_fadeBuffers, 0, count);
+            EZAudioQueuePlayerMixFade(player, player->_fadeBuffers, rendered, count, cosf(start), cosf(end));
+            if (player->_incoming)
+            {
+                EZAudioQueuePlayerReadItem(player, player->_incoming, player->_fadeBuffers, 0, count);
+                EZAudioQueuePlayerMixFade(player, player->_fadeBuffers, rendered, count, sinf(start), sinf(end));
+            }
+            player->_fadePosition += count;
+            rendered += count;
+
+            // the incoming item carries on from where the fade left it
+            if (player->_fadePosition >= fadeFrames)
+            {
+                EZAudioQueuePlayerRetireItem(player, current);
+                player->_current = player->_incoming;
+                player->_incoming = NULL;
+                player->_fadeFrames = 0;
+                player->_fadePosition = 0;
+                changed = YES;
+            }
+            continue;
+        }
+
+        // stop short of the crossfade so it starts on the right sample
+        UInt32 count = frames - rendered;
+        if (crossfadeFrames && remaining > crossfadeFrames)
+        {
+            count = (UInt32)MIN((SInt64)count, remaining - crossfadeFrames);
+        }
+        UInt32 read = EZAudioQueuePlayerReadItem(player, current, player->_mixBuffers, rendered, count);
+        rendered += read;
+        if (read < count)
+        {
+            if (!current->eof)
+            {
+                break;
+            }
+            EZAudioQueuePlayerRetireItem(player, current);
+            player->_current = NULL;
+            changed = YES;
+        }
+    }
+    return changed;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - EZOutputDataSource
+//------------------------------------------------------------------------------
+
+- (void)              output:(EZOutput *)output
+   shouldFillAudioBufferList:(AudioBufferList *)audioBufferList
+          withNumberOfFrames:(UInt32)frames
+{
+    BOOL changed = NO;
+    for (UInt32 offset = 0; offset < frames; offset += EZAudioQueuePlayerMaximumFrames)
+    {
+        UInt32 count = MIN(frames - offset, EZAudioQueuePlayerMaximumFrames);
+        changed |= EZAudioQueuePlayerRender(self, count);
+        _kernel->fromFloat(_mixBuffers, audioBufferList, offset, count, _channels);
+    }
+
+    // wake the loader to report the change, free the finished item and open the next one
+    if (changed)
+    {
+        dispatch_source_merge_data(_loaderSource, 1);
+    }
+}
+
+@end
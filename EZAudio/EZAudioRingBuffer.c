@@ -0,0 +1,232 @@
+//
+//  EZAudioRingBuffer.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#include "EZAudioRingBuffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+#pragma mark - Initialization
+//------------------------------------------------------------------------------
+
+bool EZAudioRingBufferInit(EZAudioRingBuffer *ring,
+                           AudioStreamBasicDescription format,
+                           UInt32 capacityFrames)
+{
+    memset(ring, 0, sizeof(EZAudioRingBuffer));
+
+    // one ring per AudioBuffer, just like the AudioBufferList it mirrors
+    bool interleaved = !(format.mFormatFlags & kAudioFormatFlagIsNonInterleaved);
+    ring->numberOfBuffers = interleaved ? 1 : format.mChannelsPerFrame;
+    ring->bytesPerFrame   = format.mBytesPerFrame;
+    if (ring->numberOfBuffers == 0 || ring->bytesPerFrame == 0)
+    {
+        return false;
+    }
+
+    ring->buffers = (TPCircularBuffer *)calloc(ring->numberOfBuffers, sizeof(TPCircularBuffer));
+    if (!ring->buffers)
+    {
+        return false;
+    }
+
+    int32_t length = (int32_t)(capacityFrames * ring->bytesPerFrame);
+    ring->capacityFrames = capacityFrames;
+    for (UInt32 i = 0; i < ring->numberOfBuffers; i++)
+    {
+        if (!TPCircularBufferInit(&ring->buffers[i], length))
+        {
+            ring->numberOfBuffers = i;
+            EZAudioRingBufferCleanup(ring);
+            return false;
+        }
+
+        // the mirrored memory is page aligned so the true length may be larger
+        UInt32 frames = (UInt32)(ring->buffers[i].length / ring->bytesPerFrame);
+        if (i == 0 || frames < ring->capacityFrames)
+        {
+            ring->capacityFrames = frames;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioRingBufferCleanup(EZAudioRingBuffer *ring)
+{
+    if (ring->buffers)
+    {
+        for (UInt32 i = 0; i < ring->numberOfBuffers; i++)
+        {
+            TPCircularBufferCleanup(&ring->buffers[i]);
+        }
+        free(ring->buffers);
+    }
+    memset(ring, 0, sizeof(EZAudioRingBuffer));
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioRingBufferClear(EZAudioRingBuffer *ring)
+{
+    EZAudioRingBufferDiscard(ring, EZAudioRingBufferFillCount(ring));
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Producing
+//------------------------------------------------------------------------------
+
+UInt32 EZAudioRingBufferSpace(EZAudioRingBuffer *ring)
+{
+    if (!ring->buffers)
+    {
+        return 0;
+    }
+
+    UInt32 space = ring->capacityFrames;
+    for (UInt32 i = 0; i < ring->numberOfBuffers; i++)
+    {
+        int32_t availableBytes;
+        TPCircularBufferHead(&ring->buffers[i], &availableBytes);
+        UInt32 frames = (UInt32)availableBytes / ring->bytesPerFrame;
+        if (frames < space)
+        {
+            space = frames;
+        }
+    }
+    return space;
+}
+
+//------------------------------------------------------------------------------
+
+bool EZAudioRingBufferProduce(EZAudioRingBuffer *ring,
+                              const AudioBufferList *bufferList,
+                              UInt32 frames)
+{
+    if (frames == 0)
+    {
+        return true;
+    }
+
+    // The consumer only ever makes more space, so if every channel has room
+    // now it will still have room once we've written the ones before it.
+    if (EZAudioRingBufferSpace(ring) < frames)
+    {
+        OSAtomicIncrement32(&ring->overruns);
+        OSAtomicAdd64(frames, &ring->droppedFrames);
+        return false;
+    }
+
+    int32_t bytes = (int32_t)(frames * ring->bytesPerFrame);
+    for (UInt32 i = 0; i < ring->numberOfBuffers; i++)
+    {
+        TPCircularBufferProduceBytes(&ring->buffers[i], bufferList->mBuffers[i].mData, bytes);
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Consuming
+//------------------------------------------------------------------------------
+
+UInt32 EZAudioRingBufferFillCount(EZAudioRingBuffer *ring)
+{
+    if (!ring->buffers)
+    {
+        return 0;
+    }
+
+    // channels are written in order so the last one bounds what's complete
+    UInt32 fillCount = ring->capacityFrames;
+    for (UInt32 i = 0; i < ring->numberOfBuffers; i++)
+    {
+        int32_t availableBytes;
+        TPCircularBufferTail(&ring->buffers[i], &availableBytes);
+        UInt32 frames = (UInt32)availableBytes / ring->bytesPerFrame;
+        if (frames < fillCount)
+        {
+            fillCount = frames;
+        }
+    }
+    return fillCount;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 EZAudioRingBufferConsume(EZAudioRingBuffer *ring,
+                                AudioBufferList *bufferList,
+                                UInt32 frames)
+{
+    UInt32 available = EZAudioRingBufferFillCount(ring);
+    frames = frames < available ? frames : available;
+
+    int32_t bytes = (int32_t)(frames * ring->bytesPerFrame);
+    for (UInt32 i = 0; i < ring->numberOfBuffers; i++)
+    {
+        int32_t availableBytes;
+        void *tail = TPCircularBufferTail(&ring->buffers[i], &availableBytes);
+        if (bytes > 0)
+        {
+            memcpy(bufferList->mBuffers[i].mData, tail, bytes);
+            TPCircularBufferConsume(&ring->buffers[i], bytes);
+        }
+        bufferList->mBuffers[i].mDataByteSize = (UInt32)bytes;
+    }
+    return frames;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 EZAudioRingBufferDiscard(EZAudioRingBuffer *ring,
+                                UInt32 frames)
+{
+    UInt32 available = EZAudioRingBufferFillCount(ring);
+    frames = frames < available ? frames : available;
+    if (frames > 0)
+    {
+        int32_t bytes = (int32_t)(frames * ring->bytesPerFrame);
+        for (UInt32 i = 0; i < ring->numberOfBuffers; i++)
+        {
+            TPCircularBufferConsume(&ring->buffers[i], bytes);
+        }
+    }
+    return frames;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Counters
+//------------------------------------------------------------------------------
+
+UInt32 EZAudioRingBufferOverruns(EZAudioRingBuffer *ring)
+{
+    return (UInt32)ring->overruns;
+}
+
+//------------------------------------------------------------------------------
+
+SInt64 EZAudioRingBufferDroppedFrames(EZAudioRingBuffer *ring)
+{
+    return OSAtomicAdd64(0, &ring->droppedFrames);
+}
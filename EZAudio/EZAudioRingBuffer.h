@@ -0,0 +1,157 @@
+//
+//  EZAudioRingBuffer.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef EZAudioRingBuffer_h
+#define EZAudioRingBuffer_h
+
+#include <AudioToolbox/AudioToolbox.h>
+#include <stdbool.h>
+#include "TPCircularBuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioRingBuffer
+//------------------------------------------------------------------------------
+
+/**
+ A preallocated, lock-free ring of audio frames for handing AudioBufferLists from the realtime audio thread to another thread. It keeps one TPCircularBuffer per AudioBuffer of the stream format so non-interleaved audio stays non-interleaved, and a write either lands completely in every channel or is dropped and counted as an overrun.
+
+ Like the TPCircularBuffer it wraps, it is safe for a single producer and a single consumer. The counters may be read from any thread.
+ */
+typedef struct EZAudioRingBuffer
+{
+    TPCircularBuffer *buffers;
+    UInt32           numberOfBuffers;
+    UInt32           bytesPerFrame;
+    UInt32           capacityFrames;
+    volatile int32_t overruns;
+    volatile int64_t droppedFrames;
+} EZAudioRingBuffer;
+
+//------------------------------------------------------------------------------
+#pragma mark - Initialization
+//------------------------------------------------------------------------------
+
+/**
+ Allocates the ring for a stream format. Must not be called from the audio thread.
+ @param ring           The ring to initialize.
+ @param format         The linear PCM AudioStreamBasicDescription of the frames that will pass through the ring.
+ @param capacityFrames The minimum number of frames the ring must hold. The actual capacity is rounded up to the page size (see capacityFrames).
+ @return true on success, false if the memory could not be allocated.
+ */
+bool EZAudioRingBufferInit(EZAudioRingBuffer *ring,
+                           AudioStreamBasicDescription format,
+                           UInt32 capacityFrames);
+
+/**
+ Frees the ring's memory. Neither the producer nor the consumer may be using the ring.
+ @param ring The ring to clean up.
+ */
+void EZAudioRingBufferCleanup(EZAudioRingBuffer *ring);
+
+/**
+ Discards all frames in the ring. Consumer thread only.
+ @param ring The ring to clear.
+ */
+void EZAudioRingBufferClear(EZAudioRingBuffer *ring);
+
+//------------------------------------------------------------------------------
+#pragma mark - Producing
+//------------------------------------------------------------------------------
+
+/**
+ Copies frames into the ring. Safe to call from the realtime audio thread: it never locks or allocates. If there is not enough space for all of the frames in every channel nothing is written, the overrun counter is incremented and the frames are added to the dropped frame count.
+ @param ring       The ring to write into.
+ @param bufferList An AudioBufferList in the ring's format holding at least `frames` frames.
+ @param frames     The number of frames to write.
+ @return true if the frames were written, false on overrun.
+ */
+bool EZAudioRingBufferProduce(EZAudioRingBuffer *ring,
+                              const AudioBufferList *bufferList,
+                              UInt32 frames);
+
+/**
+ Provides the number of frames that can currently be written without an overrun. Producer thread only.
+ @param ring The ring.
+ @return The number of free frames.
+ */
+UInt32 EZAudioRingBufferSpace(EZAudioRingBuffer *ring);
+
+//------------------------------------------------------------------------------
+#pragma mark - Consuming
+//------------------------------------------------------------------------------
+
+/**
+ Provides the number of frames that have been written to every channel and can be consumed.
+ @param ring The ring.
+ @return The number of frames available.
+ */
+UInt32 EZAudioRingBufferFillCount(EZAudioRingBuffer *ring);
+
+/**
+ Copies up to `frames` frames out of the ring into a buffer list and removes them from the ring. Consumer thread only.
+ @param ring       The ring to read from.
+ @param bufferList An AudioBufferList in the ring's format with room for `frames` frames. Each buffer's mDataByteSize is set to the number of bytes copied.
+ @param frames     The maximum number of frames to copy.
+ @return The number of frames copied.
+ */
+UInt32 EZAudioRingBufferConsume(EZAudioRingBuffer *ring,
+                                AudioBufferList *bufferList,
+                                UInt32 frames);
+
+/**
+ Removes up to `frames` frames from the ring without copying them. Consumer thread only.
+ @param ring   The ring.
+ @param frames The maximum number of frames to discard.
+ @return The number of frames discarded.
+ */
+UInt32 EZAudioRingBufferDiscard(EZAudioRingBuffer *ring,
+                                UInt32 frames);
+
+//------------------------------------------------------------------------------
+#pragma mark - Counters
+//------------------------------------------------------------------------------
+
+/**
+ Provides the number of writes that were dropped because the ring was full.
+ @param ring The ring.
+ @return The overrun count.
+ */
+UInt32 EZAudioRingBufferOverruns(EZAudioRingBuffer *ring);
+
+/**
+ Provides the total number of frames that were dropped because the ring was full.
+ @param ring The ring.
+ @return The dropped frame count.
+ */
+SInt64 EZAudioRingBufferDroppedFrames(EZAudioRingBuffer *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
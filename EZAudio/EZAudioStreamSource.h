@@ -0,0 +1,225 @@
+//
+//  EZAudioStreamSource.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import "EZOutput.h"
+
+@class EZAudioFile;
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioStreamSource
+//------------------------------------------------------------------------------
+
+/**
+ The EZAudioStreamSource plays audio arriving over a network through an EZOutput (or an EZAudioMixer). Packets are enqueued from the network thread as they arrive, tagged with their position in the stream, and played out through an EZAudioJitterBuffer: the latency adapts to the measured arrival jitter, playout is sped up or slowed down by a fraction of a percent to hold it there, lost packets and underruns are concealed and a burst that overruns the maximum latency is dropped with a crossfade.
+
+ For testing without a network the source can replay an audio file to itself through an EZAudioPacketReplay, which delays, reorders and loses packets with a configurable jitter and loss rate.
+ */
+@interface EZAudioStreamSource : NSObject <EZOutputDataSource>
+
+//------------------------------------------------------------------------------
+#pragma mark - Properties
+//------------------------------------------------------------------------------
+
+/**
+ The format of the buffer lists the source fills, i.e. the output's `audioStreamBasicDescription` or a mixer's `sourceFormat`. The stream must have the same channel count and sample rate.
+ */
+@property (nonatomic, readonly) AudioStreamBasicDescription format;
+
+/**
+ The smallest latency in seconds, however steady the network. Default is 0.02 seconds.
+ */
+@property (nonatomic, readonly) NSTimeInterval minimumLatency;
+
+/**
+ The largest latency in seconds, however jittery the network. Anything buffered past this is dropped. Default is 0.5 seconds.
+ */
+@property (nonatomic, readonly) NSTimeInterval maximumLatency;
+
+/**
+ Whether a packet replay is running (see `startReplayingAudioFile:packetSize:delay:jitter:lossProbability:burstLength:`).
+ */
+@property (nonatomic, readonly) BOOL isReplaying;
+
+//------------------------------------------------------------------------------
+#pragma mark - Initializers
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Initializers
+///-----------------------------------------------------------
+
+/**
+ Creates a stream source with the default latency bounds.
+ @param format The format of the buffer lists the source fills. Must be packed native endian float or 16-bit integer linear PCM.
+ @return A newly created instance of the EZAudioStreamSource class.
+ */
+- (instancetype)initWithFormat:(AudioStreamBasicDescription)format;
+
+//------------------------------------------------------------------------------
+
+/**
+ Creates a stream source.
+ @param format         The format of the buffer lists the source fills. Must be packed native endian float or 16-bit integer linear PCM.
+ @param minimumLatency The smallest latency in seconds.
+ @param maximumLatency The largest latency in seconds.
+ @return A newly created instance of the EZAudioStreamSource class.
+ */
+- (instancetype)initWithFormat:(AudioStreamBasicDescription)format
+                minimumLatency:(NSTimeInterval)minimumLatency
+                maximumLatency:(NSTimeInterval)maximumLatency;
+
+//------------------------------------------------------------------------------
+
+/**
+ Class method to create a stream source with the default latency bounds.
+ @param format The format of the buffer lists the source fills. Must be packed native endian float or 16-bit integer linear PCM.
+ @return A newly created instance of the EZAudioStreamSource class.
+ */
++ (instancetype)streamSourceWithFormat:(AudioStreamBasicDescription)format;
+
+//------------------------------------------------------------------------------
+#pragma mark - Enqueuing
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Enqueuing Packets
+///-----------------------------------------------------------
+
+/**
+ Enqueues a packet of float samples as it arrives. Packets must be enqueued from one thread at a time.
+ @param buffer     One float array per channel.
+ @param bufferSize The number of frames in the packet.
+ @param frameIndex The position of the packet's first frame in the stream (i.e. an RTP timestamp). Consecutive packets are contiguous, a jump forward is a gap to conceal and a jump back is a late packet.
+ */
+- (void)enqueueBuffer:(float **)buffer
+       withBufferSize:(UInt32)bufferSize
+           frameIndex:(SInt64)frameIndex;
+
+//------------------------------------------------------------------------------
+
+/**
+ Enqueues a packet in the source's `format` as it arrives. Packets must be enqueued from one thread at a time.
+ @param bufferList The AudioBufferList holding the packet.
+ @param bufferSize The number of frames in the packet.
+ @param frameIndex The position of the packet's first frame in the stream.
+ */
+- (void)enqueueBufferList:(AudioBufferList *)bufferList
+           withBufferSize:(UInt32)bufferSize
+               frameIndex:(SInt64)frameIndex;
+
+//------------------------------------------------------------------------------
+
+/**
+ Empties the source and forgets the stream, i.e. before playing a new stream. Safe while an output is pulling from the source, which plays silence until the reset is done.
+ @warning Do not call this while packets are being enqueued.
+ */
+- (void)reset;
+
+//------------------------------------------------------------------------------
+#pragma mark - Replaying
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Replaying A File As A Network Stream
+///-----------------------------------------------------------
+
+/**
+ Starts a thread that cuts an audio file into packets and enqueues them as they would arrive over a network with the given delay, jitter and loss. The file loops forever. Resets the source first. Don't enqueue any other packets while replaying.
+ @param audioFile       The EZAudioFile to replay. Its client format is set to float at the source's channel count and sample rate.
+ @param packetSize      The number of frames in each packet.
+ @param delay           The fixed part of the transit time in seconds.
+ @param jitter          The mean of the random part of the transit time in seconds.
+ @param lossProbability The fraction of packets lost, from 0 to 1.
+ @param burstLength     The mean number of packets lost in a row (1 for independent losses).
+ */
+- (void)startReplayingAudioFile:(EZAudioFile *)audioFile
+                     packetSize:(UInt32)packetSize
+                          delay:(NSTimeInterval)delay
+                         jitter:(NSTimeInterval)jitter
+                lossProbability:(float)lossProbability
+                    burstLength:(float)burstLength;
+
+//------------------------------------------------------------------------------
+
+/**
+ Stops the packet replay thread and waits for it to finish.
+ */
+- (void)stopReplaying;
+
+//------------------------------------------------------------------------------
+#pragma mark - Getters
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Getting The Playout Statistics
+///-----------------------------------------------------------
+
+/**
+ Provides the arrival jitter estimated from the packets' transit times.
+ @return The mean jitter in seconds.
+ */
+- (NSTimeInterval)jitter;
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides the latency the playout is currently steered towards, adapted to the jitter.
+ @return The target latency in seconds.
+ */
+- (NSTimeInterval)targetLatency;
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides the amount of audio currently buffered.
+ @return The latency in seconds.
+ */
+- (NSTimeInterval)latency;
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides the number of times the source ran dry and had to rebuffer.
+ @return The underrun count.
+ */
+- (UInt32)underruns;
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides the number of frames concealed in place of lost packets and underruns.
+ @return The concealed frame count.
+ */
+- (UInt64)concealedFrames;
+
+//------------------------------------------------------------------------------
+
+/**
+ Provides the number of frames never played because they arrived too late or overran the maximum latency.
+ @return The dropped frame count.
+ */
+- (UInt64)droppedFrames;
+
+@end
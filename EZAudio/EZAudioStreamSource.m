@@ -0,0 +1,403 @@
+//
+//  EZAudioStreamSource.m
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#import "EZAudioStreamSource.h"
+
+//------------------------------------------------------------------------------
+
+#import "EZAudio.h"
+#include <mach/mach_time.h>
+#include <pthread.h>
+
+//------------------------------------------------------------------------------
+
+// constants
+static const UInt32 EZAudioStreamSourceMaximumFrames = 4096;
+static const NSTimeInterval EZAudioStreamSourceDefaultMinimumLatency = 0.02;
+static const NSTimeInterval EZAudioStreamSourceDefaultMaximumLatency = 0.5;
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioStreamSource
+//------------------------------------------------------------------------------
+
+@interface EZAudioStreamSource ()
+{
+    EZAudioJitterBuffer    *_jitterBuffer;
+    const EZAudioDSPKernel *_kernel;
+    UInt32                 _channels;
+    float                  **_packetBuffers;
+    float                  **_playoutBuffers;
+    double                 _hostTicksToSeconds;
+
+    // the output plays silence while the jitter buffer is reset, and a reset waits out a read that's already running
+    volatile BOOL          _resetting;
+    volatile int64_t       _renderEpoch;
+
+    // packet replay
+    pthread_t              _replayThread;
+    volatile BOOL          _replaying;
+    BOOL                   _replayStarted;
+    EZAudioPacketReplay    *_replay;
+    EZAudioFile            *_replayFile;
+    UInt32                 _replayPacketSize;
+}
+@property (nonatomic, readwrite) AudioStreamBasicDescription format;
+@property (nonatomic, readwrite) NSTimeInterval minimumLatency;
+@property (nonatomic, readwrite) NSTimeInterval maximumLatency;
+@end
+
+//------------------------------------------------------------------------------
+
+@implementation EZAudioStreamSource
+
+//------------------------------------------------------------------------------
+#pragma mark - Dealloc
+//------------------------------------------------------------------------------
+
+- (void)dealloc
+{
+    [self stopReplaying];
+    EZAudioJitterBufferFree(_jitterBuffer);
+    [EZAudio freeFloatBuffers:_packetBuffers numberOfChannels:_channels];
+    [EZAudio freeFloatBuffers:_playoutBuffers numberOfChannels:_channels];
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Initialization
+//------------------------------------------------------------------------------
+
+- (instancetype)initWithFormat:(AudioStreamBasicDescription)format
+{
+    return [self initWithFormat:format
+                 minimumLatency:EZAudioStreamSourceDefaultMinimumLatency
+                 maximumLatency:EZAudioStreamSourceDefaultMaximumLatency];
+}
+
+//------------------------------------------------------------------------------
+
+- (instancetype)initWithFormat:(AudioStreamBasicDescription)format
+                minimumLatency:(NSTimeInterval)minimumLatency
+                maximumLatency:(NSTimeInterval)maximumLatency
+{
+    self = [super init];
+    if (self)
+    {
+        _kernel = EZAudioDSPKernelForFormat(format);
+        NSAssert(_kernel, @"The stream source's format must be packed native endian float or 16-bit integer linear PCM");
+        _format = format;
+        _channels = format.mChannelsPerFrame;
+        _minimumLatency = minimumLatency;
+        _maximumLatency = maximumLatency;
+        _jitterBuffer = EZAudioJitterBufferCreate(_channels,
+                                                  format.mSampleRate,
+                                                  minimumLatency,
+                                                  maximumLatency);
+        NSAssert(_jitterBuffer, @"Could not create the stream source's jitter buffer");
+        _packetBuffers = [EZAudio floatBuffersWithNumberOfFrames:EZAudioStreamSourceMaximumFrames
+                                                numberOfChannels:_channels];
+        _playoutBuffers = [EZAudio floatBuffersWithNumberOfFrames:EZAudioStreamSourceMaximumFrames
+                                                 numberOfChannels:_channels];
+
+        mach_timebase_info_data_t timebase;
+        mach_timebase_info(&timebase);
+        _hostTicksToSeconds = 1.0e-9 * (double)timebase.numer / (double)timebase.denom;
+    }
+    return self;
+}
+
+//------------------------------------------------------------------------------
+
++ (instancetype)streamSourceWithFormat:(AudioStreamBasicDescription)format
+{
+    return [[self alloc] initWithFormat:format];
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Enqueuing
+//------------------------------------------------------------------------------
+
+- (void)enqueueBuffer:(float **)buffer
+       withBufferSize:(UInt32)bufferSize
+           frameIndex:(SInt64)frameIndex
+{
+    double time = _hostTicksToSeconds * (double)mach_absolute_time();
+    EZAudioJitterBufferWrite(_jitterBuffer,
+                             (const float * const *)buffer,
+                             bufferSize,
+                             frameIndex,
+                             time);
+}
+
+//------------------------------------------------------------------------------
+
+- (void)enqueueBufferList:(AudioBufferList *)bufferList
+           withBufferSize:(UInt32)bufferSize
+               frameIndex:(SInt64)frameIndex
+{
+    // the packet keeps its arrival time however many pieces it's converted in
+    double time = _hostTicksToSeconds * (double)mach_absolute_time();
+    for (UInt32 offset = 0; offset < bufferSize; offset += EZAudioStreamSourceMaximumFrames)
+    {
+        UInt32 frames = MIN(bufferSize - offset, EZAudioStreamSourceMaximumFrames);
+        _kernel->toFloat(bufferList, offset, _packetBuffers, frames, _channels);
+        EZAudioJitterBufferWrite(_jitterBuffer,
+                                 (const float * const *)_packetBuffers,
+                                 frames,
+                                 frameIndex + offset,
+                                 time);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+- (void)reset
+{
+    _resetting = YES;
+    OSMemoryBarrier();
+    int64_t epoch = _renderEpoch;
+    while ((epoch & 1) && _renderEpoch == epoch)
+    {
+        usleep(1000);
+    }
+    EZAudioJitterBufferReset(_jitterBuffer);
+    OSMemoryBarrier();
+    _resetting = NO;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Replaying
+//------------------------------------------------------------------------------
+
+static void *replayThread(void *context)
+{
+    @autoreleasepool
+    {
+        [(__bridge EZAudioStreamSource *)context runReplay];
+    }
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+
+- (void)startReplayingAudioFile:(EZAudioFile *)audioFile
+                     packetSize:(UInt32)packetSize
+                          delay:(NSTimeInterval)delay
+                         jitter:(NSTimeInterval)jitter
+                lossProbability:(float)lossProbability
+                    burstLength:(float)burstLength
+{
+    [self stopReplaying];
+    [self reset];
+
+    _replayPacketSize = MIN(MAX(packetSize, 1), EZAudioStreamSourceMaximumFrames);
+    _replay = EZAudioPacketReplayCreate(self.format.mSampleRate,
+                                        _replayPacketSize,
+                                        delay,
+                                        jitter,
+                                        lossProbability,
+                                        burstLength,
+                                        arc4random());
+    if (!_replay)
+    {
+        NSLog(@"Stream source could not create a packet replay (invalid delay, jitter, loss probability or burst length)");
+        return;
+    }
+    _replayFile = audioFile;
+    _replayFile.clientFormat = [EZAudio floatFormatWithNumberOfChannels:_channels
+                                                             sampleRate:self.format.mSampleRate];
+
+    _replaying = YES;
+    int error = pthread_create(&_replayThread, NULL, replayThread, (__bridge void *)self);
+    if (error)
+    {
+        _replaying = NO;
+        NSLog(@"Stream source failed to start the replay thread (%d)", error);
+        [self freeReplay];
+        return;
+    }
+    _replayStarted = YES;
+}
+
+//------------------------------------------------------------------------------
+
+- (void)stopReplaying
+{
+    if (_replayStarted)
+    {
+        _replaying = NO;
+        pthread_join(_replayThread, NULL);
+        _replayStarted = NO;
+        [self freeReplay];
+    }
+}
+
+//------------------------------------------------------------------------------
+
+- (BOOL)isReplaying
+{
+    return _replaying;
+}
+
+//------------------------------------------------------------------------------
+
+- (void)runReplay
+{
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    double ticksPerSecond = 1.0e9 * (double)timebase.denom / (double)timebase.numer;
+
+    SInt64 totalFrames = _replayFile.totalClientFrames;
+    // the buffer list points into the packet buffers while reading
+    AudioBufferList *bufferList = (AudioBufferList *)malloc(offsetof(AudioBufferList, mBuffers[0]) + sizeof(AudioBuffer) * _channels);
+    bufferList->mNumberBuffers = _channels;
+    for (UInt32 channel = 0; channel < _channels; channel++)
+    {
+        bufferList->mBuffers[channel].mNumberChannels = 1;
+    }
+    UInt64 startTime = mach_absolute_time();
+    while (_replaying && totalFrames > 0)
+    {
+        @autoreleasepool
+        {
+            // hand each packet over when it would have arrived
+            EZAudioPacketReplayPacket packet;
+            EZAudioPacketReplayNext(_replay, &packet);
+            UInt64 arrivalTime = startTime + (UInt64)(packet.arrivalTime * ticksPerSecond);
+            mach_wait_until(arrivalTime);
+
+            // the file loops, so a packet can wrap around its end
+            UInt32 read = 0;
+            while (read < packet.frames)
+            {
+                for (UInt32 channel = 0; channel < _channels; channel++)
+                {
+                    bufferList->mBuffers[channel].mData = _packetBuffers[channel] + read;
+                    bufferList->mBuffers[channel].mDataByteSize = (packet.frames - read) * sizeof(float);
+                }
+                [_replayFile seekToFrame:(packet.frameIndex + read) % totalFrames];
+                UInt32 bufferSize = 0;
+                BOOL eof = NO;
+                [_replayFile readFrames:packet.frames - read
+                        audioBufferList:bufferList
+                             bufferSize:&bufferSize
+                                    eof:&eof];
+                if (bufferSize == 0)
+                {
+                    break;
+                }
+                read += bufferSize;
+            }
+
+            EZAudioJitterBufferWrite(_jitterBuffer,
+                                     (const float * const *)_packetBuffers,
+                                     read,
+                                     packet.frameIndex,
+                                     _hostTicksToSeconds * (double)arrivalTime);
+        }
+    }
+
+    free(bufferList);
+    _replaying = NO;
+}
+
+//------------------------------------------------------------------------------
+
+- (void)freeReplay
+{
+    EZAudioPacketReplayFree(_replay);
+    _replay = NULL;
+    _replayFile = nil;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Getters
+//------------------------------------------------------------------------------
+
+- (NSTimeInterval)jitter
+{
+    return EZAudioJitterBufferJitter(_jitterBuffer);
+}
+
+//------------------------------------------------------------------------------
+
+- (NSTimeInterval)targetLatency
+{
+    return EZAudioJitterBufferTargetLatency(_jitterBuffer);
+}
+
+//------------------------------------------------------------------------------
+
+- (NSTimeInterval)latency
+{
+    return EZAudioJitterBufferLatency(_jitterBuffer);
+}
+
+//------------------------------------------------------------------------------
+
+- (UInt32)underruns
+{
+    return EZAudioJitterBufferUnderruns(_jitterBuffer);
+}
+
+//------------------------------------------------------------------------------
+
+- (UInt64)concealedFrames
+{
+    return EZAudioJitterBufferConcealedFrames(_jitterBuffer);
+}
+
+//------------------------------------------------------------------------------
+
+- (UInt64)droppedFrames
+{
+    return EZAudioJitterBufferDroppedFrames(_jitterBuffer);
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - EZOutputDataSource
+//------------------------------------------------------------------------------
+
+- (void)             output:(EZOutput *)output
+  shouldFillAudioBufferList:(AudioBufferList *)audioBufferList
+         withNumberOfFrames:(UInt32)frames
+{
+    // odd while reading so a reset on another thread waits for this read to finish
+    OSAtomicIncrement64Barrier(&_renderEpoch);
+    if (_resetting)
+    {
+        _kernel->clear(audioBufferList, 0, frames, _channels);
+    }
+    else
+    {
+        for (UInt32 offset = 0; offset < frames; offset += EZAudioStreamSourceMaximumFrames)
+        {
+            UInt32 chunk = MIN(frames - offset, EZAudioStreamSourceMaximumFrames);
+            EZAudioJitterBufferRead(_jitterBuffer, _playoutBuffers, chunk);
+            _kernel->fromFloat(_playoutBuffers, audioBufferList, offset, chunk, _channels);
+        }
+    }
+    OSAtomicIncrement64Barrier(&_renderEpoch);
+}
+
+@end
@@ -0,0 +1,527 @@
+//
+//  EZAudioTimeStretcher.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+#include "EZAudioTimeStretcher.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// not part of strict C
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//------------------------------------------------------------------------------
+
+// the rate is clamped to this range
+static const double EZAudioTimeStretcherMinimumRate = 0.25;
+static const double EZAudioTimeStretcherMaximumRate = 4.0;
+
+// the most frames a single read produces, larger reads are split up
+static const uint32_t EZAudioTimeStretcherMaximumReadFrames = 4096;
+
+//------------------------------------------------------------------------------
+
+// window duration, search range either way and coarse search stride per quality
+typedef struct
+{
+    double   window;
+    double   search;
+    uint32_t stride;
+} EZAudioTimeStretcherSettings;
+
+static const EZAudioTimeStretcherSettings EZAudioTimeStretcherQualitySettings[] =
+{
+    { 0.020, 0.008, 4 },
+    { 0.030, 0.012, 2 },
+    { 0.040, 0.015, 1 }
+};
+
+//------------------------------------------------------------------------------
+
+struct EZAudioTimeStretcher
+{
+    uint32_t        channels;
+    uint32_t        windowFrames;
+    uint32_t        hopFrames;
+    uint32_t        searchFrames;
+    uint32_t        stride;
+    float           *window;
+    volatile double rate;
+
+    // input, the mono mix is what the search correlates
+    float           **input;
+    float           *mono;
+    uint32_t        inputCapacity;
+    uint32_t        inputFrames;
+    double          position;
+    int64_t         previous;
+    int             started;
+
+    // overlap-add and the finished output
+    float           **overlap;
+    float           **output;
+    uint32_t        outputCapacity;
+    uint32_t        outputFrames;
+
+    // search scratch
+    double          *energy;
+};
+
+//------------------------------------------------------------------------------
+#pragma mark - Utility
+//------------------------------------------------------------------------------
+
+static float **EZAudioTimeStretcherAllocateBuffers(uint32_t channels, uint32_t frames)
+{
+    float **buffers = (float **)calloc(channels, sizeof(float *));
+    if (!buffers)
+    {
+        return NULL;
+    }
+    for (uint32_t channel = 0; channel < channels; channel++)
+    {
+        buffers[channel] = (float *)calloc(frames, sizeof(float));
+        if (!buffers[channel])
+        {
+            return buffers;
+        }
+    }
+    return buffers;
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioTimeStretcherFreeBuffers(float **buffers, uint32_t channels)
+{
+    if (buffers)
+    {
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            free(buffers[channel]);
+        }
+        free(buffers);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static int EZAudioTimeStretcherBuffersAllocated(float **buffers, uint32_t channels)
+{
+    if (!buffers)
+    {
+        return 0;
+    }
+    for (uint32_t channel = 0; channel < channels; channel++)
+    {
+        if (!buffers[channel])
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+
+// four lanes accumulated separately so the compiler can vectorize without reassociating
+static float EZAudioTimeStretcherDot(const float *__restrict a,
+                                     const float *__restrict b,
+                                     uint32_t length)
+{
+    float sums[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    uint32_t blocks = length & ~3u;
+    for (uint32_t i = 0; i < blocks; i += 4)
+    {
+        sums[0] += a[i]     * b[i];
+        sums[1] += a[i + 1] * b[i + 1];
+        sums[2] += a[i + 2] * b[i + 2];
+        sums[3] += a[i + 3] * b[i + 3];
+    }
+    for (uint32_t i = blocks; i < length; i++)
+    {
+        sums[0] += a[i] * b[i];
+    }
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+EZAudioTimeStretcher *EZAudioTimeStretcherCreate(uint32_t channels,
+                                                 double sampleRate,
+                                                 EZAudioTimeStretcherQuality quality)
+{
+    if (channels == 0 || sampleRate <= 0.0 || quality > EZAudioTimeStretcherQualityHigh)
+    {
+        return NULL;
+    }
+    EZAudioTimeStretcher *timeStretcher = (EZAudioTimeStretcher *)calloc(1, sizeof(EZAudioTimeStretcher));
+    if (!timeStretcher)
+    {
+        return NULL;
+    }
+
+    // an even window so the hop is exactly half of it
+    EZAudioTimeStretcherSettings settings = EZAudioTimeStretcherQualitySettings[quality];
+    timeStretcher->channels = channels;
+    timeStretcher->hopFrames = (uint32_t)(settings.window * sampleRate / 2.0) > 0 ? (uint32_t)(settings.window * sampleRate / 2.0) : 1;
+    timeStretcher->windowFrames = 2 * timeStretcher->hopFrames;
+    timeStretcher->searchFrames = (uint32_t)(settings.search * sampleRate);
+    timeStretcher->stride = settings.stride;
+    timeStretcher->rate = 1.0;
+
+    // the input for the largest read at the fastest rate, plus a window past the farthest search position
+    timeStretcher->inputCapacity = timeStretcher->windowFrames + 2 * timeStretcher->searchFrames +
+                                   (uint32_t)ceil(EZAudioTimeStretcherMaximumRate * (EZAudioTimeStretcherMaximumReadFrames + 2 * timeStretcher->hopFrames));
+    timeStretcher->outputCapacity = EZAudioTimeStretcherMaximumReadFrames + timeStretcher->hopFrames;
+
+    // a periodic Hann window, two of them half a window apart sum to one
+    timeStretcher->window = (float *)malloc(timeStretcher->windowFrames * sizeof(float));
+    timeStretcher->input = EZAudioTimeStretcherAllocateBuffers(channels, timeStretcher->inputCapacity);
+    timeStretcher->mono = (float *)calloc(timeStretcher->inputCapacity, sizeof(float));
+    timeStretcher->overlap = EZAudioTimeStretcherAllocateBuffers(channels, timeStretcher->windowFrames);
+    timeStretcher->output = EZAudioTimeStretcherAllocateBuffers(channels, timeStretcher->outputCapacity);
+    timeStretcher->energy = (double *)malloc((2 * timeStretcher->searchFrames + timeStretcher->hopFrames + 1) * sizeof(double));
+    if (!timeStretcher->window || !timeStretcher->mono || !timeStretcher->energy ||
+        !EZAudioTimeStretcherBuffersAllocated(timeStretcher->input, channels) ||
+        !EZAudioTimeStretcherBuffersAllocated(timeStretcher->overlap, channels) ||
+        !EZAudioTimeStretcherBuffersAllocated(timeStretcher->output, channels))
+    {
+        EZAudioTimeStretcherFree(timeStretcher);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < timeStretcher->windowFrames; i++)
+    {
+        timeStretcher->window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / timeStretcher->windowFrames));
+    }
+
+    EZAudioTimeStretcherReset(timeStretcher);
+    return timeStretcher;
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioTimeStretcherFree(EZAudioTimeStretcher *timeStretcher)
+{
+    if (timeStretcher)
+    {
+        free(timeStretcher->window);
+        EZAudioTimeStretcherFreeBuffers(timeStretcher->input, timeStretcher->channels);
+        free(timeStretcher->mono);
+        EZAudioTimeStretcherFreeBuffers(timeStretcher->overlap, timeStretcher->channels);
+        EZAudioTimeStretcherFreeBuffers(timeStretcher->output, timeStretcher->channels);
+        free(timeStretcher->energy);
+        free(timeStretcher);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioTimeStretcherReset(EZAudioTimeStretcher *timeStretcher)
+{
+    timeStretcher->inputFrames = 0;
+    timeStretcher->outputFrames = 0;
+    timeStretcher->position = 0.0;
+    timeStretcher->previous = 0;
+    timeStretcher->started = 0;
+    for (uint32_t channel = 0; channel < timeStretcher->channels; channel++)
+    {
+        memset(timeStretcher->overlap[channel], 0, timeStretcher->windowFrames * sizeof(float));
+    }
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Rate
+//------------------------------------------------------------------------------
+
+void EZAudioTimeStretcherSetRate(EZAudioTimeStretcher *timeStretcher,
+                                 double rate)
+{
+    timeStretcher->rate = fmin(fmax(rate, EZAudioTimeStretcherMinimumRate), EZAudioTimeStretcherMaximumRate);
+}
+
+//------------------------------------------------------------------------------
+
+double EZAudioTimeStretcherRate(EZAudioTimeStretcher *timeStretcher)
+{
+    return timeStretcher->rate;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Search
+//------------------------------------------------------------------------------
+
+// the score is the normalized cross-correlation squared (keeping its sign) so no square root is needed
+static double EZAudioTimeStretcherScore(EZAudioTimeStretcher *timeStretcher,
+                                        const float *template,
+                                        int64_t candidate,
+                                        int64_t from)
+{
+    uint32_t length = timeStretcher->hopFrames;
+    double correlation = EZAudioTimeStretcherDot(template, timeStretcher->mono + candidate, length);
+    double energy = timeStretcher->energy[candidate - from + length] - timeStretcher->energy[candidate - from];
+    return correlation * fabs(correlation) / (energy + 1.0e-9);
+}
+
+//------------------------------------------------------------------------------
+
+// finds the segment start within the search range whose first half best continues the previous segment
+static int64_t EZAudioTimeStretcherSearch(EZAudioTimeStretcher *timeStretcher,
+                                          int64_t nominal)
+{
+    int64_t from = nominal - timeStretcher->searchFrames;
+    int64_t to = nominal + timeStretcher->searchFrames;
+    from = from > 0 ? from : 0;
+    const float *template = timeStretcher->mono + timeStretcher->previous + timeStretcher->hopFrames;
+
+    // running energy so each candidate's is a subtraction
+    uint32_t length = (uint32_t)(to - from) + timeStretcher->hopFrames;
+    double *energy = timeStretcher->energy;
+    energy[0] = 0.0;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        float sample = timeStretcher->mono[from + i];
+        energy[i + 1] = energy[i] + sample * sample;
+    }
+
+    // coarse pass over every stride-th lag, then every lag around the best of them
+    int64_t best = nominal;
+    double bestScore = -INFINITY;
+    int64_t stride = timeStretcher->stride;
+    for (int64_t candidate = from; candidate <= to; candidate += stride)
+    {
+        double score = EZAudioTimeStretcherScore(timeStretcher, template, candidate, from);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            best = candidate;
+        }
+    }
+    if (stride > 1)
+    {
+        int64_t coarse = best;
+        for (int64_t candidate = coarse - stride + 1; candidate < coarse + stride; candidate++)
+        {
+            if (candidate == coarse || candidate < from || candidate > to)
+            {
+                continue;
+            }
+            double score = EZAudioTimeStretcherScore(timeStretcher, template, candidate, from);
+            if (score > bestScore)
+            {
+                bestScore = score;
+                best = candidate;
+            }
+        }
+    }
+    return best;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Processing
+//------------------------------------------------------------------------------
+
+// overlap-adds segments until there are enough output frames, only as many as
+// a read needs so the work per render stays proportional to its length
+static void EZAudioTimeStretcherProcess(EZAudioTimeStretcher *timeStretcher,
+                                        uint32_t frames)
+{
+    uint32_t channels = timeStretcher->channels;
+    uint32_t hopFrames = timeStretcher->hopFrames;
+    uint32_t windowFrames = timeStretcher->windowFrames;
+    while (timeStretcher->outputFrames < frames &&
+           timeStretcher->outputFrames + hopFrames <= timeStretcher->outputCapacity)
+    {
+        // the search needs a whole window past its farthest candidate
+        int64_t nominal = (int64_t)floor(timeStretcher->position + 0.5);
+        int64_t candidate = nominal;
+        if (nominal + timeStretcher->searchFrames + windowFrames > timeStretcher->inputFrames)
+        {
+            break;
+        }
+        if (timeStretcher->started)
+        {
+            candidate = EZAudioTimeStretcherSearch(timeStretcher, nominal);
+        }
+
+        // the very first segment starts at full gain so playback doesn't fade in
+        int first = !timeStretcher->started;
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            const float *segment = timeStretcher->input[channel] + candidate;
+            float *overlap = timeStretcher->overlap[channel];
+            for (uint32_t i = 0; i < windowFrames; i++)
+            {
+                float gain = (first && i < hopFrames) ? 1.0f : timeStretcher->window[i];
+                overlap[i] += gain * segment[i];
+            }
+
+            // the first half is finished, the second waits for the next segment
+            memcpy(timeStretcher->output[channel] + timeStretcher->outputFrames, overlap, hopFrames * sizeof(float));
+            memmove(overlap, overlap + hopFrames, hopFrames * sizeof(float));
+            memset(overlap + hopFrames, 0, hopFrames * sizeof(float));
+        }
+        timeStretcher->outputFrames += hopFrames;
+        timeStretcher->previous = candidate;
+        timeStretcher->started = 1;
+        timeStretcher->position += hopFrames * timeStretcher->rate;
+    }
+
+    // drop the input the next segment's template and search can no longer reach
+    int64_t keep = (int64_t)floor(timeStretcher->position + 0.5) - timeStretcher->searchFrames;
+    if (timeStretcher->started && timeStretcher->previous + hopFrames < keep)
+    {
+        keep = timeStretcher->previous + hopFrames;
+    }
+    if (keep > (int64_t)timeStretcher->inputFrames)
+    {
+        keep = timeStretcher->inputFrames;
+    }
+    if (keep > 0)
+    {
+        uint32_t remaining = timeStretcher->inputFrames - (uint32_t)keep;
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            memmove(timeStretcher->input[channel], timeStretcher->input[channel] + keep, remaining * sizeof(float));
+        }
+        memmove(timeStretcher->mono, timeStretcher->mono + keep, remaining * sizeof(float));
+        timeStretcher->inputFrames = remaining;
+        timeStretcher->position -= keep;
+        timeStretcher->previous -= keep;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioTimeStretcherInputFramesNeeded(EZAudioTimeStretcher *timeStretcher,
+                                               uint32_t frames)
+{
+    // the segments still to come and how far into the input the last of them reaches
+    frames = frames < EZAudioTimeStretcherMaximumReadFrames ? frames : EZAudioTimeStretcherMaximumReadFrames;
+    if (timeStretcher->outputFrames >= frames)
+    {
+        return 0;
+    }
+    uint32_t segments = (frames - timeStretcher->outputFrames + timeStretcher->hopFrames - 1) / timeStretcher->hopFrames;
+    double last = timeStretcher->position + (segments - 1) * timeStretcher->hopFrames * timeStretcher->rate;
+    int64_t end = (int64_t)floor(last + 0.5) + timeStretcher->searchFrames + timeStretcher->windowFrames;
+    int64_t needed = end - (int64_t)timeStretcher->inputFrames;
+    int64_t writable = EZAudioTimeStretcherWritableFrames(timeStretcher);
+    return (uint32_t)(needed <= 0 ? 0 : (needed < writable ? needed : writable));
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioTimeStretcherWritableFrames(EZAudioTimeStretcher *timeStretcher)
+{
+    return timeStretcher->inputCapacity - timeStretcher->inputFrames;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioTimeStretcherWrite(EZAudioTimeStretcher *timeStretcher,
+                                   const float * const *source,
+                                   uint32_t frames)
+{
+    uint32_t writable = EZAudioTimeStretcherWritableFrames(timeStretcher);
+    frames = frames < writable ? frames : writable;
+
+    uint32_t channels = timeStretcher->channels;
+    uint32_t offset = timeStretcher->inputFrames;
+    float *mono = timeStretcher->mono + offset;
+    float scale = 1.0f / channels;
+    for (uint32_t channel = 0; channel < channels; channel++)
+    {
+        memcpy(timeStretcher->input[channel] + offset, source[channel], frames * sizeof(float));
+    }
+    memcpy(mono, source[0], frames * sizeof(float));
+    for (uint32_t channel = 1; channel < channels; channel++)
+    {
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            mono[i] += source[channel][i];
+        }
+    }
+    if (channels > 1)
+    {
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            mono[i] *= scale;
+        }
+    }
+    timeStretcher->inputFrames += frames;
+    return frames;
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioTimeStretcherFlush(EZAudioTimeStretcher *timeStretcher)
+{
+    // the last segment can start up to a search range late and needs a whole window
+    uint32_t frames = timeStretcher->windowFrames + 2 * timeStretcher->searchFrames;
+    uint32_t writable = EZAudioTimeStretcherWritableFrames(timeStretcher);
+    frames = frames < writable ? frames : writable;
+
+    uint32_t offset = timeStretcher->inputFrames;
+    for (uint32_t channel = 0; channel < timeStretcher->channels; channel++)
+    {
+        memset(timeStretcher->input[channel] + offset, 0, frames * sizeof(float));
+    }
+    memset(timeStretcher->mono + offset, 0, frames * sizeof(float));
+    timeStretcher->inputFrames += frames;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioTimeStretcherRead(EZAudioTimeStretcher *timeStretcher,
+                                  float * const *destination,
+                                  uint32_t frames)
+{
+    uint32_t read = 0;
+    while (read < frames)
+    {
+        uint32_t wanted = frames - read;
+        wanted = wanted < EZAudioTimeStretcherMaximumReadFrames ? wanted : EZAudioTimeStretcherMaximumReadFrames;
+        EZAudioTimeStretcherProcess(timeStretcher, wanted);
+
+        uint32_t count = wanted < timeStretcher->outputFrames ? wanted : timeStretcher->outputFrames;
+        uint32_t remaining = timeStretcher->outputFrames - count;
+        for (uint32_t channel = 0; channel < timeStretcher->channels; channel++)
+        {
+            float *output = timeStretcher->output[channel];
+            memcpy(destination[channel] + read, output, count * sizeof(float));
+            memmove(output, output + count, remaining * sizeof(float));
+        }
+        timeStretcher->outputFrames = remaining;
+        read += count;
+
+        // out of input
+        if (count < wanted)
+        {
+            break;
+        }
+    }
+    return read;
+}
@@ -0,0 +1,163 @@
+//
+//  EZAudioTimeStretcher.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+#ifndef EZAudioTimeStretcher_h
+#define EZAudioTimeStretcher_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioTimeStretcher
+//------------------------------------------------------------------------------
+
+/**
+ Changes the speed of audio without changing its pitch using WSOLA (waveform similarity overlap-add). The output is built from Hann windowed segments of the input overlapping by half a window. Each segment is taken from around where the playback rate says the input should be by now, and the exact spot is picked within a small search range to be the one that best continues the segment before it, measured by normalized cross-correlation over the overlap. Since the overlapping waveforms line up, nothing is smeared the way a phase vocoder smears transients and speech stays intelligible at 3x.
+
+ The cross-correlation runs on a mono mix of the channels with four wide loops the compiler vectorizes. Its cost depends only on the window and search lengths, never the rate, so the time spent per output frame is bounded. The EZAudioTimeStretcherQuality trades the two off against CPU.
+
+ This is plain C without any Core Audio dependencies so it can be benchmarked offline (i.e. on Linux). It is not thread safe apart from the rate, which can be changed from any thread while the audio thread writes and reads.
+ */
+typedef struct EZAudioTimeStretcher EZAudioTimeStretcher;
+
+/**
+ The window and search lengths of an EZAudioTimeStretcher.
+ */
+typedef enum
+{
+    /**
+     20 ms windows searched 8 ms either way at every 4th lag, refined around the best. The cheapest, fine for speech.
+     */
+    EZAudioTimeStretcherQualityLow,
+    /**
+     30 ms windows searched 12 ms either way at every 2nd lag, refined around the best.
+     */
+    EZAudioTimeStretcherQualityMedium,
+    /**
+     40 ms windows searched 15 ms either way at every lag. The best for music.
+     */
+    EZAudioTimeStretcherQualityHigh
+} EZAudioTimeStretcherQuality;
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+/**
+ Creates a time stretcher playing at 1x. Must not be called from an audio thread.
+ @param channels   The number of channels.
+ @param sampleRate The sample rate.
+ @param quality    The EZAudioTimeStretcherQuality setting the window and search lengths.
+ @return A new time stretcher or NULL if it couldn't be allocated. Free it with EZAudioTimeStretcherFree.
+ */
+EZAudioTimeStretcher *EZAudioTimeStretcherCreate(uint32_t channels,
+                                                 double sampleRate,
+                                                 EZAudioTimeStretcherQuality quality);
+
+/**
+ Frees a time stretcher.
+ @param timeStretcher The time stretcher to free.
+ */
+void EZAudioTimeStretcherFree(EZAudioTimeStretcher *timeStretcher);
+
+/**
+ Discards all the input and output held by the time stretcher, i.e. after a seek, keeping its rate.
+ @param timeStretcher The time stretcher to reset.
+ */
+void EZAudioTimeStretcherReset(EZAudioTimeStretcher *timeStretcher);
+
+//------------------------------------------------------------------------------
+#pragma mark - Rate
+//------------------------------------------------------------------------------
+
+/**
+ Sets the playback rate. Safe to call from any thread, it takes effect from the next segment.
+ @param timeStretcher The time stretcher.
+ @param rate          The number of input frames played per output frame, clamped to 0.25 through 4.
+ */
+void EZAudioTimeStretcherSetRate(EZAudioTimeStretcher *timeStretcher,
+                                 double rate);
+
+/**
+ Provides the playback rate.
+ @param timeStretcher The time stretcher.
+ @return The number of input frames played per output frame.
+ */
+double EZAudioTimeStretcherRate(EZAudioTimeStretcher *timeStretcher);
+
+//------------------------------------------------------------------------------
+#pragma mark - Processing
+//------------------------------------------------------------------------------
+
+/**
+ Provides how many more input frames have to be written before a number of output frames can be read, i.e. how much of a file to read for the next render. Never locks or allocates.
+ @param timeStretcher The time stretcher.
+ @param frames        The number of output frames about to be read (up to 4096).
+ @return The number of input frames to write, at most `EZAudioTimeStretcherWritableFrames`.
+ */
+uint32_t EZAudioTimeStretcherInputFramesNeeded(EZAudioTimeStretcher *timeStretcher,
+                                               uint32_t frames);
+
+/**
+ Provides how many input frames can be written right now. Never locks or allocates.
+ @param timeStretcher The time stretcher.
+ @return The number of frames `EZAudioTimeStretcherWrite` would accept. 0 means the output has to be read first.
+ */
+uint32_t EZAudioTimeStretcherWritableFrames(EZAudioTimeStretcher *timeStretcher);
+
+/**
+ Writes input frames. They're stretched as they're read. Never locks or allocates.
+ @param timeStretcher The time stretcher.
+ @param source        One float array per channel.
+ @param frames        The number of frames to write.
+ @return The number of frames written, at most `EZAudioTimeStretcherWritableFrames`.
+ */
+uint32_t EZAudioTimeStretcherWrite(EZAudioTimeStretcher *timeStretcher,
+                                   const float * const *source,
+                                   uint32_t frames);
+
+/**
+ Writes enough silence after the input for all of it to be stretched, i.e. at the end of a file. Never locks or allocates.
+ @param timeStretcher The time stretcher.
+ */
+void EZAudioTimeStretcherFlush(EZAudioTimeStretcher *timeStretcher);
+
+/**
+ Stretches and reads frames. Only the segments needed for these frames are computed, so the work is proportional to the read. Never locks or allocates.
+ @param timeStretcher The time stretcher.
+ @param destination   One float array per channel receiving the frames.
+ @param frames        The number of frames to read.
+ @return The number of frames read. Fewer than `frames` means more input has to be written first (see `EZAudioTimeStretcherInputFramesNeeded`).
+ */
+uint32_t EZAudioTimeStretcherRead(EZAudioTimeStretcher *timeStretcher,
+                                  float * const *destination,
+                                  uint32_t frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,177 @@
+//
+//  EZAudioVirtualInput.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <AudioToolbox/AudioToolbox.h>
+
+//------------------------------------------------------------------------------
+#pragma mark - Blocks
+//------------------------------------------------------------------------------
+
+/**
+ A block that generates the audio of an EZAudioVirtualInput. It is called on the virtual input's thread, never the main thread.
+ @param buffers          One float array per channel to write the audio into.
+ @param frames           The number of frames to generate.
+ @param numberOfChannels The number of float arrays in `buffers`.
+ @param sampleRate       The sample rate of the audio.
+ @param frameIndex       The number of frames generated before this call (i.e. for keeping an oscillator's phase).
+ */
+typedef void (^EZAudioVirtualInputGeneratorBlock)(float **buffers,
+                                                  UInt32 frames,
+                                                  UInt32 numberOfChannels,
+                                                  Float64 sampleRate,
+                                                  SInt64 frameIndex);
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioVirtualInput
+//------------------------------------------------------------------------------
+
+/**
+ The EZAudioVirtualInput stands in for the hardware input of an EZMicrophone (see EZMicrophone's `initWithMicrophoneDelegate:virtualInput:`). It replays an audio file or a generated signal through the microphone's exact delegate, buffer list and consumer thread pipeline, so capture load can be reproduced and delegates benchmarked without an input device (i.e. headless on a CI machine).
+
+ The audio can be paced to real time, with configurable buffer sizes and timing jitter to mimic a device, or delivered as fast as the pipeline will take it. Either way the microphone's `callbackMetrics` measure the pipeline and its `realtimeStreamsPerCore` reports how many realtime streams of this format the pipeline could sustain on one core.
+ */
+@interface EZAudioVirtualInput : NSObject
+
+//------------------------------------------------------------------------------
+#pragma mark - Initializers
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Initializers
+///-----------------------------------------------------------
+
+/**
+ Creates a virtual input that replays an audio file (i.e. a WAV or raw PCM CAF file). The file is read and converted to the microphone's stream format at the file's sample rate.
+ @param url The file path reference of the audio file as an NSURL.
+ @return A newly created instance of the EZAudioVirtualInput class.
+ */
+- (instancetype)initWithURL:(NSURL *)url;
+
+//------------------------------------------------------------------------------
+
+/**
+ Creates a virtual input that delivers a generated signal.
+ @param sampleRate The sample rate of the generated signal.
+ @param generator  An EZAudioVirtualInputGeneratorBlock that writes the signal as float arrays.
+ @return A newly created instance of the EZAudioVirtualInput class.
+ */
+- (instancetype)initWithSampleRate:(Float64)sampleRate
+                         generator:(EZAudioVirtualInputGeneratorBlock)generator;
+
+//------------------------------------------------------------------------------
+
+/**
+ Class method to create a virtual input that replays an audio file.
+ @param url The file path reference of the audio file as an NSURL.
+ @return A newly created instance of the EZAudioVirtualInput class.
+ */
++ (instancetype)virtualInputWithURL:(NSURL *)url;
+
+//------------------------------------------------------------------------------
+
+/**
+ Class method to create a virtual input that delivers a generated signal.
+ @param sampleRate The sample rate of the generated signal.
+ @param generator  An EZAudioVirtualInputGeneratorBlock that writes the signal as float arrays.
+ @return A newly created instance of the EZAudioVirtualInput class.
+ */
++ (instancetype)virtualInputWithSampleRate:(Float64)sampleRate
+                                 generator:(EZAudioVirtualInputGeneratorBlock)generator;
+
+//------------------------------------------------------------------------------
+
+/**
+ Class method to create a virtual input that delivers a sine wave on every channel.
+ @param frequency  The frequency of the sine wave in Hz.
+ @param amplitude  The peak amplitude of the sine wave from 0.0 to 1.0.
+ @param sampleRate The sample rate of the generated signal.
+ @return A newly created instance of the EZAudioVirtualInput class.
+ */
++ (instancetype)sineWaveVirtualInputWithFrequency:(float)frequency
+                                        amplitude:(float)amplitude
+                                       sampleRate:(Float64)sampleRate;
+
+//------------------------------------------------------------------------------
+#pragma mark - Properties
+//------------------------------------------------------------------------------
+
+/**
+ The sample rate of the audio the virtual input delivers. For a file this is the file's sample rate.
+ */
+@property (nonatomic, readonly) Float64 sampleRate;
+
+/**
+ The number of frames delivered per buffer, like a device's buffer frame size. Default is 512.
+ */
+@property (nonatomic, assign) UInt32 bufferSize;
+
+/**
+ The maximum number of frames each buffer may randomly come up short of `bufferSize`, to mimic devices that don't deliver fixed buffer sizes. Default is 0.
+ */
+@property (nonatomic, assign) UInt32 bufferSizeJitter;
+
+/**
+ The maximum random delay in seconds added to each paced buffer, to mimic a device's scheduling jitter. Late buffers don't push back the ones after them so the average rate stays real time. Default is 0.
+ */
+@property (nonatomic, assign) NSTimeInterval timingJitter;
+
+/**
+ Whether buffers are delivered at the pace of real time (YES) or as fast as the pipeline takes them (NO). Default is YES.
+ */
+@property (nonatomic, assign) BOOL paced;
+
+/**
+ Whether a file starts over from the beginning when it reaches the end. If NO the microphone stops delivering audio at the end of the file. Default is YES.
+ */
+@property (nonatomic, assign) BOOL loops;
+
+//------------------------------------------------------------------------------
+#pragma mark - Rendering
+//------------------------------------------------------------------------------
+
+///-----------------------------------------------------------
+/// @name Rendering (used by EZMicrophone)
+///-----------------------------------------------------------
+
+/**
+ Prepares the virtual input to render into a stream format. Called by the EZMicrophone before it starts fetching audio.
+ @param format        The linear PCM AudioStreamBasicDescription to render in. Its sample rate must be the virtual input's `sampleRate`.
+ @param maximumFrames The largest number of frames that will be rendered at once.
+ */
+- (void)prepareWithFormat:(AudioStreamBasicDescription)format
+            maximumFrames:(UInt32)maximumFrames;
+
+//------------------------------------------------------------------------------
+
+/**
+ Renders the next frames of the file or signal. Called by the EZMicrophone on its virtual input thread.
+ @param frames     The number of frames to render.
+ @param bufferList An AudioBufferList in the prepared format with room for `frames` frames. Each buffer's mDataByteSize is set to the bytes rendered.
+ @return The number of frames rendered, fewer than `frames` only at the end of a file that doesn't loop.
+ */
+- (UInt32)renderFrames:(UInt32)frames
+        intoBufferList:(AudioBufferList *)bufferList;
+
+@end
@@ -0,0 +1,264 @@
+//
+//  EZAudioVirtualInput.m
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#import "EZAudioVirtualInput.h"
+
+//------------------------------------------------------------------------------
+
+#import "EZAudio.h"
+
+//------------------------------------------------------------------------------
+
+// constants
+static const UInt32 EZAudioVirtualInputDefaultBufferSize = 512;
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioVirtualInput
+//------------------------------------------------------------------------------
+
+@interface EZAudioVirtualInput ()
+@property (nonatomic, readwrite) Float64 sampleRate;
+@property (nonatomic, strong) EZAudioFile *audioFile;
+@property (nonatomic, copy) EZAudioVirtualInputGeneratorBlock generator;
+@property (nonatomic, strong) AEFloatConverter *converter;
+@property (nonatomic) AudioStreamBasicDescription format;
+@property (nonatomic) float **floatBuffers;
+@property (nonatomic) AudioBufferList *cursor;
+@property (nonatomic) SInt64 frameIndex;
+@end
+
+//------------------------------------------------------------------------------
+
+@implementation EZAudioVirtualInput
+
+//------------------------------------------------------------------------------
+#pragma mark - Dealloc
+//------------------------------------------------------------------------------
+
+- (void)dealloc
+{
+    [self freeBuffers];
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Initialization
+//------------------------------------------------------------------------------
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self)
+    {
+        _bufferSize = EZAudioVirtualInputDefaultBufferSize;
+        _paced = YES;
+        _loops = YES;
+    }
+    return self;
+}
+
+//------------------------------------------------------------------------------
+
+- (instancetype)initWithURL:(NSURL *)url
+{
+    self = [self init];
+    if (self)
+    {
+        _audioFile = [EZAudioFile audioFileWithURL:url];
+        _sampleRate = _audioFile.fileFormat.mSampleRate;
+    }
+    return self;
+}
+
+//------------------------------------------------------------------------------
+
+- (instancetype)initWithSampleRate:(Float64)sampleRate
+                         generator:(EZAudioVirtualInputGeneratorBlock)generator
+{
+    self = [self init];
+    if (self)
+    {
+        _sampleRate = sampleRate;
+        _generator = [generator copy];
+    }
+    return self;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Class Initializers
+//------------------------------------------------------------------------------
+
++ (instancetype)virtualInputWithURL:(NSURL *)url
+{
+    return [[self alloc] initWithURL:url];
+}
+
+//------------------------------------------------------------------------------
+
++ (instancetype)virtualInputWithSampleRate:(Float64)sampleRate
+                                 generator:(EZAudioVirtualInputGeneratorBlock)generator
+{
+    return [[self alloc] initWithSampleRate:sampleRate
+                                  generator:generator];
+}
+
+//------------------------------------------------------------------------------
+
++ (instancetype)sineWaveVirtualInputWithFrequency:(float)frequency
+                                        amplitude:(float)amplitude
+                                       sampleRate:(Float64)sampleRate
+{
+    return [[self alloc] initWithSampleRate:sampleRate
+                                  generator:^(float **buffers, UInt32 frames, UInt32 numberOfChannels, Float64 rate, SInt64 frameIndex) {
+        double increment = 2.0 * M_PI * frequency / rate;
+        for (UInt32 frame = 0; frame < frames; frame++)
+        {
+            float sample = amplitude * (float)sin(increment * (double)(frameIndex + frame));
+            for (UInt32 channel = 0; channel < numberOfChannels; channel++)
+            {
+                buffers[channel][frame] = sample;
+            }
+        }
+    }];
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Rendering
+//------------------------------------------------------------------------------
+
+- (void)prepareWithFormat:(AudioStreamBasicDescription)format
+            maximumFrames:(UInt32)maximumFrames
+{
+    NSAssert(format.mSampleRate == self.sampleRate, @"The virtual input must be rendered at its own sample rate");
+    [self freeBuffers];
+    self.format = format;
+    self.frameIndex = 0;
+
+    if (self.audioFile)
+    {
+        // let the file convert into the microphone's format and start from the top
+        self.audioFile.clientFormat = format;
+        [self.audioFile seekToFrame:0];
+
+        // the cursor points into the microphone's buffer list while filling it in pieces
+        self.cursor = (AudioBufferList *)malloc(offsetof(AudioBufferList, mBuffers[0]) + sizeof(AudioBuffer) * format.mChannelsPerFrame);
+    }
+    else
+    {
+        self.converter = [[AEFloatConverter alloc] initWithSourceFormat:format];
+        self.floatBuffers = [EZAudio floatBuffersWithNumberOfFrames:maximumFrames
+                                                   numberOfChannels:format.mChannelsPerFrame];
+    }
+}
+
+//------------------------------------------------------------------------------
+
+- (UInt32)renderFrames:(UInt32)frames
+        intoBufferList:(AudioBufferList *)bufferList
+{
+    UInt32 rendered = self.audioFile ? [self readFrames:frames intoBufferList:bufferList] : [self generateFrames:frames intoBufferList:bufferList];
+    for (UInt32 i = 0; i < bufferList->mNumberBuffers; i++)
+    {
+        bufferList->mBuffers[i].mDataByteSize = rendered * self.format.mBytesPerFrame;
+    }
+    self.frameIndex += rendered;
+    return rendered;
+}
+
+//------------------------------------------------------------------------------
+
+- (UInt32)readFrames:(UInt32)frames
+      intoBufferList:(AudioBufferList *)bufferList
+{
+    UInt32 bytesPerFrame = self.format.mBytesPerFrame;
+    UInt32 rendered = 0;
+    BOOL restarted = NO;
+    self.cursor->mNumberBuffers = bufferList->mNumberBuffers;
+    while (rendered < frames)
+    {
+        for (UInt32 i = 0; i < self.cursor->mNumberBuffers; i++)
+        {
+            self.cursor->mBuffers[i].mNumberChannels = bufferList->mBuffers[i].mNumberChannels;
+            self.cursor->mBuffers[i].mData = (char *)bufferList->mBuffers[i].mData + rendered * bytesPerFrame;
+            self.cursor->mBuffers[i].mDataByteSize = (frames - rendered) * bytesPerFrame;
+        }
+
+        UInt32 read = 0;
+        BOOL eof = NO;
+        [self.audioFile readFrames:frames - rendered
+                   audioBufferList:self.cursor
+                        bufferSize:&read
+                               eof:&eof];
+        rendered += read;
+
+        // start over at the end, unless the file is empty
+        if (read == 0)
+        {
+            if (!self.loops || restarted)
+            {
+                break;
+            }
+            [self.audioFile seekToFrame:0];
+            restarted = YES;
+        }
+        else
+        {
+            restarted = NO;
+        }
+    }
+    return rendered;
+}
+
+//------------------------------------------------------------------------------
+
+- (UInt32)generateFrames:(UInt32)frames
+          intoBufferList:(AudioBufferList *)bufferList
+{
+    self.generator(self.floatBuffers,
+                   frames,
+                   self.format.mChannelsPerFrame,
+                   self.sampleRate,
+                   self.frameIndex);
+    AEFloatConverterFromFloat(self.converter,
+                              self.floatBuffers,
+                              bufferList,
+                              frames);
+    return frames;
+}
+
+//------------------------------------------------------------------------------
+
+- (void)freeBuffers
+{
+    if (self.floatBuffers)
+    {
+        [EZAudio freeFloatBuffers:self.floatBuffers
+                 numberOfChannels:self.format.mChannelsPerFrame];
+        self.floatBuffers = NULL;
+    }
+    free(self.cursor);
+    self.cursor = NULL;
+    self.converter = nil;
+}
+
+@end
@@ -0,0 +1,440 @@
+//
+//  EZAudioVoiceActivityDetector.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#include "EZAudioVoiceActivityDetector.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// not part of strict C
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//------------------------------------------------------------------------------
+#pragma mark - Constants
+//------------------------------------------------------------------------------
+
+#define EZAudioVoiceActivityDetectorFFTSize 256
+
+static const float  EZAudioVoiceActivityDetectorDefaultEnergyThreshold   = 9.0f;
+static const float  EZAudioVoiceActivityDetectorDefaultFlatnessThreshold = 0.35f;
+static const float  EZAudioVoiceActivityDetectorMinimumEnergy            = -70.0f;
+static const float  EZAudioVoiceActivityDetectorSilence                  = -120.0f;
+static const double EZAudioVoiceActivityDetectorFloorFallTime            = 0.1;
+static const double EZAudioVoiceActivityDetectorFloorRiseTime            = 10.0;
+
+//------------------------------------------------------------------------------
+#pragma mark - Types
+//------------------------------------------------------------------------------
+
+struct EZAudioVoiceActivityDetector
+{
+    uint32_t channels;
+    double   sampleRate;
+    uint32_t hangoverFrames;
+    float    energyThreshold;
+    float    flatnessThreshold;
+
+    // state
+    bool     active;
+    bool     hasFloor;
+    uint32_t hangoverRemaining;
+    float    energy;
+    float    noiseFloor;
+    float    flatness;
+
+    // pre-roll ring, one per channel
+    float    **preRoll;
+    uint32_t preRollCapacity;
+    uint32_t preRollWrite;
+    uint32_t preRollCount;
+
+    // spectral flatness
+    float    window[EZAudioVoiceActivityDetectorFFTSize];
+    float    cosines[EZAudioVoiceActivityDetectorFFTSize / 2];
+    float    sines[EZAudioVoiceActivityDetectorFFTSize / 2];
+    uint16_t bitReverse[EZAudioVoiceActivityDetectorFFTSize];
+    float    real[EZAudioVoiceActivityDetectorFFTSize];
+    float    imaginary[EZAudioVoiceActivityDetectorFFTSize];
+};
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+EZAudioVoiceActivityDetector *EZAudioVoiceActivityDetectorCreate(uint32_t channels,
+                                                                 double sampleRate,
+                                                                 uint32_t hangoverFrames,
+                                                                 uint32_t preRollFrames)
+{
+    if (channels == 0 || sampleRate <= 0.0)
+    {
+        return NULL;
+    }
+
+    EZAudioVoiceActivityDetector *detector = (EZAudioVoiceActivityDetector *)calloc(1, sizeof(EZAudioVoiceActivityDetector));
+    if (!detector)
+    {
+        return NULL;
+    }
+    detector->channels          = channels;
+    detector->sampleRate        = sampleRate;
+    detector->hangoverFrames    = hangoverFrames;
+    detector->energyThreshold   = EZAudioVoiceActivityDetectorDefaultEnergyThreshold;
+    detector->flatnessThreshold = EZAudioVoiceActivityDetectorDefaultFlatnessThreshold;
+
+    if (preRollFrames > 0)
+    {
+        detector->preRollCapacity = preRollFrames;
+        detector->preRoll = (float **)calloc(channels, sizeof(float *));
+        if (!detector->preRoll)
+        {
+            EZAudioVoiceActivityDetectorFree(detector);
+            return NULL;
+        }
+        for (uint32_t channel = 0; channel < channels; channel++)
+        {
+            detector->preRoll[channel] = (float *)calloc(preRollFrames, sizeof(float));
+            if (!detector->preRoll[channel])
+            {
+                EZAudioVoiceActivityDetectorFree(detector);
+                return NULL;
+            }
+        }
+    }
+
+    // hann window, twiddles and the bit reversal permutation for the flatness fft
+    const uint32_t size = EZAudioVoiceActivityDetectorFFTSize;
+    uint32_t bits = 0;
+    while ((1u << bits) < size)
+    {
+        bits++;
+    }
+    for (uint32_t i = 0; i < size; i++)
+    {
+        detector->window[i] = 0.5f - 0.5f * (float)cos(2.0 * M_PI * i / size);
+        uint32_t reversed = 0;
+        for (uint32_t bit = 0; bit < bits; bit++)
+        {
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        }
+        detector->bitReverse[i] = (uint16_t)reversed;
+    }
+    for (uint32_t i = 0; i < size / 2; i++)
+    {
+        detector->cosines[i] = (float)cos(2.0 * M_PI * i / size);
+        detector->sines[i]   = (float)-sin(2.0 * M_PI * i / size);
+    }
+
+    EZAudioVoiceActivityDetectorReset(detector);
+    return detector;
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioVoiceActivityDetectorFree(EZAudioVoiceActivityDetector *detector)
+{
+    if (!detector)
+    {
+        return;
+    }
+    if (detector->preRoll)
+    {
+        for (uint32_t channel = 0; channel < detector->channels; channel++)
+        {
+            free(detector->preRoll[channel]);
+        }
+        free(detector->preRoll);
+    }
+    free(detector);
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioVoiceActivityDetectorReset(EZAudioVoiceActivityDetector *detector)
+{
+    detector->active            = false;
+    detector->hasFloor          = false;
+    detector->hangoverRemaining = 0;
+    detector->energy            = EZAudioVoiceActivityDetectorSilence;
+    detector->noiseFloor        = EZAudioVoiceActivityDetectorSilence;
+    detector->flatness          = 1.0f;
+    detector->preRollWrite      = 0;
+    detector->preRollCount      = 0;
+}
+
+//------------------------------------------------------------------------------
+
+void EZAudioVoiceActivityDetectorSetThresholds(EZAudioVoiceActivityDetector *detector,
+                                               float energyThreshold,
+                                               float flatnessThreshold)
+{
+    detector->energyThreshold   = energyThreshold;
+    detector->flatnessThreshold = flatnessThreshold;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Analysis
+//------------------------------------------------------------------------------
+
+static float EZAudioVoiceActivityDetectorMeasureEnergy(EZAudioVoiceActivityDetector *detector,
+                                                       float * const *buffers,
+                                                       uint32_t frames)
+{
+    double sum = 0.0;
+    for (uint32_t channel = 0; channel < detector->channels; channel++)
+    {
+        const float *buffer = buffers[channel];
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            sum += buffer[frame] * buffer[frame];
+        }
+    }
+    double meanSquare = sum / ((double)frames * detector->channels);
+    return meanSquare > 1.0e-12 ? (float)(10.0 * log10(meanSquare)) : EZAudioVoiceActivityDetectorSilence;
+}
+
+//------------------------------------------------------------------------------
+
+static float EZAudioVoiceActivityDetectorMeasureFlatness(EZAudioVoiceActivityDetector *detector,
+                                                         float * const *buffers,
+                                                         uint32_t frames)
+{
+    const uint32_t size  = EZAudioVoiceActivityDetectorFFTSize;
+    float *real          = detector->real;
+    float *imaginary     = detector->imaginary;
+
+    // window the end of the buffer (mixed down), zero padded when it's shorter
+    uint32_t count  = frames < size ? frames : size;
+    uint32_t offset = frames - count;
+    memset(real, 0, sizeof(detector->real));
+    memset(imaginary, 0, sizeof(detector->imaginary));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        float sample = 0.0f;
+        for (uint32_t channel = 0; channel < detector->channels; channel++)
+        {
+            sample += buffers[channel][offset + i];
+        }
+        real[detector->bitReverse[i]] = sample * detector->window[i];
+    }
+
+    // in place radix-2 fft
+    for (uint32_t length = 2; length <= size; length <<= 1)
+    {
+        uint32_t half   = length >> 1;
+        uint32_t stride = size / length;
+        for (uint32_t start = 0; start < size; start += length)
+        {
+            for (uint32_t k = 0; k < half; k++)
+            {
+                float wr = detector->cosines[k * stride];
+                float wi = detector->sines[k * stride];
+                uint32_t a = start + k;
+                uint32_t b = a + half;
+                float tr = real[b] * wr - imaginary[b] * wi;
+                float ti = real[b] * wi + imaginary[b] * wr;
+                real[b]      = real[a] - tr;
+                imaginary[b] = imaginary[a] - ti;
+                real[a]      += tr;
+                imaginary[a] += ti;
+            }
+        }
+    }
+
+    // geometric over arithmetic mean of the power spectrum, skipping dc and nyquist
+    double logSum = 0.0;
+    double sum    = 0.0;
+    uint32_t bins = size / 2 - 1;
+    for (uint32_t bin = 1; bin <= bins; bin++)
+    {
+        double power = (double)real[bin] * real[bin] + (double)imaginary[bin] * imaginary[bin] + 1.0e-20;
+        logSum += log(power);
+        sum    += power;
+    }
+    return (float)(exp(logSum / bins) / (sum / bins));
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Pre-Roll
+//------------------------------------------------------------------------------
+
+static void EZAudioVoiceActivityDetectorWritePreRoll(EZAudioVoiceActivityDetector *detector,
+                                                     float * const *buffers,
+                                                     uint32_t frames)
+{
+    uint32_t capacity = detector->preRollCapacity;
+    if (capacity == 0)
+    {
+        return;
+    }
+
+    // only the newest frames can survive
+    uint32_t offset = frames > capacity ? frames - capacity : 0;
+    uint32_t count  = frames - offset;
+    for (uint32_t channel = 0; channel < detector->channels; channel++)
+    {
+        uint32_t write = detector->preRollWrite;
+        uint32_t first = capacity - write < count ? capacity - write : count;
+        memcpy(detector->preRoll[channel] + write, buffers[channel] + offset, first * sizeof(float));
+        memcpy(detector->preRoll[channel], buffers[channel] + offset + first, (count - first) * sizeof(float));
+    }
+    detector->preRollWrite = (detector->preRollWrite + count) % capacity;
+    detector->preRollCount = detector->preRollCount + count < capacity ? detector->preRollCount + count : capacity;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioVoiceActivityDetectorReadPreRoll(EZAudioVoiceActivityDetector *detector,
+                                                 float * const *destination,
+                                                 uint32_t frames)
+{
+    uint32_t capacity = detector->preRollCapacity;
+    uint32_t count    = frames < detector->preRollCount ? frames : detector->preRollCount;
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    uint32_t read  = (detector->preRollWrite + capacity - detector->preRollCount) % capacity;
+    uint32_t first = capacity - read < count ? capacity - read : count;
+    for (uint32_t channel = 0; channel < detector->channels; channel++)
+    {
+        memcpy(destination[channel], detector->preRoll[channel] + read, first * sizeof(float));
+        memcpy(destination[channel] + first, detector->preRoll[channel], (count - first) * sizeof(float));
+    }
+    detector->preRollCount -= count;
+    return count;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t EZAudioVoiceActivityDetectorPreRollFrames(EZAudioVoiceActivityDetector *detector)
+{
+    return detector->preRollCount;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Processing
+//------------------------------------------------------------------------------
+
+bool EZAudioVoiceActivityDetectorProcess(EZAudioVoiceActivityDetector *detector,
+                                         float * const *buffers,
+                                         uint32_t frames)
+{
+    if (frames == 0)
+    {
+        return detector->active;
+    }
+
+    // a pre-roll handed over with the last buffer is stale now
+    if (detector->active)
+    {
+        detector->preRollCount = 0;
+    }
+
+    float energy = EZAudioVoiceActivityDetectorMeasureEnergy(detector, buffers, frames);
+    detector->energy = energy;
+    if (!detector->hasFloor)
+    {
+        detector->noiseFloor = energy;
+        detector->hasFloor   = true;
+    }
+
+    // only spend the fft on buffers that stand out from the floor
+    float above = energy - detector->noiseFloor;
+    bool  voice = false;
+    if (energy > EZAudioVoiceActivityDetectorMinimumEnergy && above > detector->energyThreshold)
+    {
+        if (above > 2.0f * detector->energyThreshold)
+        {
+            voice = true;
+        }
+        else
+        {
+            detector->flatness = EZAudioVoiceActivityDetectorMeasureFlatness(detector, buffers, frames);
+            voice = detector->flatness < detector->flatnessThreshold;
+        }
+    }
+
+    // the floor drops quickly to quiet buffers but only creeps up, so a lasting change in the background is eventually learned
+    double duration = (double)frames / detector->sampleRate;
+    if (energy < detector->noiseFloor)
+    {
+        detector->noiseFloor += (float)(1.0 - exp(-duration / EZAudioVoiceActivityDetectorFloorFallTime)) * (energy - detector->noiseFloor);
+    }
+    else
+    {
+        detector->noiseFloor += (float)(1.0 - exp(-duration / EZAudioVoiceActivityDetectorFloorRiseTime)) * (energy - detector->noiseFloor);
+    }
+
+    // hold on through the hangover
+    if (voice)
+    {
+        detector->hangoverRemaining = detector->hangoverFrames;
+        detector->active = true;
+    }
+    else if (detector->hangoverRemaining > 0)
+    {
+        detector->hangoverRemaining = detector->hangoverRemaining > frames ? detector->hangoverRemaining - frames : 0;
+        detector->active = true;
+    }
+    else
+    {
+        detector->active = false;
+        EZAudioVoiceActivityDetectorWritePreRoll(detector, buffers, frames);
+    }
+    return detector->active;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - State
+//------------------------------------------------------------------------------
+
+bool EZAudioVoiceActivityDetectorIsActive(EZAudioVoiceActivityDetector *detector)
+{
+    return detector->active;
+}
+
+//------------------------------------------------------------------------------
+
+float EZAudioVoiceActivityDetectorEnergy(EZAudioVoiceActivityDetector *detector)
+{
+    return detector->energy;
+}
+
+//------------------------------------------------------------------------------
+
+float EZAudioVoiceActivityDetectorNoiseFloor(EZAudioVoiceActivityDetector *detector)
+{
+    return detector->noiseFloor;
+}
+
+//------------------------------------------------------------------------------
+
+float EZAudioVoiceActivityDetectorFlatness(EZAudioVoiceActivityDetector *detector)
+{
+    return detector->flatness;
+}
@@ -0,0 +1,156 @@
+//
+//  EZAudioVoiceActivityDetector.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef EZAudioVoiceActivityDetector_h
+#define EZAudioVoiceActivityDetector_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioVoiceActivityDetector
+//------------------------------------------------------------------------------
+
+/**
+ A cheap voice activity detector for gating silent audio out of a capture path. Each buffer's energy is compared against an adaptive noise floor; only buffers that stand out from the floor go on to a spectral flatness check (a 256 point FFT of the end of the buffer) that tells voiced, tonal audio (low flatness) apart from a noise burst (flatness near that of white noise). Buffers far enough above the floor count as voice regardless of their flatness so unvoiced consonants aren't clipped.
+
+ Once voice ends the detector stays active for a hangover so trailing syllables aren't cut, and while inactive it keeps the most recent frames as a pre-roll so the start of the next utterance can be delivered along with it.
+
+ This is plain C without any Core Audio dependencies so it can be measured offline on recorded or synthetic corpora. It is not thread safe: process and read the pre-roll on one thread.
+ */
+typedef struct EZAudioVoiceActivityDetector EZAudioVoiceActivityDetector;
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+/**
+ Creates a voice activity detector. Must not be called from an audio thread.
+ @param channels       The number of channels of the audio.
+ @param sampleRate     The sample rate of the audio.
+ @param hangoverFrames The number of frames the detector stays active after the last voiced buffer.
+ @param preRollFrames  The number of frames from before an utterance kept for EZAudioVoiceActivityDetectorReadPreRoll.
+ @return A new detector or NULL if it couldn't be allocated. Free it with EZAudioVoiceActivityDetectorFree.
+ */
+EZAudioVoiceActivityDetector *EZAudioVoiceActivityDetectorCreate(uint32_t channels,
+                                                                 double sampleRate,
+                                                                 uint32_t hangoverFrames,
+                                                                 uint32_t preRollFrames);
+
+/**
+ Frees a voice activity detector.
+ @param detector The detector to free.
+ */
+void EZAudioVoiceActivityDetectorFree(EZAudioVoiceActivityDetector *detector);
+
+/**
+ Forgets the noise floor, the hangover and the pre-roll.
+ @param detector The detector to reset.
+ */
+void EZAudioVoiceActivityDetectorReset(EZAudioVoiceActivityDetector *detector);
+
+/**
+ Tunes the detector. The defaults are 9 dB and 0.35.
+ @param detector          The detector.
+ @param energyThreshold   How far in dB a buffer's energy must rise above the noise floor to be considered voice. Twice this counts as voice regardless of the flatness.
+ @param flatnessThreshold The spectral flatness from 0.0 (a pure tone) to 1.0 (flat noise) below which a buffer above the energy threshold is voice. White noise measures about 0.56.
+ */
+void EZAudioVoiceActivityDetectorSetThresholds(EZAudioVoiceActivityDetector *detector,
+                                               float energyThreshold,
+                                               float flatnessThreshold);
+
+//------------------------------------------------------------------------------
+#pragma mark - Processing
+//------------------------------------------------------------------------------
+
+/**
+ Classifies a buffer. Never locks or allocates. While the detector is inactive the buffer is added to the pre-roll; when this call makes it active the pre-roll holds the audio from just before this buffer until the next call.
+ @param detector The detector.
+ @param buffers  One float array per channel.
+ @param frames   The number of frames in each array.
+ @return true if the buffer is voice or within the hangover, false if it is silence.
+ */
+bool EZAudioVoiceActivityDetectorProcess(EZAudioVoiceActivityDetector *detector,
+                                         float * const *buffers,
+                                         uint32_t frames);
+
+/**
+ Moves the oldest pre-roll frames out of the detector. Call it until it returns 0 right after EZAudioVoiceActivityDetectorProcess turned active to get the audio leading up to the utterance.
+ @param detector    The detector.
+ @param destination One float array per channel with room for `frames` frames.
+ @param frames      The maximum number of frames to read.
+ @return The number of frames read.
+ */
+uint32_t EZAudioVoiceActivityDetectorReadPreRoll(EZAudioVoiceActivityDetector *detector,
+                                                 float * const *destination,
+                                                 uint32_t frames);
+
+/**
+ Provides how many pre-roll frames are left to read. They lead right up to the buffer that turned the detector active, i.e. to work out when each one was captured.
+ @param detector The detector.
+ @return The number of frames.
+ */
+uint32_t EZAudioVoiceActivityDetectorPreRollFrames(EZAudioVoiceActivityDetector *detector);
+
+//------------------------------------------------------------------------------
+#pragma mark - State
+//------------------------------------------------------------------------------
+
+/**
+ Provides whether the last processed buffer was voice or within the hangover.
+ @param detector The detector.
+ @return true if active.
+ */
+bool EZAudioVoiceActivityDetectorIsActive(EZAudioVoiceActivityDetector *detector);
+
+/**
+ Provides the energy of the last processed buffer.
+ @param detector The detector.
+ @return The energy in dBFS.
+ */
+float EZAudioVoiceActivityDetectorEnergy(EZAudioVoiceActivityDetector *detector);
+
+/**
+ Provides the current estimate of the noise floor.
+ @param detector The detector.
+ @return The noise floor in dBFS.
+ */
+float EZAudioVoiceActivityDetectorNoiseFloor(EZAudioVoiceActivityDetector *detector);
+
+/**
+ Provides the spectral flatness of the last buffer that was loud enough to need it.
+ @param detector The detector.
+ @return The flatness from 0.0 to 1.0.
+ */
+float EZAudioVoiceActivityDetectorFlatness(EZAudioVoiceActivityDetector *detector);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
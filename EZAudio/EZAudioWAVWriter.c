@@ -0,0 +1,733 @@
+//
+//  EZAudioWAVWriter.c
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+// fileno, fseeko, ftello and ftruncate are POSIX, not strict C
+#define _POSIX_C_SOURCE 200809L
+
+#include "EZAudioWAVWriter.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+
+// frames interleaved per fwrite
+#define EZ_AUDIO_WAV_WRITER_CHUNK_FRAMES 1024
+
+static const uint16_t EZAudioWAVWriterFormatTagPCM   = 0x0001;
+static const uint16_t EZAudioWAVWriterFormatTagFloat = 0x0003;
+
+// the size of a ds64 chunk without a table, which the JUNK chunk reserves room for
+static const uint32_t EZAudioWAVWriterDS64Size = 28;
+
+//------------------------------------------------------------------------------
+
+struct EZAudioWAVWriter
+{
+    FILE                         *file;
+    uint32_t                     channels;
+    uint32_t                     sampleRate;
+    EZAudioWAVWriterSampleFormat sampleFormat;
+    uint32_t                     bytesPerSample;
+    EZAudioWAVWriterOptions      options;
+    long                         riffSizeOffset;
+    long                         ds64Offset;
+    long                         factFramesOffset;
+    long                         dataSizeOffset;
+    uint64_t                     frames;
+    uint64_t                     dataBytes;
+    bool                         rf64;
+    bool                         failed;
+    uint8_t                      *scratch;
+    int32_t                      *quantized;
+    uint32_t                     dither[4];
+};
+
+//------------------------------------------------------------------------------
+#pragma mark - Utility
+//------------------------------------------------------------------------------
+
+// WAV is little endian whatever the host is
+static void EZAudioWAVWriterPut16(uint8_t *bytes, uint16_t value)
+{
+    bytes[0] = (uint8_t)(value);
+    bytes[1] = (uint8_t)(value >> 8);
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioWAVWriterPut32(uint8_t *bytes, uint32_t value)
+{
+    bytes[0] = (uint8_t)(value);
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+}
+
+//------------------------------------------------------------------------------
+
+static void EZAudioWAVWriterPut64(uint8_t *bytes, uint64_t value)
+{
+    EZAudioWAVWriterPut32(bytes, (uint32_t)value);
+    EZAudioWAVWriterPut32(bytes + 4, (uint32_t)(value >> 32));
+}
+
+//------------------------------------------------------------------------------
+
+static uint16_t EZAudioWAVWriterGet16(const uint8_t *bytes)
+{
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+//------------------------------------------------------------------------------
+
+static uint32_t EZAudioWAVWriterGet32(const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+//------------------------------------------------------------------------------
+
+static uint64_t EZAudioWAVWriterGet64(const uint8_t *bytes)
+{
+    return (uint64_t)EZAudioWAVWriterGet32(bytes) | ((uint64_t)EZAudioWAVWriterGet32(bytes + 4) << 32);
+}
+
+//------------------------------------------------------------------------------
+
+// the sum of the random word's two halves is triangular over -1..1 steps
+static inline float EZAudioWAVWriterTriangular(uint32_t random)
+{
+    return (float)((int32_t)(random & 0xFFFF) + (int32_t)(random >> 16) - 65535) * (1.0f / 65536.0f);
+}
+
+//------------------------------------------------------------------------------
+
+static inline uint32_t EZAudioWAVWriterXorshift(uint32_t state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+//------------------------------------------------------------------------------
+
+// clips to the sample format, with NaN going to silence rather than full scale
+static inline int32_t EZAudioWAVWriterRound(float value, float minimum, float maximum)
+{
+    value = value == value ? value : 0.0f;
+    value = value < maximum ? value : maximum;
+    value = value > minimum ? value : minimum;
+    return (int32_t)lrintf(value);
+}
+
+//------------------------------------------------------------------------------
+
+// scales a channel to the integer sample format in one contiguous pass the compiler can vectorize
+static void EZAudioWAVWriterQuantize(EZAudioWAVWriter *writer,
+                                     const float *source,
+                                     uint32_t count,
+                                     int32_t *destination)
+{
+    uint32_t bits    = writer->bytesPerSample * 8;
+    float    scale   = ldexpf(1.0f, (int)bits - 1);
+    float    minimum = -scale;
+    // the largest float below 2^31, as 2^31 - 1 itself rounds up out of range
+    float    maximum = bits == 32 ? 2147483520.0f : scale - 1.0f;
+    if (!(writer->options & EZAudioWAVWriterOptionDither) || bits == 32)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            destination[i] = EZAudioWAVWriterRound(source[i] * scale, minimum, maximum);
+        }
+        return;
+    }
+
+    // four independent generators keep the loop four wide
+    uint32_t d0 = writer->dither[0];
+    uint32_t d1 = writer->dither[1];
+    uint32_t d2 = writer->dither[2];
+    uint32_t d3 = writer->dither[3];
+    uint32_t i  = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        d0 = EZAudioWAVWriterXorshift(d0);
+        d1 = EZAudioWAVWriterXorshift(d1);
+        d2 = EZAudioWAVWriterXorshift(d2);
+        d3 = EZAudioWAVWriterXorshift(d3);
+        destination[i]     = EZAudioWAVWriterRound(source[i] * scale + EZAudioWAVWriterTriangular(d0), minimum, maximum);
+        destination[i + 1] = EZAudioWAVWriterRound(source[i + 1] * scale + EZAudioWAVWriterTriangular(d1), minimum, maximum);
+        destination[i + 2] = EZAudioWAVWriterRound(source[i + 2] * scale + EZAudioWAVWriterTriangular(d2), minimum, maximum);
+        destination[i + 3] = EZAudioWAVWriterRound(source[i + 3] * scale + EZAudioWAVWriterTriangular(d3), minimum, maximum);
+    }
+    for (; i < count; i++)
+    {
+        d0 = EZAudioWAVWriterXorshift(d0);
+        destination[i] = EZAudioWAVWriterRound(source[i] * scale + EZAudioWAVWriterTriangular(d0), minimum, maximum);
+    }
+    writer->dither[0] = d0;
+    writer->dither[1] = d1;
+    writer->dither[2] = d2;
+    writer->dither[3] = d3;
+}
+
+//------------------------------------------------------------------------------
+
+// interleaves the quantized channels into little endian bytes, with a loop per sample size so the inner loop doesn't branch
+static uint8_t *EZAudioWAVWriterPack(EZAudioWAVWriter *writer,
+                                     uint32_t count,
+                                     uint8_t *bytes)
+{
+    uint32_t channels = writer->channels;
+    switch (writer->bytesPerSample)
+    {
+        case 2:
+            for (uint32_t frame = 0; frame < count; frame++)
+            {
+                for (uint32_t channel = 0; channel < channels; channel++, bytes += 2)
+                {
+                    EZAudioWAVWriterPut16(bytes, (uint16_t)writer->quantized[channel * EZ_AUDIO_WAV_WRITER_CHUNK_FRAMES + frame]);
+                }
+            }
+            break;
+        case 3:
+            for (uint32_t frame = 0; frame < count; frame++)
+            {
+                for (uint32_t channel = 0; channel < channels; channel++, bytes += 3)
+                {
+                    uint32_t value = (uint32_t)writer->quantized[channel * EZ_AUDIO_WAV_WRITER_CHUNK_FRAMES + frame];
+                    bytes[0] = (uint8_t)(value);
+                    bytes[1] = (uint8_t)(value >> 8);
+                    bytes[2] = (uint8_t)(value >> 16);
+                }
+            }
+            break;
+        default:
+            for (uint32_t frame = 0; frame < count; frame++)
+            {
+                for (uint32_t channel = 0; channel < channels; channel++, bytes += 4)
+                {
+                    EZAudioWAVWriterPut32(bytes, (uint32_t)writer->quantized[channel * EZ_AUDIO_WAV_WRITER_CHUNK_FRAMES + frame]);
+                }
+            }
+            break;
+    }
+    return bytes;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioWAVWriterWriteBytes(EZAudioWAVWriter *writer, const void *bytes, size_t length)
+{
+    if (fwrite(bytes, 1, length, writer->file) != length)
+    {
+        writer->failed = true;
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioWAVWriterPatch32(EZAudioWAVWriter *writer, long offset, uint32_t value)
+{
+    uint8_t bytes[4];
+    EZAudioWAVWriterPut32(bytes, value);
+    return fseek(writer->file, offset, SEEK_SET) == 0 && EZAudioWAVWriterWriteBytes(writer, bytes, 4);
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioWAVWriterPatchBytes(EZAudioWAVWriter *writer, long offset, const void *bytes, size_t length)
+{
+    return fseek(writer->file, offset, SEEK_SET) == 0 && EZAudioWAVWriterWriteBytes(writer, bytes, length);
+}
+
+//------------------------------------------------------------------------------
+
+// patches the header to describe everything written so far (and the padding after it when closing)
+static bool EZAudioWAVWriterCommitSizes(EZAudioWAVWriter *writer, uint64_t padding)
+{
+    bool     committed = true;
+    uint64_t riffSize  = (uint64_t)writer->dataSizeOffset + 4 + writer->dataBytes + padding - 8;
+    if (riffSize > UINT32_MAX && !writer->rf64)
+    {
+        // past 4 GB the reserved JUNK chunk becomes the ds64 chunk and the 32-bit sizes point to it
+        committed = EZAudioWAVWriterPatchBytes(writer, 0, "RF64", 4) && committed;
+        committed = EZAudioWAVWriterPatchBytes(writer, writer->ds64Offset, "ds64", 4) && committed;
+        writer->rf64 = true;
+    }
+    if (writer->rf64)
+    {
+        uint8_t ds64[24];
+        EZAudioWAVWriterPut64(ds64, riffSize);
+        EZAudioWAVWriterPut64(ds64 + 8, writer->dataBytes);
+        EZAudioWAVWriterPut64(ds64 + 16, writer->frames);
+        committed = EZAudioWAVWriterPatchBytes(writer, writer->ds64Offset + 8, ds64, sizeof(ds64)) && committed;
+        committed = EZAudioWAVWriterPatch32(writer, writer->riffSizeOffset, UINT32_MAX) && committed;
+        committed = EZAudioWAVWriterPatch32(writer, writer->dataSizeOffset, UINT32_MAX) && committed;
+        if (writer->factFramesOffset >= 0)
+        {
+            committed = EZAudioWAVWriterPatch32(writer, writer->factFramesOffset, UINT32_MAX) && committed;
+        }
+        return committed;
+    }
+
+    committed = EZAudioWAVWriterPatch32(writer, writer->riffSizeOffset, (uint32_t)riffSize) && committed;
+    committed = EZAudioWAVWriterPatch32(writer, writer->dataSizeOffset, (uint32_t)writer->dataBytes) && committed;
+    if (writer->factFramesOffset >= 0)
+    {
+        committed = EZAudioWAVWriterPatch32(writer, writer->factFramesOffset, (uint32_t)writer->frames) && committed;
+    }
+    return committed;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioWAVWriterWriteHeader(EZAudioWAVWriter *writer)
+{
+    bool     isFloat    = writer->sampleFormat == EZAudioWAVWriterSampleFormatFloat32;
+    uint32_t blockAlign = writer->channels * writer->bytesPerSample;
+    uint8_t  header[94];
+    size_t   length = 12;
+
+    // the sizes are placeholders until the file is synced or closed
+    memcpy(header, "RIFF", 4);
+    writer->riffSizeOffset = 4;
+    EZAudioWAVWriterPut32(header + 4, 0);
+    memcpy(header + 8, "WAVE", 4);
+
+    // room for a ds64 chunk that readers skip over unless the file turns into RF64
+    if (writer->options & EZAudioWAVWriterOptionRF64)
+    {
+        memcpy(header + length, "JUNK", 4);
+        EZAudioWAVWriterPut32(header + length + 4, EZAudioWAVWriterDS64Size);
+        memset(header + length + 8, 0, EZAudioWAVWriterDS64Size);
+        writer->ds64Offset = (long)length;
+        length += 8 + EZAudioWAVWriterDS64Size;
+    }
+
+    // float files carry the extension size and a fact chunk as the spec asks
+    uint8_t *format = header + length;
+    memcpy(format, "fmt ", 4);
+    EZAudioWAVWriterPut32(format + 4, isFloat ? 18 : 16);
+    EZAudioWAVWriterPut16(format + 8, isFloat ? EZAudioWAVWriterFormatTagFloat : EZAudioWAVWriterFormatTagPCM);
+    EZAudioWAVWriterPut16(format + 10, (uint16_t)writer->channels);
+    EZAudioWAVWriterPut32(format + 12, writer->sampleRate);
+    EZAudioWAVWriterPut32(format + 16, writer->sampleRate * blockAlign);
+    EZAudioWAVWriterPut16(format + 20, (uint16_t)blockAlign);
+    EZAudioWAVWriterPut16(format + 22, (uint16_t)(writer->bytesPerSample * 8));
+    length += 24;
+    if (isFloat)
+    {
+        EZAudioWAVWriterPut16(header + length, 0);
+        memcpy(header + length + 2, "fact", 4);
+        EZAudioWAVWriterPut32(header + length + 6, 4);
+        writer->factFramesOffset = (long)length + 10;
+        EZAudioWAVWriterPut32(header + length + 10, 0);
+        length += 14;
+    }
+
+    memcpy(header + length, "data", 4);
+    writer->dataSizeOffset = (long)length + 4;
+    EZAudioWAVWriterPut32(header + length + 4, 0);
+    length += 8;
+
+    return EZAudioWAVWriterWriteBytes(writer, header, length);
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+EZAudioWAVWriter *EZAudioWAVWriterCreate(const char *path,
+                                         uint32_t channels,
+                                         double sampleRate,
+                                         EZAudioWAVWriterSampleFormat sampleFormat)
+{
+    return EZAudioWAVWriterCreateWithOptions(path, channels, sampleRate, sampleFormat, EZAudioWAVWriterOptionNone);
+}
+
+//------------------------------------------------------------------------------
+
+EZAudioWAVWriter *EZAudioWAVWriterCreateWithOptions(const char *path,
+                                                    uint32_t channels,
+                                                    double sampleRate,
+                                                    EZAudioWAVWriterSampleFormat sampleFormat,
+                                                    EZAudioWAVWriterOptions options)
+{
+    if (!path || channels == 0 || channels > UINT16_MAX || sampleRate <= 0.0)
+    {
+        return NULL;
+    }
+
+    EZAudioWAVWriter *writer = (EZAudioWAVWriter *)calloc(1, sizeof(EZAudioWAVWriter));
+    if (!writer)
+    {
+        return NULL;
+    }
+    writer->channels       = channels;
+    writer->sampleRate     = (uint32_t)lround(sampleRate);
+    writer->sampleFormat   = sampleFormat;
+    writer->options        = options;
+    switch (sampleFormat)
+    {
+        case EZAudioWAVWriterSampleFormatSInt16:
+            writer->bytesPerSample = 2;
+            break;
+        case EZAudioWAVWriterSampleFormatSInt24:
+            writer->bytesPerSample = 3;
+            break;
+        default:
+            writer->bytesPerSample = 4;
+            break;
+    }
+    writer->ds64Offset       = -1;
+    writer->factFramesOffset = -1;
+    for (int i = 0; i < 4; i++)
+    {
+        // any nonzero seeds do, distinct ones keep the lanes uncorrelated
+        writer->dither[i] = 0x9E3779B9u * (uint32_t)(i + 1);
+    }
+    writer->scratch = (uint8_t *)malloc((size_t)EZ_AUDIO_WAV_WRITER_CHUNK_FRAMES * channels * writer->bytesPerSample);
+    if (sampleFormat != EZAudioWAVWriterSampleFormatFloat32)
+    {
+        writer->quantized = (int32_t *)malloc((size_t)EZ_AUDIO_WAV_WRITER_CHUNK_FRAMES * channels * sizeof(int32_t));
+    }
+    writer->file = fopen(path, "wb");
+    if (!writer->scratch || (sampleFormat != EZAudioWAVWriterSampleFormatFloat32 && !writer->quantized) ||
+        !writer->file || !EZAudioWAVWriterWriteHeader(writer))
+    {
+        if (writer->file)
+        {
+            fclose(writer->file);
+        }
+        free(writer->quantized);
+        free(writer->scratch);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+//------------------------------------------------------------------------------
+
+bool EZAudioWAVWriterClose(EZAudioWAVWriter *writer)
+{
+    if (!writer)
+    {
+        return false;
+    }
+
+    // an odd sized data chunk is padded to keep the chunks word aligned
+    bool completed = !writer->failed;
+    uint64_t padding = writer->dataBytes & 1;
+    if (padding)
+    {
+        uint8_t zero = 0;
+        completed = EZAudioWAVWriterWriteBytes(writer, &zero, 1) && completed;
+    }
+
+    completed = EZAudioWAVWriterCommitSizes(writer, padding) && completed;
+    completed = fclose(writer->file) == 0 && completed;
+    free(writer->quantized);
+    free(writer->scratch);
+    free(writer);
+    return completed;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Writing
+//------------------------------------------------------------------------------
+
+bool EZAudioWAVWriterWrite(EZAudioWAVWriter *writer,
+                           const float * const *source,
+                           uint32_t frames)
+{
+    if (writer->failed)
+    {
+        return false;
+    }
+
+    // the header's sizes are 32 bits unless it can turn into RF64
+    uint32_t channels   = writer->channels;
+    uint64_t blockAlign = (uint64_t)channels * writer->bytesPerSample;
+    if (!(writer->options & EZAudioWAVWriterOptionRF64) && writer->dataSizeOffset + 4 + writer->dataBytes + frames * blockAlign > UINT32_MAX)
+    {
+        writer->failed = true;
+        return false;
+    }
+
+    for (uint32_t offset = 0; offset < frames; offset += EZ_AUDIO_WAV_WRITER_CHUNK_FRAMES)
+    {
+        uint32_t count = frames - offset < EZ_AUDIO_WAV_WRITER_CHUNK_FRAMES ? frames - offset : EZ_AUDIO_WAV_WRITER_CHUNK_FRAMES;
+        uint8_t  *bytes = writer->scratch;
+        if (writer->sampleFormat == EZAudioWAVWriterSampleFormatFloat32)
+        {
+            for (uint32_t frame = 0; frame < count; frame++)
+            {
+                for (uint32_t channel = 0; channel < channels; channel++)
+                {
+                    uint32_t bits;
+                    memcpy(&bits, &source[channel][offset + frame], 4);
+                    EZAudioWAVWriterPut32(bytes, bits);
+                    bytes += 4;
+                }
+            }
+        }
+        else
+        {
+            for (uint32_t channel = 0; channel < channels; channel++)
+            {
+                EZAudioWAVWriterQuantize(writer,
+                                         source[channel] + offset,
+                                         count,
+                                         writer->quantized + (size_t)channel * EZ_AUDIO_WAV_WRITER_CHUNK_FRAMES);
+            }
+            bytes = EZAudioWAVWriterPack(writer, count, bytes);
+        }
+        if (!EZAudioWAVWriterWriteBytes(writer, writer->scratch, (size_t)(bytes - writer->scratch)))
+        {
+            return false;
+        }
+        writer->frames    += count;
+        writer->dataBytes += count * blockAlign;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool EZAudioWAVWriterSync(EZAudioWAVWriter *writer)
+{
+    // the audio has to be on the disk before the header says it's there
+    if (fflush(writer->file) != 0 || fsync(fileno(writer->file)) != 0)
+    {
+        return false;
+    }
+    bool committed = EZAudioWAVWriterCommitSizes(writer, 0);
+    committed = fseek(writer->file, 0, SEEK_END) == 0 && committed;
+    return fflush(writer->file) == 0 && fsync(fileno(writer->file)) == 0 && committed;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Repair
+//------------------------------------------------------------------------------
+
+static bool EZAudioWAVWriterReadAt(FILE *file, off_t offset, void *bytes, size_t length)
+{
+    return fseeko(file, offset, SEEK_SET) == 0 && fread(bytes, 1, length, file) == length;
+}
+
+//------------------------------------------------------------------------------
+
+static bool EZAudioWAVWriterWriteAt(FILE *file, off_t offset, const void *bytes, size_t length)
+{
+    return fseeko(file, offset, SEEK_SET) == 0 && fwrite(bytes, 1, length, file) == length;
+}
+
+//------------------------------------------------------------------------------
+
+static EZAudioWAVWriterRepairResult EZAudioWAVWriterRepairFile(FILE *file, uint64_t *frames)
+{
+    uint8_t bytes[28];
+    if (fseeko(file, 0, SEEK_END) != 0)
+    {
+        return EZAudioWAVWriterRepairResultFailed;
+    }
+    off_t fileSize = ftello(file);
+    if (fileSize < 12 || !EZAudioWAVWriterReadAt(file, 0, bytes, 12))
+    {
+        return EZAudioWAVWriterRepairResultFailed;
+    }
+    bool isRF64 = memcmp(bytes, "RF64", 4) == 0;
+    if ((!isRF64 && memcmp(bytes, "RIFF", 4) != 0) || memcmp(bytes + 8, "WAVE", 4) != 0)
+    {
+        return EZAudioWAVWriterRepairResultFailed;
+    }
+    uint64_t declaredRIFFSize = EZAudioWAVWriterGet32(bytes + 4);
+
+    // walk the chunks up to the audio data, which is all that's left of a file that was never closed
+    off_t    offset         = 12;
+    off_t    ds64Offset     = -1;
+    off_t    factOffset     = -1;
+    off_t    dataOffset     = -1;
+    uint32_t blockAlign     = 0;
+    uint64_t declaredBytes  = 0;
+    uint64_t ds64RIFFSize   = 0;
+    uint64_t ds64DataSize   = 0;
+    bool     hasDS64        = false;
+    while (offset + 8 <= fileSize)
+    {
+        if (!EZAudioWAVWriterReadAt(file, offset, bytes, 8))
+        {
+            return EZAudioWAVWriterRepairResultFailed;
+        }
+        uint32_t size = EZAudioWAVWriterGet32(bytes + 4);
+        if (memcmp(bytes, "data", 4) == 0)
+        {
+            dataOffset    = offset;
+            declaredBytes = size;
+            break;
+        }
+        bool isDS64 = memcmp(bytes, "ds64", 4) == 0;
+        if ((isDS64 || (memcmp(bytes, "JUNK", 4) == 0 && offset == 12)) && size >= EZAudioWAVWriterDS64Size)
+        {
+            // a JUNK chunk first thing after WAVE can be turned into the ds64 chunk
+            ds64Offset = offset;
+            if (isDS64 && EZAudioWAVWriterReadAt(file, offset + 8, bytes, 16))
+            {
+                ds64RIFFSize = EZAudioWAVWriterGet64(bytes);
+                ds64DataSize = EZAudioWAVWriterGet64(bytes + 8);
+                hasDS64      = true;
+            }
+        }
+        else if (memcmp(bytes, "fmt ", 4) == 0 && size >= 16)
+        {
+            if (!EZAudioWAVWriterReadAt(file, offset + 8, bytes, 16))
+            {
+                return EZAudioWAVWriterRepairResultFailed;
+            }
+            blockAlign = EZAudioWAVWriterGet16(bytes + 12);
+        }
+        else if (memcmp(bytes, "fact", 4) == 0 && size >= 4)
+        {
+            factOffset = offset + 8;
+        }
+        offset += 8 + (off_t)size + (size & 1);
+    }
+    if (dataOffset < 0 || blockAlign == 0)
+    {
+        return EZAudioWAVWriterRepairResultFailed;
+    }
+    if (isRF64 && hasDS64)
+    {
+        declaredRIFFSize = declaredRIFFSize == UINT32_MAX ? ds64RIFFSize : declaredRIFFSize;
+        declaredBytes    = declaredBytes == UINT32_MAX ? ds64DataSize : declaredBytes;
+    }
+
+    // a file that was closed properly has a RIFF size covering the whole of it
+    off_t dataStart = dataOffset + 8;
+    if (declaredRIFFSize + 8 == (uint64_t)fileSize && (uint64_t)dataStart + declaredBytes <= (uint64_t)fileSize)
+    {
+        if (frames)
+        {
+            *frames = declaredBytes / blockAlign;
+        }
+        return EZAudioWAVWriterRepairResultIntact;
+    }
+
+    // otherwise the audio runs to the end of the file, less whatever partial frame was being written
+    uint64_t available = (uint64_t)(fileSize - dataStart);
+    uint64_t dataBytes = available - available % blockAlign;
+    uint64_t padding   = dataBytes & 1;
+    uint64_t riffSize  = (uint64_t)dataStart + dataBytes + padding - 8;
+    uint64_t count     = dataBytes / blockAlign;
+    bool     repaired  = true;
+    if (riffSize > UINT32_MAX || isRF64)
+    {
+        if (ds64Offset < 0)
+        {
+            return EZAudioWAVWriterRepairResultFailed;
+        }
+        uint8_t ds64[32];
+        memcpy(ds64, "ds64", 4);
+        EZAudioWAVWriterPut32(ds64 + 4, EZAudioWAVWriterDS64Size);
+        EZAudioWAVWriterPut64(ds64 + 8, riffSize);
+        EZAudioWAVWriterPut64(ds64 + 16, dataBytes);
+        EZAudioWAVWriterPut64(ds64 + 24, count);
+        EZAudioWAVWriterPut32(bytes, UINT32_MAX);
+        repaired = EZAudioWAVWriterWriteAt(file, 0, "RF64", 4) && repaired;
+        repaired = EZAudioWAVWriterWriteAt(file, 4, bytes, 4) && repaired;
+        repaired = EZAudioWAVWriterWriteAt(file, ds64Offset, ds64, sizeof(ds64)) && repaired;
+        repaired = EZAudioWAVWriterWriteAt(file, dataOffset + 4, bytes, 4) && repaired;
+        if (factOffset >= 0)
+        {
+            repaired = EZAudioWAVWriterWriteAt(file, factOffset, bytes, 4) && repaired;
+        }
+    }
+    else
+    {
+        EZAudioWAVWriterPut32(bytes, (uint32_t)riffSize);
+        EZAudioWAVWriterPut32(bytes + 4, (uint32_t)dataBytes);
+        EZAudioWAVWriterPut32(bytes + 8, (uint32_t)count);
+        repaired = EZAudioWAVWriterWriteAt(file, 4, bytes, 4) && repaired;
+        repaired = EZAudioWAVWriterWriteAt(file, dataOffset + 4, bytes + 4, 4) && repaired;
+        if (factOffset >= 0)
+        {
+            repaired = EZAudioWAVWriterWriteAt(file, factOffset, bytes + 8, 4) && repaired;
+        }
+    }
+    repaired = fflush(file) == 0 && repaired;
+    if (available != dataBytes + padding)
+    {
+        // drop the partial frame (or add the pad byte) so the data chunk ends the file
+        repaired = ftruncate(fileno(file), dataStart + (off_t)(dataBytes + padding)) == 0 && repaired;
+    }
+    repaired = fsync(fileno(file)) == 0 && repaired;
+    if (!repaired)
+    {
+        return EZAudioWAVWriterRepairResultFailed;
+    }
+    if (frames)
+    {
+        *frames = count;
+    }
+    return EZAudioWAVWriterRepairResultRepaired;
+}
+
+//------------------------------------------------------------------------------
+
+EZAudioWAVWriterRepairResult EZAudioWAVWriterRepair(const char *path,
+                                                    uint64_t *frames)
+{
+    if (!path)
+    {
+        return EZAudioWAVWriterRepairResultFailed;
+    }
+    FILE *file = fopen(path, "r+b");
+    if (!file)
+    {
+        return EZAudioWAVWriterRepairResultFailed;
+    }
+    EZAudioWAVWriterRepairResult result = EZAudioWAVWriterRepairFile(file, frames);
+    if (fclose(file) != 0 && result == EZAudioWAVWriterRepairResultRepaired)
+    {
+        result = EZAudioWAVWriterRepairResultFailed;
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------------
+#pragma mark - Properties
+//------------------------------------------------------------------------------
+
+uint64_t EZAudioWAVWriterFrames(const EZAudioWAVWriter *writer)
+{
+    return writer->frames;
+}
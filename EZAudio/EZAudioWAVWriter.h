@@ -0,0 +1,198 @@
+//
+//  EZAudioWAVWriter.h
+//  EZAudio
+//
+//  Copyright (c) 2015 Syed Haris Ali. All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef EZAudioWAVWriter_h
+#define EZAudioWAVWriter_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioWAVWriter
+//------------------------------------------------------------------------------
+
+/**
+ Writes non-interleaved float audio to a WAV file. The samples are converted to the file's sample format and interleaved in fixed scratch buffers, so writing never allocates. Integer formats are quantized a channel at a time in contiguous loops the compiler vectorizes, optionally with dither, before they're interleaved. The header is written with placeholder sizes when the file is created and patched when it's closed, and each EZAudioWAVWriterSync commits the sizes of everything written so far, so a long recording that's synced periodically survives the process being killed as a playable file.
+
+ A WAV header can only describe 4 GB. A writer created with EZAudioWAVWriterOptionRF64 reserves room in the header (a JUNK chunk, as EBU Tech 3306 recommends) and turns the file into an RF64 file with 64-bit sizes if it grows past that, otherwise it stays a plain WAV file. Files left behind by a crash (or any writer that died before patching its header) are repaired in place with EZAudioWAVWriterRepair, which only reads the header and looks at the file's size so it's just as fast for hours of audio.
+
+ This is plain C on top of stdio without any Core Audio dependencies, so offline renders and the files they produce can be written and checked anywhere (i.e. on Linux). A writer is not thread safe, use it from one thread at a time.
+ */
+typedef struct EZAudioWAVWriter EZAudioWAVWriter;
+
+/**
+ The sample formats a WAV file can be written in.
+ */
+typedef enum
+{
+    /**
+     32-bit IEEE float samples (WAVE_FORMAT_IEEE_FLOAT), written exactly as rendered.
+     */
+    EZAudioWAVWriterSampleFormatFloat32,
+    /**
+     16-bit signed integer samples (WAVE_FORMAT_PCM), rounded and clipped.
+     */
+    EZAudioWAVWriterSampleFormatSInt16,
+    /**
+     24-bit signed integer samples (WAVE_FORMAT_PCM), rounded and clipped.
+     */
+    EZAudioWAVWriterSampleFormatSInt24,
+    /**
+     32-bit signed integer samples (WAVE_FORMAT_PCM), rounded and clipped.
+     */
+    EZAudioWAVWriterSampleFormatSInt32
+} EZAudioWAVWriterSampleFormat;
+
+/**
+ Options for how a WAV file is written.
+ */
+typedef enum
+{
+    /**
+     A plain WAV file, which fails to write past 4 GB.
+     */
+    EZAudioWAVWriterOptionNone = 0,
+    /**
+     Reserves room for a ds64 chunk in the header and turns the file into RF64 if it grows past 4 GB.
+     */
+    EZAudioWAVWriterOptionRF64 = 1 << 0,
+    /**
+     Adds triangular (TPDF) dither of up to one step either way before rounding to 16 or 24-bit integer samples, which turns the rounding error's distortion of quiet signals into a constant, benign noise floor. Ignored for the other sample formats.
+     */
+    EZAudioWAVWriterOptionDither = 1 << 1
+} EZAudioWAVWriterOptions;
+
+/**
+ The outcomes of repairing a WAV file with EZAudioWAVWriterRepair.
+ */
+typedef enum
+{
+    /**
+     The file isn't a WAV or RF64 file or its header is too damaged to find the audio data.
+     */
+    EZAudioWAVWriterRepairResultFailed,
+    /**
+     The file's header already describes all of its audio data, nothing was changed.
+     */
+    EZAudioWAVWriterRepairResultIntact,
+    /**
+     The file's header was patched to describe all of the audio data that reached the disk.
+     */
+    EZAudioWAVWriterRepairResultRepaired
+} EZAudioWAVWriterRepairResult;
+
+//------------------------------------------------------------------------------
+#pragma mark - Creation
+//------------------------------------------------------------------------------
+
+/**
+ Creates a WAV file (replacing any file at the path) and writes its header.
+ @param path         The file system path of the file to write.
+ @param channels     The number of channels.
+ @param sampleRate   The sample rate.
+ @param sampleFormat The EZAudioWAVWriterSampleFormat of the samples in the file.
+ @return A new writer or NULL if the file couldn't be created. Close it with EZAudioWAVWriterClose.
+ */
+EZAudioWAVWriter *EZAudioWAVWriterCreate(const char *path,
+                                         uint32_t channels,
+                                         double sampleRate,
+                                         EZAudioWAVWriterSampleFormat sampleFormat);
+
+/**
+ Creates a WAV file (replacing any file at the path) with EZAudioWAVWriterOptions and writes its header.
+ @param path         The file system path of the file to write.
+ @param channels     The number of channels.
+ @param sampleRate   The sample rate.
+ @param sampleFormat The EZAudioWAVWriterSampleFormat of the samples in the file.
+ @param options      The EZAudioWAVWriterOptions, i.e. EZAudioWAVWriterOptionRF64 for recordings that could run past 4 GB.
+ @return A new writer or NULL if the file couldn't be created. Close it with EZAudioWAVWriterClose.
+ */
+EZAudioWAVWriter *EZAudioWAVWriterCreateWithOptions(const char *path,
+                                                    uint32_t channels,
+                                                    double sampleRate,
+                                                    EZAudioWAVWriterSampleFormat sampleFormat,
+                                                    EZAudioWAVWriterOptions options);
+
+/**
+ Patches the header with the final sizes, closes the file and frees the writer.
+ @param writer The writer to close.
+ @return true if the file was completed, false if a write or the header patch failed along the way.
+ */
+bool EZAudioWAVWriterClose(EZAudioWAVWriter *writer);
+
+//------------------------------------------------------------------------------
+#pragma mark - Writing
+//------------------------------------------------------------------------------
+
+/**
+ Appends frames to the file.
+ @param writer The writer.
+ @param source One float array per channel.
+ @param frames The number of frames to write.
+ @return true if every frame was written, false if the write failed or the file would grow past the 4 GB a WAV header can describe (without EZAudioWAVWriterOptionRF64).
+ */
+bool EZAudioWAVWriterWrite(EZAudioWAVWriter *writer,
+                           const float * const *source,
+                           uint32_t frames);
+
+/**
+ Pushes everything written so far through to the disk and then commits the header's sizes to match it, so the file survives a crash with all of it playable. The audio is synced (fflush and fsync) before the header is patched and synced in turn, so the header never describes audio that isn't on the disk yet.
+ @param writer The writer.
+ @return true if the sync and the header commit succeeded.
+ */
+bool EZAudioWAVWriterSync(EZAudioWAVWriter *writer);
+
+//------------------------------------------------------------------------------
+#pragma mark - Repair
+//------------------------------------------------------------------------------
+
+/**
+ Repairs a WAV or RF64 file whose header wasn't patched to its final sizes, i.e. one left behind by a crash during a recording. The chunks before the audio data are scanned to find it and the header is patched to describe everything from there to the end of the file (less any partial frame, which is truncated). Nothing is re-encoded. Files larger than 4 GB can only be repaired if they have an RF64 ds64 chunk or a JUNK chunk reserving room for one, as written with EZAudioWAVWriterOptionRF64. Must not be used on a file that's still being written.
+ @param path   The file system path of the file to repair.
+ @param frames If not NULL receives the number of frames the repaired (or intact) file holds.
+ @return The EZAudioWAVWriterRepairResult.
+ */
+EZAudioWAVWriterRepairResult EZAudioWAVWriterRepair(const char *path,
+                                                    uint64_t *frames);
+
+//------------------------------------------------------------------------------
+#pragma mark - Properties
+//------------------------------------------------------------------------------
+
+/**
+ Provides the number of frames written so far.
+ @param writer The writer.
+ @return The number of frames.
+ */
+uint64_t EZAudioWAVWriterFrames(const EZAudioWAVWriter *writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -26,10 +26,35 @@
 #import  <Foundation/Foundation.h>
 #import  <AudioToolbox/AudioToolbox.h>
 #import  "TargetConditionals.h"
+#import  "EZAudioCallbackMetrics.h"
+#import  "EZAudioVirtualInput.h"
+#import  "EZAudioVoiceActivityDetector.h"
+#if TARGET_OS_IPHONE
+#elif TARGET_OS_MAC
+#import  <CoreAudio/CoreAudio.h>
+#endif
 
 @class EZAudio;
 @class EZMicrophone;
 
+/**
+ The ways the EZMicrophone can use its voice activity detector.
+ */
+typedef NS_ENUM(NSInteger, EZMicrophoneVoiceActivityMode){
+  /**
+   No voice activity detection, every buffer is delivered (the default).
+   */
+  EZMicrophoneVoiceActivityModeOff,
+  /**
+   Every buffer is delivered and the delegate is told when voice activity starts and stops.
+   */
+  EZMicrophoneVoiceActivityModeFlag,
+  /**
+   Only buffers with voice activity (plus the hangover and pre-roll around them) are delivered, silence is dropped before it reaches the delegate.
+   */
+  EZMicrophoneVoiceActivityModeGate
+};
+
 #pragma mark - EZMicrophoneDelegate
 /**
  The delegate for the EZMicrophone provides a receiver for the incoming audio data events. When the microphone has been successfully internally configured it will try to send its delegate an AudioStreamBasicDescription describing the format of the incoming audio data. 
@@ -39,6 +64,9 @@
    -`microphone:hasAudioReceived:withBufferSize:withNumberOfChannels:`
      Provides float arrays instead of the AudioBufferList structure to hold the audio data. There could be a number of float arrays depending on the number of channels (see the function description below). These are useful for doing any visualizations that would like to make use of the raw audio data.
  
+   -`microphone:hasAudioReceived:withBufferSize:withNumberOfChannels:atTimeStamp:`
+     The same float arrays along with the time the first frame was captured, for lining the audio up against other sources.
+ 
    -`microphone:hasBufferList:withBufferSize:withNumberOfChannels:`
      Provides the AudioBufferList structures holding the audio data. These are the native structures Core Audio uses to hold the buffer information and useful for piping out directly to an output (see EZOutput).
  
@@ -75,6 +103,21 @@
        withBufferSize:(UInt32)bufferSize
  withNumberOfChannels:(UInt32)numberOfChannels;
 
+/**
+ Returns back a float array of the audio received along with when it was captured. When implemented this is called instead of `microphone:hasAudioReceived:withBufferSize:withNumberOfChannels:`.
+ @param microphone       The instance of the EZMicrophone that triggered the event.
+ @param buffer           The audio data as an array of float arrays. In a stereo signal buffer[0] represents the left channel while buffer[1] would represent the right channel.
+ @param bufferSize       The size of each of the buffers (the length of each float array).
+ @param numberOfChannels The number of channels for the incoming audio.
+ @param timeStamp        The capture time of the buffer's first frame, its mHostTime is on the mach_absolute_time clock. Batches from the consumer thread and the pre-roll in gate mode are stamped relative to the input callback's time stamp, only their mHostTime is valid.
+ @warning This function executes on a background thread to avoid blocking any audio operations. If operations should be performed on any other thread (like the main thread) it should be performed within a dispatch block like so: dispatch_async(dispatch_get_main_queue(), ^{ ...Your Code... })
+ */
+-(void)    microphone:(EZMicrophone*)microphone
+     hasAudioReceived:(float**)buffer
+       withBufferSize:(UInt32)bufferSize
+ withNumberOfChannels:(UInt32)numberOfChannels
+          atTimeStamp:(const AudioTimeStamp*)timeStamp;
+
 /**
  Returns back the buffer list containing the audio received. This occurs on the background thread so any drawing code must explicity perform its functions on the main thread.
  @param microphone       The instance of the EZMicrophone that triggered the event.
@@ -88,6 +131,19 @@
        withBufferSize:(UInt32)bufferSize
  withNumberOfChannels:(UInt32)numberOfChannels;
 
+///-----------------------------------------------------------
+/// @name Voice Activity
+///-----------------------------------------------------------
+
+/**
+ Called when the voice activity detector's decision changes (see `voiceActivityMode`). In gate mode this is called right before the first buffer of an utterance (and its pre-roll) is delivered and right after the last one.
+ @param microphone    The instance of the EZMicrophone that triggered the event.
+ @param isVoiceActive A bool describing whether voice activity has started (YES) or stopped (NO).
+ @warning This function executes on the same thread as the audio callbacks.
+ */
+-(void)microphone:(EZMicrophone*)microphone
+voiceActivityChanged:(BOOL)isVoiceActive;
+
 @end
 
 #pragma mark - EZMicrophone
@@ -106,6 +162,36 @@
  */
 @property (nonatomic,assign) BOOL microphoneOn;
 
+/**
+ A bool describing whether the delegate callbacks are delivered from a dedicated consumer thread instead of the realtime audio thread. When YES the input callback only copies the incoming audio into a preallocated lock-free ring buffer and the consumer thread drains it, converts it to float and calls the delegate in batches of `consumerBatchSize` frames, so a slow delegate shows up as an overrun (see `consumerOverruns`) instead of a dropout. Default is NO.
+ @warning Do not set this while fetching audio (startFetchingAudio)
+ */
+@property (nonatomic,assign) BOOL shouldDeliverAudioOnConsumerThread;
+
+/**
+ The number of frames handed to the delegate per callback when `shouldDeliverAudioOnConsumerThread` is YES. Default is 1024.
+ @warning Do not set this while fetching audio (startFetchingAudio)
+ */
+@property (nonatomic,assign) UInt32 consumerBatchSize;
+
+/**
+ The EZMicrophoneVoiceActivityMode describing what the microphone does with its voice activity detector, which decides from each buffer's energy against a tracked noise floor and its spectral flatness whether someone is speaking. In gate mode silent buffers are dropped before they're handed to the delegate so any downstream processing (and the float conversion for it) only runs while there's speech. Default is EZMicrophoneVoiceActivityModeOff.
+ @warning Do not set this while fetching audio (startFetchingAudio)
+ */
+@property (nonatomic,assign) EZMicrophoneVoiceActivityMode voiceActivityMode;
+
+/**
+ The time in seconds voice activity is held after the detector last heard speech, so pauses between words don't cut an utterance apart. Default is 0.3 seconds.
+ @warning Do not set this while fetching audio (startFetchingAudio)
+ */
+@property (nonatomic,assign) NSTimeInterval voiceActivityHangover;
+
+/**
+ The time in seconds of audio from just before voice activity started that's delivered ahead of the utterance in gate mode, so soft onsets the detector needs a moment to pick up aren't lost. Default is 0.2 seconds.
+ @warning Do not set this while fetching audio (startFetchingAudio)
+ */
+@property (nonatomic,assign) NSTimeInterval voiceActivityPreRoll;
+
 #pragma mark - Initializers
 ///-----------------------------------------------------------
 /// @name Initializers
@@ -147,6 +233,15 @@
            withAudioStreamBasicDescription:(AudioStreamBasicDescription)audioStreamBasicDescription
                          startsImmediately:(BOOL)startsImmediately;
 
+/**
+ Creates an instance of the EZMicrophone driven by an EZAudioVirtualInput instead of an input device. No audio unit is created: when the microphone starts fetching audio a thread pulls buffers from the virtual input (paced to real time or not, see EZAudioVirtualInput) and hands them to the same delivery path the hardware input callback uses, so the delegate, the consumer thread and the callback metrics behave exactly as they would with a device.
+ @param microphoneDelegate A EZMicrophoneDelegate delegate that will receive the audioReceived callback.
+ @param virtualInput       The EZAudioVirtualInput providing the audio. The stream format's sample rate is the virtual input's.
+ @return An instance of the EZMicrophone class. This should be strongly retained.
+ */
+-(EZMicrophone*)initWithMicrophoneDelegate:(id<EZMicrophoneDelegate>)microphoneDelegate
+                              virtualInput:(EZAudioVirtualInput*)virtualInput;
+
 #pragma mark - Class Initializers
 ///-----------------------------------------------------------
 /// @name Class Initializers
@@ -190,6 +285,15 @@
        withAudioStreamBasicDescription:(AudioStreamBasicDescription)audioStreamBasicDescription
                      startsImmediately:(BOOL)startsImmediately;
 
+/**
+ Creates an instance of the EZMicrophone driven by an EZAudioVirtualInput instead of an input device (see initWithMicrophoneDelegate:virtualInput:).
+ @param microphoneDelegate A EZMicrophoneDelegate delegate that will receive the audioReceived callback.
+ @param virtualInput       The EZAudioVirtualInput providing the audio.
+ @return An instance of the EZMicrophone class. This should be strongly retained.
+ */
++(EZMicrophone*)microphoneWithDelegate:(id<EZMicrophoneDelegate>)microphoneDelegate
+                          virtualInput:(EZAudioVirtualInput*)virtualInput;
+
 #pragma mark - Singleton
 ///-----------------------------------------------------------
 /// @name Shared Instance
@@ -233,16 +337,100 @@
  */
 -(AudioUnit*)audioUnit;
 
+/**
+ Provides the EZAudioVirtualInput driving the microphone, if it was created with one.
+ @return The EZAudioVirtualInput or nil when the microphone uses an input device.
+ */
+-(EZAudioVirtualInput*)virtualInput;
+
+///-----------------------------------------------------------
+/// @name Consumer Thread Overruns
+///-----------------------------------------------------------
+
+/**
+ Provides the number of input buffers that were dropped because the consumer thread's ring buffer was full (i.e. the delegate could not keep up) since the microphone last started fetching audio. Only counts while `shouldDeliverAudioOnConsumerThread` is YES.
+ @return The number of dropped input buffers.
+ */
+-(UInt32)consumerOverruns;
+
+/**
+ Provides the total number of frames that were dropped because the consumer thread's ring buffer was full since the microphone last started fetching audio.
+ @return The number of dropped frames.
+ */
+-(SInt64)consumerDroppedFrames;
+
+///-----------------------------------------------------------
+/// @name Measuring The Input Callback
+///-----------------------------------------------------------
+
+/**
+ Provides a consistent snapshot of the input callback's instrumentation since the microphone last started fetching audio (or since `resetCallbackMetrics`): a histogram of how long each callback took, the callbacks that took longer than the audio they captured lasts (deadline misses), the buffers that failed to render or were dropped by the consumer thread (short buffers) and the jumps in the input's sample time (timestamp gaps, i.e. input overloads). Reading never blocks or disturbs the audio thread and is safe from any thread.
+ @return An EZAudioCallbackMetricsSnapshot of the input callback's counters.
+ */
+-(EZAudioCallbackMetricsSnapshot)callbackMetrics;
+
+/**
+ Provides the same snapshot as `callbackMetrics` exported as an NSDictionary (see EZAudio's `dictionaryWithCallbackMetrics:`).
+ @return An NSDictionary of the input callback's counters and duration percentiles.
+ */
+-(NSDictionary *)callbackMetricsDictionary;
+
+/**
+ Zeroes the input callback's instrumentation. The audio thread clears the counters at the end of its next callback so this is safe to call from any thread at any time.
+ */
+-(void)resetCallbackMetrics;
+
+/**
+ Provides how many realtime streams in the microphone's format the input pipeline could sustain on one core, computed from the callback metrics as the seconds of audio delivered per second spent delivering it. Most useful with an unpaced EZAudioVirtualInput to benchmark delegates. When `shouldDeliverAudioOnConsumerThread` is YES only the hand-off to the consumer thread is measured, not the delegate.
+ @return The number of realtime streams per core, or 0 before any audio was delivered.
+ */
+-(double)realtimeStreamsPerCore;
+
+///-----------------------------------------------------------
+/// @name Getting The Voice Activity
+///-----------------------------------------------------------
+
+/**
+ Provides the voice activity detector's current decision.
+ @return A bool describing whether voice activity was detected in the latest buffer (including the hangover). Always NO when `voiceActivityMode` is off.
+ */
+-(BOOL)isVoiceActive;
+
+/**
+ Provides the number of frames the voice activity gate dropped since the microphone last started fetching audio.
+ @return The number of suppressed frames.
+ */
+-(SInt64)voiceActivitySuppressedFrames;
+
 #pragma mark - Setters
 ///-----------------------------------------------------------
 /// @name Customizing The Microphone Input Format
 ///-----------------------------------------------------------
 
 /**
- Sets the AudioStreamBasicDescription on the microphone input.
- @warning Do not set this while fetching audio (startFetchingAudio)
+ Sets the AudioStreamBasicDescription on the microphone input. If the microphone is fetching audio it's stopped and restarted around the change. Formats of up to 64 channels are supported, one with more is ignored.
  @param asbd The new AudioStreamBasicDescription to use in place of the current audio format description.
  */
 -(void)setAudioStreamBasicDescription:(AudioStreamBasicDescription)asbd;
 
+#if TARGET_OS_IPHONE
+#elif TARGET_OS_MAC
+///-----------------------------------------------------------
+/// @name Choosing The Input Device (OSX only)
+///-----------------------------------------------------------
+
+/**
+ Provides the AudioDeviceID of the input device the microphone is bound to. This is the system default input device unless `setInputDevice:` was called.
+ @return The AudioDeviceID of the microphone's input device.
+ */
+-(AudioDeviceID)inputDevice;
+
+/**
+ Binds the microphone to a specific input device instead of the system default. The stream format's sample rate is updated to the device's and the delegate is sent the new AudioStreamBasicDescription. Use one microphone per device with an EZAggregateMicrophone to capture from several devices at once.
+ @warning Do not set this while fetching audio (startFetchingAudio)
+ @param inputDevice The AudioDeviceID of the input device to use.
+ */
+-(void)setInputDevice:(AudioDeviceID)inputDevice;
+#endif
+
 @end
@@ -31,6 +31,8 @@
 #endif
 
 #import "EZAudio.h"
+#import <pthread.h>
+#import <mach/mach_time.h>
 
 /// Buses
 static const AudioUnitScope kEZAudioMicrophoneInputBus  = 1;
@@ -44,6 +46,54 @@ static const UInt32 kEZAudioMicrophoneDisableFlag = 0;
 #endif
 static const UInt32 kEZAudioMicrophoneEnableFlag  = 1;
 
+/// Consumer Thread
+static const UInt32 kEZAudioMicrophoneDefaultConsumerBatchSize = 1024;
+static const UInt32 kEZAudioMicrophoneConsumerRingBatches      = 8;
+static const UInt32 kEZAudioMicrophoneConsumerAnchors           = 1024;
+
+/// Buffers (never sized below the minimum slice so the device's buffer size can change without reallocating)
+static const UInt32 kEZAudioMicrophoneMinimumFramesPerSlice   = 4096;
+static const UInt32 kEZAudioMicrophoneMaximumChannels         = 64;
+
+/// Voice Activity
+static const NSTimeInterval kEZAudioMicrophoneDefaultVoiceActivityHangover = 0.3;
+static const NSTimeInterval kEZAudioMicrophoneDefaultVoiceActivityPreRoll  = 0.2;
+static const UInt32         kEZAudioMicrophoneVoiceActivityPreRollChunk    = 1024;
+
+/// Delegate Dispatch
+typedef void (*EZMicrophoneHasAudioReceivedIMP)(id, SEL, EZMicrophone *, float **, UInt32, UInt32);
+typedef void (*EZMicrophoneHasAudioReceivedAtTimeStampIMP)(id, SEL, EZMicrophone *, float **, UInt32, UInt32, const AudioTimeStamp *);
+typedef void (*EZMicrophoneHasBufferListIMP)(id, SEL, EZMicrophone *, AudioBufferList *, UInt32, UInt32);
+typedef void (*EZMicrophoneVoiceActivityChangedIMP)(id, SEL, EZMicrophone *, BOOL);
+typedef struct EZMicrophoneDelegateDispatch {
+  __unsafe_unretained id                     delegate;
+  EZMicrophoneHasAudioReceivedIMP            hasAudioReceived;
+  EZMicrophoneHasAudioReceivedAtTimeStampIMP hasAudioReceivedAtTimeStamp;
+  EZMicrophoneHasBufferListIMP               hasBufferList;
+  EZMicrophoneVoiceActivityChangedIMP        voiceActivityChanged;
+  int64_t                                    retiredEpoch;
+  struct EZMicrophoneDelegateDispatch        *next;
+} EZMicrophoneDelegateDispatch;
+
+/// Buffer Configuration (immutable once published, the audio thread picks up the current one at the start of each callback)
+typedef struct EZMicrophoneBufferConfiguration {
+  AudioStreamBasicDescription            format;
+  UInt32                                 frameCapacity;
+  __unsafe_unretained AEFloatConverter   *converter;
+  AudioBufferList                        *bufferList;
+  float                                  **floatBuffers;
+  void                                   *sampleStorage;
+  float                                  *floatStorage;
+  int64_t                                retiredEpoch;
+  struct EZMicrophoneBufferConfiguration *next;
+} EZMicrophoneBufferConfiguration;
+
+/// Capture Anchor (the time stamp of a buffer handed to the consumer thread and the index of its first frame among the handed off frames)
+typedef struct EZMicrophoneCaptureAnchor {
+  SInt64         frame;
+  AudioTimeStamp timeStamp;
+} EZMicrophoneCaptureAnchor;
+
 @interface EZMicrophone (){
   /// Internal
   BOOL _customASBD;
@@ -56,10 +106,10 @@ static const UInt32 kEZAudioMicrophoneEnableFlag  = 1;
   /// Audio Graph and Input/Output Units
   AudioUnit microphoneInput;
   
-  /// Audio Buffers
-    AEFloatConverter *converter;
-  float           **floatBuffers;
-  AudioBufferList *microphoneInputBuffer;
+  /// Audio Buffers (a replaced configuration is freed once no callback can be using it)
+  EZMicrophoneBufferConfiguration *volatile _configuration;
+  EZMicrophoneBufferConfiguration          *_retiredConfigurations;
+  volatile int64_t                         _renderEpoch;
   
   /// Device Parameters
   Float64 _deviceSampleRate;
@@ -68,10 +118,55 @@ static const UInt32 kEZAudioMicrophoneEnableFlag  = 1;
   
 #if TARGET_OS_IPHONE
 #elif TARGET_OS_MAC
-  Float64 inputScopeSampleRate;
+  Float64       inputScopeSampleRate;
+  AudioDeviceID _inputDevice;
 #endif
   
+  /// Consumer Thread
+  EZAudioRingBuffer _consumerRing;
+  AEFloatConverter  *_consumerConverter;
+  AudioBufferList   *_consumerBufferList;
+  float             **_consumerFloatBuffers;
+  UInt32            _consumerChannels;
+  pthread_t         _consumerThread;
+  volatile BOOL     _consumerRunning;
+  useconds_t        _consumerPollInterval;
+  
+  /// Consumer Time Stamps (anchors travel alongside the frames, a batch is stamped from the last anchor at or before its first frame)
+  TPCircularBuffer          _consumerAnchors;
+  EZMicrophoneCaptureAnchor _consumerAnchor;
+  SInt64                    _consumerProducedFrames;
+  SInt64                    _consumerConsumedFrames;
+  
+  /// Delegate Dispatch (a new immutable table whenever the delegate is set, the old one is freed once no notification can be reading it)
+  EZMicrophoneDelegateDispatch *volatile _delegateDispatch;
+  EZMicrophoneDelegateDispatch          *_retiredDelegateDispatches;
+  volatile int64_t                      _notifyEpoch;
+  
+  /// Instrumentation
+  EZAudioCallbackMetrics _callbackMetrics;
+  
+  /// Voice Activity
+  EZAudioVoiceActivityDetector *_voiceActivityDetector;
+  float                        **_voiceActivityPreRollFloatBuffers;
+  UInt32                       _voiceActivityPreRollChannels;
+  AudioBufferList              *_voiceActivityPreRollBufferList;
+  volatile BOOL                _voiceActive;
+  volatile int64_t             _voiceActivitySuppressedFrames;
+  
+  /// Virtual Input (stands in for the input unit)
+  EZAudioVirtualInput *_virtualInput;
+  pthread_t           _virtualInputThread;
+  volatile BOOL       _virtualInputRunning;
+  BOOL                _virtualInputStarted;
+  
 }
+-(void)_drainConsumerRingIncludingPartialBatch:(BOOL)includingPartialBatch;
+-(AudioTimeStamp)_consumerTimeStampAtFrame:(SInt64)frame;
+-(void)_runVirtualInput;
+-(void)_cleanupVoiceActivityDetector;
+-(void)_configureBuffersWithFrameSize:(UInt32)bufferFrameSize;
+-(void)_bufferFrameSizeChanged;
 @end
 
 @implementation EZMicrophone
@@ -79,6 +174,269 @@ static const UInt32 kEZAudioMicrophoneEnableFlag  = 1;
 @synthesize microphoneOn = _microphoneOn;
 
 #pragma mark - Callbacks
+// The capture time a number of frames after (or before) a time stamp, only the host time carries over since the device's sample clock may run at another rate
+static AudioTimeStamp offsetTimeStamp(const AudioTimeStamp *timeStamp,
+                                      SInt64               frames,
+                                      Float64              sampleRate)
+{
+  static Float64 hostTicksPerSecond = 0.0;
+  if( hostTicksPerSecond == 0.0 ){
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    hostTicksPerSecond = 1.0e9 * (double)timebase.denom / (double)timebase.numer;
+  }
+  AudioTimeStamp offset;
+  memset(&offset,0,sizeof(offset));
+  offset.mFlags      = timeStamp->mFlags & kAudioTimeStampHostTimeValid;
+  offset.mHostTime   = (UInt64)( (SInt64)timeStamp->mHostTime + llround( (double)frames / sampleRate * hostTicksPerSecond ) );
+  offset.mRateScalar = 1.0;
+  return offset;
+}
+
+static void notifyDelegateOfFloats(EZMicrophone                 *microphone,
+                                   EZMicrophoneDelegateDispatch *dispatch,
+                                   float                        **floatBuffers,
+                                   UInt32                       frames,
+                                   const AudioTimeStamp         *timeStamp)
+{
+  // The time stamped variant replaces the plain one
+  if( dispatch->hasAudioReceivedAtTimeStamp ){
+    dispatch->hasAudioReceivedAtTimeStamp(dispatch->delegate,
+                                          @selector(microphone:hasAudioReceived:withBufferSize:withNumberOfChannels:atTimeStamp:),
+                                          microphone,
+                                          floatBuffers,
+                                          frames,
+                                          microphone->streamFormat.mChannelsPerFrame,
+                                          timeStamp);
+  }
+  else if( dispatch->hasAudioReceived ){
+    dispatch->hasAudioReceived(dispatch->delegate,
+                               @selector(microphone:hasAudioReceived:withBufferSize:withNumberOfChannels:),
+                               microphone,
+                               floatBuffers,
+                               frames,
+                               microphone->streamFormat.mChannelsPerFrame);
+  }
+}
+
+// Delivers the audio from just before an utterance (gate mode), it goes through the same converter as the live audio
+static void notifyDelegateOfPreRoll(EZMicrophone                 *microphone,
+                                    EZMicrophoneDelegateDispatch *dispatch,
+                                    AEFloatConverter             *converter,
+                                    const AudioTimeStamp         *timeStamp)
+{
+  float           **floatBuffers = microphone->_voiceActivityPreRollFloatBuffers;
+  AudioBufferList *bufferList    = microphone->_voiceActivityPreRollBufferList;
+  // The pre-roll leads right up to the buffer that turned the detector active
+  UInt32          remaining      = EZAudioVoiceActivityDetectorPreRollFrames(microphone->_voiceActivityDetector);
+  UInt32          frames;
+  while( ( frames = EZAudioVoiceActivityDetectorReadPreRoll(microphone->_voiceActivityDetector,
+                                                            floatBuffers,
+                                                            kEZAudioMicrophoneVoiceActivityPreRollChunk) ) ){
+    AudioTimeStamp preRollTimeStamp = offsetTimeStamp(timeStamp,-(SInt64)remaining,microphone->streamFormat.mSampleRate);
+    remaining -= frames;
+    notifyDelegateOfFloats(microphone,
+                           dispatch,
+                           floatBuffers,
+                           frames,
+                           &preRollTimeStamp);
+    if( dispatch->hasBufferList ){
+      for( UInt32 i = 0; i < bufferList->mNumberBuffers; i++ ){
+        bufferList->mBuffers[i].mDataByteSize = frames * microphone->streamFormat.mBytesPerFrame;
+      }
+      AEFloatConverterFromFloat(converter,
+                                floatBuffers,
+                                bufferList,
+                                frames);
+      dispatch->hasBufferList(dispatch->delegate,
+                              @selector(microphone:hasBufferList:withBufferSize:withNumberOfChannels:),
+                              microphone,
+                              bufferList,
+                              frames,
+                              microphone->streamFormat.mChannelsPerFrame);
+    }
+  }
+}
+
+static void notifyDelegateWithDispatch(EZMicrophone                 *microphone,
+                                       EZMicrophoneDelegateDispatch *dispatch,
+                                       AEFloatConverter             *converter,
+                                       AudioBufferList              *bufferList,
+                                       float                        **floatBuffers,
+                                       UInt32                       frames,
+                                       const AudioTimeStamp         *timeStamp)
+{
+  // ----- Voice activity (right after the float conversion everything downstream would need) -----
+  BOOL converted = NO;
+  EZAudioVoiceActivityDetector *detector = microphone->_voiceActivityDetector;
+  if( detector ){
+    AEFloatConverterToFloat(converter,
+                            bufferList,
+                            floatBuffers,
+                            frames);
+    converted = YES;
+    BOOL wasActive = microphone->_voiceActive;
+    BOOL isActive  = EZAudioVoiceActivityDetectorProcess(detector,floatBuffers,frames);
+    microphone->_voiceActive = isActive;
+    if( isActive != wasActive && dispatch->voiceActivityChanged ){
+      dispatch->voiceActivityChanged(dispatch->delegate,
+                                     @selector(microphone:voiceActivityChanged:),
+                                     microphone,
+                                     isActive);
+    }
+    if( microphone->_voiceActivityMode == EZMicrophoneVoiceActivityModeGate ){
+      if( !isActive ){
+        // Silence stops here so none of the delegate's work is spent on it
+        OSAtomicAdd64((int64_t)frames,&microphone->_voiceActivitySuppressedFrames);
+        return;
+      }
+      if( !wasActive ){
+        notifyDelegateOfPreRoll(microphone,dispatch,converter,timeStamp);
+      }
+    }
+  }
+  // ----- Notify delegate (OF-style) -----
+  // Audio Received (float array)
+  if( dispatch->hasAudioReceived || dispatch->hasAudioReceivedAtTimeStamp ){
+    if( !converted ){
+      AEFloatConverterToFloat(converter,
+                              bufferList,
+                              floatBuffers,
+                              frames);
+    }
+    notifyDelegateOfFloats(microphone,
+                           dispatch,
+                           floatBuffers,
+                           frames,
+                           timeStamp);
+  }
+  // Audio Received (buffer list)
+  if( dispatch->hasBufferList ){
+    dispatch->hasBufferList(dispatch->delegate,
+                            @selector(microphone:hasBufferList:withBufferSize:withNumberOfChannels:),
+                            microphone,
+                            bufferList,
+                            frames,
+                            microphone->streamFormat.mChannelsPerFrame);
+  }
+}
+
+static void notifyDelegate(EZMicrophone         *microphone,
+                           AEFloatConverter     *converter,
+                           AudioBufferList      *bufferList,
+                           float                **floatBuffers,
+                           UInt32               frames,
+                           const AudioTimeStamp *timeStamp)
+{
+  // THIS IS NOT OCCURING ON THE MAIN THREAD
+  // Odd while notifying so a dispatch table replaced meanwhile is kept until this notification is done
+  OSAtomicIncrement64Barrier(&microphone->_notifyEpoch);
+  EZMicrophoneDelegateDispatch *dispatch = microphone->_delegateDispatch;
+  if( dispatch ){
+    notifyDelegateWithDispatch(microphone,
+                               dispatch,
+                               converter,
+                               bufferList,
+                               floatBuffers,
+                               frames,
+                               timeStamp);
+  }
+  OSAtomicIncrement64Barrier(&microphone->_notifyEpoch);
+}
+
+// Lays a buffer list and float buffers out over storage of their own for the format, made on the configuring thread only
+static EZMicrophoneBufferConfiguration *createBufferConfiguration(AudioStreamBasicDescription format,
+                                                                  UInt32                      frameCapacity)
+{
+  UInt32 channels        = format.mChannelsPerFrame;
+  UInt32 numberOfBuffers = [EZAudio isInterleaved:format] ? 1 : channels;
+  UInt32 bytesPerBuffer  = frameCapacity * format.mBytesPerFrame;
+  EZMicrophoneBufferConfiguration *configuration = (EZMicrophoneBufferConfiguration*)calloc(1,sizeof(EZMicrophoneBufferConfiguration));
+  configuration->format        = format;
+  configuration->frameCapacity = frameCapacity;
+  configuration->bufferList    = (AudioBufferList*)calloc(1,offsetof( AudioBufferList, mBuffers[0] ) + ( sizeof( AudioBuffer ) * numberOfBuffers ));
+  configuration->floatBuffers  = (float**)calloc(channels,sizeof(float*));
+  configuration->sampleStorage = calloc(numberOfBuffers,bytesPerBuffer);
+  configuration->floatStorage  = (float*)calloc(frameCapacity * channels,sizeof(float));
+  assert(configuration->bufferList && configuration->floatBuffers && configuration->sampleStorage && configuration->floatStorage);
+  AudioBufferList *bufferList = configuration->bufferList;
+  bufferList->mNumberBuffers  = numberOfBuffers;
+  for( UInt32 i = 0; i < numberOfBuffers; i++ ){
+    bufferList->mBuffers[i].mNumberChannels = channels / numberOfBuffers;
+    bufferList->mBuffers[i].mDataByteSize   = bytesPerBuffer;
+    bufferList->mBuffers[i].mData           = (char*)configuration->sampleStorage + i * bytesPerBuffer;
+  }
+  for( UInt32 i = 0; i < channels; i++ ){
+    configuration->floatBuffers[i] = configuration->floatStorage + i * frameCapacity;
+  }
+  // The configuration owns its converter (the struct can't hold a strong reference)
+  configuration->converter = (__bridge AEFloatConverter*)CFBridgingRetain([[AEFloatConverter alloc] initWithSourceFormat:format]);
+  return configuration;
+}
+
+static void freeBufferConfiguration(EZMicrophoneBufferConfiguration *configuration)
+{
+  if( configuration ){
+    CFBridgingRelease((__bridge CFTypeRef)configuration->converter);
+    free(configuration->bufferList);
+    free(configuration->floatBuffers);
+    free(configuration->sampleStorage);
+    free(configuration->floatStorage);
+    free(configuration);
+  }
+}
+
+// Sizes the buffer list for this callback's frames (the caller made sure they fit the storage)
+static void prepareBufferList(EZMicrophoneBufferConfiguration *configuration,
+                              UInt32                          frames)
+{
+  AudioBufferList *bufferList = configuration->bufferList;
+  for( UInt32 i = 0; i < bufferList->mNumberBuffers; i++ ){
+    bufferList->mBuffers[i].mDataByteSize = frames * configuration->format.mBytesPerFrame;
+  }
+}
+
+// Hands the captured frames in the configuration's buffer list on (shared by the input unit and the virtual input)
+static void deliverInput(EZMicrophone                    *microphone,
+                         EZMicrophoneBufferConfiguration *configuration,
+                         UInt64                          beginTime,
+                         const AudioTimeStamp            *timeStamp,
+                         UInt32                          frames,
+                         BOOL                            rendered)
+{
+  UInt32 delivered = 0;
+  if( rendered ){
+    if( microphone->_consumerRunning ){
+      // The time stamp goes ahead of the frames so it's there by the time the consumer reads them (a dropped buffer's anchor is superseded by the next one at the same frame, if the anchors ever fill up the consumer extrapolates from the last one)
+      EZMicrophoneCaptureAnchor anchor;
+      anchor.frame     = microphone->_consumerProducedFrames;
+      anchor.timeStamp = *timeStamp;
+      TPCircularBufferProduceBytes(&microphone->_consumerAnchors,
+                                   &anchor,
+                                   sizeof(anchor));
+      // Hand off to the consumer thread (drops and counts the buffer if it's behind)
+      delivered = EZAudioRingBufferProduce(&microphone->_consumerRing,
+                                           configuration->bufferList,
+                                           frames) ? frames : 0;
+      microphone->_consumerProducedFrames += delivered;
+    }
+    else {
+      notifyDelegate(microphone,
+                     configuration->converter,
+                     configuration->bufferList,
+                     configuration->floatBuffers,
+                     frames,
+                     timeStamp);
+      delivered = frames;
+    }
+  }
+  EZAudioCallbackMetricsEnd(&microphone->_callbackMetrics,
+                            beginTime,
+                            timeStamp,
+                            frames,
+                            delivered);
+}
+
 static OSStatus inputCallback(void                          *inRefCon,
                               AudioUnitRenderActionFlags    *ioActionFlags,
                               const AudioTimeStamp          *inTimeStamp,
@@ -87,49 +445,72 @@ static OSStatus inputCallback(void                          *inRefCon,
                               AudioBufferList               *ioData)
 {
   EZMicrophone *microphone = (__bridge EZMicrophone*)inRefCon;
-  OSStatus      result     = noErr;
-  // Render audio into buffer
-  result = AudioUnitRender(microphone->microphoneInput,
-                           ioActionFlags,
-                           inTimeStamp,
-                           inBusNumber,
-                           inNumberFrames,
-                           microphone->microphoneInputBuffer);
-  if( !result ){
-    // ----- Notify delegate (OF-style) -----
-    // Audio Received (float array)
-    if( microphone.microphoneDelegate ){
-      // THIS IS NOT OCCURING ON THE MAIN THREAD
-      if( [microphone.microphoneDelegate respondsToSelector:@selector(microphone:hasAudioReceived:withBufferSize:withNumberOfChannels:)] ){
-        AEFloatConverterToFloat(microphone->converter,
-                                microphone->microphoneInputBuffer,
-                                microphone->floatBuffers,
-                                inNumberFrames);
-        [microphone.microphoneDelegate microphone:microphone
-                                 hasAudioReceived:microphone->floatBuffers
-                                   withBufferSize:inNumberFrames
-                             withNumberOfChannels:microphone->streamFormat.mChannelsPerFrame];
-      }
-    }
-    // Audio Received (buffer list)
-    if( microphone.microphoneDelegate ){
-      if( [microphone.microphoneDelegate respondsToSelector:@selector(microphone:hasBufferList:withBufferSize:withNumberOfChannels:)] ){
-        [microphone.microphoneDelegate microphone:microphone
-                                    hasBufferList:microphone->microphoneInputBuffer
-                                   withBufferSize:inNumberFrames
-                             withNumberOfChannels:microphone->streamFormat.mChannelsPerFrame];
-      }
-    }
+  OSStatus     result     = noErr;
+  UInt64       beginTime  = EZAudioCallbackMetricsBegin();
+  // Odd while the callback runs so a configuration replaced meanwhile is kept until it's done with it
+  OSAtomicIncrement64Barrier(&microphone->_renderEpoch);
+  EZMicrophoneBufferConfiguration *configuration = microphone->_configuration;
+  // The storage follows the device's buffer size, only a slice the device never announced can be larger
+  if( inNumberFrames > configuration->frameCapacity ){
+    deliverInput(microphone,
+                 configuration,
+                 beginTime,
+                 inTimeStamp,
+                 inNumberFrames,
+                 NO);
+    result = kAudioUnitErr_TooManyFramesToProcess;
   }
+  else {
+    // Render audio into buffer (the device's buffer size may have changed since we configured, so size it per slice)
+    prepareBufferList(configuration,inNumberFrames);
+    result = AudioUnitRender(microphone->microphoneInput,
+                             ioActionFlags,
+                             inTimeStamp,
+                             inBusNumber,
+                             inNumberFrames,
+                             configuration->bufferList);
+    deliverInput(microphone,
+                 configuration,
+                 beginTime,
+                 inTimeStamp,
+                 inNumberFrames,
+                 !result);
+  }
+  OSAtomicIncrement64Barrier(&microphone->_renderEpoch);
   return result;
 }
 
+static void *consumerThread(void *context)
+{
+  EZMicrophone *microphone = (__bridge EZMicrophone*)context;
+  while( microphone->_consumerRunning ){
+    @autoreleasepool {
+      [microphone _drainConsumerRingIncludingPartialBatch:NO];
+    }
+    usleep(microphone->_consumerPollInterval);
+  }
+  // Deliver whatever the input callback wrote before it was stopped
+  @autoreleasepool {
+    [microphone _drainConsumerRingIncludingPartialBatch:YES];
+  }
+  return NULL;
+}
+
+static void *virtualInputThread(void *context)
+{
+  EZMicrophone *microphone = (__bridge EZMicrophone*)context;
+  [microphone _runVirtualInput];
+  return NULL;
+}
+
 #pragma mark - Initialization
 -(id)init {
   self = [super init];
   if(self){
-    // Clear the float buffer
-    floatBuffers = NULL;
+    // Default batch size for when delivery moves to the consumer thread
+    _consumerBatchSize = kEZAudioMicrophoneDefaultConsumerBatchSize;
+    _voiceActivityHangover = kEZAudioMicrophoneDefaultVoiceActivityHangover;
+    _voiceActivityPreRoll  = kEZAudioMicrophoneDefaultVoiceActivityPreRoll;
     // We're not fetching anything yet
     _isConfigured = NO;
     _isFetching   = NO;
@@ -147,8 +528,10 @@ static OSStatus inputCallback(void                          *inRefCon,
   self = [super init];
   if(self){
     self.microphoneDelegate = microphoneDelegate;
-    // Clear the float buffer
-    floatBuffers = NULL;
+    // Default batch size for when delivery moves to the consumer thread
+    _consumerBatchSize = kEZAudioMicrophoneDefaultConsumerBatchSize;
+    _voiceActivityHangover = kEZAudioMicrophoneDefaultVoiceActivityHangover;
+    _voiceActivityPreRoll  = kEZAudioMicrophoneDefaultVoiceActivityPreRoll;
     // We're not fetching anything yet
     _isConfigured = NO;
     _isFetching   = NO;
@@ -165,9 +548,10 @@ static OSStatus inputCallback(void                          *inRefCon,
 -(EZMicrophone *)initWithMicrophoneDelegate:(id<EZMicrophoneDelegate>)microphoneDelegate
             withAudioStreamBasicDescription:(AudioStreamBasicDescription)audioStreamBasicDescription {
   self = [self initWithMicrophoneDelegate:microphoneDelegate];
-  if(self){
+  if(self && [self _isSupportedStreamFormat:audioStreamBasicDescription]){
     _customASBD  = YES;
     streamFormat = audioStreamBasicDescription;
+    [self _configureBuffersWithFrameSize:_deviceBufferFrameSize];
   }
   return self;
 }
@@ -191,6 +575,27 @@ static OSStatus inputCallback(void                          *inRefCon,
   return self;
 }
 
+-(EZMicrophone *)initWithMicrophoneDelegate:(id<EZMicrophoneDelegate>)microphoneDelegate
+                               virtualInput:(EZAudioVirtualInput *)virtualInput {
+  self = [super init];
+  if(self){
+    self.microphoneDelegate = microphoneDelegate;
+    // Default batch size for when delivery moves to the consumer thread
+    _consumerBatchSize = kEZAudioMicrophoneDefaultConsumerBatchSize;
+    _voiceActivityHangover = kEZAudioMicrophoneDefaultVoiceActivityHangover;
+    _voiceActivityPreRoll  = kEZAudioMicrophoneDefaultVoiceActivityPreRoll;
+    // We're not fetching anything yet
+    _isFetching = NO;
+    // No input unit, the virtual input stands in for the device
+    _virtualInput = virtualInput;
+    _deviceSampleRate = virtualInput.sampleRate;
+    [self _configureStreamFormatWithSampleRate:_deviceSampleRate];
+    [self _notifyDelegateOfStreamFormat];
+    _isConfigured = YES;
+  }
+  return self;
+}
+
 #pragma mark - Class Initializers
 +(EZMicrophone *)microphoneWithDelegate:(id<EZMicrophoneDelegate>)microphoneDelegate {
   return [[EZMicrophone alloc] initWithMicrophoneDelegate:microphoneDelegate];
@@ -216,6 +621,12 @@ static OSStatus inputCallback(void                          *inRefCon,
                                         startsImmediately:startsImmediately];
 }
 
++(EZMicrophone *)microphoneWithDelegate:(id<EZMicrophoneDelegate>)microphoneDelegate
+                           virtualInput:(EZAudioVirtualInput *)virtualInput {
+  return [[EZMicrophone alloc] initWithMicrophoneDelegate:microphoneDelegate
+                                             virtualInput:virtualInput];
+}
+
 #pragma mark - Singleton
 +(EZMicrophone*)sharedMicrophone {
   static EZMicrophone *_sharedMicrophone = nil;
@@ -226,12 +637,39 @@ static OSStatus inputCallback(void                          *inRefCon,
   return _sharedMicrophone;
 }
 
+#pragma mark - Dealloc
+-(void)dealloc {
+  [self stopFetchingAudio];
+  if( _isConfigured && !_virtualInput ){
+    [self _removeBufferFrameSizeListener];
+  }
+  [self _cleanupConsumer];
+  [self _cleanupVoiceActivityDetector];
+  [self _freeBuffers];
+  // Nothing notifies anymore, so every dispatch table can go
+  [self _freeRetiredDelegateDispatches];
+  free(_delegateDispatch);
+}
+
 #pragma mark - Events
 -(void)startFetchingAudio {
   if( !_isFetching ){
+    // Spin up the consumer before the input callback can write into its ring
+    if( _shouldDeliverAudioOnConsumerThread ){
+      [self _startConsumerThread];
+    }
+    // Measure the input callback from scratch against this format's deadlines
+    EZAudioCallbackMetricsInit(&_callbackMetrics,streamFormat.mSampleRate);
+    // Detect voice activity from scratch for the current format
+    [self _configureVoiceActivityDetector];
     // Start fetching input
-    [EZAudio checkResult:AudioOutputUnitStart(self->microphoneInput)
-               operation:"Microphone failed to start fetching audio"];
+    if( _virtualInput ){
+      [self _startVirtualInputThread];
+    }
+    else {
+      [EZAudio checkResult:AudioOutputUnitStart(self->microphoneInput)
+                 operation:"Microphone failed to start fetching audio"];
+    }
     _isFetching = YES;
     self.microphoneOn = YES;
   }
@@ -241,8 +679,15 @@ static OSStatus inputCallback(void                          *inRefCon,
   // Stop fetching input data
   if( _isConfigured ){
     if( _isFetching ){
-      [EZAudio checkResult:AudioOutputUnitStop(self->microphoneInput)
-                 operation:"Microphone failed to stop fetching audio"];
+      if( _virtualInput ){
+        [self _stopVirtualInputThread];
+      }
+      else {
+        [EZAudio checkResult:AudioOutputUnitStop(self->microphoneInput)
+                   operation:"Microphone failed to stop fetching audio"];
+      }
+      // The input callback won't write anymore so let the consumer drain and exit
+      [self _stopConsumerThread];
       _isFetching = NO;
       self.microphoneOn = NO;
     }
@@ -259,7 +704,102 @@ static OSStatus inputCallback(void                          *inRefCon,
     return &microphoneInput;
 }
 
+-(EZAudioVirtualInput *)virtualInput {
+  return _virtualInput;
+}
+
+#if TARGET_OS_IPHONE
+#elif TARGET_OS_MAC
+-(AudioDeviceID)inputDevice {
+  return _inputDevice;
+}
+#endif
+
+-(UInt32)consumerOverruns {
+  return EZAudioRingBufferOverruns(&_consumerRing);
+}
+
+-(SInt64)consumerDroppedFrames {
+  return EZAudioRingBufferDroppedFrames(&_consumerRing);
+}
+
+-(EZAudioCallbackMetricsSnapshot)callbackMetrics {
+  EZAudioCallbackMetricsSnapshot snapshot;
+  EZAudioCallbackMetricsRead(&_callbackMetrics,&snapshot);
+  return snapshot;
+}
+
+-(NSDictionary *)callbackMetricsDictionary {
+  return [EZAudio dictionaryWithCallbackMetrics:[self callbackMetrics]];
+}
+
+-(void)resetCallbackMetrics {
+  EZAudioCallbackMetricsReset(&_callbackMetrics);
+}
+
+-(BOOL)isVoiceActive {
+  return _voiceActive;
+}
+
+-(SInt64)voiceActivitySuppressedFrames {
+  return OSAtomicAdd64(0,&_voiceActivitySuppressedFrames);
+}
+
+-(double)realtimeStreamsPerCore {
+  EZAudioCallbackMetricsSnapshot snapshot = [self callbackMetrics];
+  if( snapshot.totalMicroseconds == 0 || streamFormat.mSampleRate <= 0.0 ){
+    return 0.0;
+  }
+  // Seconds of audio handled per second spent handling it
+  double audioSeconds = (double)snapshot.framesDelivered / streamFormat.mSampleRate;
+  return audioSeconds / ( 1.0e-6 * (double)snapshot.totalMicroseconds );
+}
+
 #pragma mark - Setter
+-(void)setMicrophoneDelegate:(id<EZMicrophoneDelegate>)microphoneDelegate {
+  _microphoneDelegate = microphoneDelegate;
+  
+  // Resolve the delegate's callbacks into a table of their own, the input callback may still be reading the current one
+  EZMicrophoneDelegateDispatch *dispatch = (EZMicrophoneDelegateDispatch*)calloc(1,sizeof(EZMicrophoneDelegateDispatch));
+  SEL hasAudioReceived            = @selector(microphone:hasAudioReceived:withBufferSize:withNumberOfChannels:);
+  SEL hasAudioReceivedAtTimeStamp = @selector(microphone:hasAudioReceived:withBufferSize:withNumberOfChannels:atTimeStamp:);
+  SEL hasBufferList               = @selector(microphone:hasBufferList:withBufferSize:withNumberOfChannels:);
+  SEL voiceActivity               = @selector(microphone:voiceActivityChanged:);
+  dispatch->delegate                    = microphoneDelegate;
+  dispatch->hasAudioReceived            = [microphoneDelegate respondsToSelector:hasAudioReceived] ? (EZMicrophoneHasAudioReceivedIMP)[(NSObject *)microphoneDelegate methodForSelector:hasAudioReceived] : NULL;
+  dispatch->hasAudioReceivedAtTimeStamp = [microphoneDelegate respondsToSelector:hasAudioReceivedAtTimeStamp] ? (EZMicrophoneHasAudioReceivedAtTimeStampIMP)[(NSObject *)microphoneDelegate methodForSelector:hasAudioReceivedAtTimeStamp] : NULL;
+  dispatch->hasBufferList               = [microphoneDelegate respondsToSelector:hasBufferList] ? (EZMicrophoneHasBufferListIMP)[(NSObject *)microphoneDelegate methodForSelector:hasBufferList] : NULL;
+  dispatch->voiceActivityChanged        = [microphoneDelegate respondsToSelector:voiceActivity] ? (EZMicrophoneVoiceActivityChangedIMP)[(NSObject *)microphoneDelegate methodForSelector:voiceActivity] : NULL;
+  
+  // Publish it once it's complete
+  OSMemoryBarrier();
+  EZMicrophoneDelegateDispatch *previous = _delegateDispatch;
+  _delegateDispatch = dispatch;
+  
+  // A notification running right now (odd epoch) may still be reading the previous table, any notification after that can't see it
+  if( previous ){
+    OSMemoryBarrier();
+    previous->retiredEpoch = (_notifyEpoch + 1) & ~1LL;
+    previous->next         = _retiredDelegateDispatches;
+    _retiredDelegateDispatches = previous;
+  }
+  [self _freeRetiredDelegateDispatches];
+}
+
+-(void)_freeRetiredDelegateDispatches {
+  EZMicrophoneDelegateDispatch **link = &_retiredDelegateDispatches;
+  while( *link ){
+    EZMicrophoneDelegateDispatch *dispatch = *link;
+    if( _notifyEpoch >= dispatch->retiredEpoch ){
+      *link = dispatch->next;
+      free(dispatch);
+    }
+    else {
+      link = &dispatch->next;
+    }
+  }
+}
+
 -(void)setMicrophoneOn:(BOOL)microphoneOn {
   _microphoneOn = microphoneOn;
   if( microphoneOn ){
@@ -271,14 +811,95 @@ static OSStatus inputCallback(void                          *inRefCon,
 }
 
 -(void)setAudioStreamBasicDescription:(AudioStreamBasicDescription)asbd {
+  if( ![self _isSupportedStreamFormat:asbd] ){
+    return;
+  }
+  // The unit only takes a new format while it's stopped, so fetching restarts around the change
+  BOOL wasFetching = _isFetching;
+  if( wasFetching ){
+    [self stopFetchingAudio];
+  }
+  _customASBD = YES;
+  streamFormat = asbd;
+  [self _configureStreamFormatWithSampleRate:_deviceSampleRate];
+  // Give the new format buffers of its own
+  [self _configureBuffersWithFrameSize:_deviceBufferFrameSize];
+  if( wasFetching ){
+    [self startFetchingAudio];
+  }
+}
+
+#if TARGET_OS_IPHONE
+#elif TARGET_OS_MAC
+-(void)setInputDevice:(AudioDeviceID)inputDevice {
   if( self.microphoneOn ){
-    NSAssert(self.microphoneOn,@"Cannot set the AudioStreamBasicDescription while microphone is fetching audio");
+    NSAssert(!self.microphoneOn,@"Cannot set the input device while microphone is fetching audio");
+  }
+  else if( _virtualInput ){
+    NSAssert(!_virtualInput,@"Cannot set the input device of a microphone driven by a virtual input");
   }
   else {
-    _customASBD = YES;
-    streamFormat = asbd;
+    // The device can only be swapped on an uninitialized unit
+    [EZAudio checkResult:AudioUnitUninitialize(microphoneInput)
+               operation:"Couldn't uninitialize the input unit"];
+    
+    // Pick up the new device's sample rate and buffer size (same steps as _createInputUnit)
+    [self _configureDevice:inputDevice];
+    _deviceSampleRate = [self _configureDeviceSampleRateWithDefault:44100.0];
     [self _configureStreamFormatWithSampleRate:_deviceSampleRate];
-  }  
+    [self _notifyDelegateOfStreamFormat];
+    _deviceBufferFrameSize = [self _getBufferFrameSize];
+    [self _configureBuffersWithFrameSize:_deviceBufferFrameSize];
+    
+    [EZAudio checkResult:AudioUnitInitialize(microphoneInput)
+               operation:"Couldn't initialize the input unit"];
+  }
+}
+#endif
+
+-(void)setShouldDeliverAudioOnConsumerThread:(BOOL)shouldDeliverAudioOnConsumerThread {
+  if( self.microphoneOn ){
+    NSAssert(!self.microphoneOn,@"Cannot change the consumer thread delivery while microphone is fetching audio");
+  }
+  else {
+    _shouldDeliverAudioOnConsumerThread = shouldDeliverAudioOnConsumerThread;
+  }
+}
+
+-(void)setVoiceActivityMode:(EZMicrophoneVoiceActivityMode)voiceActivityMode {
+  if( self.microphoneOn ){
+    NSAssert(!self.microphoneOn,@"Cannot change the voice activity mode while microphone is fetching audio");
+  }
+  else {
+    _voiceActivityMode = voiceActivityMode;
+  }
+}
+
+-(void)setVoiceActivityHangover:(NSTimeInterval)voiceActivityHangover {
+  if( self.microphoneOn ){
+    NSAssert(!self.microphoneOn,@"Cannot set the voice activity hangover while microphone is fetching audio");
+  }
+  else {
+    _voiceActivityHangover = MAX(voiceActivityHangover,0.0);
+  }
+}
+
+-(void)setVoiceActivityPreRoll:(NSTimeInterval)voiceActivityPreRoll {
+  if( self.microphoneOn ){
+    NSAssert(!self.microphoneOn,@"Cannot set the voice activity pre-roll while microphone is fetching audio");
+  }
+  else {
+    _voiceActivityPreRoll = MAX(voiceActivityPreRoll,0.0);
+  }
+}
+
+-(void)setConsumerBatchSize:(UInt32)consumerBatchSize {
+  if( self.microphoneOn ){
+    NSAssert(!self.microphoneOn,@"Cannot set the consumer batch size while microphone is fetching audio");
+  }
+  else {
+    _consumerBatchSize = MAX(consumerBatchSize,1);
+  }
 }
 
 #pragma mark - Configure The Input Unit
@@ -322,11 +943,11 @@ static OSStatus inputCallback(void                          *inRefCon,
   // Get buffer frame size
   _deviceBufferFrameSize = [self _getBufferFrameSize];
   
-  // Create the audio buffer list and pre-malloc the buffers in the list
-  [self _configureAudioBufferListWithFrameSize:_deviceBufferFrameSize];
+  // Make the audio buffer list, float buffers and float converter for the stream format and buffer size
+  [self _configureBuffersWithFrameSize:_deviceBufferFrameSize];
   
-  // Set the float converter's stream format
-  [self _configureFloatConverterWithFrameSize:_deviceBufferFrameSize];
+  // Follow the device's buffer size from here on
+  [self _addBufferFrameSizeListener];
   
   // Setup input callback
   [self _configureInputCallback];
@@ -417,15 +1038,22 @@ static OSStatus inputCallback(void                          *inRefCon,
                                                   &defaultDevice)
              operation:"Couldn't get default input device"];
   
-  // Set the default device on the microphone input unit
-  propSize = sizeof(defaultDevice);
+  // Bind the microphone input unit to it
+  [self _configureDevice:defaultDevice];
+}
+
+-(void)_configureDevice:(AudioDeviceID)device {
+  
+  // Set the device on the microphone input unit
+  UInt32 propSize = sizeof(device);
   [EZAudio checkResult:AudioUnitSetProperty(microphoneInput,
                                             kAudioOutputUnitProperty_CurrentDevice,
                                             kAudioUnitScope_Global,
                                             kEZAudioMicrophoneOutputBus,
-                                            &defaultDevice,
+                                            &device,
                                             propSize)
-             operation:"Couldn't set default device on I/O unit"];
+             operation:"Couldn't set device on I/O unit"];
+  _inputDevice = device;
   
   // Get the stream format description from the newly created input unit and assign it to the output of the input unit
   AudioStreamBasicDescription inputScopeFormat;
@@ -518,6 +1146,10 @@ static OSStatus inputCallback(void                          *inRefCon,
   else {
     streamFormat.mSampleRate = sampleRate;
   }
+  // A virtual input has no unit to set it on
+  if( _virtualInput ){
+    return;
+  }
   UInt32 propSize = sizeof(streamFormat);
   // Set the stream format for output on the microphone's input scope
   [EZAudio checkResult:AudioUnitSetProperty(microphoneInput,
@@ -547,31 +1179,107 @@ static OSStatus inputCallback(void                          *inRefCon,
   }
 }
 
-#pragma mark - AudioBufferList Initialization
--(void)_configureAudioBufferListWithFrameSize:(UInt32)bufferFrameSize {
-  UInt32 bufferSizeBytes = bufferFrameSize * streamFormat.mBytesPerFrame;
-  UInt32 propSize = offsetof( AudioBufferList, mBuffers[0] ) + ( sizeof( AudioBuffer ) *streamFormat.mChannelsPerFrame );
-  microphoneInputBuffer                 = (AudioBufferList*)malloc(propSize);
-  microphoneInputBuffer->mNumberBuffers = streamFormat.mChannelsPerFrame;
-  for( UInt32 i = 0; i < microphoneInputBuffer->mNumberBuffers; i++ ){
-    microphoneInputBuffer->mBuffers[i].mNumberChannels = streamFormat.mChannelsPerFrame;
-    microphoneInputBuffer->mBuffers[i].mDataByteSize   = bufferSizeBytes;
-    microphoneInputBuffer->mBuffers[i].mData           = malloc(bufferSizeBytes);
+#pragma mark - Buffer Initialization
+-(BOOL)_isSupportedStreamFormat:(AudioStreamBasicDescription)asbd {
+  if( asbd.mChannelsPerFrame == 0 || asbd.mChannelsPerFrame > kEZAudioMicrophoneMaximumChannels ){
+    NSLog(@"Microphone supports 1 to %u channels, ignoring a format with %u",(unsigned int)kEZAudioMicrophoneMaximumChannels,(unsigned int)asbd.mChannelsPerFrame);
+    return NO;
+  }
+  return YES;
+}
+
+-(void)_configureBuffersWithFrameSize:(UInt32)bufferFrameSize {
+  
+  // The current configuration still fits, a smaller or slightly larger device buffer needs nothing new
+  EZMicrophoneBufferConfiguration *current = _configuration;
+  if( current && current->frameCapacity >= bufferFrameSize && memcmp(&current->format,&streamFormat,sizeof(streamFormat)) == 0 ){
+    return;
+  }
+  
+  // Everything's made here on the configuring thread, the audio thread never allocates
+  UInt32 frameCapacity = MAX(bufferFrameSize,kEZAudioMicrophoneMinimumFramesPerSlice);
+  EZMicrophoneBufferConfiguration *configuration = createBufferConfiguration(streamFormat,frameCapacity);
+  
+  // Swap it in, the audio thread picks up whichever configuration is current at the start of a callback
+  EZMicrophoneBufferConfiguration *previous;
+  do {
+    previous = _configuration;
+  } while( !OSAtomicCompareAndSwapPtrBarrier(previous, configuration, (void * volatile *)&_configuration) );
+  
+  // A callback running right now (odd epoch) may still be using the previous one, any callback after that can't see it
+  if( previous ){
+    previous->retiredEpoch = (_renderEpoch + 1) & ~1LL;
+    previous->next         = _retiredConfigurations;
+    _retiredConfigurations = previous;
   }
+  [self _freeRetiredConfigurations];
+  
 }
 
-#pragma mark - Float Converter Initialization
--(void)_configureFloatConverterWithFrameSize:(UInt32)bufferFrameSize {
-  UInt32 bufferSizeBytes = bufferFrameSize * streamFormat.mBytesPerFrame;
-  converter              = [[AEFloatConverter alloc] initWithSourceFormat:streamFormat];
-  floatBuffers           = (float**)malloc(sizeof(float*)*streamFormat.mChannelsPerFrame);
-  assert(floatBuffers);
-  for ( int i=0; i<streamFormat.mChannelsPerFrame; i++ ) {
-    floatBuffers[i] = (float*)malloc(bufferSizeBytes);
-    assert(floatBuffers[i]);
+-(void)_freeRetiredConfigurations {
+  EZMicrophoneBufferConfiguration **link = &_retiredConfigurations;
+  while( *link ){
+    EZMicrophoneBufferConfiguration *configuration = *link;
+    if( _renderEpoch >= configuration->retiredEpoch ){
+      *link = configuration->next;
+      freeBufferConfiguration(configuration);
+    }
+    else {
+      link = &configuration->next;
+    }
   }
 }
 
+-(void)_freeBuffers {
+  [self _freeRetiredConfigurations];
+  freeBufferConfiguration(_configuration);
+  _configuration = NULL;
+}
+
+#pragma mark - Buffer Frame Size Listener
+static void bufferFrameSizeListener(void                *inRefCon,
+                                    AudioUnit           inUnit,
+                                    AudioUnitPropertyID inID,
+                                    AudioUnitScope      inScope,
+                                    AudioUnitElement    inElement)
+{
+  // Called on a Core Audio thread, the buffers are only ever configured on the main thread
+  __weak EZMicrophone *weakMicrophone = (__bridge EZMicrophone*)inRefCon;
+  dispatch_async(dispatch_get_main_queue(), ^{
+    [weakMicrophone _bufferFrameSizeChanged];
+  });
+}
+
+-(void)_addBufferFrameSizeListener {
+  [EZAudio checkResult:AudioUnitAddPropertyListener(microphoneInput,
+                                                    #if TARGET_OS_IPHONE
+                                                      kAudioUnitProperty_MaximumFramesPerSlice,
+                                                    #elif TARGET_OS_MAC
+                                                      kAudioDevicePropertyBufferFrameSize,
+                                                    #endif
+                                                    bufferFrameSizeListener,
+                                                    (__bridge void *)self)
+             operation:"Couldn't add the buffer frame size listener"];
+}
+
+-(void)_removeBufferFrameSizeListener {
+  [EZAudio checkResult:AudioUnitRemovePropertyListenerWithUserData(microphoneInput,
+                                                                   #if TARGET_OS_IPHONE
+                                                                     kAudioUnitProperty_MaximumFramesPerSlice,
+                                                                   #elif TARGET_OS_MAC
+                                                                     kAudioDevicePropertyBufferFrameSize,
+                                                                   #endif
+                                                                   bufferFrameSizeListener,
+                                                                   (__bridge void *)self)
+             operation:"Couldn't remove the buffer frame size listener"];
+}
+
+-(void)_bufferFrameSizeChanged {
+  // Applied while fetching, a larger buffer gets new storage and the next callback picks it up
+  _deviceBufferFrameSize = [self _getBufferFrameSize];
+  [self _configureBuffersWithFrameSize:_deviceBufferFrameSize];
+}
+
 #pragma mark - Input Callback Initialization
 -(void)_configureInputCallback {
   AURenderCallbackStruct microphoneCallbackStruct;
@@ -601,4 +1309,279 @@ static OSStatus inputCallback(void                          *inRefCon,
              operation:"Could not disable audio unit allocating its own buffers"];
 }
 
+#pragma mark - Virtual Input Thread
+-(void)_startVirtualInputThread {
+  
+  // Lay the buffers out for the virtual input's current buffer size (its jitter only ever shortens buffers)
+  _deviceBufferFrameSize = MAX(_virtualInput.bufferSize,1);
+  _deviceBufferDuration  = _deviceBufferFrameSize / streamFormat.mSampleRate;
+  [self _configureBuffersWithFrameSize:_deviceBufferFrameSize];
+  [_virtualInput prepareWithFormat:streamFormat
+                     maximumFrames:_deviceBufferFrameSize];
+  
+  _virtualInputRunning = YES;
+  int error = pthread_create(&_virtualInputThread, NULL, virtualInputThread, (__bridge void *)self);
+  if( error ){
+    _virtualInputRunning = NO;
+    NSLog(@"Microphone failed to start the virtual input thread (%d)", error);
+    return;
+  }
+  _virtualInputStarted = YES;
+  
+}
+
+-(void)_stopVirtualInputThread {
+  // The thread may have already finished at the end of a file that doesn't loop
+  if( _virtualInputStarted ){
+    _virtualInputRunning = NO;
+    pthread_join(_virtualInputThread, NULL);
+    _virtualInputStarted = NO;
+  }
+}
+
+-(void)_runVirtualInput {
+  
+  mach_timebase_info_data_t timebase;
+  mach_timebase_info(&timebase);
+  double ticksPerSecond = 1.0e9 * (double)timebase.denom / (double)timebase.numer;
+  
+  // Snapshot the settings, they only apply from the next start
+  UInt32  bufferSize   = _deviceBufferFrameSize;
+  UInt32  sizeJitter   = MIN(_virtualInput.bufferSizeJitter,bufferSize - 1);
+  double  timingJitter = _virtualInput.timingJitter * ticksPerSecond;
+  BOOL    paced        = _virtualInput.paced;
+  Float64 sampleRate   = streamFormat.mSampleRate;
+  Float64 sampleTime   = 0.0;
+  UInt64  startTime    = mach_absolute_time();
+  
+  AudioTimeStamp timeStamp;
+  memset(&timeStamp,0,sizeof(timeStamp));
+  timeStamp.mFlags      = kAudioTimeStampSampleTimeValid | kAudioTimeStampHostTimeValid;
+  timeStamp.mRateScalar = 1.0;
+  
+  while( _virtualInputRunning ){
+    @autoreleasepool {
+      UInt32 frames = bufferSize - ( sizeJitter ? arc4random_uniform(sizeJitter + 1) : 0 );
+      
+      // A device hands over a buffer once its last frame has been captured, late by up to the jitter
+      UInt64 dueTime = startTime + (UInt64)( ( sampleTime + frames ) / sampleRate * ticksPerSecond );
+      if( paced ){
+        UInt64 lateness = timingJitter > 0.0 ? (UInt64)( timingJitter * ( (double)arc4random() / (double)UINT32_MAX ) ) : 0;
+        mach_wait_until(dueTime + lateness);
+      }
+      
+      // Only the delivery is measured, not the file reading or signal generation standing in for the device
+      OSAtomicIncrement64Barrier(&_renderEpoch);
+      EZMicrophoneBufferConfiguration *configuration = _configuration;
+      prepareBufferList(configuration,frames);
+      UInt32 rendered = [_virtualInput renderFrames:frames
+                                     intoBufferList:configuration->bufferList];
+      // Like a device's, the time stamp is when the first frame was captured
+      timeStamp.mSampleTime = sampleTime;
+      timeStamp.mHostTime   = paced ? startTime + (UInt64)( sampleTime / sampleRate * ticksPerSecond ) : mach_absolute_time();
+      if( rendered > 0 ){
+        deliverInput(self,
+                     configuration,
+                     EZAudioCallbackMetricsBegin(),
+                     &timeStamp,
+                     rendered,
+                     YES);
+      }
+      OSAtomicIncrement64Barrier(&_renderEpoch);
+      sampleTime += rendered;
+      
+      // The end of a file that doesn't loop
+      if( rendered < frames ){
+        _virtualInputRunning = NO;
+      }
+    }
+  }
+  
+}
+
+#pragma mark - Voice Activity
+-(void)_configureVoiceActivityDetector {
+  
+  // Start from scratch so a new format or setting always gets a fresh detector
+  [self _cleanupVoiceActivityDetector];
+  _voiceActive = NO;
+  _voiceActivitySuppressedFrames = 0;
+  if( _voiceActivityMode == EZMicrophoneVoiceActivityModeOff ){
+    return;
+  }
+  
+  Float64 sampleRate = streamFormat.mSampleRate;
+  _voiceActivityDetector = EZAudioVoiceActivityDetectorCreate(streamFormat.mChannelsPerFrame,
+                                                              sampleRate,
+                                                              (uint32_t)( _voiceActivityHangover * sampleRate ),
+                                                              (uint32_t)( _voiceActivityPreRoll * sampleRate ));
+  if( !_voiceActivityDetector ){
+    NSLog(@"Microphone failed to create the voice activity detector, delivering every buffer");
+    return;
+  }
+  
+  // The pre-roll is handed out in chunks through its own buffers (the live ones are in use when it's delivered)
+  UInt32 chunk           = kEZAudioMicrophoneVoiceActivityPreRollChunk;
+  UInt32 numberOfBuffers = [EZAudio isInterleaved:streamFormat] ? 1 : streamFormat.mChannelsPerFrame;
+  UInt32 bufferSizeBytes = chunk * streamFormat.mBytesPerFrame;
+  _voiceActivityPreRollFloatBuffers = [EZAudio floatBuffersWithNumberOfFrames:chunk
+                                                             numberOfChannels:streamFormat.mChannelsPerFrame];
+  _voiceActivityPreRollChannels     = streamFormat.mChannelsPerFrame;
+  _voiceActivityPreRollBufferList = (AudioBufferList*)malloc(offsetof( AudioBufferList, mBuffers[0] ) + ( sizeof( AudioBuffer ) * numberOfBuffers ));
+  _voiceActivityPreRollBufferList->mNumberBuffers = numberOfBuffers;
+  for( UInt32 i = 0; i < numberOfBuffers; i++ ){
+    _voiceActivityPreRollBufferList->mBuffers[i].mNumberChannels = streamFormat.mChannelsPerFrame / numberOfBuffers;
+    _voiceActivityPreRollBufferList->mBuffers[i].mDataByteSize   = bufferSizeBytes;
+    _voiceActivityPreRollBufferList->mBuffers[i].mData           = malloc(bufferSizeBytes);
+  }
+  
+}
+
+-(void)_cleanupVoiceActivityDetector {
+  EZAudioVoiceActivityDetectorFree(_voiceActivityDetector);
+  _voiceActivityDetector = NULL;
+  if( _voiceActivityPreRollFloatBuffers ){
+    // Freed with the channel count they were made for, the format may have changed since
+    [EZAudio freeFloatBuffers:_voiceActivityPreRollFloatBuffers
+             numberOfChannels:_voiceActivityPreRollChannels];
+    _voiceActivityPreRollFloatBuffers = NULL;
+  }
+  if( _voiceActivityPreRollBufferList ){
+    [EZAudio freeBufferList:_voiceActivityPreRollBufferList];
+    _voiceActivityPreRollBufferList = NULL;
+  }
+}
+
+#pragma mark - Consumer Thread
+-(void)_startConsumerThread {
+  
+  // Allocate everything the consumer needs up front for the current format and batch size
+  [self _configureConsumerWithBatchSize:_consumerBatchSize];
+  if( !_consumerBufferList ){
+    NSLog(@"Microphone failed to allocate the consumer ring, delivering on the audio thread");
+    return;
+  }
+  
+  // Poll at twice the batch rate so a full batch never waits long
+  Float64 batchDuration = (Float64)_consumerBatchSize / streamFormat.mSampleRate;
+  _consumerPollInterval = (useconds_t)MAX(batchDuration * 500000.0, 1000.0);
+  
+  // High enough that delegates don't fall behind, but a step below the top of the range so the consumer never competes with the audio thread
+  pthread_attr_t attributes;
+  struct sched_param parameters;
+  pthread_attr_init(&attributes);
+  pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+  pthread_attr_setschedpolicy(&attributes, SCHED_RR);
+  parameters.sched_priority = sched_get_priority_max(SCHED_RR) - 1;
+  pthread_attr_setschedparam(&attributes, &parameters);
+  
+  _consumerRunning = YES;
+  int error = pthread_create(&_consumerThread, &attributes, consumerThread, (__bridge void *)self);
+  pthread_attr_destroy(&attributes);
+  if( error ){
+    _consumerRunning = NO;
+    NSLog(@"Microphone failed to start the consumer thread (%d), delivering on the audio thread", error);
+  }
+  
+}
+
+-(void)_stopConsumerThread {
+  if( _consumerRunning ){
+    _consumerRunning = NO;
+    pthread_join(_consumerThread, NULL);
+  }
+}
+
+-(void)_drainConsumerRingIncludingPartialBatch:(BOOL)includingPartialBatch {
+  UInt32 batchSize = _consumerBatchSize;
+  UInt32 available = EZAudioRingBufferFillCount(&_consumerRing);
+  while( available >= batchSize || ( includingPartialBatch && available > 0 ) ){
+    UInt32 frames = EZAudioRingBufferConsume(&_consumerRing,
+                                             _consumerBufferList,
+                                             batchSize);
+    AudioTimeStamp timeStamp = [self _consumerTimeStampAtFrame:_consumerConsumedFrames];
+    notifyDelegate(self,
+                   _consumerConverter,
+                   _consumerBufferList,
+                   _consumerFloatBuffers,
+                   frames,
+                   &timeStamp);
+    _consumerConsumedFrames += frames;
+    available = EZAudioRingBufferFillCount(&_consumerRing);
+  }
+}
+
+-(AudioTimeStamp)_consumerTimeStampAtFrame:(SInt64)frame {
+  // Move up to the last anchor at or before the frame, the ones after it belong to later batches
+  int32_t availableBytes;
+  EZMicrophoneCaptureAnchor *anchor;
+  while( ( anchor = TPCircularBufferTail(&_consumerAnchors, &availableBytes) ) &&
+         availableBytes >= (int32_t)sizeof(EZMicrophoneCaptureAnchor) &&
+         anchor->frame <= frame ){
+    _consumerAnchor = *anchor;
+    TPCircularBufferConsume(&_consumerAnchors, sizeof(EZMicrophoneCaptureAnchor));
+  }
+  return offsetTimeStamp(&_consumerAnchor.timeStamp,
+                         frame - _consumerAnchor.frame,
+                         streamFormat.mSampleRate);
+}
+
+-(void)_configureConsumerWithBatchSize:(UInt32)batchSize {
+  
+  // Start from scratch so a new format or batch size always gets fresh buffers
+  [self _cleanupConsumer];
+  
+  // Hold a handful of batches or a second of audio, whichever is longer
+  UInt32 capacity = MAX(batchSize * kEZAudioMicrophoneConsumerRingBatches, (UInt32)streamFormat.mSampleRate);
+  if( !EZAudioRingBufferInit(&_consumerRing, streamFormat, capacity) ){
+    return;
+  }
+  if( !TPCircularBufferInit(&_consumerAnchors, kEZAudioMicrophoneConsumerAnchors * sizeof(EZMicrophoneCaptureAnchor)) ){
+    EZAudioRingBufferCleanup(&_consumerRing);
+    return;
+  }
+  memset(&_consumerAnchor,0,sizeof(_consumerAnchor));
+  _consumerProducedFrames = 0;
+  _consumerConsumedFrames = 0;
+  
+  // The batch buffer list mirrors the ring's layout
+  UInt32 bufferSizeBytes = batchSize * streamFormat.mBytesPerFrame;
+  UInt32 propSize = offsetof( AudioBufferList, mBuffers[0] ) + ( sizeof( AudioBuffer ) * _consumerRing.numberOfBuffers );
+  _consumerBufferList                 = (AudioBufferList*)malloc(propSize);
+  _consumerBufferList->mNumberBuffers = _consumerRing.numberOfBuffers;
+  for( UInt32 i = 0; i < _consumerBufferList->mNumberBuffers; i++ ){
+    _consumerBufferList->mBuffers[i].mNumberChannels = streamFormat.mChannelsPerFrame / _consumerRing.numberOfBuffers;
+    _consumerBufferList->mBuffers[i].mDataByteSize   = bufferSizeBytes;
+    _consumerBufferList->mBuffers[i].mData           = malloc(bufferSizeBytes);
+  }
+  
+  // The consumer gets its own converter since the audio thread's isn't safe to share
+  _consumerConverter    = [[AEFloatConverter alloc] initWithSourceFormat:streamFormat];
+  _consumerFloatBuffers = [EZAudio floatBuffersWithNumberOfFrames:batchSize
+                                                 numberOfChannels:streamFormat.mChannelsPerFrame];
+  // The format may have changed by the time these are freed
+  _consumerChannels     = streamFormat.mChannelsPerFrame;
+  
+}
+
+-(void)_cleanupConsumer {
+  EZAudioRingBufferCleanup(&_consumerRing);
+  if( _consumerAnchors.buffer ){
+    TPCircularBufferCleanup(&_consumerAnchors);
+  }
+  if( _consumerBufferList ){
+    for( UInt32 i = 0; i < _consumerBufferList->mNumberBuffers; i++ ){
+      free(_consumerBufferList->mBuffers[i].mData);
+    }
+    free(_consumerBufferList);
+    _consumerBufferList = NULL;
+  }
+  if( _consumerFloatBuffers ){
+    [EZAudio freeFloatBuffers:_consumerFloatBuffers
+             numberOfChannels:_consumerChannels];
+    _consumerFloatBuffers = NULL;
+  }
+  _consumerConverter = nil;
+}
+
 @end
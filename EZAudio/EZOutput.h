@@ -31,6 +31,7 @@
 #endif
 
 #import "TPCircularBuffer.h"
+#import "EZAudioCallbackMetrics.h"
 
 @class EZOutput;
 
@@ -64,7 +65,7 @@ inNumberFrames:(UInt32)inNumberFrames
        ioData:(AudioBufferList*)ioData;
 
 /**
- Provides output using a circular
+ Provides output using a circular buffer of mono float samples, copied into every output channel. Whatever the circular buffer is short of is played as silence. For audio arriving over a network use an EZAudioStreamSource instead, which absorbs the arrival jitter and conceals lost packets.
  @param output The instance of the EZOutput that asked for the data
  @return The EZOutputDataSource's TPCircularBuffer structure holding the audio data in a circular buffer
  */
@@ -84,6 +85,16 @@ inNumberFrames:(UInt32)inNumberFrames
 
 @end
 
+/**
+ A block receiving the audio of an offline render (see EZOutput's `renderOfflineFrames:bufferSize:usingBlock:`).
+ @param bufferList The AudioBufferList holding the rendered audio in the output's format. It is reused for the next buffer so copy out anything that should be kept.
+ @param frames     The number of frames rendered into the buffer list.
+ @param stop       Set to YES to end the render after this buffer.
+ */
+typedef void (^EZOutputOfflineRenderBlock)(AudioBufferList *bufferList,
+                                           UInt32 frames,
+                                           BOOL *stop);
+
 /**
  The EZOutput component provides a generic output to glue all the other EZAudio components together and push whatever sound you've created to the default output device (think opposite of the microphone). The EZOutputDataSource provides the required AudioBufferList needed to populate the output buffer.
  */
@@ -165,6 +176,32 @@ inNumberFrames:(UInt32)inNumberFrames
  */
 -(void)stopPlayback;
 
+///-----------------------------------------------------------
+/// @name Rendering Offline
+///-----------------------------------------------------------
+
+/**
+ Pulls audio from the EZOutputDataSource as fast as the CPU allows instead of at the device's pace, through the same data source methods (and data source dispatch) as playback, so a graph can be bounced or checked in a regression test many times faster than real time. The output device isn't touched. Each buffer is cleared before the data source is asked for it, so a data source that provides fewer frames leaves silence. The render is measured by `callbackMetrics` like playback, so the metrics report how much faster than real time it ran.
+ @param frames     The total number of frames to render.
+ @param bufferSize The number of frames per buffer handed to the data source (i.e. 512 to match a typical device).
+ @param block      An EZOutputOfflineRenderBlock receiving each rendered buffer, i.e. to copy it into memory.
+ @return The number of frames rendered.
+ @warning Do not call this during playback. It runs on the calling thread, so the data source is called on that thread instead of the audio thread.
+ */
+-(SInt64)renderOfflineFrames:(SInt64)frames
+                  bufferSize:(UInt32)bufferSize
+                  usingBlock:(EZOutputOfflineRenderBlock)block;
+
+/**
+ Renders offline (see `renderOfflineFrames:bufferSize:usingBlock:`) into a 32-bit float WAV file at the output's sample rate and channel count. The file is written with EZAudioWAVWriter, which doesn't depend on Core Audio.
+ @param frames The total number of frames to render.
+ @param url    The file path reference of the WAV file to write as an NSURL. Any existing file is replaced.
+ @return The number of frames written, which is less than `frames` if the file couldn't be written.
+ @warning Do not call this during playback.
+ */
+-(SInt64)renderOfflineFrames:(SInt64)frames
+                       toURL:(NSURL*)url;
+
 #pragma mark - Getters
 ///-----------------------------------------------------------
 /// @name Getting The Output Audio Format
@@ -186,6 +223,27 @@ inNumberFrames:(UInt32)inNumberFrames
  */
 -(BOOL)isPlaying;
 
+///-----------------------------------------------------------
+/// @name Measuring The Render Callback
+///-----------------------------------------------------------
+
+/**
+ Provides a consistent snapshot of the render callback's instrumentation since playback last started (or since `resetCallbackMetrics`): a histogram of how long each callback took, the callbacks that took longer than the audio they rendered lasts (deadline misses), the callbacks where the data source had fewer frames than were asked for (short buffers, i.e. an underrunning circular buffer) and the jumps in the output's sample time (timestamp gaps). Reading never blocks or disturbs the audio thread and is safe from any thread.
+ @return An EZAudioCallbackMetricsSnapshot of the render callback's counters.
+ */
+-(EZAudioCallbackMetricsSnapshot)callbackMetrics;
+
+/**
+ Provides the same snapshot as `callbackMetrics` exported as an NSDictionary (see EZAudio's `dictionaryWithCallbackMetrics:`).
+ @return An NSDictionary of the render callback's counters and duration percentiles.
+ */
+-(NSDictionary *)callbackMetricsDictionary;
+
+/**
+ Zeroes the render callback's instrumentation. The audio thread clears the counters at the end of its next callback so this is safe to call from any thread at any time.
+ */
+-(void)resetCallbackMetrics;
+
 #pragma mark - Setters
 ///-----------------------------------------------------------
 /// @name Customizing The Output Format
@@ -27,75 +27,169 @@
 
 #import "EZAudio.h"
 
+/// Offline Rendering
+static const UInt32 kEZOutputOfflineFileBufferSize = 4096;
+
+/// Data Source Dispatch
+typedef void (*EZOutputCallbackIMP)(id, SEL, EZOutput *, AudioUnitRenderActionFlags *, const AudioTimeStamp *, UInt32, UInt32, AudioBufferList *);
+typedef TPCircularBuffer *(*EZOutputCircularBufferIMP)(id, SEL, EZOutput *);
+typedef void (*EZOutputFillIMP)(id, SEL, EZOutput *, AudioBufferList *, UInt32);
+typedef struct EZOutputDataSourceDispatch {
+  __unsafe_unretained id            dataSource;
+  EZOutputCallbackIMP               callback;
+  EZOutputCircularBufferIMP         circularBuffer;
+  EZOutputFillIMP                   fill;
+  int64_t                           retiredEpoch;
+  struct EZOutputDataSourceDispatch *next;
+} EZOutputDataSourceDispatch;
+
 @interface EZOutput (){
   BOOL                        _customASBD;
   BOOL                        _isPlaying;
   AudioStreamBasicDescription _outputASBD;
   AudioUnit                   _outputUnit;
+  const EZAudioDSPKernel      *_kernel;
+  
+  /// Data Source Dispatch (a new immutable table whenever the data source is set, the old one is freed once no render can be reading it)
+  EZOutputDataSourceDispatch *volatile _dataSourceDispatch;
+  EZOutputDataSourceDispatch           *_retiredDataSourceDispatches;
+  volatile int64_t                     _renderEpoch;
+  
+  /// Instrumentation
+  EZAudioCallbackMetrics _callbackMetrics;
 }
 @end
 
 @implementation EZOutput
 @synthesize outputDataSource = _outputDataSource;
 
-static OSStatus OutputRenderCallback(void                        *inRefCon,
-                                     AudioUnitRenderActionFlags  *ioActionFlags,
-                                     const AudioTimeStamp        *inTimeStamp,
-                                     UInt32                      inBusNumber,
-                                     UInt32                      inNumberFrames,
-                                     AudioBufferList             *ioData){
-  EZOutput *output = (__bridge EZOutput*)inRefCon;
+// Zeroes every buffer and marks them silent, for when there's no way to write the output's format
+static void OutputRenderSilence(AudioUnitRenderActionFlags *ioActionFlags,
+                                AudioBufferList            *ioData){
+  for( UInt32 i = 0; i < ioData->mNumberBuffers; i++ ){
+    memset(ioData->mBuffers[i].mData,0,ioData->mBuffers[i].mDataByteSize);
+  }
+  *ioActionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+}
+
+// Pulls the frames from the data source, returns how many of them it had
+static UInt32 OutputRenderDispatch(EZOutput                    *output,
+                                   EZOutputDataSourceDispatch  *dispatch,
+                                   AudioUnitRenderActionFlags  *ioActionFlags,
+                                   const AudioTimeStamp        *inTimeStamp,
+                                   UInt32                      inBusNumber,
+                                   UInt32                      inNumberFrames,
+                                   AudioBufferList             *ioData){
   // Manual override
-  if( [output.outputDataSource respondsToSelector:@selector(output:callbackWithActionFlags:inTimeStamp:inBusNumber:inNumberFrames:ioData:)] ){
-    [output.outputDataSource output:output
-            callbackWithActionFlags:ioActionFlags
-                        inTimeStamp:inTimeStamp
-                        inBusNumber:inBusNumber
-                     inNumberFrames:inNumberFrames
-                             ioData:ioData];
+  if( dispatch->callback ){
+    dispatch->callback(dispatch->dataSource,
+                       @selector(output:callbackWithActionFlags:inTimeStamp:inBusNumber:inNumberFrames:ioData:),
+                       output,
+                       ioActionFlags,
+                       inTimeStamp,
+                       inBusNumber,
+                       inNumberFrames,
+                       ioData);
   }
-  else if( [output.outputDataSource respondsToSelector:@selector(outputShouldUseCircularBuffer:)] ){
+  else if( dispatch->circularBuffer ){
+    
+    // The kernel was picked for the output format when it was configured
+    const EZAudioDSPKernel *kernel   = output->_kernel;
+    UInt32                  channels = output->_outputASBD.mChannelsPerFrame;
+    if( !kernel ){
+      OutputRenderSilence(ioActionFlags,ioData);
+      return 0;
+    }
     
-    TPCircularBuffer *circularBuffer = [output.outputDataSource outputShouldUseCircularBuffer:output];
+    TPCircularBuffer *circularBuffer = dispatch->circularBuffer(dispatch->dataSource,
+                                                                @selector(outputShouldUseCircularBuffer:),
+                                                                output);
     if( !circularBuffer ){
-      float *left  = (float*)ioData->mBuffers[0].mData;
-      float *right = (float*)ioData->mBuffers[1].mData;
-      for(int i = 0; i < inNumberFrames; i++ ){
-        left[  i ] = 0.0f;
-        right[ i ] = 0.0f;
-      }
-      return noErr;
+      kernel->clear(ioData,0,inNumberFrames,channels);
+      return 0;
     };
     
     /**
      Thank you Michael Tyson (A Tasty Pixel) for writing the TPCircularBuffer, you are amazing!
      */
     
-    // Get the desired amount of bytes to copy
-    int32_t bytesToCopy = ioData->mBuffers[0].mDataByteSize;
-    float *left  = (float*)ioData->mBuffers[0].mData;
-    float *right = (float*)ioData->mBuffers[1].mData;
-    
-    // Get the available bytes in the circular buffer
+    // Get the available bytes in the circular buffer (mono float samples)
     int32_t availableBytes;
     float *buffer = TPCircularBufferTail(circularBuffer,&availableBytes);
     
-    // Ideally we'd have all the bytes to be copied, but compare it against the available bytes (get min)
-    int32_t amount = MIN(bytesToCopy,availableBytes);
-    memcpy( left,  buffer, amount );
-    memcpy( right, buffer, amount );
+    // Ideally we'd have all the frames to be copied, but compare it against the available frames (get min)
+    UInt32 frames = MIN(inNumberFrames,(UInt32)(availableBytes/sizeof(float)));
+    
+    // Copy the mono samples into every output channel
+    kernel->fill(buffer,ioData,0,frames,channels);
+    
+    // An underrun plays silence for the rest rather than whatever was left in the buffer
+    if( frames < inNumberFrames ){
+      kernel->clear(ioData,frames,inNumberFrames-frames,channels);
+    }
     
     // Consume those bytes ( this will internally push the head of the circular buffer )
-    TPCircularBufferConsume(circularBuffer,amount);
+    TPCircularBufferConsume(circularBuffer,(int32_t)(frames*sizeof(float)));
     
+    return frames;
   }
   // Provided an AudioBufferList (defaults to silence)
-  else if( [output.outputDataSource respondsToSelector:@selector(output:shouldFillAudioBufferList:withNumberOfFrames:)] ) {
-    [output.outputDataSource output:output
-          shouldFillAudioBufferList:ioData
-                 withNumberOfFrames:inNumberFrames];
+  else if( dispatch->fill ) {
+    dispatch->fill(dispatch->dataSource,
+                   @selector(output:shouldFillAudioBufferList:withNumberOfFrames:),
+                   output,
+                   ioData,
+                   inNumberFrames);
   }
-  
+  else {
+    return 0;
+  }
+
+  return inNumberFrames;
+}
+
+static UInt32 OutputRenderDataSource(EZOutput                    *output,
+                                     AudioUnitRenderActionFlags  *ioActionFlags,
+                                     const AudioTimeStamp        *inTimeStamp,
+                                     UInt32                      inBusNumber,
+                                     UInt32                      inNumberFrames,
+                                     AudioBufferList             *ioData){
+  // Odd while rendering so a dispatch table replaced meanwhile is kept until this render is done
+  OSAtomicIncrement64Barrier(&output->_renderEpoch);
+  EZOutputDataSourceDispatch *dispatch  = output->_dataSourceDispatch;
+  UInt32                     delivered = 0;
+  if( dispatch ){
+    delivered = OutputRenderDispatch(output,
+                                     dispatch,
+                                     ioActionFlags,
+                                     inTimeStamp,
+                                     inBusNumber,
+                                     inNumberFrames,
+                                     ioData);
+  }
+  OSAtomicIncrement64Barrier(&output->_renderEpoch);
+  return delivered;
+}
+
+static OSStatus OutputRenderCallback(void                        *inRefCon,
+                                     AudioUnitRenderActionFlags  *ioActionFlags,
+                                     const AudioTimeStamp        *inTimeStamp,
+                                     UInt32                      inBusNumber,
+                                     UInt32                      inNumberFrames,
+                                     AudioBufferList             *ioData){
+  EZOutput *output    = (__bridge EZOutput*)inRefCon;
+  UInt64    beginTime = EZAudioCallbackMetricsBegin();
+  UInt32    delivered = OutputRenderDataSource(output,
+                                               ioActionFlags,
+                                               inTimeStamp,
+                                               inBusNumber,
+                                               inNumberFrames,
+                                               ioData);
+  EZAudioCallbackMetricsEnd(&output->_callbackMetrics,
+                            beginTime,
+                            inTimeStamp,
+                            inNumberFrames,
+                            delivered);
   return noErr;
 }
 
@@ -231,6 +325,9 @@ static OSStatus OutputRenderCallback(void                        *inRefCon,
     _outputASBD = [EZAudio stereoCanonicalNonInterleavedFormatWithSampleRate:hardwareSampleRate];
   }
   
+  // Pick the sample loops for the output format
+  _kernel = EZAudioDSPKernelForFormat(_outputASBD);
+  
   // Set the format for output
   [EZAudio checkResult:AudioUnitSetProperty(_outputUnit,
                                             kAudioUnitProperty_StreamFormat,
@@ -282,6 +379,9 @@ static OSStatus OutputRenderCallback(void                        *inRefCon,
       _outputASBD = [EZAudio stereoFloatNonInterleavedFormatWithSampleRate:44100];
   }
   
+  // Pick the sample loops for the output format
+  _kernel = EZAudioDSPKernelForFormat(_outputASBD);
+  
   // Set the format for output
   [EZAudio checkResult:AudioUnitSetProperty(_outputUnit,
                                             kAudioUnitProperty_StreamFormat,
@@ -313,6 +413,8 @@ static OSStatus OutputRenderCallback(void                        *inRefCon,
 #pragma mark - Events
 -(void)startPlayback {
   if( !_isPlaying ){
+    // Measure the render callback from scratch against this format's deadlines
+    EZAudioCallbackMetricsInit(&_callbackMetrics,_outputASBD.mSampleRate);
     [EZAudio checkResult:AudioOutputUnitStart(_outputUnit)
                operation:"Failed to start output unit"];
     _isPlaying = YES;
@@ -327,6 +429,105 @@ static OSStatus OutputRenderCallback(void                        *inRefCon,
   }
 }
 
+#pragma mark - Offline Rendering
+-(SInt64)renderOfflineFrames:(SInt64)frames
+                  bufferSize:(UInt32)bufferSize
+                  usingBlock:(EZOutputOfflineRenderBlock)block {
+  NSAssert(!_isPlaying,@"Cannot render offline during playback");
+  NSAssert(_kernel,@"Cannot render offline to a format without a sample kernel");
+  if( _isPlaying || !_kernel || frames <= 0 ){
+    return 0;
+  }
+  bufferSize = MAX(bufferSize,1);
+  
+  // One buffer list in the output's format, reused for every buffer
+  UInt32 channels        = _outputASBD.mChannelsPerFrame;
+  UInt32 numberOfBuffers = [EZAudio isInterleaved:_outputASBD] ? 1 : channels;
+  UInt32 bufferSizeBytes = bufferSize * _outputASBD.mBytesPerFrame;
+  AudioBufferList *bufferList = (AudioBufferList*)malloc(offsetof( AudioBufferList, mBuffers[0] ) + ( sizeof( AudioBuffer ) * numberOfBuffers ));
+  bufferList->mNumberBuffers = numberOfBuffers;
+  for( UInt32 i = 0; i < numberOfBuffers; i++ ){
+    bufferList->mBuffers[i].mNumberChannels = channels / numberOfBuffers;
+    bufferList->mBuffers[i].mData           = malloc(bufferSizeBytes);
+  }
+  
+  // The render is measured the same as playback so the metrics give its speed
+  EZAudioCallbackMetricsInit(&_callbackMetrics,_outputASBD.mSampleRate);
+  AudioTimeStamp timeStamp;
+  memset(&timeStamp,0,sizeof(timeStamp));
+  timeStamp.mFlags      = kAudioTimeStampSampleTimeValid;
+  timeStamp.mRateScalar = 1.0;
+  
+  SInt64 rendered = 0;
+  BOOL   stop     = NO;
+  while( rendered < frames && !stop ){
+    @autoreleasepool {
+      UInt32 count = (UInt32)MIN((SInt64)bufferSize,frames - rendered);
+      for( UInt32 i = 0; i < numberOfBuffers; i++ ){
+        bufferList->mBuffers[i].mDataByteSize = count * _outputASBD.mBytesPerFrame;
+      }
+      _kernel->clear(bufferList,0,count,channels);
+      AudioUnitRenderActionFlags flags     = 0;
+      UInt64                     beginTime = EZAudioCallbackMetricsBegin();
+      UInt32                     delivered = OutputRenderDataSource(self,
+                                                                    &flags,
+                                                                    &timeStamp,
+                                                                    0,
+                                                                    count,
+                                                                    bufferList);
+      EZAudioCallbackMetricsEnd(&_callbackMetrics,
+                                beginTime,
+                                &timeStamp,
+                                count,
+                                delivered);
+      if( block ){
+        block(bufferList,count,&stop);
+      }
+      timeStamp.mSampleTime += count;
+      rendered              += count;
+    }
+  }
+  
+  [EZAudio freeBufferList:bufferList];
+  return rendered;
+}
+
+-(SInt64)renderOfflineFrames:(SInt64)frames
+                       toURL:(NSURL*)url {
+  UInt32 channels = _outputASBD.mChannelsPerFrame;
+  EZAudioWAVWriter *writer = EZAudioWAVWriterCreate([url.path fileSystemRepresentation],
+                                                    channels,
+                                                    _outputASBD.mSampleRate,
+                                                    EZAudioWAVWriterSampleFormatFloat32);
+  if( !writer ){
+    NSLog(@"Output failed to create the offline render file at %@",url.path);
+    return 0;
+  }
+  
+  // Whatever the output's format the file gets the floats
+  float **floatBuffers = [EZAudio floatBuffersWithNumberOfFrames:kEZOutputOfflineFileBufferSize
+                                                numberOfChannels:channels];
+  const EZAudioDSPKernel *kernel = _kernel;
+  __block SInt64 written = 0;
+  [self renderOfflineFrames:frames
+                 bufferSize:kEZOutputOfflineFileBufferSize
+                 usingBlock:^(AudioBufferList *bufferList, UInt32 count, BOOL *stop) {
+                   kernel->toFloat(bufferList,0,floatBuffers,count,channels);
+                   if( EZAudioWAVWriterWrite(writer,(const float * const *)floatBuffers,count) ){
+                     written += count;
+                   }
+                   else {
+                     *stop = YES;
+                   }
+                 }];
+  
+  if( !EZAudioWAVWriterClose(writer) ){
+    NSLog(@"Output failed to finish the offline render file at %@",url.path);
+  }
+  [EZAudio freeFloatBuffers:floatBuffers numberOfChannels:channels];
+  return written;
+}
+
 #pragma mark - Getters
 -(AudioStreamBasicDescription)audioStreamBasicDescription {
   return _outputASBD;
@@ -336,7 +537,63 @@ static OSStatus OutputRenderCallback(void                        *inRefCon,
   return _isPlaying;
 }
 
+-(EZAudioCallbackMetricsSnapshot)callbackMetrics {
+  EZAudioCallbackMetricsSnapshot snapshot;
+  EZAudioCallbackMetricsRead(&_callbackMetrics,&snapshot);
+  return snapshot;
+}
+
+-(NSDictionary *)callbackMetricsDictionary {
+  return [EZAudio dictionaryWithCallbackMetrics:[self callbackMetrics]];
+}
+
+-(void)resetCallbackMetrics {
+  EZAudioCallbackMetricsReset(&_callbackMetrics);
+}
+
 #pragma mark - Setters
+-(void)setOutputDataSource:(id<EZOutputDataSource>)outputDataSource {
+  _outputDataSource = outputDataSource;
+  
+  // Resolve the data source's methods into a table of their own, the render callback may still be reading the current one
+  EZOutputDataSourceDispatch *dispatch = (EZOutputDataSourceDispatch*)calloc(1,sizeof(EZOutputDataSourceDispatch));
+  SEL callback       = @selector(output:callbackWithActionFlags:inTimeStamp:inBusNumber:inNumberFrames:ioData:);
+  SEL circularBuffer = @selector(outputShouldUseCircularBuffer:);
+  SEL fill           = @selector(output:shouldFillAudioBufferList:withNumberOfFrames:);
+  dispatch->dataSource     = outputDataSource;
+  dispatch->callback       = [outputDataSource respondsToSelector:callback] ? (EZOutputCallbackIMP)[(NSObject *)outputDataSource methodForSelector:callback] : NULL;
+  dispatch->circularBuffer = [outputDataSource respondsToSelector:circularBuffer] ? (EZOutputCircularBufferIMP)[(NSObject *)outputDataSource methodForSelector:circularBuffer] : NULL;
+  dispatch->fill           = [outputDataSource respondsToSelector:fill] ? (EZOutputFillIMP)[(NSObject *)outputDataSource methodForSelector:fill] : NULL;
+  
+  // Publish it once it's complete
+  OSMemoryBarrier();
+  EZOutputDataSourceDispatch *previous = _dataSourceDispatch;
+  _dataSourceDispatch = dispatch;
+  
+  // A render running right now (odd epoch) may still be reading the previous table, any render after that can't see it
+  if( previous ){
+    OSMemoryBarrier();
+    previous->retiredEpoch = (_renderEpoch + 1) & ~1LL;
+    previous->next         = _retiredDataSourceDispatches;
+    _retiredDataSourceDispatches = previous;
+  }
+  [self _freeRetiredDataSourceDispatches];
+}
+
+-(void)_freeRetiredDataSourceDispatches {
+  EZOutputDataSourceDispatch **link = &_retiredDataSourceDispatches;
+  while( *link ){
+    EZOutputDataSourceDispatch *dispatch = *link;
+    if( _renderEpoch >= dispatch->retiredEpoch ){
+      *link = dispatch->next;
+      free(dispatch);
+    }
+    else {
+      link = &dispatch->next;
+    }
+  }
+}
+
 -(void)setAudioStreamBasicDescription:(AudioStreamBasicDescription)asbd {
   BOOL wasPlaying = NO;
   if( self.isPlaying ){
@@ -345,6 +602,9 @@ static OSStatus OutputRenderCallback(void                        *inRefCon,
   }
   _customASBD = YES;
   _outputASBD = asbd;
+  // Pick the sample loops for the output format
+  _kernel = EZAudioDSPKernelForFormat(_outputASBD);
+  
   // Set the format for output
   [EZAudio checkResult:AudioUnitSetProperty(_outputUnit,
                                             kAudioUnitProperty_StreamFormat,
@@ -366,6 +626,9 @@ static OSStatus OutputRenderCallback(void                        *inRefCon,
              operation:"Failed to uninitialize output unit"];
   [EZAudio checkResult:AudioComponentInstanceDispose(_outputUnit)
              operation:"Failed to uninitialize output unit"];
+  // Nothing renders anymore, so every dispatch table can go
+  [self _freeRetiredDataSourceDispatches];
+  free(_dataSourceDispatch);
 }
 
 @end
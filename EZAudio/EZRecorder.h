@@ -25,6 +25,7 @@
 
 #import <Foundation/Foundation.h>
 #import <AudioToolbox/AudioToolbox.h>
+#import "EZAudioBackgroundWriter.h"
 
 /**
  To ensure valid recording formats are used when recording to a file the EZRecorderFileType describes the most common file types that a file can be encoded in. Each of these types can be used to output recordings as such:
@@ -32,6 +33,7 @@
  EZRecorderFileTypeAIFF - .aif, .aiff, .aifc, .aac
  EZRecorderFileTypeM4A  - .m4a, .mp4
  EZRecorderFileTypeWAV  - .wav
+ EZRecorderFileTypeFLAC - .flac
  
  */
 typedef NS_ENUM(NSInteger, EZRecorderFileType)
@@ -47,14 +49,128 @@ typedef NS_ENUM(NSInteger, EZRecorderFileType)
     /**
      Recording format that describes WAV file types. These are uncompressed, LPCM files that are completely lossless, but are large in file size.
      */
-    EZRecorderFileTypeWAV
+    EZRecorderFileTypeWAV,
+    /**
+     Recording format that describes FLAC file types. These are compressed, but completely lossless, usually about half the size of the same audio in WAV. FLAC files are encoded by an EZAudioFLACEncoder and can only be written by the background writer (see `startBackgroundWriterWithBufferDuration:flushDuration:syncPolicy:syncInterval:`) or as an output.
+     */
+    EZRecorderFileTypeFLAC
 };
 
 /**
- The EZRecorder provides a flexible way to create an audio file and append raw audio data to it. The EZRecorder will convert the incoming audio on the fly to the destination format so no conversion is needed between this and any other component. Right now the only supported output format is 'caf'. Each output file should have its own EZRecorder instance (think 1 EZRecorder = 1 audio file).
+ The sample format of the audio written to uncompressed and FLAC files. Choosing the depth the audio actually needs (i.e. 16-bit for a 16-bit microphone) cuts the disk I/O and storage of a recording by as much as half compared to 32-bit float. Each file type takes the nearest format it supports:
+ 
+ EZRecorderFileTypeWAV  - every format
+ EZRecorderFileTypeAIFF - integer formats, 32-bit float is written as 32-bit integer
+ EZRecorderFileTypeFLAC - 16 and 24-bit, the 32-bit formats are written as 24-bit
+ EZRecorderFileTypeM4A  - ignored
+ 
+ */
+typedef NS_ENUM(NSInteger, EZRecorderSampleFormat)
+{
+    /**
+     32-bit float samples, which keep everything a float source holds, including peaks above full scale.
+     */
+    EZRecorderSampleFormatFloat32,
+    /**
+     16-bit integer samples, CD quality.
+     */
+    EZRecorderSampleFormatSInt16,
+    /**
+     24-bit integer samples, more resolution than any microphone delivers.
+     */
+    EZRecorderSampleFormatSInt24,
+    /**
+     32-bit integer samples.
+     */
+    EZRecorderSampleFormatSInt32
+};
+
+/**
+ The dither added when float audio is rounded to fewer bits.
+ */
+typedef NS_ENUM(NSInteger, EZRecorderDither)
+{
+    /**
+     No dither, the samples are just rounded.
+     */
+    EZRecorderDitherNone,
+    /**
+     Triangular (TPDF) dither of up to one step either way, which trades the rounding's distortion of quiet passages for a constant noise floor. Only applies to 16 and 24-bit WAV files written by the background writer or as outputs.
+     */
+    EZRecorderDitherTriangular
+};
+
+@class EZAudioFloatData;
+@class EZRecorder;
+
+#pragma mark - EZRecorderDelegate
+/**
+ The EZRecorderDelegate provides event callbacks for the EZRecorder. All events are triggered on the main thread.
+ */
+@protocol EZRecorderDelegate <NSObject>
+
+@optional
+/**
+ Triggered by the EZRecorder when a segment of a segmented recording has been written and closed, i.e. to start uploading it while the next one is recorded.
+ @param recorder  The instance of the EZRecorder that triggered the event
+ @param url       The NSURL of the completed segment's file
+ @param frames    The number of frames in the segment
+ @param succeeded YES if every write to the segment succeeded, NO if some of its audio is missing
+ */
+-(void)recorder:(EZRecorder*)recorder didCompleteSegmentAtURL:(NSURL*)url numberOfFrames:(SInt64)frames succeeded:(BOOL)succeeded;
+
+@end
+
+/**
+ The EZRecorder provides a flexible way to create an audio file and append raw audio data to it. The EZRecorder will convert the incoming audio on the fly to the destination format so no conversion is needed between this and any other component. Right now the only supported output format is 'caf'. Each output file should have its own EZRecorder instance (think 1 EZRecorder = 1 audio file), except for copies of the same recording in other formats, which are added as outputs of one recorder (see `addOutputWithDestinationURL:destinationFileType:bufferDuration:flushDuration:syncPolicy:syncInterval:`) so the incoming audio is only converted once.
  */
 @interface EZRecorder : NSObject
 
+#pragma mark - Properties
+///-----------------------------------------------------------
+/// @name Properties
+///-----------------------------------------------------------
+
+/**
+ The EZRecorderDelegate that will handle the recorder's callbacks
+ */
+@property (nonatomic, weak) id<EZRecorderDelegate> delegate;
+
+/**
+ The number of channels written to the file. Defaults to the source's channel count.
+ */
+@property (nonatomic, assign, readonly) UInt32 destinationChannels;
+
+/**
+ The sample format written to the file (see EZRecorderSampleFormat). Defaults to 16-bit integer for a 16-bit integer source and 32-bit float otherwise.
+ */
+@property (nonatomic, assign, readonly) EZRecorderSampleFormat destinationSampleFormat;
+
+/**
+ The dither added when the file's sample format has fewer bits than the source. Defaults to EZRecorderDitherNone.
+ */
+@property (nonatomic, assign, readonly) EZRecorderDither dither;
+
+/**
+ The compression level of FLAC files, from 0 (fastest) to 8 (smallest). Defaults to 5. Set it before starting the background writer or adding a FLAC output.
+ */
+@property (nonatomic, assign) UInt32 flacCompressionLevel;
+
+/**
+ The number of threads encoding each FLAC file's frames in parallel, including its writer thread. Defaults to the number of active processors. Set it before starting the background writer or adding a FLAC output.
+ */
+@property (nonatomic, assign) UInt32 flacEncoderThreads;
+
+/**
+ The RMS level (0.0 to 1.0, linear) of any channel of an append that triggers the pre-roll on its own (see `startPreRollWithDuration:`), or 0.0 to only trigger it with `trigger`. Defaults to 0.0. Measuring it needs a packed native endian float or 16-bit integer linear PCM source format.
+ */
+@property (nonatomic, assign) float preRollTriggerLevel;
+
+/**
+ Where a peak file (see EZAudioPeakFile) of the recording is built while it's written, so its waveform can be drawn live and is ready the moment recording stops (see `waveformDataWithNumberOfPoints:`), or nil to build none. Defaults to nil. The peak file summarizes the source's channels on the background writer's thread and spans every segment of a segmented recording. Set it before starting the background writer.
+ */
+@property (nonatomic, copy) NSURL *peakFileURL;
+
 #pragma mark - Initializers
 ///-----------------------------------------------------------
 /// @name Initializers
@@ -71,6 +187,23 @@ typedef NS_ENUM(NSInteger, EZRecorderFileType)
                         sourceFormat:(AudioStreamBasicDescription)sourceFormat
                  destinationFileType:(EZRecorderFileType)destinationFileType;
 
+/**
+ Creates a new instance of an EZRecorder using a destination file path URL, the source format of the incoming audio and the channel count and sample format the file is written in. Mixing down to mono averages the source's channels, fewer channels keep the source's first ones and more channels repeat them in turn (i.e. a mono microphone recorded to both channels of a stereo file). The background writer and outputs remix and convert the audio on their writer threads, so the thread appending the audio never pays for it.
+ @param url                     An NSURL specifying the file path location of where the audio file should be written to.
+ @param sourceFormat            The AudioStreamBasicDescription for the incoming audio that will be written to the file.
+ @param destinationFileType     A constant described by the EZRecorderFileType that corresponds to the type of destination file that should be written. See EZRecorderFileType for all the constants and mapping combinations.
+ @param destinationChannels     The number of channels written to the file, or 0 for the source's channel count.
+ @param destinationSampleFormat The EZRecorderSampleFormat written to the file, which the file type may adjust (see EZRecorderSampleFormat).
+ @param dither                  The EZRecorderDither added when rounding to 16 or 24-bit.
+ @return The newly created EZRecorder instance.
+ */
+-(EZRecorder*)initWithDestinationURL:(NSURL*)url
+                        sourceFormat:(AudioStreamBasicDescription)sourceFormat
+                 destinationFileType:(EZRecorderFileType)destinationFileType
+                 destinationChannels:(UInt32)destinationChannels
+             destinationSampleFormat:(EZRecorderSampleFormat)destinationSampleFormat
+                              dither:(EZRecorderDither)dither;
+
 
 #pragma mark - Class Initializers
 ///-----------------------------------------------------------
@@ -88,6 +221,37 @@ typedef NS_ENUM(NSInteger, EZRecorderFileType)
                             sourceFormat:(AudioStreamBasicDescription)sourceFormat
                      destinationFileType:(EZRecorderFileType)destinationFileType;
 
+/**
+ Class method to create a new instance of an EZRecorder using a destination file path URL, the source format of the incoming audio and the channel count and sample format the file is written in.
+ @param url                     An NSURL specifying the file path location of where the audio file should be written to.
+ @param sourceFormat            The AudioStreamBasicDescription for the incoming audio that will be written to the file.
+ @param destinationFileType     A constant described by the EZRecorderFileType that corresponds to the type of destination file that should be written. See EZRecorderFileType for all the constants and mapping combinations.
+ @param destinationChannels     The number of channels written to the file, or 0 for the source's channel count.
+ @param destinationSampleFormat The EZRecorderSampleFormat written to the file, which the file type may adjust (see EZRecorderSampleFormat).
+ @param dither                  The EZRecorderDither added when rounding to 16 or 24-bit.
+ @return The newly created EZRecorder instance.
+ */
++(EZRecorder*)recorderWithDestinationURL:(NSURL*)url
+                            sourceFormat:(AudioStreamBasicDescription)sourceFormat
+                     destinationFileType:(EZRecorderFileType)destinationFileType
+                     destinationChannels:(UInt32)destinationChannels
+                 destinationSampleFormat:(EZRecorderSampleFormat)destinationSampleFormat
+                                  dither:(EZRecorderDither)dither;
+
+#pragma mark - Repair
+///-----------------------------------------------------------
+/// @name Repairing Recordings
+///-----------------------------------------------------------
+
+/**
+ Repairs a WAV (or RF64) recording that was never closed, i.e. one left behind when the app was killed or crashed mid recording. The header is patched to describe all of the audio that reached the disk (see EZAudioWAVWriterRepair), which only takes a scan of the header however long the recording is. Files that are already intact are left as they are.
+ @param url    An NSURL specifying the file path of the WAV file to repair. It must not still be being recorded to.
+ @param frames If not NULL receives the number of frames the repaired file holds.
+ @return YES if the file is intact or was repaired, NO if it isn't a WAV file or couldn't be repaired.
+ */
++(BOOL)repairWAVFileAtURL:(NSURL*)url
+           numberOfFrames:(SInt64*)frames;
+
 #pragma mark - Getters
 ///-----------------------------------------------------------
 /// @name Getting The Recorder's Properties
@@ -98,6 +262,202 @@ typedef NS_ENUM(NSInteger, EZRecorderFileType)
  */
 -(NSURL*)url;
 
+/**
+ Provides the file path of a segment of a segmented recording. The segments are named after the recorder's url with the segment's index appended, i.e. `take.wav` is recorded as `take_0000.wav`, `take_0001.wav` and so on.
+ @param index The index of the segment.
+ @return The NSURL representing the file path of the segment's audio file.
+ */
+-(NSURL*)urlForSegmentAtIndex:(UInt32)index;
+
+/**
+ Provides the number of segments of a segmented recording that have been written and closed.
+ @return The completed segment count, or 0 if the recording isn't segmented.
+ */
+-(UInt32)completedSegments;
+
+/**
+ Provides the number of appends the background writer dropped because its buffer was full, i.e. the disk stalled for longer than the buffer duration.
+ @return The overrun count, or 0 if the background writer wasn't started.
+ */
+-(UInt32)backgroundWriterOverruns;
+
+/**
+ Provides the total number of frames the background writer dropped because its buffer was full.
+ @return The dropped frame count, or 0 if the background writer wasn't started.
+ */
+-(SInt64)backgroundWriterDroppedFrames;
+
+#pragma mark - Background Writer
+///-----------------------------------------------------------
+/// @name Writing On A Background Thread
+///-----------------------------------------------------------
+
+/**
+ Moves writing the file off the thread calling `appendDataFromBufferList:withBufferSize:` (usually a microphone's audio thread). From then on appending only converts the audio to float and copies it into a preallocated lock-free ring, and an EZAudioBackgroundWriter thread writes it to the file in large batches. If the disk stalls for longer than the buffer duration whole appends are dropped and counted (see `backgroundWriterOverruns`) instead of blocking the audio thread.
+
+ WAV files are written by an EZAudioWAVWriter in the destination channels and sample format, converted on the writer thread, which honors the sync policy. Every sync also commits the WAV header's sizes, so with EZAudioBackgroundWriterSyncPolicyInterval a recording cut short by a crash is a playable file up to its last sync (and `repairWAVFileAtURL:numberOfFrames:` recovers everything after that which reached the disk). Past 4 GB the file turns into RF64 instead of failing. FLAC files are encoded by an EZAudioFLACEncoder (see `flacCompressionLevel` and `flacEncoderThreads`) in 16-bit for EZRecorderSampleFormatSInt16 and 24-bit otherwise, and every sync commits its header the same way. Other file types are written through the ExtAudioFile, which has no way to sync so the sync policy is ignored and the header is only written when the file is closed. Call this once, before the first append.
+ @param bufferDuration How much audio in seconds is buffered for the writer thread, i.e. 2.0.
+ @param flushDuration  The smallest batch in seconds the writer thread writes at once, i.e. 0.25.
+ @param syncPolicy     The EZAudioBackgroundWriterSyncPolicy for pushing writes through to the disk.
+ @param syncInterval   The shortest time in seconds between syncs for EZAudioBackgroundWriterSyncPolicyInterval.
+ @return YES if the writer thread was started, NO if the source format isn't packed native endian float or 16-bit integer linear PCM or the writer couldn't be created.
+ */
+-(BOOL)startBackgroundWriterWithBufferDuration:(NSTimeInterval)bufferDuration
+                                 flushDuration:(NSTimeInterval)flushDuration
+                                    syncPolicy:(EZAudioBackgroundWriterSyncPolicy)syncPolicy
+                                  syncInterval:(NSTimeInterval)syncInterval;
+
+/**
+ Starts the background writer (see `startBackgroundWriterWithBufferDuration:flushDuration:syncPolicy:syncInterval:`) writing a series of segment files instead of one, for long running captures that need to be uploaded or rotated as they go. The file at the recorder's url isn't written, the segments are (see `urlForSegmentAtIndex:`).
+
+ A segment ends after exactly the number of frames given by the segment duration or size (whichever comes first) and the next segment picks up at the very next frame, so the segments join back together without a gap or a repeated frame. The writer thread opens each segment's file while the one before it is still being written so rolling over never stalls it, and a segment that can't be opened leaves the one before it growing until it can. Every completed segment is reported to the delegate's `recorder:didCompleteSegmentAtURL:numberOfFrames:succeeded:`, including the last one when the recorder is closed.
+ @param segmentDuration The length of each segment in seconds, or 0 to only segment by size.
+ @param segmentSize     The largest size of each segment's audio data in bytes, or 0 to only segment by duration. Compressed (M4A and FLAC) segments can only be segmented by duration.
+ @param bufferDuration  How much audio in seconds is buffered for the writer thread, i.e. 2.0.
+ @param flushDuration   The smallest batch in seconds the writer thread writes at once, i.e. 0.25.
+ @param syncPolicy      The EZAudioBackgroundWriterSyncPolicy for pushing writes through to the disk. Each segment is also synced as it's closed unless this is EZAudioBackgroundWriterSyncPolicyNone.
+ @param syncInterval    The shortest time in seconds between syncs for EZAudioBackgroundWriterSyncPolicyInterval.
+ @return YES if the writer thread was started, NO if the source format can't be written in the background, no segment length was given or the first segment couldn't be created.
+ */
+-(BOOL)startSegmentedBackgroundWriterWithSegmentDuration:(NSTimeInterval)segmentDuration
+                                             segmentSize:(UInt64)segmentSize
+                                          bufferDuration:(NSTimeInterval)bufferDuration
+                                           flushDuration:(NSTimeInterval)flushDuration
+                                              syncPolicy:(EZAudioBackgroundWriterSyncPolicy)syncPolicy
+                                            syncInterval:(NSTimeInterval)syncInterval;
+
+/**
+ Starts the background writer (see `startBackgroundWriterWithBufferDuration:flushDuration:syncPolicy:syncInterval:`) writing every channel of the source to its own mono file instead of one file, for multitrack recordings of wide (i.e. 16 to 64 channel) interfaces. Create the recorder with the interface's full non-interleaved format (i.e. from an EZMicrophone given that format with `initWithMicrophoneDelegate:withAudioStreamBasicDescription:`). The file at the recorder's url isn't written.
+
+ Each track is a file of the recorder's destination file type and sample format, the destination channels are ignored. The writer thread hands every batch to a pool of threads that write the tracks in parallel, and a batch is finished on every track before the next one is taken out of the buffer, so the tracks always hold the same frames and line up sample for sample, even across dropped appends. FLAC tracks are encoded by a single thread each since the pool already spreads the tracks over the threads.
+ @param urls           One NSURL per channel of the source format, in channel order.
+ @param writerThreads  The number of threads writing the tracks, including the writer thread, i.e. the number of processors. More threads than tracks are never started.
+ @param bufferDuration How much audio in seconds is buffered for the writer thread, i.e. 2.0.
+ @param flushDuration  The smallest batch in seconds the writer thread writes at once, i.e. 0.25.
+ @param syncPolicy     The EZAudioBackgroundWriterSyncPolicy for pushing writes through to the disk. The tracks are synced in parallel too.
+ @param syncInterval   The shortest time in seconds between syncs for EZAudioBackgroundWriterSyncPolicyInterval.
+ @return YES if the writer thread was started, NO if the source format can't be written in the background, there isn't one url per channel or a track's file couldn't be created.
+ */
+-(BOOL)startMultitrackBackgroundWriterWithDestinationURLs:(NSArray*)urls
+                                            writerThreads:(UInt32)writerThreads
+                                           bufferDuration:(NSTimeInterval)bufferDuration
+                                            flushDuration:(NSTimeInterval)flushDuration
+                                               syncPolicy:(EZAudioBackgroundWriterSyncPolicy)syncPolicy
+                                             syncInterval:(NSTimeInterval)syncInterval;
+
+#pragma mark - Outputs
+///-----------------------------------------------------------
+/// @name Recording To More Than One File
+///-----------------------------------------------------------
+
+/**
+ Adds another file the appended audio is recorded to, i.e. an M4A preview alongside a lossless archive. The incoming audio is converted to float once per append and shared by the background writer and every output, and each output has its own EZAudioBackgroundWriter (its own ring and writer thread), so the thread calling `appendDataFromBufferList:withBufferSize:` only pays for a copy into each output's ring while the encoders run on their own threads. Backpressure is independent: an output whose encoder or disk falls behind drops its own appends (see `overrunsForOutputAtIndex:`) without affecting the others.
+
+ Outputs are written in the recorder's destination channels, sample format and dither (as far as their file type supports it), see `addOutputWithDestinationURL:destinationFileType:destinationChannels:destinationSampleFormat:dither:bufferDuration:flushDuration:syncPolicy:syncInterval:` to give an output its own. WAV outputs are written by an EZAudioWAVWriter and FLAC outputs by an EZAudioFLACEncoder, both honor the sync policy, other file types are written through an ExtAudioFile that ignores it. Add every output before the first append. Outputs are closed along with the recorder's own file in `closeAudioFile`.
+ @param url                 An NSURL specifying the file path location the output should be written to.
+ @param destinationFileType The EZRecorderFileType of the output file.
+ @param bufferDuration      How much audio in seconds is buffered for the output's writer thread, i.e. 2.0.
+ @param flushDuration       The smallest batch in seconds the output's writer thread writes at once, i.e. 0.25.
+ @param syncPolicy          The EZAudioBackgroundWriterSyncPolicy for pushing the output's writes through to the disk.
+ @param syncInterval        The shortest time in seconds between syncs for EZAudioBackgroundWriterSyncPolicyInterval.
+ @return YES if the output was added, NO if the source format isn't packed native endian float or 16-bit integer linear PCM, the recorder already has the most outputs it can (8) or the output's file or writer couldn't be created.
+ */
+-(BOOL)addOutputWithDestinationURL:(NSURL*)url
+               destinationFileType:(EZRecorderFileType)destinationFileType
+                    bufferDuration:(NSTimeInterval)bufferDuration
+                     flushDuration:(NSTimeInterval)flushDuration
+                        syncPolicy:(EZAudioBackgroundWriterSyncPolicy)syncPolicy
+                      syncInterval:(NSTimeInterval)syncInterval;
+
+/**
+ Adds another file the appended audio is recorded to in a channel count, sample format and dither of its own, i.e. a 16-bit stereo FLAC master and a mono M4A preview of a 32-bit float recording. The output is remixed and converted on its own writer thread just like the recorder's background writer (see `initWithDestinationURL:sourceFormat:destinationFileType:destinationChannels:destinationSampleFormat:dither:`), everything else is as for `addOutputWithDestinationURL:destinationFileType:bufferDuration:flushDuration:syncPolicy:syncInterval:`.
+ @param url                     An NSURL specifying the file path location the output should be written to.
+ @param destinationFileType     The EZRecorderFileType of the output file.
+ @param destinationChannels     The number of channels written to the output, or 0 for the source's channel count.
+ @param destinationSampleFormat The EZRecorderSampleFormat written to the output, which its file type may adjust (see EZRecorderSampleFormat).
+ @param dither                  The EZRecorderDither added when rounding to 16 or 24-bit.
+ @param bufferDuration          How much audio in seconds is buffered for the output's writer thread, i.e. 2.0.
+ @param flushDuration           The smallest batch in seconds the output's writer thread writes at once, i.e. 0.25.
+ @param syncPolicy              The EZAudioBackgroundWriterSyncPolicy for pushing the output's writes through to the disk.
+ @param syncInterval            The shortest time in seconds between syncs for EZAudioBackgroundWriterSyncPolicyInterval.
+ @return YES if the output was added, NO if the source format isn't packed native endian float or 16-bit integer linear PCM, the recorder already has the most outputs it can (8) or the output's file or writer couldn't be created.
+ */
+-(BOOL)addOutputWithDestinationURL:(NSURL*)url
+               destinationFileType:(EZRecorderFileType)destinationFileType
+               destinationChannels:(UInt32)destinationChannels
+           destinationSampleFormat:(EZRecorderSampleFormat)destinationSampleFormat
+                            dither:(EZRecorderDither)dither
+                    bufferDuration:(NSTimeInterval)bufferDuration
+                     flushDuration:(NSTimeInterval)flushDuration
+                        syncPolicy:(EZAudioBackgroundWriterSyncPolicy)syncPolicy
+                      syncInterval:(NSTimeInterval)syncInterval;
+
+/**
+ Provides the number of outputs added with `addOutputWithDestinationURL:destinationFileType:bufferDuration:flushDuration:syncPolicy:syncInterval:`.
+ @return The number of outputs, not counting the recorder's own file.
+ */
+-(UInt32)numberOfOutputs;
+
+/**
+ Provides the number of appends an output dropped because its buffer was full.
+ @param index The index of the output in the order it was added.
+ @return The output's overrun count, or 0 if there's no such output.
+ */
+-(UInt32)overrunsForOutputAtIndex:(UInt32)index;
+
+/**
+ Provides the total number of frames an output dropped because its buffer was full.
+ @param index The index of the output in the order it was added.
+ @return The output's dropped frame count, or 0 if there's no such output.
+ */
+-(SInt64)droppedFramesForOutputAtIndex:(UInt32)index;
+
+#pragma mark - Pre-roll
+///-----------------------------------------------------------
+/// @name Capturing The Audio Before A Trigger
+///-----------------------------------------------------------
+
+/**
+ Holds appended audio back until the recording is triggered, keeping the last `duration` seconds of it in a preallocated lock-free ring instead of writing it. When the recording is triggered (by `trigger` or by an append reaching `preRollTriggerLevel`) that history is written ahead of the live audio, so the file starts `duration` seconds before the trigger without a gap or a repeated frame.
+
+ The audio thread never allocates or writes all of the history at once: after the trigger each append drains a bounded amount more than it adds, the live audio waits its turn in the same ring until the history has caught up and from then on appends are written directly. This works with any of the ways the recorder writes, including the background writer, segments and outputs (whose buffer durations should be comfortably longer than the catch-up needs). Call this once, before the first append. Closing the recorder writes out whatever is left of a triggered pre-roll, an untriggered one is discarded.
+ @param duration The length of the history in seconds, i.e. 5.0.
+ @return YES if the pre-roll was started, NO if the duration is shorter than a frame or the ring couldn't be allocated.
+ */
+-(BOOL)startPreRollWithDuration:(NSTimeInterval)duration;
+
+/**
+ Triggers the recording, writing the pre-roll's history followed by the live audio from the next append on. Safe to call from any thread, including the audio thread, and only the first call has any effect.
+ */
+-(void)trigger;
+
+/**
+ Provides whether the recorder is holding audio back in its pre-roll, waiting for a trigger.
+ @return YES if the pre-roll was started and hasn't been triggered yet.
+ */
+-(BOOL)isPreRolling;
+
+#pragma mark - Waveform
+///-----------------------------------------------------------
+/// @name Getting The Recording's Waveform
+///-----------------------------------------------------------
+
+/**
+ Provides the waveform of the recording from its peak file (see `peakFileURL`), the RMS of each point like EZAudioFile's `getWaveformDataWithNumberOfPoints:` but without reading any audio. While recording the waveform covers everything written so far, and after closing the recorder the finished peak file is read.
+ @param numberOfPoints The number of points, i.e. the width of the plot.
+ @return An EZAudioFloatData with one buffer per channel, or nil if the recorder has no peak file.
+ */
+-(EZAudioFloatData*)waveformDataWithNumberOfPoints:(UInt32)numberOfPoints;
+
+/**
+ Provides the waveform of a recording from a peak file built by an EZRecorder (see `peakFileURL`), which only reads the coarsest summary that has enough resolution however long the recording is. A peak file whose recording was cut short by a crash is read up to where it last reached the disk.
+ @param url            An NSURL specifying the file path of the peak file.
+ @param numberOfPoints The number of points, i.e. the width of the plot.
+ @return An EZAudioFloatData with one buffer per channel holding the RMS of each point, or nil if the peak file couldn't be read.
+ */
++(EZAudioFloatData*)waveformDataFromPeakFileAtURL:(NSURL*)url
+                                   numberOfPoints:(UInt32)numberOfPoints;
+
 #pragma mark - Events
 ///-----------------------------------------------------------
 /// @name Appending Data To The Audio File
@@ -116,7 +476,7 @@ typedef NS_ENUM(NSInteger, EZRecorderFileType)
 ///-----------------------------------------------------------
 
 /**
- Finishes writes to the audio file and closes it.
+ Finishes writes to the audio file and closes it. With the background writer this waits for everything still buffered to be written.
  */
 -(void)closeAudioFile;
 
@@ -27,12 +27,360 @@
 
 #import "EZAudio.h"
 
+// The most frames converted to float at once before going into the background writers' rings
+static const UInt32 EZRecorderMaximumFrames = 4096;
+
+// The most extra outputs a recorder tees its audio to
+static const UInt32 EZRecorderMaximumOutputs = 8;
+
+// The most history frames drained per append on top of the append's own frames once a pre-roll is triggered
+static const UInt32 EZRecorderPreRollCatchUpFrames = 4096;
+
+// The frames each value of a peak file's finest level summarizes
+static const UInt32 EZRecorderPeakBlockFrames = 256;
+
+// The file type of FLAC files, which are encoded by EZAudioFLACEncoder rather than Core Audio
+static const AudioFileTypeID EZRecorderFLACFileType = 'flac';
+
+// How the background writers' files are written
+typedef struct {
+    UInt32                       channels;
+    EZAudioWAVWriterSampleFormat wavSampleFormat;
+    EZAudioWAVWriterOptions      wavOptions;
+    UInt32                       flacBitsPerSample;
+    UInt32                       flacCompressionLevel;
+    UInt32                       flacThreads;
+} EZRecorderSinkSettings;
+
+// Packed linear PCM in one of the recorder's sample formats
+static AudioStreamBasicDescription EZRecorderLinearPCMFormat(UInt32 channels,
+                                                             Float64 sampleRate,
+                                                             EZRecorderSampleFormat sampleFormat,
+                                                             BOOL isBigEndian)
+{
+    AudioStreamBasicDescription asbd;
+    memset(&asbd, 0, sizeof(asbd));
+    asbd.mFormatID          = kAudioFormatLinearPCM;
+    asbd.mFormatFlags       = kAudioFormatFlagIsPacked;
+    asbd.mFormatFlags      |= sampleFormat == EZRecorderSampleFormatFloat32 ? kAudioFormatFlagIsFloat : kAudioFormatFlagIsSignedInteger;
+    asbd.mFormatFlags      |= isBigEndian ? kAudioFormatFlagIsBigEndian : 0;
+    asbd.mSampleRate        = sampleRate;
+    asbd.mChannelsPerFrame  = channels;
+    switch ( sampleFormat )
+    {
+        case EZRecorderSampleFormatSInt16:
+            asbd.mBitsPerChannel = 16;
+            break;
+        case EZRecorderSampleFormatSInt24:
+            asbd.mBitsPerChannel = 24;
+            break;
+        default:
+            asbd.mBitsPerChannel = 32;
+            break;
+    }
+    asbd.mBytesPerPacket    = (asbd.mBitsPerChannel / 8) * asbd.mChannelsPerFrame;
+    asbd.mFramesPerPacket   = 1;
+    asbd.mBytesPerFrame     = (asbd.mBitsPerChannel / 8) * asbd.mChannelsPerFrame;
+    return asbd;
+}
+
+static EZAudioWAVWriterSampleFormat EZRecorderWAVSampleFormat(EZRecorderSampleFormat sampleFormat)
+{
+    switch ( sampleFormat )
+    {
+        case EZRecorderSampleFormatSInt16:
+            return EZAudioWAVWriterSampleFormatSInt16;
+        case EZRecorderSampleFormatSInt24:
+            return EZAudioWAVWriterSampleFormatSInt24;
+        case EZRecorderSampleFormatSInt32:
+            return EZAudioWAVWriterSampleFormatSInt32;
+        default:
+            return EZAudioWAVWriterSampleFormatFloat32;
+    }
+}
+
+// The ExtAudioFile the background writer's thread writes its float batches to
+typedef struct {
+    ExtAudioFileRef file;
+    AudioBufferList *bufferList;
+    UInt32          channels;
+} EZRecorderExtAudioFileSink;
+
+static bool EZRecorderExtAudioFileSinkWrite(void *context,
+                                            const float * const *source,
+                                            uint32_t frames)
+{
+    EZRecorderExtAudioFileSink *sink = (EZRecorderExtAudioFileSink*)context;
+    for( UInt32 i = 0; i < sink->channels; i++ )
+    {
+        sink->bufferList->mBuffers[i].mData         = (void*)source[i];
+        sink->bufferList->mBuffers[i].mDataByteSize = frames*sizeof(float);
+    }
+    // Synchronous, this is already off the audio thread
+    return ExtAudioFileWrite(sink->file,frames,sink->bufferList) == noErr;
+}
+
+static bool EZRecorderExtAudioFileSinkClose(void *context)
+{
+    EZRecorderExtAudioFileSink *sink = (EZRecorderExtAudioFileSink*)context;
+    OSStatus status = ExtAudioFileDispose(sink->file);
+    free(sink->bufferList);
+    free(sink);
+    return status == noErr;
+}
+
+// Creates a file in the destination's channels for the background writer's thread
+static bool EZRecorderOpenFileSink(CFURLRef url,
+                                   AudioFileTypeID fileTypeID,
+                                   AudioStreamBasicDescription destinationFormat,
+                                   Float64 sampleRate,
+                                   EZRecorderSinkSettings settings,
+                                   EZAudioBackgroundWriterSink *sink)
+{
+    char path[PATH_MAX];
+    UInt32 channels = settings.channels;
+    if( fileTypeID == EZRecorderFLACFileType )
+    {
+        // FLAC files are encoded by the portable encoder, on its own threads as well as the writer's
+        if( !CFURLGetFileSystemRepresentation(url,true,(UInt8*)path,sizeof(path)) )
+        {
+            return false;
+        }
+        EZAudioFLACEncoder *flacEncoder = EZAudioFLACEncoderCreate(path,
+                                                                   channels,
+                                                                   sampleRate,
+                                                                   settings.flacBitsPerSample,
+                                                                   settings.flacCompressionLevel,
+                                                                   settings.flacThreads);
+        if( !flacEncoder )
+        {
+            return false;
+        }
+        *sink = EZAudioBackgroundWriterFLACSink(flacEncoder);
+        return true;
+    }
+    if( fileTypeID == kAudioFileWAVEType )
+    {
+        // WAV files are written by the portable writer, which converts to the sample format, commits the header at every sync and turns into RF64 past 4 GB
+        if( !CFURLGetFileSystemRepresentation(url,true,(UInt8*)path,sizeof(path)) )
+        {
+            return false;
+        }
+        EZAudioWAVWriter *wavWriter = EZAudioWAVWriterCreateWithOptions(path,
+                                                                        channels,
+                                                                        sampleRate,
+                                                                        settings.wavSampleFormat,
+                                                                        settings.wavOptions);
+        if( !wavWriter )
+        {
+            return false;
+        }
+        *sink = EZAudioBackgroundWriterWAVSink(wavWriter);
+        return true;
+    }
+    
+    // Everything else goes through an ExtAudioFile that's handed float
+    ExtAudioFileRef file = NULL;
+    OSStatus status = ExtAudioFileCreateWithURL(url,
+                                                fileTypeID,
+                                                &destinationFormat,
+                                                NULL,
+                                                kAudioFileFlags_EraseFile,
+                                                &file);
+    [EZAudio checkResult:status
+               operation:"Failed to create audio file"];
+    if( status != noErr )
+    {
+        return false;
+    }
+    AudioStreamBasicDescription floatFormat = [EZAudio floatFormatWithNumberOfChannels:channels
+                                                                            sampleRate:sampleRate];
+    status = ExtAudioFileSetProperty(file,
+                                     kExtAudioFileProperty_ClientDataFormat,
+                                     sizeof(floatFormat),
+                                     &floatFormat);
+    [EZAudio checkResult:status
+               operation:"Failed to set the float client format on recorded audio file"];
+    if( status != noErr )
+    {
+        ExtAudioFileDispose(file);
+        return false;
+    }
+    EZRecorderExtAudioFileSink *fileSink = (EZRecorderExtAudioFileSink*)calloc(1,sizeof(EZRecorderExtAudioFileSink));
+    fileSink->file       = file;
+    fileSink->channels   = channels;
+    fileSink->bufferList = (AudioBufferList*)malloc(offsetof(AudioBufferList,mBuffers[0]) + sizeof(AudioBuffer)*channels);
+    fileSink->bufferList->mNumberBuffers = channels;
+    for( UInt32 i = 0; i < channels; i++ )
+    {
+        fileSink->bufferList->mBuffers[i].mNumberChannels = 1;
+    }
+    sink->context = fileSink;
+    sink->write   = EZRecorderExtAudioFileSinkWrite;
+    sink->sync    = NULL;
+    sink->close   = EZRecorderExtAudioFileSinkClose;
+    return true;
+}
+
+// Creates a file for the background writer's thread, called on the writer thread itself for segments
+static bool EZRecorderOpenSink(CFURLRef url,
+                               AudioFileTypeID fileTypeID,
+                               AudioStreamBasicDescription destinationFormat,
+                               UInt32 sourceChannels,
+                               Float64 sampleRate,
+                               EZRecorderSinkSettings settings,
+                               EZAudioBackgroundWriterSink *sink)
+{
+    EZAudioBackgroundWriterSink fileSink;
+    if( !EZRecorderOpenFileSink(url,fileTypeID,destinationFormat,sampleRate,settings,&fileSink) )
+    {
+        return false;
+    }
+    if( settings.channels == sourceChannels )
+    {
+        *sink = fileSink;
+        return true;
+    }
+    
+    // The ring holds the source's channels, they're remixed to the file's on the writer thread
+    if( !EZAudioBackgroundWriterRemixSink(fileSink,sourceChannels,settings.channels,sink) )
+    {
+        if( fileSink.close )
+        {
+            fileSink.close(fileSink.context);
+        }
+        return false;
+    }
+    return true;
+}
+
+// Summarizes the recording into its peak file on the writer thread as well, if it has one
+static void EZRecorderAddPeakFile(EZAudioPeakFile *peakFile,
+                                  EZAudioBackgroundWriterSink *sink)
+{
+    EZAudioBackgroundWriterSink peakSink;
+    if( peakFile && EZAudioBackgroundWriterPeakSink(*sink,peakFile,&peakSink) )
+    {
+        *sink = peakSink;
+    }
+}
+
+// The RMS of each point, the same waveform EZAudioFile computes from the audio itself
+static EZAudioFloatData *EZRecorderWaveformData(EZAudioPeakFile *peakFile,
+                                                UInt32 numberOfPoints)
+{
+    if( numberOfPoints == 0 )
+    {
+        return nil;
+    }
+    UInt32 channels = EZAudioPeakFileChannels(peakFile);
+    float  *rms     = (float*)malloc(sizeof(float)*numberOfPoints*channels);
+    float  **data   = (float**)malloc(sizeof(float*)*channels);
+    EZAudioPeakFileRead(peakFile,0,0,numberOfPoints,NULL,NULL,rms);
+    for( UInt32 i = 0; i < channels; i++ )
+    {
+        data[i] = rms + i*numberOfPoints;
+    }
+    EZAudioFloatData *waveformData = [EZAudioFloatData dataWithNumberOfChannels:channels
+                                                                        buffers:data
+                                                                     bufferSize:numberOfPoints];
+    free(data);
+    free(rms);
+    return waveformData;
+}
+
+// What the background writer's thread needs to open segments and report them
+typedef struct {
+    CFURLRef                    url;
+    AudioFileTypeID             fileTypeID;
+    AudioStreamBasicDescription destinationFormat;
+    UInt32                      channels;
+    Float64                     sampleRate;
+    EZRecorderSinkSettings      settings;
+    EZAudioPeakFile             *peakFile;
+    CFTypeRef                   completion;
+} EZRecorderSegments;
+
+typedef void (^EZRecorderSegmentCompletion)(UInt32 index, SInt64 frames, BOOL succeeded);
+
+// i.e. take.wav -> take_0000.wav
+static NSURL *EZRecorderSegmentURL(NSURL *url, UInt32 index)
+{
+    NSString *name = [NSString stringWithFormat:@"%@_%04u",[[url lastPathComponent] stringByDeletingPathExtension],(unsigned int)index];
+    NSURL *segmentURL = [[url URLByDeletingLastPathComponent] URLByAppendingPathComponent:name];
+    return [url pathExtension].length ? [segmentURL URLByAppendingPathExtension:[url pathExtension]] : segmentURL;
+}
+
+static bool EZRecorderOpenSegment(void *context,
+                                  uint32_t index,
+                                  EZAudioBackgroundWriterSink *sink)
+{
+    // Runs on the writer's own thread, which has no autorelease pool
+    @autoreleasepool
+    {
+        EZRecorderSegments *segments = (EZRecorderSegments*)context;
+        NSURL *url = EZRecorderSegmentURL((__bridge NSURL*)segments->url,index);
+        if( !EZRecorderOpenSink((__bridge CFURLRef)url,
+                                segments->fileTypeID,
+                                segments->destinationFormat,
+                                segments->channels,
+                                segments->sampleRate,
+                                segments->settings,
+                                sink) )
+        {
+            return false;
+        }
+        EZRecorderAddPeakFile(segments->peakFile,sink);
+        return true;
+    }
+}
+
+static void EZRecorderSegmentCompleted(void *context,
+                                       uint32_t index,
+                                       uint64_t frames,
+                                       bool succeeded)
+{
+    EZRecorderSegments *segments = (EZRecorderSegments*)context;
+    EZRecorderSegmentCompletion completion = (__bridge EZRecorderSegmentCompletion)segments->completion;
+    completion(index,(SInt64)frames,succeeded);
+}
+
+static void EZRecorderDiscardSegment(void *context,
+                                     uint32_t index,
+                                     EZAudioBackgroundWriterSink sink)
+{
+    // The segment opened ahead of the last one never got any audio
+    @autoreleasepool
+    {
+        EZRecorderSegments *segments = (EZRecorderSegments*)context;
+        if( sink.close )
+        {
+            sink.close(sink.context);
+        }
+        NSURL *url = EZRecorderSegmentURL((__bridge NSURL*)segments->url,index);
+        [[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+    }
+}
+
 @interface EZRecorder (){
     ExtAudioFileRef             _destinationFile;
+    EZRecorderFileType          _destinationFileType;
     AudioFileTypeID             _destinationFileTypeID;
     CFURLRef                    _destinationFileURL;
     AudioStreamBasicDescription _destinationFormat;
     AudioStreamBasicDescription _sourceFormat;
+    EZAudioBackgroundWriter     *_backgroundWriter;
+    const EZAudioDSPKernel      *_kernel;
+    float                       **_floatBuffers;
+    EZRecorderSegments          *_segments;
+    EZAudioBackgroundWriter     *_outputs[EZRecorderMaximumOutputs];
+    UInt32                      _outputCount;
+    EZAudioRingBuffer           _preRoll;
+    UInt32                      _preRollFrames;
+    AudioBufferList             *_preRollBufferList;
+    AudioBufferList             *_preRollWindow;
+    volatile int32_t            _preRollTriggered;
+    EZAudioPeakFile             *_peakFile;
 }
 
 @end
@@ -43,18 +391,44 @@
 -(EZRecorder*)initWithDestinationURL:(NSURL*)url
                         sourceFormat:(AudioStreamBasicDescription)sourceFormat
                  destinationFileType:(EZRecorderFileType)destinationFileType
+{
+    // A 16-bit source has nothing to gain from float
+    BOOL isInteger = !(sourceFormat.mFormatFlags & kAudioFormatFlagIsFloat);
+    EZRecorderSampleFormat sampleFormat = isInteger && sourceFormat.mBitsPerChannel == 16 ? EZRecorderSampleFormatSInt16 : EZRecorderSampleFormatFloat32;
+    return [self initWithDestinationURL:url
+                           sourceFormat:sourceFormat
+                    destinationFileType:destinationFileType
+                    destinationChannels:sourceFormat.mChannelsPerFrame
+                destinationSampleFormat:sampleFormat
+                                 dither:EZRecorderDitherNone];
+}
+
+-(EZRecorder*)initWithDestinationURL:(NSURL*)url
+                        sourceFormat:(AudioStreamBasicDescription)sourceFormat
+                 destinationFileType:(EZRecorderFileType)destinationFileType
+                 destinationChannels:(UInt32)destinationChannels
+             destinationSampleFormat:(EZRecorderSampleFormat)destinationSampleFormat
+                              dither:(EZRecorderDither)dither
 {
     self = [super init];
     if( self )
     {
         // Set defaults
-        _destinationFile        = NULL;
-        _destinationFileURL     = (__bridge CFURLRef)url;
-        _sourceFormat           = sourceFormat;
-        _destinationFormat      = [EZRecorder recorderFormatForFileType:destinationFileType
-                                                       withSourceFormat:_sourceFormat];
-        _destinationFileTypeID  = [EZRecorder recorderFileTypeIdForFileType:destinationFileType
-                                                           withSourceFormat:_sourceFormat];
+        _destinationFile         = NULL;
+        _destinationFileURL      = (CFURLRef)CFBridgingRetain(url);
+        _sourceFormat            = sourceFormat;
+        _destinationChannels     = destinationChannels > 0 ? destinationChannels : sourceFormat.mChannelsPerFrame;
+        _destinationSampleFormat = destinationSampleFormat;
+        _dither                  = dither;
+        _destinationFileType     = destinationFileType;
+        _destinationFormat       = [EZRecorder recorderFormatForFileType:destinationFileType
+                                                        withSourceFormat:_sourceFormat
+                                                     destinationChannels:_destinationChannels
+                                                            sampleFormat:_destinationSampleFormat];
+        _destinationFileTypeID   = [EZRecorder recorderFileTypeIdForFileType:destinationFileType
+                                                            withSourceFormat:_sourceFormat];
+        _flacCompressionLevel    = 5;
+        _flacEncoderThreads      = (UInt32)[[NSProcessInfo processInfo] activeProcessorCount];
         
         // Initializer the recorder instance
         [self _initializeRecorder];
@@ -72,24 +446,48 @@
                                   destinationFileType:destinationFileType];
 }
 
++(EZRecorder*)recorderWithDestinationURL:(NSURL*)url
+                            sourceFormat:(AudioStreamBasicDescription)sourceFormat
+                     destinationFileType:(EZRecorderFileType)destinationFileType
+                     destinationChannels:(UInt32)destinationChannels
+                 destinationSampleFormat:(EZRecorderSampleFormat)destinationSampleFormat
+                                  dither:(EZRecorderDither)dither
+{
+    return [[EZRecorder alloc] initWithDestinationURL:url
+                                         sourceFormat:sourceFormat
+                                  destinationFileType:destinationFileType
+                                  destinationChannels:destinationChannels
+                              destinationSampleFormat:destinationSampleFormat
+                                               dither:dither];
+}
+
 #pragma mark - Private Configuration
 +(AudioStreamBasicDescription)recorderFormatForFileType:(EZRecorderFileType)fileType
                                        withSourceFormat:(AudioStreamBasicDescription)sourceFormat
+                                    destinationChannels:(UInt32)destinationChannels
+                                           sampleFormat:(EZRecorderSampleFormat)sampleFormat
 {
     AudioStreamBasicDescription asbd;
     switch ( fileType )
     {
         case EZRecorderFileTypeAIFF:
-            asbd = [EZAudio AIFFFormatWithNumberOfChannels:sourceFormat.mChannelsPerFrame
-                                                sampleRate:sourceFormat.mSampleRate];
+            // Plain AIFF has no float samples
+            sampleFormat = sampleFormat == EZRecorderSampleFormatFloat32 ? EZRecorderSampleFormatSInt32 : sampleFormat;
+            asbd = EZRecorderLinearPCMFormat(destinationChannels,
+                                             sourceFormat.mSampleRate,
+                                             sampleFormat,
+                                             YES);
             break;
         case EZRecorderFileTypeM4A:
-            asbd = [EZAudio M4AFormatWithNumberOfChannels:sourceFormat.mChannelsPerFrame
+            asbd = [EZAudio M4AFormatWithNumberOfChannels:destinationChannels
                                                sampleRate:sourceFormat.mSampleRate];
             break;
             
         case EZRecorderFileTypeWAV:
-            asbd = [EZAudio stereoFloatInterleavedFormatWithSampleRate:sourceFormat.mSampleRate];
+            asbd = EZRecorderLinearPCMFormat(destinationChannels,
+                                             sourceFormat.mSampleRate,
+                                             sampleFormat,
+                                             NO);
             break;
             
         default:
@@ -117,6 +515,10 @@
             audioFileTypeID = kAudioFileWAVEType;
             break;
             
+        case EZRecorderFileTypeFLAC:
+            audioFileTypeID = EZRecorderFLACFileType;
+            break;
+            
         default:
             audioFileTypeID = kAudioFileWAVEType;
             break;
@@ -126,6 +528,12 @@
 
 -(void)_initializeRecorder
 {
+    // FLAC files are only created by the background writer's encoder
+    if( _destinationFileTypeID == EZRecorderFLACFileType )
+    {
+        return;
+    }
+    
     // Finish filling out the destination format description
     UInt32 propSize = sizeof(_destinationFormat);
     [EZAudio checkResult:AudioFormatGetProperty(kAudioFormatProperty_FormatInfo,
@@ -153,11 +561,646 @@
     
 }
 
+#pragma mark - Background Writer
+-(BOOL)startBackgroundWriterWithBufferDuration:(NSTimeInterval)bufferDuration
+                                 flushDuration:(NSTimeInterval)flushDuration
+                                    syncPolicy:(EZAudioBackgroundWriterSyncPolicy)syncPolicy
+                                  syncInterval:(NSTimeInterval)syncInterval
+{
+    NSAssert(!_backgroundWriter,@"The recorder's background writer was already started");
+    _kernel = EZAudioDSPKernelForFormat(_sourceFormat);
+    if( _backgroundWriter || (!_destinationFile && _destinationFileTypeID != EZRecorderFLACFileType) || !_kernel )
+    {
+        NSLog(@"The recorder's source format must be packed native endian float or 16-bit integer linear PCM to write in the background");
+        return NO;
+    }
+    
+    // The file is recreated by the writer's sink
+    if( _destinationFile )
+    {
+        [EZAudio checkResult:ExtAudioFileDispose(_destinationFile)
+                   operation:"Failed to close audio file"];
+        _destinationFile = NULL;
+    }
+    UInt32 channels = _sourceFormat.mChannelsPerFrame;
+    EZAudioBackgroundWriterSink sink;
+    if( !EZRecorderOpenSink(_destinationFileURL,
+                            _destinationFileTypeID,
+                            _destinationFormat,
+                            channels,
+                            _sourceFormat.mSampleRate,
+                            [self _sinkSettings],
+                            &sink) )
+    {
+        NSLog(@"Failed to create the audio file for the recorder's background writer");
+        return NO;
+    }
+    [self _createPeakFile];
+    EZRecorderAddPeakFile(_peakFile,&sink);
+    
+    [self _allocateFloatBuffers];
+    _backgroundWriter = EZAudioBackgroundWriterCreate(sink,
+                                                      channels,
+                                                      _sourceFormat.mSampleRate,
+                                                      bufferDuration,
+                                                      flushDuration,
+                                                      syncPolicy,
+                                                      syncInterval);
+    if( !_backgroundWriter )
+    {
+        NSLog(@"Failed to start the recorder's background writer");
+        if( sink.close )
+        {
+            sink.close(sink.context);
+        }
+        [self _closePeakFile];
+        return NO;
+    }
+    return YES;
+}
+
+-(BOOL)startSegmentedBackgroundWriterWithSegmentDuration:(NSTimeInterval)segmentDuration
+                                             segmentSize:(UInt64)segmentSize
+                                          bufferDuration:(NSTimeInterval)bufferDuration
+                                           flushDuration:(NSTimeInterval)flushDuration
+                                              syncPolicy:(EZAudioBackgroundWriterSyncPolicy)syncPolicy
+                                            syncInterval:(NSTimeInterval)syncInterval
+{
+    NSAssert(!_backgroundWriter,@"The recorder's background writer was already started");
+    _kernel = EZAudioDSPKernelForFormat(_sourceFormat);
+    if( _backgroundWriter || (!_destinationFile && _destinationFileTypeID != EZRecorderFLACFileType) || !_kernel )
+    {
+        NSLog(@"The recorder's source format must be packed native endian float or 16-bit integer linear PCM to write in the background");
+        return NO;
+    }
+    
+    // The segment length in frames is whichever of the duration and size comes first
+    UInt32 channels      = _sourceFormat.mChannelsPerFrame;
+    UInt64 segmentFrames = 0;
+    if( segmentDuration > 0.0 )
+    {
+        segmentFrames = (UInt64)(segmentDuration*_sourceFormat.mSampleRate + 0.5);
+    }
+    if( segmentSize > 0 )
+    {
+        UInt32 bytesPerFrame = _destinationFileTypeID == EZRecorderFLACFileType ? 0 : _destinationFormat.mBytesPerFrame;
+        if( bytesPerFrame > 0 )
+        {
+            UInt64 sizeFrames = segmentSize/bytesPerFrame;
+            segmentFrames = segmentFrames > 0 ? MIN(segmentFrames,sizeFrames) : sizeFrames;
+        }
+        else
+        {
+            NSLog(@"Compressed recordings can only be segmented by duration, ignoring the segment size");
+        }
+    }
+    if( segmentFrames == 0 )
+    {
+        NSLog(@"A segmented recording needs a segment duration or size of at least one frame");
+        return NO;
+    }
+    
+    // Only the segments are written, not the file the recorder was created with
+    if( _destinationFile )
+    {
+        [EZAudio checkResult:ExtAudioFileDispose(_destinationFile)
+                   operation:"Failed to close audio file"];
+        _destinationFile = NULL;
+    }
+    [[NSFileManager defaultManager] removeItemAtURL:[self url] error:NULL];
+    
+    __weak EZRecorder *weakSelf = self;
+    NSURL *url = [self url];
+    EZRecorderSegmentCompletion completion = ^(UInt32 index, SInt64 frames, BOOL succeeded){
+        dispatch_async(dispatch_get_main_queue(), ^{
+            EZRecorder *recorder = weakSelf;
+            if( [recorder.delegate respondsToSelector:@selector(recorder:didCompleteSegmentAtURL:numberOfFrames:succeeded:)] )
+            {
+                [recorder.delegate recorder:recorder
+                    didCompleteSegmentAtURL:EZRecorderSegmentURL(url,index)
+                             numberOfFrames:frames
+                                  succeeded:succeeded];
+            }
+        });
+    };
+    _segments = (EZRecorderSegments*)calloc(1,sizeof(EZRecorderSegments));
+    _segments->url               = (CFURLRef)CFBridgingRetain(url);
+    _segments->fileTypeID        = _destinationFileTypeID;
+    _segments->destinationFormat = _destinationFormat;
+    _segments->channels          = channels;
+    _segments->sampleRate        = _sourceFormat.mSampleRate;
+    _segments->settings          = [self _sinkSettings];
+    [self _createPeakFile];
+    _segments->peakFile          = _peakFile;
+    _segments->completion        = CFBridgingRetain([completion copy]);
+    
+    EZAudioBackgroundWriterSegmenter segmenter;
+    segmenter.context          = _segments;
+    segmenter.openSegment      = EZRecorderOpenSegment;
+    segmenter.segmentCompleted = EZRecorderSegmentCompleted;
+    segmenter.discardSegment   = EZRecorderDiscardSegment;
+    [self _allocateFloatBuffers];
+    _backgroundWriter = EZAudioBackgroundWriterCreateSegmented(segmenter,
+                                                               segmentFrames,
+                                                               channels,
+                                                               _sourceFormat.mSampleRate,
+                                                               bufferDuration,
+                                                               flushDuration,
+                                                               syncPolicy,
+                                                               syncInterval);
+    if( !_backgroundWriter )
+    {
+        NSLog(@"Failed to start the recorder's segmented background writer");
+        [self _freeSegments];
+        [self _closePeakFile];
+        return NO;
+    }
+    return YES;
+}
+
+-(BOOL)startMultitrackBackgroundWriterWithDestinationURLs:(NSArray*)urls
+                                            writerThreads:(UInt32)writerThreads
+                                           bufferDuration:(NSTimeInterval)bufferDuration
+                                            flushDuration:(NSTimeInterval)flushDuration
+                                               syncPolicy:(EZAudioBackgroundWriterSyncPolicy)syncPolicy
+                                             syncInterval:(NSTimeInterval)syncInterval
+{
+    NSAssert(!_backgroundWriter,@"The recorder's background writer was already started");
+    _kernel = EZAudioDSPKernelForFormat(_sourceFormat);
+    if( _backgroundWriter || (!_destinationFile && _destinationFileTypeID != EZRecorderFLACFileType) || !_kernel )
+    {
+        NSLog(@"The recorder's source format must be packed native endian float or 16-bit integer linear PCM to write in the background");
+        return NO;
+    }
+    UInt32 channels = _sourceFormat.mChannelsPerFrame;
+    if( urls.count != channels )
+    {
+        NSLog(@"A multitrack recording needs one url per channel, %u urls were given for %u channels",(unsigned int)urls.count,(unsigned int)channels);
+        return NO;
+    }
+
+    // Only the tracks are written, not the file the recorder was created with
+    if( _destinationFile )
+    {
+        [EZAudio checkResult:ExtAudioFileDispose(_destinationFile)
+                   operation:"Failed to close audio file"];
+        _destinationFile = NULL;
+    }
+    [[NSFileManager defaultManager] removeItemAtURL:[self url] error:NULL];
+
+    // Every track is a mono file of the destination's type and sample format
+    AudioStreamBasicDescription trackFormat = _destinationFormat;
+    if( _destinationFileTypeID != EZRecorderFLACFileType )
+    {
+        trackFormat = [EZRecorder recorderFormatForFileType:_destinationFileType
+                                           withSourceFormat:_sourceFormat
+                                        destinationChannels:1
+                                               sampleFormat:_destinationSampleFormat];
+        UInt32 propSize = sizeof(trackFormat);
+        [EZAudio checkResult:AudioFormatGetProperty(kAudioFormatProperty_FormatInfo,
+                                                    0,
+                                                    NULL,
+                                                    &propSize,
+                                                    &trackFormat)
+                   operation:"Failed to fill out rest of track's destination format"];
+    }
+    // The pool spreads the tracks over the threads, a FLAC track's encoder doesn't need threads of its own
+    EZRecorderSinkSettings settings = [self _sinkSettings];
+    settings.channels    = 1;
+    settings.flacThreads = 1;
+    EZAudioBackgroundWriterSink *trackSinks = (EZAudioBackgroundWriterSink*)calloc(channels,sizeof(EZAudioBackgroundWriterSink));
+    UInt32 opened = 0;
+    for( ; opened < channels; opened++ )
+    {
+        NSURL *url = urls[opened];
+        if( !EZRecorderOpenSink((__bridge CFURLRef)url,
+                                _destinationFileTypeID,
+                                trackFormat,
+                                1,
+                                _sourceFormat.mSampleRate,
+                                settings,
+                                &trackSinks[opened]) )
+        {
+            NSLog(@"Failed to create the audio file for the recorder's track %u at %@",(unsigned int)opened,url);
+            break;
+        }
+    }
+    EZAudioBackgroundWriterSink sink;
+    if( opened < channels || !EZAudioBackgroundWriterMultitrackSink(trackSinks,channels,MAX(writerThreads,1),&sink) )
+    {
+        if( opened == channels )
+        {
+            NSLog(@"Failed to start the recorder's track writer threads");
+        }
+        for( UInt32 i = 0; i < opened; i++ )
+        {
+            if( trackSinks[i].close )
+            {
+                trackSinks[i].close(trackSinks[i].context);
+            }
+        }
+        free(trackSinks);
+        return NO;
+    }
+    free(trackSinks);
+    [self _createPeakFile];
+    EZRecorderAddPeakFile(_peakFile,&sink);
+
+    [self _allocateFloatBuffers];
+    _backgroundWriter = EZAudioBackgroundWriterCreate(sink,
+                                                      channels,
+                                                      _sourceFormat.mSampleRate,
+                                                      bufferDuration,
+                                                      flushDuration,
+                                                      syncPolicy,
+                                                      syncInterval);
+    if( !_backgroundWriter )
+    {
+        NSLog(@"Failed to start the recorder's multitrack background writer");
+        if( sink.close )
+        {
+            sink.close(sink.context);
+        }
+        [self _closePeakFile];
+        return NO;
+    }
+    return YES;
+}
+
+-(void)_allocateFloatBuffers
+{
+    // One conversion to float is shared by the background writer and every output
+    if( !_floatBuffers )
+    {
+        _floatBuffers = [EZAudio floatBuffersWithNumberOfFrames:EZRecorderMaximumFrames
+                                               numberOfChannels:_sourceFormat.mChannelsPerFrame];
+    }
+}
+
+-(EZRecorderSinkSettings)_sinkSettings
+{
+    return [self _sinkSettingsWithChannels:_destinationChannels
+                              sampleFormat:_destinationSampleFormat
+                                    dither:_dither];
+}
+
+-(EZRecorderSinkSettings)_sinkSettingsWithChannels:(UInt32)channels
+                                      sampleFormat:(EZRecorderSampleFormat)sampleFormat
+                                            dither:(EZRecorderDither)dither
+{
+    EZRecorderSinkSettings settings;
+    settings.channels             = channels;
+    settings.wavSampleFormat      = EZRecorderWAVSampleFormat(sampleFormat);
+    settings.wavOptions           = EZAudioWAVWriterOptionRF64;
+    settings.wavOptions          |= dither == EZRecorderDitherTriangular ? EZAudioWAVWriterOptionDither : 0;
+    // FLAC only goes as far as 24 bits
+    settings.flacBitsPerSample    = sampleFormat == EZRecorderSampleFormatSInt16 ? 16 : 24;
+    settings.flacCompressionLevel = MIN(_flacCompressionLevel,8);
+    settings.flacThreads          = MAX(_flacEncoderThreads,1);
+    return settings;
+}
+
+-(void)_createPeakFile
+{
+    // The recording still goes ahead without its peak file if that can't be created
+    if( _peakFileURL && !_peakFile )
+    {
+        _peakFile = EZAudioPeakFileCreate([_peakFileURL fileSystemRepresentation],
+                                          _sourceFormat.mChannelsPerFrame,
+                                          _sourceFormat.mSampleRate,
+                                          EZRecorderPeakBlockFrames);
+        if( !_peakFile )
+        {
+            NSLog(@"Failed to create the recorder's peak file at %@",_peakFileURL);
+        }
+    }
+}
+
+-(void)_closePeakFile
+{
+    if( _peakFile )
+    {
+        if( !EZAudioPeakFileClose(_peakFile) )
+        {
+            NSLog(@"Failed to write some of the recorder's peak file at %@",_peakFileURL);
+        }
+        _peakFile = NULL;
+    }
+}
+
+-(void)_freeSegments
+{
+    if( _segments )
+    {
+        CFRelease(_segments->url);
+        CFRelease(_segments->completion);
+        free(_segments);
+        _segments = NULL;
+    }
+}
+
+-(UInt32)completedSegments
+{
+    return _backgroundWriter && _segments ? EZAudioBackgroundWriterCompletedSegments(_backgroundWriter) : 0;
+}
+
+-(UInt32)backgroundWriterOverruns
+{
+    return _backgroundWriter ? EZAudioBackgroundWriterOverruns(_backgroundWriter) : 0;
+}
+
+-(SInt64)backgroundWriterDroppedFrames
+{
+    return _backgroundWriter ? (SInt64)EZAudioBackgroundWriterDroppedFrames(_backgroundWriter) : 0;
+}
+
+#pragma mark - Outputs
+-(BOOL)addOutputWithDestinationURL:(NSURL*)url
+               destinationFileType:(EZRecorderFileType)destinationFileType
+                    bufferDuration:(NSTimeInterval)bufferDuration
+                     flushDuration:(NSTimeInterval)flushDuration
+                        syncPolicy:(EZAudioBackgroundWriterSyncPolicy)syncPolicy
+                      syncInterval:(NSTimeInterval)syncInterval
+{
+    return [self addOutputWithDestinationURL:url
+                         destinationFileType:destinationFileType
+                         destinationChannels:_destinationChannels
+                     destinationSampleFormat:_destinationSampleFormat
+                                      dither:_dither
+                              bufferDuration:bufferDuration
+                               flushDuration:flushDuration
+                                  syncPolicy:syncPolicy
+                                syncInterval:syncInterval];
+}
+
+-(BOOL)addOutputWithDestinationURL:(NSURL*)url
+               destinationFileType:(EZRecorderFileType)destinationFileType
+               destinationChannels:(UInt32)destinationChannels
+           destinationSampleFormat:(EZRecorderSampleFormat)destinationSampleFormat
+                            dither:(EZRecorderDither)dither
+                    bufferDuration:(NSTimeInterval)bufferDuration
+                     flushDuration:(NSTimeInterval)flushDuration
+                        syncPolicy:(EZAudioBackgroundWriterSyncPolicy)syncPolicy
+                      syncInterval:(NSTimeInterval)syncInterval
+{
+    NSAssert(_outputCount < EZRecorderMaximumOutputs,@"A recorder can only have %u outputs",(unsigned int)EZRecorderMaximumOutputs);
+    _kernel = EZAudioDSPKernelForFormat(_sourceFormat);
+    if( !_kernel )
+    {
+        NSLog(@"The recorder's source format must be packed native endian float or 16-bit integer linear PCM to add outputs");
+        return NO;
+    }
+    if( _outputCount >= EZRecorderMaximumOutputs )
+    {
+        return NO;
+    }
+    
+    // Each output has its own destination format and its own writer thread and ring, so a slow encoder only drops its own frames
+    destinationChannels = destinationChannels > 0 ? destinationChannels : _sourceFormat.mChannelsPerFrame;
+    AudioStreamBasicDescription destinationFormat = [EZRecorder recorderFormatForFileType:destinationFileType
+                                                                         withSourceFormat:_sourceFormat
+                                                                      destinationChannels:destinationChannels
+                                                                             sampleFormat:destinationSampleFormat];
+    AudioFileTypeID fileTypeID = [EZRecorder recorderFileTypeIdForFileType:destinationFileType
+                                                          withSourceFormat:_sourceFormat];
+    if( fileTypeID != EZRecorderFLACFileType )
+    {
+        UInt32 propSize = sizeof(destinationFormat);
+        [EZAudio checkResult:AudioFormatGetProperty(kAudioFormatProperty_FormatInfo,
+                                                    0,
+                                                    NULL,
+                                                    &propSize,
+                                                    &destinationFormat)
+                   operation:"Failed to fill out rest of output's destination format"];
+    }
+    EZAudioBackgroundWriterSink sink;
+    if( !EZRecorderOpenSink((__bridge CFURLRef)url,
+                            fileTypeID,
+                            destinationFormat,
+                            _sourceFormat.mChannelsPerFrame,
+                            _sourceFormat.mSampleRate,
+                            [self _sinkSettingsWithChannels:destinationChannels
+                                               sampleFormat:destinationSampleFormat
+                                                     dither:dither],
+                            &sink) )
+    {
+        NSLog(@"Failed to create the audio file for the recorder's output at %@",url);
+        return NO;
+    }
+    EZAudioBackgroundWriter *output = EZAudioBackgroundWriterCreate(sink,
+                                                                    _sourceFormat.mChannelsPerFrame,
+                                                                    _sourceFormat.mSampleRate,
+                                                                    bufferDuration,
+                                                                    flushDuration,
+                                                                    syncPolicy,
+                                                                    syncInterval);
+    if( !output )
+    {
+        NSLog(@"Failed to start the background writer for the recorder's output at %@",url);
+        if( sink.close )
+        {
+            sink.close(sink.context);
+        }
+        return NO;
+    }
+    [self _allocateFloatBuffers];
+    _outputs[_outputCount++] = output;
+    return YES;
+}
+
+-(UInt32)numberOfOutputs
+{
+    return _outputCount;
+}
+
+-(UInt32)overrunsForOutputAtIndex:(UInt32)index
+{
+    return index < _outputCount ? EZAudioBackgroundWriterOverruns(_outputs[index]) : 0;
+}
+
+-(SInt64)droppedFramesForOutputAtIndex:(UInt32)index
+{
+    return index < _outputCount ? (SInt64)EZAudioBackgroundWriterDroppedFrames(_outputs[index]) : 0;
+}
+
+#pragma mark - Pre-roll
+-(BOOL)startPreRollWithDuration:(NSTimeInterval)duration
+{
+    NSAssert(!_preRollBufferList,@"The recorder's pre-roll was already started");
+    UInt32 frames = (UInt32)(duration*_sourceFormat.mSampleRate + 0.5);
+    if( _preRollBufferList || frames == 0 )
+    {
+        return NO;
+    }
+    if( !EZAudioRingBufferInit(&_preRoll,_sourceFormat,frames) )
+    {
+        NSLog(@"Failed to allocate the recorder's pre-roll");
+        return NO;
+    }
+    _preRollFrames    = frames;
+    _preRollTriggered = 0;
+    
+    // The drain buffer list mirrors the ring's layout, the window only points into an append's buffer list
+    UInt32 bufferSizeBytes = EZRecorderMaximumFrames * _sourceFormat.mBytesPerFrame;
+    UInt32 propSize = offsetof( AudioBufferList, mBuffers[0] ) + ( sizeof( AudioBuffer ) * _preRoll.numberOfBuffers );
+    _preRollBufferList                 = (AudioBufferList*)malloc(propSize);
+    _preRollBufferList->mNumberBuffers = _preRoll.numberOfBuffers;
+    _preRollWindow                     = (AudioBufferList*)calloc(1,propSize);
+    _preRollWindow->mNumberBuffers     = _preRoll.numberOfBuffers;
+    for( UInt32 i = 0; i < _preRollBufferList->mNumberBuffers; i++ )
+    {
+        _preRollBufferList->mBuffers[i].mNumberChannels = _sourceFormat.mChannelsPerFrame / _preRoll.numberOfBuffers;
+        _preRollBufferList->mBuffers[i].mDataByteSize   = bufferSizeBytes;
+        _preRollBufferList->mBuffers[i].mData           = malloc(bufferSizeBytes);
+        _preRollWindow->mBuffers[i].mNumberChannels     = _preRollBufferList->mBuffers[i].mNumberChannels;
+    }
+    
+    // The trigger level is measured in float
+    _kernel = EZAudioDSPKernelForFormat(_sourceFormat);
+    if( _kernel )
+    {
+        [self _allocateFloatBuffers];
+    }
+    return YES;
+}
+
+-(void)trigger
+{
+    OSAtomicCompareAndSwap32Barrier(0,1,&_preRollTriggered);
+}
+
+-(BOOL)isPreRolling
+{
+    return _preRollBufferList && !_preRollTriggered;
+}
+
+-(BOOL)_reachesTriggerLevel:(AudioBufferList *)bufferList
+             withBufferSize:(UInt32)bufferSize
+{
+    if( !_kernel || _preRollTriggerLevel <= 0.0f )
+    {
+        return NO;
+    }
+    UInt32 channels = _sourceFormat.mChannelsPerFrame;
+    for( UInt32 offset = 0; offset < bufferSize; offset += EZRecorderMaximumFrames )
+    {
+        UInt32 frames = MIN(bufferSize - offset,EZRecorderMaximumFrames);
+        _kernel->toFloat(bufferList,offset,_floatBuffers,frames,channels);
+        for( UInt32 i = 0; i < channels; i++ )
+        {
+            if( EZAudioDSPRMS(_floatBuffers[i],frames) >= _preRollTriggerLevel )
+            {
+                return YES;
+            }
+        }
+    }
+    return NO;
+}
+
+-(void)_drainPreRollFrames:(UInt32)frames
+{
+    while( frames > 0 )
+    {
+        UInt32 drained = EZAudioRingBufferConsume(&_preRoll,_preRollBufferList,MIN(frames,EZRecorderMaximumFrames));
+        if( drained == 0 )
+        {
+            break;
+        }
+        [self _writeBufferList:_preRollBufferList withBufferSize:drained];
+        frames -= drained;
+    }
+}
+
+-(void)_appendPreRollBufferList:(AudioBufferList *)bufferList
+                 withBufferSize:(UInt32)bufferSize
+{
+    if( !_preRollTriggered && [self _reachesTriggerLevel:bufferList withBufferSize:bufferSize] )
+    {
+        OSAtomicCompareAndSwap32Barrier(0,1,&_preRollTriggered);
+    }
+    if( !_preRollTriggered )
+    {
+        // Only the last pre-roll duration is kept, the oldest frames make room for the newest
+        UInt32 frames = MIN(bufferSize,_preRollFrames);
+        UInt32 fill   = EZAudioRingBufferFillCount(&_preRoll);
+        if( fill + frames > _preRollFrames )
+        {
+            EZAudioRingBufferDiscard(&_preRoll,fill + frames - _preRollFrames);
+        }
+        UInt32 offsetBytes = (bufferSize - frames)*_sourceFormat.mBytesPerFrame;
+        for( UInt32 i = 0; i < _preRollWindow->mNumberBuffers; i++ )
+        {
+            _preRollWindow->mBuffers[i].mData         = (char*)bufferList->mBuffers[i].mData + offsetBytes;
+            _preRollWindow->mBuffers[i].mDataByteSize = frames*_sourceFormat.mBytesPerFrame;
+        }
+        EZAudioRingBufferProduce(&_preRoll,_preRollWindow,frames);
+        return;
+    }
+    
+    // The history goes out ahead of the live audio, which queues behind it in the ring until it has caught up. Each append drains a bounded amount more than it adds so the audio thread never copies all of the history at once and the ring can't overflow.
+    UInt32 fill = EZAudioRingBufferFillCount(&_preRoll);
+    if( fill > 0 )
+    {
+        [self _drainPreRollFrames:MIN(fill,bufferSize + EZRecorderPreRollCatchUpFrames)];
+        if( EZAudioRingBufferFillCount(&_preRoll) > 0 )
+        {
+            EZAudioRingBufferProduce(&_preRoll,bufferList,bufferSize);
+            return;
+        }
+    }
+    [self _writeBufferList:bufferList withBufferSize:bufferSize];
+}
+
+-(void)_freePreRoll
+{
+    if( _preRollBufferList )
+    {
+        EZAudioRingBufferCleanup(&_preRoll);
+        for( UInt32 i = 0; i < _preRollBufferList->mNumberBuffers; i++ )
+        {
+            free(_preRollBufferList->mBuffers[i].mData);
+        }
+        free(_preRollBufferList);
+        free(_preRollWindow);
+        _preRollBufferList = NULL;
+        _preRollWindow     = NULL;
+    }
+}
+
 #pragma mark - Events
 -(void)appendDataFromBufferList:(AudioBufferList *)bufferList
                  withBufferSize:(UInt32)bufferSize
 {
-    if( _destinationFile )
+    if( _preRollBufferList )
+    {
+        [self _appendPreRollBufferList:bufferList withBufferSize:bufferSize];
+        return;
+    }
+    [self _writeBufferList:bufferList withBufferSize:bufferSize];
+}
+
+-(void)_writeBufferList:(AudioBufferList *)bufferList
+         withBufferSize:(UInt32)bufferSize
+{
+    if( _backgroundWriter || _outputCount )
+    {
+        // Just one conversion and a copy into each ring, the writer threads do the rest
+        UInt32 channels = _sourceFormat.mChannelsPerFrame;
+        for( UInt32 offset = 0; offset < bufferSize; offset += EZRecorderMaximumFrames )
+        {
+            UInt32 frames = MIN(bufferSize - offset,EZRecorderMaximumFrames);
+            _kernel->toFloat(bufferList,offset,_floatBuffers,frames,channels);
+            if( _backgroundWriter )
+            {
+                EZAudioBackgroundWriterWrite(_backgroundWriter,(const float * const *)_floatBuffers,frames);
+            }
+            for( UInt32 i = 0; i < _outputCount; i++ )
+            {
+                EZAudioBackgroundWriterWrite(_outputs[i],(const float * const *)_floatBuffers,frames);
+            }
+        }
+    }
+    if( !_backgroundWriter && _destinationFile )
     {
         [EZAudio checkResult:ExtAudioFileWriteAsync(_destinationFile,
                                                     bufferSize,
@@ -168,6 +1211,41 @@
 
 -(void)closeAudioFile
 {
+    // A triggered pre-roll that hasn't caught up yet still has to go out ahead of the writers closing, an untriggered one is dropped
+    if( _preRollBufferList )
+    {
+        if( _preRollTriggered )
+        {
+            [self _drainPreRollFrames:EZAudioRingBufferFillCount(&_preRoll)];
+        }
+        [self _freePreRoll];
+    }
+    if( _backgroundWriter )
+    {
+        // Writes out whatever is still buffered and closes the file on the writer thread
+        if( !EZAudioBackgroundWriterClose(_backgroundWriter) )
+        {
+            NSLog(@"The recorder's background writer dropped frames or failed to write some of them");
+        }
+        _backgroundWriter = NULL;
+        [self _freeSegments];
+    }
+    // The writer thread is done with the peak file, whose last blocks and coarser levels are written now
+    [self _closePeakFile];
+    for( UInt32 i = 0; i < _outputCount; i++ )
+    {
+        if( !EZAudioBackgroundWriterClose(_outputs[i]) )
+        {
+            NSLog(@"The background writer for the recorder's output %u dropped frames or failed to write some of them",(unsigned int)i);
+        }
+        _outputs[i] = NULL;
+    }
+    _outputCount = 0;
+    if( _floatBuffers )
+    {
+        [EZAudio freeFloatBuffers:_floatBuffers numberOfChannels:_sourceFormat.mChannelsPerFrame];
+        _floatBuffers = NULL;
+    }
     if( _destinationFile )
     {
         // Dispose of the audio file reference
@@ -179,15 +1257,69 @@
     }
 }
 
+#pragma mark - Repair
++(BOOL)repairWAVFileAtURL:(NSURL*)url
+           numberOfFrames:(SInt64*)frames
+{
+    uint64_t repairedFrames = 0;
+    EZAudioWAVWriterRepairResult result = EZAudioWAVWriterRepair([url fileSystemRepresentation],&repairedFrames);
+    if( result == EZAudioWAVWriterRepairResultFailed )
+    {
+        NSLog(@"Failed to repair the WAV file at %@",url);
+        return NO;
+    }
+    if( frames )
+    {
+        *frames = (SInt64)repairedFrames;
+    }
+    return YES;
+}
+
+#pragma mark - Waveform
+-(EZAudioFloatData*)waveformDataWithNumberOfPoints:(UInt32)numberOfPoints
+{
+    // While recording the peak file is read as it's built, afterwards it's read back from the disk
+    if( _peakFile )
+    {
+        return EZRecorderWaveformData(_peakFile,numberOfPoints);
+    }
+    return _peakFileURL ? [EZRecorder waveformDataFromPeakFileAtURL:_peakFileURL numberOfPoints:numberOfPoints] : nil;
+}
+
++(EZAudioFloatData*)waveformDataFromPeakFileAtURL:(NSURL*)url
+                                   numberOfPoints:(UInt32)numberOfPoints
+{
+    EZAudioPeakFile *peakFile = EZAudioPeakFileOpen([url fileSystemRepresentation]);
+    if( !peakFile )
+    {
+        NSLog(@"Failed to read the peak file at %@",url);
+        return nil;
+    }
+    EZAudioFloatData *waveformData = EZRecorderWaveformData(peakFile,numberOfPoints);
+    EZAudioPeakFileClose(peakFile);
+    return waveformData;
+}
+
+#pragma mark - Getters
 -(NSURL *)url
 {
     return (__bridge NSURL*)_destinationFileURL;
 }
 
+-(NSURL*)urlForSegmentAtIndex:(UInt32)index
+{
+    return EZRecorderSegmentURL([self url],index);
+}
+
+
 #pragma mark - Dealloc
 -(void)dealloc
 {
     [self closeAudioFile];
+    if( _destinationFileURL )
+    {
+        CFRelease(_destinationFileURL);
+    }
 }
 
 @end
\ No newline at end of file
@@ -24,6 +24,72 @@
 //  THE SOFTWARE.
 
 #import <XCTest/XCTest.h>
+#import <CoreAudio/CoreAudio.h>
+#import "EZAudio.h"
+
+// How many threads change the transport at once and how many changes each makes
+static const NSUInteger EZAudioPlayFileExampleTestsTransportThreads = 4;
+static const NSUInteger EZAudioPlayFileExampleTestsTransportChanges = 2000;
+
+// How long to wait for the audio thread to catch up
+static const NSTimeInterval EZAudioPlayFileExampleTestsTimeout = 5.0;
+
+// How much audio the offline performance tests render, and in what size buffers
+static const SInt64 EZAudioPlayFileExampleTestsRenderFrames     = 44100 * 10;
+static const UInt32 EZAudioPlayFileExampleTestsRenderBufferSize = 512;
+
+// How many single frame buffers the dispatch tests ask a data source for, so the call itself dominates
+static const NSUInteger EZAudioPlayFileExampleTestsDispatchCalls = 1000000;
+
+typedef void (*EZAudioPlayFileExampleTestsFillIMP)(id, SEL, EZOutput *, AudioBufferList *, UInt32);
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioPlayFileExampleTestsToneSource
+//------------------------------------------------------------------------------
+
+// A sawtooth on every channel, cheap enough that a render measures the mixer rather than the sources
+@interface EZAudioPlayFileExampleTestsToneSource : NSObject <EZOutputDataSource>
+- (instancetype)initWithFrequency:(float)frequency sampleRate:(float)sampleRate;
+@end
+
+@implementation EZAudioPlayFileExampleTestsToneSource
+{
+    float _phase;
+    float _increment;
+}
+
+- (instancetype)initWithFrequency:(float)frequency sampleRate:(float)sampleRate
+{
+    self = [super init];
+    if (self)
+    {
+        _increment = frequency / sampleRate;
+    }
+    return self;
+}
+
+- (void)output:(EZOutput *)output shouldFillAudioBufferList:(AudioBufferList *)audioBufferList withNumberOfFrames:(UInt32)frames
+{
+    float phase = _phase;
+    for (UInt32 buffer = 0; buffer < audioBufferList->mNumberBuffers; buffer++)
+    {
+        float *data = (float *)audioBufferList->mBuffers[buffer].mData;
+        phase = _phase;
+        for (UInt32 i = 0; i < frames; i++)
+        {
+            data[i] = 0.1f * (2.0f * phase - 1.0f);
+            phase += _increment;
+            phase -= phase >= 1.0f ? 1.0f : 0.0f;
+        }
+    }
+    _phase = phase;
+}
+
+@end
+
+//------------------------------------------------------------------------------
+#pragma mark - EZAudioPlayFileExampleTests
+//------------------------------------------------------------------------------
 
 @interface EZAudioPlayFileExampleTests : XCTestCase
 
@@ -43,9 +109,188 @@
     [super tearDown];
 }
 
-- (void)testExample
+- (BOOL)hasOutputDevice
 {
-    XCTFail(@"No implementation for \"%s\"", __PRETTY_FUNCTION__);
+    AudioObjectPropertyAddress address = { kAudioHardwarePropertyDefaultOutputDevice,
+                                           kAudioObjectPropertyScopeGlobal,
+                                           kAudioObjectPropertyElementMaster };
+    AudioDeviceID device = kAudioObjectUnknown;
+    UInt32 size = sizeof(device);
+    OSStatus status = AudioObjectGetPropertyData(kAudioObjectSystemObject, &address, 0, NULL, &size, &device);
+    return status == noErr && device != kAudioObjectUnknown;
+}
+
+- (BOOL)waitUntil:(BOOL (^)(void))condition
+{
+    // The player's output queue stops the output once a pause or stop has faded out
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:EZAudioPlayFileExampleTestsTimeout];
+    while (!condition() && [timeout timeIntervalSinceNow] > 0.0)
+    {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    return condition();
+}
+
+- (void)measureMixingSources:(UInt32)sources
+{
+    // Rendered offline, so it runs as fast as it can and doesn't need an output device
+    EZOutput *output = [EZOutput outputWithDataSource:nil];
+    EZAudioMixer *mixer = [[EZAudioMixer alloc] initWithOutput:output maximumNumberOfSources:sources];
+    Float64 sampleRate = mixer.sourceFormat.mSampleRate;
+    for (UInt32 i = 0; i < sources; i++)
+    {
+        EZAudioPlayFileExampleTestsToneSource *source = [[EZAudioPlayFileExampleTestsToneSource alloc] initWithFrequency:110.0f + 10.0f * i
+                                                                                                             sampleRate:sampleRate];
+        XCTAssertTrue([mixer addSource:source]);
+        [mixer setPan:(i % 3) - 1.0f forSource:source];
+    }
+    XCTAssertEqual([mixer numberOfSources], sources);
+
+    [self measureBlock:^{
+        SInt64 rendered = [output renderOfflineFrames:EZAudioPlayFileExampleTestsRenderFrames
+                                           bufferSize:EZAudioPlayFileExampleTestsRenderBufferSize
+                                           usingBlock:^(AudioBufferList *bufferList, UInt32 frames, BOOL *stop) {}];
+        XCTAssertEqual(rendered, EZAudioPlayFileExampleTestsRenderFrames);
+        EZAudioCallbackMetricsSnapshot metrics = output.callbackMetrics;
+        NSLog(@"Mixed %u sources at %.0fx realtime, the longest render took %u us",
+              sources,
+              (metrics.frames / sampleRate) / (metrics.totalMicroseconds / 1.0e6),
+              metrics.maxMicroseconds);
+    }];
+    [mixer removeAllSources];
+}
+
+- (void)testMixingSixtyFourSourcesPerformance
+{
+    [self measureMixingSources:64];
+}
+
+- (void)testMixingOneHundredTwentyEightSourcesPerformance
+{
+    [self measureMixingSources:128];
+}
+
+- (void)measureDispatchResolvedOnce:(BOOL)resolvedOnce
+{
+    EZAudioPlayFileExampleTestsToneSource *source = [[EZAudioPlayFileExampleTestsToneSource alloc] initWithFrequency:440.0f
+                                                                                                         sampleRate:44100.0f];
+    float sample = 0.0f;
+    AudioBufferList bufferList;
+    bufferList.mNumberBuffers = 1;
+    bufferList.mBuffers[0].mNumberChannels = 1;
+    bufferList.mBuffers[0].mDataByteSize = sizeof(sample);
+    bufferList.mBuffers[0].mData = &sample;
+    SEL fill = @selector(output:shouldFillAudioBufferList:withNumberOfFrames:);
+    EZAudioPlayFileExampleTestsFillIMP fillIMP = (EZAudioPlayFileExampleTestsFillIMP)[source methodForSelector:fill];
+
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < EZAudioPlayFileExampleTestsDispatchCalls; i++)
+        {
+            if (resolvedOnce)
+            {
+                // what EZOutput, EZMicrophone and EZAudioFile do now that the data source's methods are resolved when it's set
+                fillIMP(source, fill, nil, &bufferList, 1);
+            }
+            else if ([source respondsToSelector:fill])
+            {
+                // what they used to do on every buffer
+                [source output:nil shouldFillAudioBufferList:&bufferList withNumberOfFrames:1];
+            }
+        }
+    }];
+}
+
+- (void)testResolvedDispatchPerformance
+{
+    [self measureDispatchResolvedOnce:YES];
+}
+
+- (void)testMessageSendDispatchPerformance
+{
+    [self measureDispatchResolvedOnce:NO];
+}
+
+- (void)testOfflineRenderDispatchPerformance
+{
+    // The whole render path with buffers small enough that its per buffer overhead shows
+    EZAudioPlayFileExampleTestsToneSource *source = [[EZAudioPlayFileExampleTestsToneSource alloc] initWithFrequency:440.0f
+                                                                                                         sampleRate:44100.0f];
+    EZOutput *output = [EZOutput outputWithDataSource:source];
+    [self measureBlock:^{
+        SInt64 rendered = [output renderOfflineFrames:EZAudioPlayFileExampleTestsRenderFrames
+                                           bufferSize:16
+                                           usingBlock:^(AudioBufferList *bufferList, UInt32 frames, BOOL *stop) {}];
+        XCTAssertEqual(rendered, EZAudioPlayFileExampleTestsRenderFrames);
+    }];
+}
+
+- (void)testTransportFromSeveralThreads
+{
+    // Build machines often have no audio hardware, there's nothing to render to then
+    if (![self hasOutputDevice])
+    {
+        NSLog(@"Skipping %s, there's no output device", __PRETTY_FUNCTION__);
+        return;
+    }
+
+    NSURL *url = [[NSBundle mainBundle] URLForResource:@"simple-drum-beat" withExtension:@"wav"];
+    XCTAssertNotNil(url);
+    EZAudioPlayer *player = [EZAudioPlayer audioPlayerWithURL:url];
+    player.output = [EZOutput outputWithDataSource:player];
+    SInt64 totalFrames = player.totalFrames;
+    XCTAssertTrue(totalFrames > 0);
+    [player play];
+    XCTAssertTrue(player.output.isPlaying, @"Needs an output device to render to");
+
+    // Hammer the transport while the output renders, seeking within the first quarter of the file
+    dispatch_group_t group = dispatch_group_create();
+    for (NSUInteger thread = 0; thread < EZAudioPlayFileExampleTestsTransportThreads; thread++)
+    {
+        dispatch_group_async(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            for (NSUInteger i = 0; i < EZAudioPlayFileExampleTestsTransportChanges; i++)
+            {
+                SInt64 frame = arc4random_uniform((u_int32_t)(totalFrames / 4));
+                switch (arc4random_uniform(5))
+                {
+                    case 0:
+                        [player play];
+                        break;
+                    case 1:
+                        [player pause];
+                        break;
+                    case 2:
+                        [player stop];
+                        break;
+                    case 3:
+                        [player seekToFrame:frame];
+                        break;
+                    default:
+                        [player seekToFrame:frame atSampleTime:player.sampleTime + arc4random_uniform(1024)];
+                        break;
+                }
+                if (i % 64 == 0)
+                {
+                    usleep(1000);
+                }
+            }
+        });
+    }
+    XCTAssertEqual(dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(60.0 * NSEC_PER_SEC))), 0L,
+                   @"Changing the transport blocked");
+
+    // The last seek lands and playback carries on from there
+    SInt64 target = totalFrames / 2;
+    [player seekToFrame:target];
+    [player play];
+    XCTAssertTrue([self waitUntil:^BOOL{ return player.frameIndex >= target; }],
+                  @"The seek to %lld never landed, the player is at %lld", target, player.frameIndex);
+    XCTAssertTrue(player.frameIndex < totalFrames);
+
+    // And the last stop rewinds and stops the output once it's faded out
+    [player stop];
+    XCTAssertTrue([self waitUntil:^BOOL{ return !player.output.isPlaying; }],
+                  @"The stop never stopped the output");
+    XCTAssertEqual(player.frameIndex, (SInt64)0);
 }
 
 @end